@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "backoff.h"
+#include "global.h"
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CBackoff
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+CBackoff::CBackoff(uint64_t min_usec, uint64_t max_usec) : m_random((unsigned)(getTimeUsec() ^ (uintptr_t)this)) {
+	setLimits(min_usec, max_usec);
+}
+
+void CBackoff::setLimits(uint64_t min_usec, uint64_t max_usec) {
+	m_min_usec = min_usec > 0 ? min_usec : 1;
+	m_max_usec = max_usec > m_min_usec ? max_usec : m_min_usec;
+	reset();
+}
+
+uint64_t CBackoff::next() {
+	uint64_t delay = m_delay;
+	m_delay = m_delay < m_max_usec/2 ? m_delay*2 : m_max_usec;
+
+	uint64_t jitter = delay/2;
+	if(jitter == 0) return(delay);
+	return(delay - jitter + m_random() % (jitter+1));
+}
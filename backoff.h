@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef BACKOFF_H_
+#define BACKOFF_H_
+
+#include <stdint.h>
+#include <random>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CBackoff
+ * exponential backoff with jitter for retries: the delay doubles with
+ * every retry up to a maximum and a random value in [delay/2, delay] is
+ * returned, so that several clients do not retry in lockstep.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CBackoff {
+public:
+	CBackoff(uint64_t min_usec, uint64_t max_usec);
+
+	void setLimits(uint64_t min_usec, uint64_t max_usec);
+	/* start again with the minimum delay */
+	void reset() { m_delay = m_min_usec; }
+	/* the delay until the next retry in micro seconds */
+	uint64_t next();
+
+private:
+	uint64_t m_min_usec;
+	uint64_t m_max_usec;
+	uint64_t m_delay; //before jitter
+	std::minstd_rand m_random;
+};
+
+
+#endif /* BACKOFF_H_ */
@@ -0,0 +1,553 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * benchmark of the PAManager code paths used by the command line tool:
+ * enumeration, selector resolution, volume parsing, formatting, the
+ * signal processing of the meters and mutations. the scenarios run against
+ * the in-memory fake backend and against a private pulseaudio instance
+ * with null sinks (if pulseaudio is installed).
+ */
+
+#include "benchmark.h"
+#include "../tools/pa_server.h"
+#include "../pa_manager.h"
+#include "../pa_backend_fake.h"
+#include "../pa_async_manager.h"
+#include "../pacmdvolume.h"
+#include "../command_line.h"
+#include "../levels.h"
+#include "../loudness.h"
+#include "../spectrum.h"
+
+#include <utility>
+#include <thread>
+#include <future>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+/* fake server layout with about n objects in total */
+static PAFakeConfig fakeLayout(uint32_t n, uint32_t latency_usec=0) {
+	PAFakeConfig config;
+	config.cards=max(1u, n/10);
+	config.sinks=max(1u, n/5); //+ the same number of monitor sources
+	config.sources=max(1u, n/10);
+	config.clients=max(1u, n/10);
+	config.sink_inputs=max(1u, n*3/10);
+	config.latency_usec=latency_usec;
+	return(config);
+}
+
+static bool anySelected(CBenchmark& bench, const string* scenarios, size_t count) {
+	for(size_t i=0; i<count; ++i) {
+		if(bench.selected(scenarios[i])) return(true);
+	}
+	return(false);
+}
+
+/* keeps the compiler from dropping unused results */
+static volatile size_t bench_sink;
+
+
+/* InitPAInfo(): connect and enumerate all objects */
+static void benchInitFake(CBenchmark& bench) {
+	static const uint32_t sizes[]={ 10, 100, 1000, 10000 };
+	static const int samples[]={ 200, 100, 30, 5 };
+	
+	for(size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i) {
+		string name="init/fake/n="+toStr(sizes[i]);
+		if(!bench.selected(name)) continue;
+		
+		PAFakeConfig config=fakeLayout(sizes[i]);
+		for(int k=0; k<samples[i]; ++k) {
+			PAManager manager;
+			PAFakeBackend* backend=new PAFakeBackend(config);
+			bench.begin();
+			manager.Init(backend);
+			bench.end();
+		}
+		bench.report(name);
+	}
+}
+
+/* selector resolution as done for -C and -I */
+static void benchLookup(CBenchmark& bench) {
+	static const uint32_t sizes[]={ 1000, 10000 };
+	const int samples=200;
+	const int ops=10;
+	
+	for(size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i) {
+		string n="/n="+toStr(sizes[i]);
+		string names[]={ "lookup/getSinks"+n, "lookup/getSinks-miss"+n, "lookup/getSinkInputsFromClient"+n };
+		if(!anySelected(bench, names, 3)) continue;
+		
+		PAManager manager;
+		manager.Init(new PAFakeBackend(fakeLayout(sizes[i])));
+		vector<uint32_t> result;
+		
+		if(bench.selected(names[0])) {
+			for(int k=0; k<samples; ++k) {
+				bench.begin();
+				for(int j=0; j<ops; ++j) manager.getSinks("fake_7.", result);
+				bench.end(ops);
+			}
+			bench.report(names[0]);
+		}
+		if(bench.selected(names[1])) {
+			for(int k=0; k<samples; ++k) {
+				bench.begin();
+				for(int j=0; j<ops; ++j) manager.getSinks("no_such_sink", result);
+				bench.end(ops);
+			}
+			bench.report(names[1]);
+		}
+		if(bench.selected(names[2])) {
+			for(int k=0; k<samples; ++k) {
+				bench.begin();
+				for(int j=0; j<ops; ++j) manager.getSinkInputsFromClient("client 7", result);
+				bench.end(ops);
+			}
+			bench.report(names[2]);
+		}
+	}
+}
+
+/* parsing & application of volume strings */
+static void benchVolume(CBenchmark& bench) {
+	static const char* formats[]={ "50%", "30000", "+5%", "-1000", "*1.1", "/1.2", "/20%" };
+	const int n_formats=sizeof(formats)/sizeof(formats[0]);
+	const int samples=2000;
+	
+	string name="volume/applyVolume";
+	if(bench.selected(name)) {
+		vector<string> volumes(formats, formats+n_formats);
+		for(int k=0; k<samples; ++k) {
+			pa_volume_t value=PA_VOLUME_NORM/2;
+			bench.begin();
+			for(int j=0; j<n_formats; ++j) PAManager::applyVolume(volumes[j], value);
+			bench.end(n_formats);
+			bench_sink=value;
+		}
+		bench.report(name);
+	}
+	
+	name="volume/applyVolumeChannel/channels=8";
+	if(bench.selected(name)) {
+		string up="+1%", down="-1%";
+		pa_cvolume volume;
+		pa_cvolume_set(&volume, 8, PA_VOLUME_NORM/2);
+		for(int k=0; k<samples; ++k) {
+			bench.begin();
+			PAManager::applyVolumeChannel(up, volume, NULL);
+			PAManager::applyVolumeChannel(down, volume, NULL);
+			bench.end(2);
+		}
+		bench_sink=volume.values[0];
+		bench.report(name);
+	}
+}
+
+/* Info() of the objects as printed by --list */
+static void benchFormat(CBenchmark& bench) {
+	const uint32_t n=1000;
+	const int samples=50;
+	string suffix="/n="+toStr(n);
+	string names[]={ "format/sink"+suffix, "format/source"+suffix, "format/sink_input"+suffix, "format/card"+suffix };
+	if(!anySelected(bench, names, 4)) return;
+	
+	PAManager manager;
+	manager.Init(new PAFakeBackend(fakeLayout(n)));
+	
+	if(bench.selected(names[0])) {
+		for(int k=0; k<samples; ++k) {
+			size_t len=0;
+			bench.begin();
+			for(pa_dev_list::const_iterator iter=manager.Sinks().begin(); iter!=manager.Sinks().end(); ++iter) {
+				len+=iter->second->Info().length();
+			}
+			bench.end(manager.Sinks().size());
+			bench_sink=len;
+		}
+		bench.report(names[0]);
+	}
+	if(bench.selected(names[1])) {
+		for(int k=0; k<samples; ++k) {
+			size_t len=0;
+			bench.begin();
+			for(pa_dev_list::const_iterator iter=manager.Sources().begin(); iter!=manager.Sources().end(); ++iter) {
+				len+=iter->second->Info().length();
+			}
+			bench.end(manager.Sources().size());
+			bench_sink=len;
+		}
+		bench.report(names[1]);
+	}
+	if(bench.selected(names[2])) {
+		for(int k=0; k<samples; ++k) {
+			size_t len=0;
+			bench.begin();
+			for(pa_sink_input_list::const_iterator iter=manager.SinkInputs().begin(); iter!=manager.SinkInputs().end(); ++iter) {
+				len+=iter->second->Info().length();
+			}
+			bench.end(manager.SinkInputs().size());
+			bench_sink=len;
+		}
+		bench.report(names[2]);
+	}
+	if(bench.selected(names[3])) {
+		for(int k=0; k<samples; ++k) {
+			size_t len=0;
+			bench.begin();
+			for(pa_card_list::const_iterator iter=manager.Cards().begin(); iter!=manager.Cards().end(); ++iter) {
+				len+=iter->second->Info().length();
+			}
+			bench.end(manager.Cards().size());
+			bench_sink=len;
+		}
+		bench.report(names[3]);
+	}
+}
+
+/* the signal processing of the meters on the fragments of a 48kHz record
+ * stream. an operation is 10ms of audio, so mean/100000 is the share of a
+ * core in percent */
+static void benchDsp(CBenchmark& bench) {
+	const uint32_t rate=48000;
+	const size_t fragment=rate/100;
+	const int samples=1000;
+	string names[]={ "dsp/levels/channels=2", "dsp/levels/channels=8", "dsp/loudness/channels=2"
+		, "dsp/loudness/streams=64", "dsp/spectrum/size=4096/third" };
+	if(!anySelected(bench, names, 5)) return;
+	
+	/* 1s of 8 channels, a sine per channel and some noise. streams with
+	 * fewer channels use it as more frames */
+	vector<float> signal(rate*8);
+	uint32_t noise=1;
+	for(size_t i=0; i<signal.size(); ++i) {
+		noise=noise*1664525+1013904223;
+		signal[i]=0.3f*(float)sin(2.0*M_PI*(220.0*(i%8+1))*(i/8)/rate) + 0.01f*((float)(noise>>8)/(1<<24)-0.5f);
+	}
+	
+	static const uint8_t level_channels[]={ 2, 8 };
+	for(size_t i=0; i<2; ++i) {
+		if(!bench.selected(names[i])) continue;
+		uint8_t channels=level_channels[i];
+		size_t fragments=signal.size()/(fragment*channels);
+		SLevels levels(channels);
+		for(int k=0; k<samples; ++k) {
+			bench.begin();
+			levels.add(&signal[(k%fragments)*fragment*channels], fragment);
+			bench.end();
+		}
+		bench_sink=levels.frames;
+		bench.report(names[i]);
+	}
+	
+	/* the stream meter runs a CLoudness per playback stream */
+	static const int streams[]={ 1, 64 };
+	SLoudness values;
+	for(size_t i=0; i<2; ++i) {
+		if(!bench.selected(names[2+i])) continue;
+		size_t fragments=signal.size()/(fragment*2);
+		vector<CLoudness> loudness(streams[i]);
+		for(int j=0; j<streams[i]; ++j) loudness[j].init(rate, 2);
+		for(int k=0; k<samples; ++k) {
+			bench.begin();
+			for(int j=0; j<streams[i]; ++j) loudness[j].process(&signal[((k+j*7)%fragments)*fragment*2], fragment);
+			bench.end();
+		}
+		loudness[0].values(values);
+		bench_sink=(size_t)values.integrated;
+		bench.report(names[2+i]);
+	}
+	
+	/* as --spectrum: mono, 75% overlap, the bands are taken every 100ms */
+	if(bench.selected(names[4])) {
+		size_t fragments=signal.size()/fragment;
+		CSpectrum spectrum;
+		spectrum.init(rate, 4096, 1024, Spectrum_third_octave);
+		vector<float> db;
+		for(int k=0; k<samples; ++k) {
+			bench.begin();
+			spectrum.process(&signal[(k%fragments)*fragment], fragment);
+			if(k%10==9) spectrum.take(db);
+			bench.end();
+		}
+		bench_sink=db.size();
+		bench.report(names[4]);
+	}
+}
+
+/* set the volume of all sinks, one round trip per sink (blocking) vs.
+ * one round trip in total (batched) */
+static void benchMutation(CBenchmark& bench, PAManager& manager, const string& prefix, int samples) {
+	string suffix="/sinks="+toStr(manager.Sinks().size());
+	string blocking=prefix+"/blocking"+suffix;
+	string batched=prefix+"/batched"+suffix;
+	
+	vector<pair<uint32_t, pa_cvolume> > volumes;
+	for(pa_dev_list::const_iterator iter=manager.Sinks().begin(); iter!=manager.Sinks().end(); ++iter) {
+		volumes.push_back(make_pair(iter->first, iter->second->volume));
+	}
+	
+	if(bench.selected(blocking)) {
+		for(int k=0; k<samples; ++k) {
+			bench.begin();
+			for(size_t i=0; i<volumes.size(); ++i) manager.setSinkVolume(volumes[i].first, volumes[i].second);
+			bench.end(volumes.size());
+		}
+		bench.report(blocking);
+	}
+	if(bench.selected(batched)) {
+		for(int k=0; k<samples; ++k) {
+			bench.begin();
+			manager.beginBatch();
+			for(size_t i=0; i<volumes.size(); ++i) manager.setSinkVolume(volumes[i].first, volumes[i].second);
+			manager.flush();
+			bench.end(volumes.size());
+		}
+		bench.report(batched);
+	}
+}
+
+static void benchMutationFake(CBenchmark& bench) {
+	/* a realistic round trip to a local server */
+	const uint32_t rtt_usec=100;
+	const uint32_t n=100;
+	string prefix="mutation/fake-rtt"+toStr(rtt_usec)+"us";
+	string names[]={ prefix+"/blocking/sinks="+toStr(n/5), prefix+"/batched/sinks="+toStr(n/5) };
+	if(!anySelected(bench, names, 2)) return;
+	
+	PAManager manager;
+	manager.Init(new PAFakeBackend(fakeLayout(n, rtt_usec)));
+	benchMutation(bench, manager, prefix, 50);
+}
+
+/* set the volume of all sinks from several threads at once with the
+ * asynchronous manager, every thread waits for its own futures */
+static void setVolumesAsync(PAAsyncManager* manager, const vector<pair<uint32_t, pa_cvolume> >* volumes) {
+	vector<future<bool> > results;
+	for(size_t i=0; i<volumes->size(); ++i) {
+		results.push_back(manager->setSinkVolume((*volumes)[i].first, (*volumes)[i].second));
+	}
+	for(size_t i=0; i<results.size(); ++i) results[i].get();
+}
+
+static void benchMutationAsync(CBenchmark& bench) {
+	static const int threads[]={ 1, 4, 16 };
+	const uint32_t rtt_usec=100;
+	const uint32_t n=100;
+	string prefix="mutation/fake-rtt"+toStr(rtt_usec)+"us/async";
+	
+	PAAsyncManager* manager=NULL;
+	for(size_t i=0; i<sizeof(threads)/sizeof(threads[0]); ++i) {
+		string name=prefix+"/threads="+toStr(threads[i])+"/sinks="+toStr(n/5);
+		if(!bench.selected(name)) continue;
+		if(!manager) {
+			manager=new PAAsyncManager();
+			manager->Init(new PAFakeBackend(fakeLayout(n, rtt_usec)));
+		}
+		
+		shared_ptr<const PASnapshot> objects=manager->snapshot();
+		vector<pair<uint32_t, pa_cvolume> > volumes;
+		for(pa_dev_list::const_iterator iter=objects->Sinks().begin(); iter!=objects->Sinks().end(); ++iter) {
+			volumes.push_back(make_pair(iter->first, iter->second->volume));
+		}
+		
+		for(int k=0; k<50; ++k) {
+			vector<thread> workers;
+			bench.begin();
+			for(int t=0; t<threads[i]; ++t) workers.push_back(thread(setVolumesAsync, manager, &volumes));
+			for(int t=0; t<threads[i]; ++t) workers[t].join();
+			bench.end(volumes.size()*threads[i]);
+		}
+		bench.report(name);
+	}
+	delete(manager);
+}
+
+/* the same against a real server */
+static void benchServer(CBenchmark& bench) {
+	static const uint32_t sizes[]={ 10, 100, 1000 };
+	const int samples=20;
+	
+	for(size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i) {
+		string suffix="/sinks="+toStr(sizes[i]);
+		string names[]={ "init/server"+suffix, "mutation/server/blocking"+suffix, "mutation/server/batched"+suffix };
+		if(!anySelected(bench, names, 3)) continue;
+		
+		CPulseServer server;
+		if(!server.start(sizes[i])) {
+			for(int k=0; k<3; ++k) {
+				if(bench.selected(names[k])) bench.skip(names[k], "failed to start pulseaudio");
+			}
+			continue;
+		}
+		
+		try {
+			if(bench.selected(names[0])) {
+				for(int k=0; k<samples; ++k) {
+					PAManager manager;
+					bench.begin();
+					manager.Init(NULL, server.server().c_str());
+					bench.end();
+				}
+				bench.report(names[0]);
+			}
+			
+			PAManager manager;
+			manager.Init(NULL, server.server().c_str());
+			benchMutation(bench, manager, "mutation/server", samples);
+		} catch(Exception& e) {
+			for(int k=0; k<3; ++k) {
+				if(bench.selected(names[k])) bench.skip(names[k], e.getErrorStr());
+			}
+		}
+	}
+}
+
+/* a volume change through the library on an open connection vs. spawning
+ * the command line tool, which connects & enumerates for every change */
+static void runCli(const string& binary, const string& server, uint32_t sink, const string& volume) {
+	string sink_str=toStr(sink);
+	pid_t pid=fork();
+	ASSERT_THROW_e(pid>=0, EGENERAL, "fork failed");
+	if(pid==0) {
+		int null_fd=open("/dev/null", O_RDWR);
+		if(null_fd>=0) {
+			dup2(null_fd, STDOUT_FILENO);
+			dup2(null_fd, STDERR_FILENO);
+		}
+		execl(binary.c_str(), binary.c_str(), "--server", server.c_str(), "-c", sink_str.c_str()
+				, "-s", volume.c_str(), (char*)NULL);
+		_exit(127);
+	}
+	waitpid(pid, NULL, 0);
+}
+
+static void benchApi(CBenchmark& bench, const string& binary) {
+	const uint32_t sinks=10;
+	const int samples=50;
+	string suffix="/sinks="+toStr(sinks);
+	string names[]={ "api/server/in-process"+suffix, "api/server/spawn"+suffix };
+	if(!anySelected(bench, names, 2)) return;
+	
+	CPulseServer server;
+	if(!server.start(sinks)) {
+		for(int k=0; k<2; ++k) {
+			if(bench.selected(names[k])) bench.skip(names[k], "failed to start pulseaudio");
+		}
+		return;
+	}
+	static const char* volumes[]={ "50%", "51%" };
+	
+	PACmdVolume pacmd;
+	vector<PACmdDevice> devices;
+	if(!pacmd.connect(server.server()) || !pacmd.listSinks(devices) || devices.empty()) {
+		for(int k=0; k<2; ++k) {
+			if(bench.selected(names[k])) bench.skip(names[k], "failed to connect: "+pacmd.lastError());
+		}
+		return;
+	}
+	uint32_t sink=devices[0].index;
+	
+	if(bench.selected(names[0])) {
+		for(int k=0; k<samples; ++k) {
+			bench.begin();
+			pacmd.setSinkVolume(PACmdSelector::Index(sink), volumes[k%2]);
+			bench.end();
+		}
+		bench.report(names[0]);
+	}
+	if(bench.selected(names[1])) {
+		if(access(binary.c_str(), X_OK)!=0) {
+			bench.skip(names[1], binary+" not found");
+			return;
+		}
+		for(int k=0; k<samples; ++k) {
+			bench.begin();
+			runCli(binary, server.server(), sink, volumes[k%2]);
+			bench.end();
+		}
+		bench.report(names[1]);
+	}
+}
+
+
+static void printUsage() {
+	printf("Usage:\n"
+		" " APP_NAME "_bench [-f <filter>] [--no-server] [--binary <path>] [-v]\n"
+		"\n"
+		"  -f, --filter <filter>           only run scenarios containing <filter>\n"
+		"      --no-server                 skip the scenarios with a private pulseaudio\n"
+		"                                  server\n"
+		"      --binary <path>             command line tool for the spawn scenario\n"
+		"                                  (default ./" APP_NAME ")\n"
+		"  -v, --verbose                   print debug messages\n"
+		"  -h, --help                      print this message\n"
+		);
+}
+
+int main(int argc, char *argv[]) {
+	try {
+		CLog::getInstance().setConsoleLevel(WARN);
+		CLog::getInstance().setFileLevel(NONE);
+		CLog::getInstance().setLogDateTime(false);
+		CLog::getInstance().setLogSourceFileAll(false);
+		
+		CCommandLineParser parameters(argc, argv);
+		parameters.addSwitch("help", 'h');
+		parameters.addSwitch("verbose", 'v');
+		parameters.addSwitch("no-server");
+		parameters.addParam("filter", 'f');
+		parameters.addParam("binary", ' ');
+		
+		ECLParsingResult result=parameters.parse();
+		if(result==Parse_unknown_command) {
+			printUsage();
+			printf("\n Unknown command: %s\n", parameters.getUnknownCommand().c_str());
+			return(-1);
+		}
+		if(parameters.getSwitch("help")) {
+			printUsage();
+			return(0);
+		}
+		if(parameters.getSwitch("verbose")) CLog::getInstance().setConsoleLevel(DEBUG);
+		
+		string filter;
+		parameters.getParam("filter", filter);
+		CBenchmark bench(filter);
+		bench.printHeader();
+		
+		benchInitFake(bench);
+		benchLookup(bench);
+		benchVolume(bench);
+		benchFormat(bench);
+		benchDsp(bench);
+		benchMutationFake(bench);
+		benchMutationAsync(bench);
+		if(!parameters.getSwitch("no-server")) {
+			string binary="./" APP_NAME;
+			parameters.getParam("binary", binary);
+			benchServer(bench);
+			benchApi(bench, binary);
+		}
+		
+	} catch(Exception& e) {
+		return(-1);
+	}
+	return(0);
+}
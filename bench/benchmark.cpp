@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "benchmark.h"
+#include "../version.h"
+
+#include <ctime>
+
+
+uint64_t getTimeNsec() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return((uint64_t)t.tv_sec*1000000000ULL + (uint64_t)t.tv_nsec);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CBenchmark
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+CBenchmark::CBenchmark(const string& filter) : m_filter(filter), m_sample_start(0) {
+}
+
+bool CBenchmark::selected(const string& scenario) const {
+	return(m_filter.empty() || scenario.find(m_filter)!=string::npos);
+}
+
+void CBenchmark::printHeader() {
+	printf("# %s %s benchmark, times in ns per operation\n", APP_NAME, getAppVersion().toStr().c_str());
+	printf("%-48s %8s %12s %12s %12s %12s %12s\n", "# scenario", "samples", "mean", "p50", "p90", "p99", "max");
+	fflush(stdout);
+}
+
+void CBenchmark::end(uint32_t ops) {
+	uint64_t duration=getTimeNsec()-m_sample_start;
+	m_samples.record(duration/(ops>0 ? ops : 1));
+}
+
+void CBenchmark::report(const string& scenario) {
+	printf("%-48s %8llu %12llu %12llu %12llu %12llu %12llu\n", scenario.c_str()
+			, (unsigned long long)m_samples.count(), (unsigned long long)m_samples.mean()
+			, (unsigned long long)m_samples.percentile(50), (unsigned long long)m_samples.percentile(90)
+			, (unsigned long long)m_samples.percentile(99), (unsigned long long)m_samples.max());
+	fflush(stdout);
+	m_samples.reset();
+}
+
+void CBenchmark::skip(const string& scenario, const string& reason) {
+	printf("%-48s skipped (%s)\n", scenario.c_str(), reason.c_str());
+	fflush(stdout);
+	m_samples.reset();
+}
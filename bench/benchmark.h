@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "../global.h"
+#include "../latency_histogram.h"
+
+
+uint64_t getTimeNsec(); //monotonic clock in nano seconds
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CBenchmark
+ * measures scenarios and prints one line per scenario:
+ * <scenario> <samples> <mean> <p50> <p90> <p99> <max>
+ * all times are nano seconds per operation. a sample can consist of
+ * several operations, so that fast operations are not dominated by the
+ * clock overhead. the format does not change between runs, so the output
+ * of two releases can be diffed.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CBenchmark {
+public:
+	/* only scenarios containing filter are run ("" runs all) */
+	CBenchmark(const string& filter);
+	
+	bool selected(const string& scenario) const;
+	
+	void printHeader();
+	
+	/* measure a sample of ops operations */
+	void begin() { m_sample_start=getTimeNsec(); }
+	void end(uint32_t ops=1);
+	
+	/* print the collected samples & reset them */
+	void report(const string& scenario);
+	void skip(const string& scenario, const string& reason);
+	
+private:
+	string m_filter;
+	uint64_t m_sample_start;
+	CLatencyHistogram m_samples; //ns per operation
+};
+
+
+#endif /* BENCHMARK_H_ */
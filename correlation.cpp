@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+
+#include "correlation.h"
+
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CCrossCorrelation
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CCrossCorrelation::init(const float* reference, size_t size) {
+	m_reference.assign(reference, reference+size);
+	m_energy=0.0;
+	for(size_t i=0; i<size; ++i) m_energy+=(double)reference[i]*reference[i];
+}
+
+void CCrossCorrelation::correlate(const float* signal, size_t lags, float* out) const {
+	const float* reference=m_reference.empty() ? NULL : &m_reference[0];
+	size_t size=m_reference.size();
+	for(size_t lag=0; lag<lags; ++lag) {
+		const float* p=signal+lag;
+		size_t i=0;
+		float sum=0.0f;
+#ifdef __SSE2__
+		/* 4 independent accumulators hide the latency of the adds */
+		__m128 acc0=_mm_setzero_ps(), acc1=_mm_setzero_ps(), acc2=_mm_setzero_ps(), acc3=_mm_setzero_ps();
+		for(; i+16<=size; i+=16) {
+			acc0=_mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(p+i), _mm_loadu_ps(reference+i)));
+			acc1=_mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(p+i+4), _mm_loadu_ps(reference+i+4)));
+			acc2=_mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(p+i+8), _mm_loadu_ps(reference+i+8)));
+			acc3=_mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(p+i+12), _mm_loadu_ps(reference+i+12)));
+		}
+		for(; i+4<=size; i+=4) acc0=_mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(p+i), _mm_loadu_ps(reference+i)));
+		__m128 acc=_mm_add_ps(_mm_add_ps(acc0, acc1), _mm_add_ps(acc2, acc3));
+		acc=_mm_add_ps(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 0, 3, 2)));
+		acc=_mm_add_ps(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum=_mm_cvtss_f32(acc);
+#endif
+		for(; i<size; ++i) sum+=p[i]*reference[i];
+		out[lag]=sum;
+	}
+}
+
+double CCrossCorrelation::find(const float* signal, size_t count, double& lag) {
+	size_t size=m_reference.size();
+	lag=0.0;
+	if(size==0 || count<size || m_energy<=0.0) return(0.0);
+	
+	size_t lags=count-size+1;
+	m_correlation.resize(lags);
+	correlate(signal, lags, &m_correlation[0]);
+	
+	/* the energy of the signal under the reference slides along */
+	double energy=0.0;
+	for(size_t i=0; i<size; ++i) energy+=(double)signal[i]*signal[i];
+	double best=0.0;
+	size_t best_lag=0;
+	for(size_t k=0; k<lags; ++k) {
+		if(k>0) {
+			energy+=(double)signal[k+size-1]*signal[k+size-1] - (double)signal[k-1]*signal[k-1];
+			if(energy<0.0) energy=0.0;
+		}
+		if(energy<=0.0) continue;
+		double normalized=m_correlation[k]/sqrt(m_energy*energy);
+		if(normalized>best) {
+			best=normalized;
+			best_lag=k;
+		}
+	}
+	
+	/* parabola through the peak & its neighbours */
+	lag=(double)best_lag;
+	if(best_lag>0 && best_lag+1<lags) {
+		double a=m_correlation[best_lag-1], b=m_correlation[best_lag], c=m_correlation[best_lag+1];
+		double denominator=a - 2.0*b + c;
+		if(denominator<0.0) lag+=0.5*(a-c)/denominator;
+	}
+	return(best>1.0 ? 1.0 : best);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+
+#ifndef CORRELATION_H_
+#define CORRELATION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CCrossCorrelation
+ * finds a known reference signal (eg. a chirp) in a recording: the
+ * correlation at every lag is a dot product of the reference with the
+ * recording at that lag, computed with 4 lanes & 4 accumulators of SSE2.
+ * the peak is taken from the normalized correlation, so a loud signal
+ * which is not the reference (eg. music on the device) doesn't win.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CCrossCorrelation {
+public:
+	CCrossCorrelation() : m_energy(0.0) {}
+	
+	void init(const float* reference, size_t size);
+	size_t size() const { return(m_reference.size()); }
+	
+	/* correlation at the lags 0 to lags-1, signal needs lags+size()-1
+	 * samples */
+	void correlate(const float* signal, size_t lags, float* out) const;
+	
+	/* lag of the reference in signal (count samples) with sub-sample
+	 * precision. returns the normalized correlation at that lag (1 is a
+	 * perfect match), 0 if signal is shorter than the reference */
+	double find(const float* signal, size_t count, double& lag);
+	
+private:
+	std::vector<float> m_reference;
+	double m_energy;
+	std::vector<float> m_correlation;
+};
+
+
+#endif /* CORRELATION_H_ */
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * example client of libpacmdvolume: lists the sinks and playback streams
+ * and changes the volume over a single connection. it only needs the
+ * public header and the library:
+ *  g++ example.cpp -lpacmdvolume -lpulse
+ */
+
+#include "../pacmdvolume.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+static void printDevices(const vector<PACmdDevice>& devices) {
+	for(size_t i=0; i<devices.size(); ++i) {
+		const PACmdDevice& device=devices[i];
+		uint32_t percent=device.volume.empty() ? 0 : device.volume[0]*100/PACMD_VOLUME_NORM;
+		printf(" %3u %-40s %3u%%%s\n", device.index, device.name.c_str(), percent, device.bMute ? " (muted)" : "");
+	}
+}
+
+int main(int argc, char *argv[]) {
+	const char* volume=argc>1 ? argv[1] : "+1%";
+	string server=argc>2 ? argv[2] : "";
+	
+	PACmdVolume pacmd;
+	if(!pacmd.connect(server)) {
+		fprintf(stderr, "connect failed: %s\n", pacmd.lastError().c_str());
+		return(1);
+	}
+	
+	vector<PACmdDevice> sinks;
+	pacmd.listSinks(sinks);
+	printf("sinks:\n");
+	printDevices(sinks);
+	
+	vector<PACmdPlayback> playback;
+	pacmd.listPlayback(playback);
+	printf("playback:\n");
+	for(size_t i=0; i<playback.size(); ++i) {
+		printf(" %3u %-30s sink %u\n", playback[i].index, playback[i].client_name.c_str(), playback[i].sink);
+	}
+	
+	/* a single change waits for the server */
+	if(!sinks.empty() && !pacmd.setSinkVolume(PACmdSelector::Index(sinks[0].index), volume)) {
+		fprintf(stderr, "set volume failed: %s\n", pacmd.lastError().c_str());
+	}
+	
+	/* several changes are sent together and cost one round trip */
+	pacmd.beginBatch();
+	pacmd.setSinkVolume(PACmdSelector(), volume);
+	pacmd.setPlaybackVolume(PACmdSelector(), volume);
+	if(!pacmd.flush()) fprintf(stderr, "batch failed: %s\n", pacmd.lastError().c_str());
+	
+	pacmd.listSinks(sinks);
+	printf("sinks after %s:\n", volume);
+	printDevices(sinks);
+	return(0);
+}
@@ -17,6 +17,8 @@
 
 #include "version.h"
 
+#include <ctime>
+
 VERSION getAppVersion() {
 	return(VERSION((int)VERSION_MAJOR, (int)VERSION_MINOR, (int)VERSION_PATCH));
 }
@@ -44,6 +46,12 @@ string getTime() {
 	return(timestr);
 }
 
+uint64_t getTimeUsec() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec*1000000ULL + (uint64_t)ts.tv_nsec/1000);
+}
+
 
 string toStr(int val) {
 	char b[20];
@@ -98,6 +106,25 @@ string roundStr(float val, int digits) {
 	return(string(buffer2));
 }
 
+string jsonStr(const string& str) {
+	string ret="\"";
+	for(size_t i=0; i<str.length(); ++i) {
+		unsigned char c=(unsigned char)str[i];
+		if(c=='"' || c=='\\') {
+			ret+='\\';
+			ret+=(char)c;
+		} else if(c<0x20) {
+			char buffer[8];
+			sprintf(buffer, "\\u%04x", c);
+			ret+=buffer;
+		} else {
+			ret+=(char)c;
+		}
+	}
+	ret+='"';
+	return(ret);
+}
+
 bool isInteger(const string& str, int* istr) {
 	size_t i=0;
 	if(str.length() > 0 && str[0]=='-') ++i;
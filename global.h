@@ -23,6 +23,7 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <stdint.h>
 using namespace std;
 
 #include "config.h"
@@ -36,6 +37,8 @@ using namespace std;
 string getDate(); //format: DD.MM.YY
 string getTime(); //format: HH:MM:SS
 
+uint64_t getTimeUsec(); //monotonic clock in micro seconds
+
 
 
 /* useful string functions */
@@ -52,6 +55,8 @@ string& replace(string& str, const string& find, const string& replace);
 
 string roundStr(float val, int digits);
 
+string jsonStr(const string& str); //quoted & escaped json string
+
 bool isInteger(const string& str, int* istr); //converts str to int if str is numerical & returns true
 
 #endif /* GLOBAL_H_ */
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "latency_histogram.h"
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CLatencyHistogram
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLatencyHistogram::CLatencyHistogram() {
+	reset();
+}
+
+int CLatencyHistogram::bucketIndex(uint64_t value) {
+	if(value < SUB_BUCKETS) return((int)value);
+
+	int magnitude = 63 - __builtin_clzll(value); // >= SUB_BUCKET_BITS
+	int sub_bucket = (int)(value >> (magnitude-SUB_BUCKET_BITS)) & (SUB_BUCKETS-1);
+	return((magnitude-SUB_BUCKET_BITS+1)*SUB_BUCKETS + sub_bucket);
+}
+
+uint64_t CLatencyHistogram::bucketUpperBound(int index) {
+	if(index < SUB_BUCKETS) return((uint64_t)index);
+
+	int magnitude = index/SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+	uint64_t sub_bucket = (uint64_t)(index%SUB_BUCKETS + SUB_BUCKETS);
+	return(((sub_bucket+1) << (magnitude-SUB_BUCKET_BITS)) - 1);
+}
+
+void CLatencyHistogram::record(uint64_t usec) {
+	const uint64_t max_value = (1ULL<<MAX_VALUE_BITS)-1;
+	if(usec > max_value) usec = max_value;
+
+	m_buckets[bucketIndex(usec)].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	m_sum.fetch_add(usec, std::memory_order_relaxed);
+
+	uint64_t cur_max = m_max.load(std::memory_order_relaxed);
+	while(usec > cur_max && !m_max.compare_exchange_weak(cur_max, usec
+			, std::memory_order_relaxed)) {
+	}
+}
+
+void CLatencyHistogram::reset() {
+	for(int i=0; i<BUCKET_COUNT; ++i) m_buckets[i].store(0, std::memory_order_relaxed);
+	m_count.store(0, std::memory_order_relaxed);
+	m_sum.store(0, std::memory_order_relaxed);
+	m_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t CLatencyHistogram::mean() const {
+	uint64_t n = count();
+	if(n == 0) return(0);
+	return(m_sum.load(std::memory_order_relaxed) / n);
+}
+
+uint64_t CLatencyHistogram::percentile(double p) const {
+	uint64_t n = count();
+	if(n == 0) return(0);
+	if(p < 0.0) p = 0.0;
+	if(p > 100.0) p = 100.0;
+
+	uint64_t rank = (uint64_t)(p/100.0*(double)n + 0.5);
+	if(rank < 1) rank = 1;
+
+	uint64_t seen = 0;
+	for(int i=0; i<BUCKET_COUNT; ++i) {
+		seen += m_buckets[i].load(std::memory_order_relaxed);
+		if(seen >= rank) {
+			uint64_t value = bucketUpperBound(i);
+			return(value < max() ? value : max());
+		}
+	}
+	return(max());
+}
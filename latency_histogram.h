@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <atomic>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CLatencyHistogram
+ * fixed size histogram with logarithmic buckets (hdr style): each power of 2
+ * is split into 16 linear sub buckets, so the relative error of a
+ * percentile is below 6.25%. values are in micro seconds and clamped to
+ * 2^40 us.
+ *
+ * record() is lock-free and does not allocate, so it can be called from
+ * any thread (eg. from pulseaudio callbacks).
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CLatencyHistogram {
+public:
+	CLatencyHistogram();
+
+	void record(uint64_t usec);
+	void reset();
+
+	uint64_t count() const { return(m_count.load(std::memory_order_relaxed)); }
+	uint64_t max() const { return(m_max.load(std::memory_order_relaxed)); }
+	uint64_t mean() const; //0 if empty
+
+	/* percentile in [0, 100]. returns 0 if empty */
+	uint64_t percentile(double p) const;
+
+private:
+	enum {
+		SUB_BUCKET_BITS = 4,
+		SUB_BUCKETS = 1<<SUB_BUCKET_BITS,
+		MAX_VALUE_BITS = 40,
+		BUCKET_COUNT = (MAX_VALUE_BITS-SUB_BUCKET_BITS+1)*SUB_BUCKETS
+	};
+
+	static int bucketIndex(uint64_t value);
+	static uint64_t bucketUpperBound(int index);
+
+	std::atomic<uint64_t> m_buckets[BUCKET_COUNT];
+	std::atomic<uint64_t> m_count;
+	std::atomic<uint64_t> m_sum;
+	std::atomic<uint64_t> m_max;
+};
+
+
+#endif /* LATENCY_HISTOGRAM_H_ */
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "level_table.h"
+
+#include <cmath>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CLevelTable
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLevelTable::CLevelTable(size_t capacity) : m_capacity(capacity), m_slots(new SSlot[capacity]) {
+	m_free.reserve(capacity);
+	for(size_t i=0; i<capacity; ++i) {
+		SSlot& slot = m_slots[i];
+		slot.seq.store(0, std::memory_order_relaxed);
+		slot.key.store(PA_INVALID_INDEX, std::memory_order_relaxed);
+		slot.channels.store(0, std::memory_order_relaxed);
+		for(int k=0; k<LEVEL_TABLE_CHANNELS; ++k) {
+			slot.peak[k].store(0.0f, std::memory_order_relaxed);
+			slot.rms[k].store(0.0f, std::memory_order_relaxed);
+		}
+		for(int k=0; k<4; ++k) slot.loudness[k].store(-HUGE_VAL, std::memory_order_relaxed);
+		slot.time.store(0, std::memory_order_relaxed);
+		slot.updates.store(0, std::memory_order_relaxed);
+		/* the lowest slots are used first */
+		m_free.push_back((int)(capacity-1-i));
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+CLevelTable::~CLevelTable() {
+	delete[] m_slots;
+}
+
+void CLevelTable::beginWrite(SSlot& slot) {
+	slot.seq.store(slot.seq.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+void CLevelTable::endWrite(SSlot& slot) {
+	slot.seq.store(slot.seq.load(std::memory_order_relaxed)+1, std::memory_order_release);
+}
+
+int CLevelTable::acquire(uint32_t key) {
+	if(m_free.empty()) return(-1);
+	int index = m_free.back();
+	m_free.pop_back();
+
+	SSlot& slot = m_slots[index];
+	beginWrite(slot);
+	slot.key.store(key, std::memory_order_relaxed);
+	slot.channels.store(0, std::memory_order_relaxed);
+	for(int k=0; k<4; ++k) slot.loudness[k].store(-HUGE_VAL, std::memory_order_relaxed);
+	slot.time.store(0, std::memory_order_relaxed);
+	slot.updates.store(0, std::memory_order_relaxed);
+	endWrite(slot);
+	return(index);
+}
+
+void CLevelTable::release(int index) {
+	if(index < 0 || (size_t)index >= m_capacity) return;
+	SSlot& slot = m_slots[index];
+	beginWrite(slot);
+	slot.key.store(PA_INVALID_INDEX, std::memory_order_relaxed);
+	endWrite(slot);
+	m_free.push_back(index);
+}
+
+void CLevelTable::update(int index, const SLevels& levels, uint64_t time, const SLoudness* loudness) {
+	if(index < 0 || (size_t)index >= m_capacity) return;
+	SSlot& slot = m_slots[index];
+	uint8_t channels = levels.channels < LEVEL_TABLE_CHANNELS ? levels.channels : LEVEL_TABLE_CHANNELS;
+
+	beginWrite(slot);
+	slot.channels.store(channels, std::memory_order_relaxed);
+	for(uint8_t k=0; k<channels; ++k) {
+		slot.peak[k].store(levels.peak[k], std::memory_order_relaxed);
+		slot.rms[k].store((float)levels.rms(k), std::memory_order_relaxed);
+	}
+	if(loudness) {
+		slot.loudness[0].store(loudness->momentary, std::memory_order_relaxed);
+		slot.loudness[1].store(loudness->short_term, std::memory_order_relaxed);
+		slot.loudness[2].store(loudness->integrated, std::memory_order_relaxed);
+		slot.loudness[3].store(loudness->range, std::memory_order_relaxed);
+	}
+	slot.time.store(time, std::memory_order_relaxed);
+	slot.updates.store(slot.updates.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+	endWrite(slot);
+}
+
+bool CLevelTable::read(int index, SLevelEntry& entry) const {
+	if(index < 0 || (size_t)index >= m_capacity) return(false);
+	const SSlot& slot = m_slots[index];
+
+	while(true) {
+		uint32_t seq = slot.seq.load(std::memory_order_acquire);
+		if(seq & 1) continue;
+
+		entry.key = slot.key.load(std::memory_order_relaxed);
+		entry.channels = (uint8_t)slot.channels.load(std::memory_order_relaxed);
+		if(entry.channels > LEVEL_TABLE_CHANNELS) entry.channels = LEVEL_TABLE_CHANNELS;
+		for(int k=0; k<LEVEL_TABLE_CHANNELS; ++k) {
+			entry.peak[k] = slot.peak[k].load(std::memory_order_relaxed);
+			entry.rms[k] = slot.rms[k].load(std::memory_order_relaxed);
+		}
+		entry.loudness.momentary = slot.loudness[0].load(std::memory_order_relaxed);
+		entry.loudness.short_term = slot.loudness[1].load(std::memory_order_relaxed);
+		entry.loudness.integrated = slot.loudness[2].load(std::memory_order_relaxed);
+		entry.loudness.range = slot.loudness[3].load(std::memory_order_relaxed);
+		entry.time = slot.time.load(std::memory_order_relaxed);
+		entry.updates = slot.updates.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(slot.seq.load(std::memory_order_relaxed) == seq) break;
+	}
+	return(entry.key != PA_INVALID_INDEX);
+}
+
+void CLevelTable::snapshot(std::vector<SLevelEntry>& entries) const {
+	entries.clear();
+	SLevelEntry entry;
+	for(size_t i=0; i<m_capacity; ++i) {
+		if(read((int)i, entry)) entries.push_back(entry);
+	}
+}
+
+bool CLevelTable::find(uint32_t key, SLevelEntry& entry) const {
+	for(size_t i=0; i<m_capacity; ++i) {
+		if(m_slots[i].key.load(std::memory_order_relaxed) == key && read((int)i, entry) && entry.key == key) return(true);
+	}
+	return(false);
+}
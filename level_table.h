@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef LEVEL_TABLE_H_
+#define LEVEL_TABLE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+#include "levels.h"
+#include "loudness.h"
+
+
+#define LEVEL_TABLE_CHANNELS 2
+
+/* a copy of a table entry */
+struct SLevelEntry {
+	uint32_t key;
+	uint8_t channels;
+	float peak[LEVEL_TABLE_CHANNELS];
+	float rms[LEVEL_TABLE_CHANNELS];
+	SLoudness loudness; //-HUGE_VAL if not measured
+	uint64_t time; //getTimeUsec() of the update
+	uint32_t updates; //number of updates since the slot was acquired
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CLevelTable
+ * fixed number of level slots, written by one thread and read by any
+ * number of threads without locks: every slot is a seqlock, a reader
+ * copies it and retries if it was written meanwhile. the memory is
+ * allocated once, so it does not grow when keys come and go.
+ *
+ * acquire(), release() and update() must be called from the writer
+ * thread only.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CLevelTable {
+public:
+	CLevelTable(size_t capacity);
+	~CLevelTable();
+
+	size_t capacity() const { return(m_capacity); }
+
+	/* returns the slot for key, -1 if the table is full */
+	int acquire(uint32_t key);
+	void release(int slot);
+	/* publish the levels (at most LEVEL_TABLE_CHANNELS channels) and the
+	 * loudness if it's not NULL */
+	void update(int slot, const SLevels& levels, uint64_t time, const SLoudness* loudness=NULL);
+
+	/* false if the slot is free */
+	bool read(int slot, SLevelEntry& entry) const;
+	/* all used slots */
+	void snapshot(std::vector<SLevelEntry>& entries) const;
+	/* the entry of key, false if there is none */
+	bool find(uint32_t key, SLevelEntry& entry) const;
+
+private:
+	struct SSlot {
+		std::atomic<uint32_t> seq; //odd while it's written
+		std::atomic<uint32_t> key; //PA_INVALID_INDEX if free
+		std::atomic<uint32_t> channels;
+		std::atomic<float> peak[LEVEL_TABLE_CHANNELS];
+		std::atomic<float> rms[LEVEL_TABLE_CHANNELS];
+		std::atomic<double> loudness[4]; //as in SLoudness
+		std::atomic<uint64_t> time;
+		std::atomic<uint32_t> updates;
+	};
+
+	void beginWrite(SSlot& slot);
+	void endWrite(SSlot& slot);
+
+	size_t m_capacity;
+	SSlot* m_slots;
+	std::vector<int> m_free; //writer only
+};
+
+
+#endif /* LEVEL_TABLE_H_ */
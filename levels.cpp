@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "levels.h"
+
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+void measureLevels(const float* samples, size_t frames, uint8_t channels, float* peak, double* sum_square) {
+	if(channels==0) return;
+	size_t count=frames*channels;
+	size_t i=0;
+	
+#ifdef __SSE2__
+	/* a block of 4*channels samples is loaded as channels vectors, lane j
+	 * of vector k then always belongs to channel (4*k+j)%channels. the
+	 * lanes are folded into the channels at the end */
+	__m128 max_acc[PA_CHANNELS_MAX];
+	__m128 sum_acc[PA_CHANNELS_MAX];
+	const __m128 abs_mask=_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	size_t block=4*(size_t)channels;
+	if(count>=block) {
+		for(uint8_t k=0; k<channels; ++k) {
+			max_acc[k]=_mm_setzero_ps();
+			sum_acc[k]=_mm_setzero_ps();
+		}
+		for(; i+block<=count; i+=block) {
+			const float* p=samples+i;
+			for(uint8_t k=0; k<channels; ++k) {
+				__m128 v=_mm_loadu_ps(p+4*k);
+				max_acc[k]=_mm_max_ps(max_acc[k], _mm_and_ps(v, abs_mask));
+				sum_acc[k]=_mm_add_ps(sum_acc[k], _mm_mul_ps(v, v));
+			}
+		}
+		float lane_max[4], lane_sum[4];
+		for(uint8_t k=0; k<channels; ++k) {
+			_mm_storeu_ps(lane_max, max_acc[k]);
+			_mm_storeu_ps(lane_sum, sum_acc[k]);
+			for(int j=0; j<4; ++j) {
+				int channel=(4*k+j)%channels;
+				if(lane_max[j]>peak[channel]) peak[channel]=lane_max[j];
+				sum_square[channel]+=lane_sum[j];
+			}
+		}
+	}
+#endif
+	
+	/* rest (i is a multiple of channels) */
+	for(; i<count; ++i) {
+		int channel=(int)(i%channels);
+		float v=samples[i];
+		float a=fabsf(v);
+		if(a>peak[channel]) peak[channel]=a;
+		sum_square[channel]+=(double)v*v;
+	}
+}
+
+static float blockPeak(const float* samples, size_t count) {
+	float peak=0.0f;
+	size_t i=0;
+#ifdef __SSE2__
+	if(count>=4) {
+		const __m128 abs_mask=_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		__m128 max_acc=_mm_setzero_ps();
+		for(; i+4<=count; i+=4) max_acc=_mm_max_ps(max_acc, _mm_and_ps(_mm_loadu_ps(samples+i), abs_mask));
+		max_acc=_mm_max_ps(max_acc, _mm_shuffle_ps(max_acc, max_acc, _MM_SHUFFLE(1, 0, 3, 2)));
+		max_acc=_mm_max_ps(max_acc, _mm_shuffle_ps(max_acc, max_acc, _MM_SHUFFLE(2, 3, 0, 1)));
+		peak=_mm_cvtss_f32(max_acc);
+	}
+#endif
+	for(; i<count; ++i) {
+		float a=fabsf(samples[i]);
+		if(a>peak) peak=a;
+	}
+	return(peak);
+}
+
+float followEnvelope(const float* samples, size_t frames, size_t block_frames, float release, float& envelope) {
+	if(block_frames==0) block_frames=1;
+	float max_envelope=0.0f;
+	for(size_t i=0; i<frames; i+=block_frames) {
+		float peak=blockPeak(samples+i, frames-i<block_frames ? frames-i : block_frames);
+		envelope*=release;
+		if(peak>envelope) envelope=peak;
+		if(envelope>max_envelope) max_envelope=envelope;
+	}
+	return(max_envelope);
+}
+
+void countPeaks(const float* samples, size_t count, float clip_level, float near_level, SPeakCount& counts) {
+	float peak=counts.peak;
+	size_t i=0;
+#ifdef __SSE2__
+	if(count>=4) {
+		const __m128 abs_mask=_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const __m128 clip=_mm_set1_ps(clip_level);
+		const __m128 near=_mm_set1_ps(near_level);
+		__m128 max_acc=_mm_setzero_ps();
+		/* a true comparison is -1 in the lane, subtracting it counts */
+		__m128i clip_acc=_mm_setzero_si128();
+		__m128i near_acc=_mm_setzero_si128();
+		for(; i+4<=count; i+=4) {
+			__m128 a=_mm_and_ps(_mm_loadu_ps(samples+i), abs_mask);
+			max_acc=_mm_max_ps(max_acc, a);
+			clip_acc=_mm_sub_epi32(clip_acc, _mm_castps_si128(_mm_cmpge_ps(a, clip)));
+			near_acc=_mm_sub_epi32(near_acc, _mm_castps_si128(_mm_cmpge_ps(a, near)));
+		}
+		max_acc=_mm_max_ps(max_acc, _mm_shuffle_ps(max_acc, max_acc, _MM_SHUFFLE(1, 0, 3, 2)));
+		max_acc=_mm_max_ps(max_acc, _mm_shuffle_ps(max_acc, max_acc, _MM_SHUFFLE(2, 3, 0, 1)));
+		if(_mm_cvtss_f32(max_acc)>peak) peak=_mm_cvtss_f32(max_acc);
+		uint32_t lanes[4];
+		_mm_storeu_si128((__m128i*)lanes, clip_acc);
+		counts.clipped+=(uint64_t)lanes[0]+lanes[1]+lanes[2]+lanes[3];
+		_mm_storeu_si128((__m128i*)lanes, near_acc);
+		counts.near+=(uint64_t)lanes[0]+lanes[1]+lanes[2]+lanes[3];
+	}
+#endif
+	for(; i<count; ++i) {
+		float a=fabsf(samples[i]);
+		if(a>peak) peak=a;
+		if(a>=clip_level) ++counts.clipped;
+		if(a>=near_level) ++counts.near;
+	}
+	counts.peak=peak;
+}
+
+double levelToDb(double level) {
+	if(level<=1e-6) return(-120.0);
+	return(20.0*log10(level));
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** struct SLevels
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SLevels::reset(uint8_t level_channels) {
+	channels=level_channels<=PA_CHANNELS_MAX ? level_channels : PA_CHANNELS_MAX;
+	frames=0;
+	for(uint32_t i=0; i<PA_CHANNELS_MAX; ++i) {
+		peak[i]=0.0f;
+		sum_square[i]=0.0;
+	}
+}
+
+void SLevels::add(const float* samples, size_t add_frames) {
+	measureLevels(samples, add_frames, channels, peak, sum_square);
+	frames+=add_frames;
+}
+
+double SLevels::rms(uint8_t channel) const {
+	if(frames==0) return(0.0);
+	return(sqrt(sum_square[channel]/(double)frames));
+}
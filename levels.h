@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef LEVELS_H_
+#define LEVELS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pulse/pulseaudio.h>
+
+
+/* accumulate the peak (max. absolute value) and the sum of squares of
+ * every channel of interleaved float32 samples. peak & sum_square have
+ * channels entries and are not reset */
+void measureLevels(const float* samples, size_t frames, uint8_t channels, float* peak, double* sum_square);
+
+/* peak envelope of mono samples: the peaks of blocks of block_frames
+ * (computed with SIMD) with an instant attack and a release by the factor
+ * release per block. envelope is the state of the follower, returns the
+ * max. of the envelope over the samples */
+float followEnvelope(const float* samples, size_t frames, size_t block_frames, float release, float& envelope);
+
+/* counters of countPeaks(), not reset by it */
+struct SPeakCount {
+	uint64_t clipped; //samples at or above the clip level
+	uint64_t near; //samples at or above the near level (including the clipped)
+	float peak;
+};
+
+/* count the samples of any channel whose absolute value reaches clip_level
+ * resp. near_level (computed with SIMD) and keep their max. */
+void countPeaks(const float* samples, size_t count, float clip_level, float near_level, SPeakCount& counts);
+
+/* linear level to dBFS, -120 for silence */
+double levelToDb(double level);
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** struct SLevels
+ * peak & RMS per channel over all fragments added since the last reset
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct SLevels {
+	SLevels(uint8_t level_channels=0) { reset(level_channels); }
+
+	void reset(uint8_t level_channels);
+	void add(const float* samples, size_t frames);
+
+	double rms(uint8_t channel) const;
+
+	uint8_t channels;
+	uint64_t frames;
+	float peak[PA_CHANNELS_MAX];
+	double sum_square[PA_CHANNELS_MAX];
+};
+
+
+#endif /* LEVELS_H_ */
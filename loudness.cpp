@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "loudness.h"
+
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CLoudness
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+CLoudness::CLoudness() : m_rate(0), m_channels(0), m_groups(0), m_block_frames(1)
+	, m_momentary_histogram(HISTOGRAM_BINS), m_short_term_histogram(HISTOGRAM_BINS) {
+	memset(&m_shelf, 0, sizeof(m_shelf));
+	memset(&m_highpass, 0, sizeof(m_highpass));
+	reset();
+}
+
+void CLoudness::init(uint32_t rate, uint8_t channels) {
+	if(channels>MAX_GROUPS*4) channels=MAX_GROUPS*4;
+	m_rate=rate;
+	m_channels=channels;
+	m_groups=(uint8_t)((channels+3)/4);
+	m_block_frames=rate/10>0 ? rate/10 : 1;
+	
+	/* K-weighting for any rate (the BS.1770 coefficients are for 48kHz) */
+	double f0=1681.974450955533;
+	double gain=3.999843853973347;
+	double q=0.7071752369554196;
+	double k=tan(M_PI*f0/rate);
+	double vh=pow(10.0, gain/20.0);
+	double vb=pow(vh, 0.4996667741545416);
+	double a0=1.0+k/q+k*k;
+	m_shelf.b0=(float)((vh+vb*k/q+k*k)/a0);
+	m_shelf.b1=(float)(2.0*(k*k-vh)/a0);
+	m_shelf.b2=(float)((vh-vb*k/q+k*k)/a0);
+	m_shelf.a1=(float)(2.0*(k*k-1.0)/a0);
+	m_shelf.a2=(float)((1.0-k/q+k*k)/a0);
+	
+	f0=38.13547087602444;
+	q=0.5003270373238773;
+	k=tan(M_PI*f0/rate);
+	a0=1.0+k/q+k*k;
+	m_highpass.b0=1.0f;
+	m_highpass.b1=-2.0f;
+	m_highpass.b2=1.0f;
+	m_highpass.a1=(float)(2.0*(k*k-1.0)/a0);
+	m_highpass.a2=(float)((1.0-k/q+k*k)/a0);
+	
+	for(int i=0; i<MAX_GROUPS*4; ++i) m_weight[i]=i<channels ? 1.0f : 0.0f;
+	if(channels==6) {
+		m_weight[3]=0.0f; //LFE
+		m_weight[4]=m_weight[5]=1.41f;
+	}
+	reset();
+}
+
+void CLoudness::reset() {
+	memset(m_state, 0, sizeof(m_state));
+	m_frames_in_block=0;
+	m_block_sum=0.0;
+	for(int i=0; i<SHORT_TERM_BLOCKS; ++i) m_blocks[i]=0.0;
+	m_block_count=0;
+	m_momentary_histogram.assign(HISTOGRAM_BINS, 0);
+	m_short_term_histogram.assign(HISTOGRAM_BINS, 0);
+}
+
+void CLoudness::process(const float* samples, size_t frames) {
+	if(m_channels==0) return;
+	while(frames>0) {
+		size_t count=m_block_frames-m_frames_in_block;
+		if(count>frames) count=frames;
+		filter(samples, count);
+		samples+=count*m_channels;
+		frames-=count;
+		m_frames_in_block+=(uint32_t)count;
+		if(m_frames_in_block==m_block_frames) finishBlock();
+	}
+}
+
+void CLoudness::filter(const float* samples, size_t frames) {
+	for(uint8_t group=0; group<m_groups; ++group) {
+		int first=group*4;
+		int lanes=m_channels-first<4 ? m_channels-first : 4;
+		
+#ifdef __SSE2__
+		/* transposed direct form II, a lane per channel */
+		__m128 sb0=_mm_set1_ps(m_shelf.b0), sb1=_mm_set1_ps(m_shelf.b1), sb2=_mm_set1_ps(m_shelf.b2);
+		__m128 sa1=_mm_set1_ps(m_shelf.a1), sa2=_mm_set1_ps(m_shelf.a2);
+		__m128 ha1=_mm_set1_ps(m_highpass.a1), ha2=_mm_set1_ps(m_highpass.a2);
+		__m128 s1=_mm_loadu_ps(&m_state[0][first]);
+		__m128 s2=_mm_loadu_ps(&m_state[1][first]);
+		__m128 h1=_mm_loadu_ps(&m_state[2][first]);
+		__m128 h2=_mm_loadu_ps(&m_state[3][first]);
+		__m128 sum=_mm_setzero_ps();
+		float frame[4]={0.0f, 0.0f, 0.0f, 0.0f};
+		
+		const float* p=samples+first;
+		for(size_t i=0; i<frames; ++i, p+=m_channels) {
+			__m128 x;
+			if(lanes==4) {
+				x=_mm_loadu_ps(p);
+			} else {
+				for(int j=0; j<lanes; ++j) frame[j]=p[j];
+				x=_mm_loadu_ps(frame);
+			}
+			__m128 y=_mm_add_ps(_mm_mul_ps(sb0, x), s1);
+			s1=_mm_sub_ps(_mm_add_ps(_mm_mul_ps(sb1, x), s2), _mm_mul_ps(sa1, y));
+			s2=_mm_sub_ps(_mm_mul_ps(sb2, x), _mm_mul_ps(sa2, y));
+			/* high pass: b = 1, -2, 1 */
+			__m128 z=_mm_add_ps(y, h1);
+			h1=_mm_sub_ps(_mm_add_ps(_mm_sub_ps(h2, y), _mm_sub_ps(_mm_setzero_ps(), y)), _mm_mul_ps(ha1, z));
+			h2=_mm_sub_ps(y, _mm_mul_ps(ha2, z));
+			sum=_mm_add_ps(sum, _mm_mul_ps(z, z));
+		}
+		_mm_storeu_ps(&m_state[0][first], s1);
+		_mm_storeu_ps(&m_state[1][first], s2);
+		_mm_storeu_ps(&m_state[2][first], h1);
+		_mm_storeu_ps(&m_state[3][first], h2);
+		float lane_sum[4];
+		_mm_storeu_ps(lane_sum, sum);
+		for(int j=0; j<lanes; ++j) m_block_sum+=(double)m_weight[first+j]*lane_sum[j];
+#else
+		for(int j=0; j<lanes; ++j) {
+			int channel=first+j;
+			float s1=m_state[0][channel], s2=m_state[1][channel], h1=m_state[2][channel], h2=m_state[3][channel];
+			double sum=0.0;
+			const float* p=samples+channel;
+			for(size_t i=0; i<frames; ++i, p+=m_channels) {
+				float x=*p;
+				float y=m_shelf.b0*x+s1;
+				s1=m_shelf.b1*x+s2-m_shelf.a1*y;
+				s2=m_shelf.b2*x-m_shelf.a2*y;
+				float z=y+h1;
+				h1=-2.0f*y+h2-m_highpass.a1*z;
+				h2=y-m_highpass.a2*z;
+				sum+=z*z;
+			}
+			m_state[0][channel]=s1; m_state[1][channel]=s2; m_state[2][channel]=h1; m_state[3][channel]=h2;
+			m_block_sum+=m_weight[channel]*sum;
+		}
+#endif
+	}
+	
+	/* don't let the states of a silent signal decay into denormals */
+	for(int k=0; k<4; ++k) {
+		for(int channel=0; channel<m_channels; ++channel) {
+			if(fabsf(m_state[k][channel])<1e-15f) m_state[k][channel]=0.0f;
+		}
+	}
+}
+
+static double energyToLoudness(double energy) {
+	if(energy<=0.0) return(-HUGE_VAL);
+	return(-0.691+10.0*log10(energy));
+}
+
+int CLoudness::histogramBin(double loudness) {
+	int bin=(int)floor((loudness+70.0)*10.0);
+	if(bin<0) return(-1);
+	if(bin>=HISTOGRAM_BINS) bin=HISTOGRAM_BINS-1;
+	return(bin);
+}
+
+double CLoudness::binEnergy(int bin) {
+	/* center of the bin */
+	double loudness=-70.0+(bin+0.5)/10.0;
+	return(pow(10.0, (loudness+0.691)/10.0));
+}
+
+double CLoudness::windowEnergy(int blocks) const {
+	double sum=0.0;
+	for(int i=0; i<blocks; ++i) sum+=m_blocks[(m_block_count-1-i+SHORT_TERM_BLOCKS)%SHORT_TERM_BLOCKS];
+	return(sum/blocks);
+}
+
+void CLoudness::finishBlock() {
+	m_blocks[m_block_count%SHORT_TERM_BLOCKS]=m_block_sum/m_frames_in_block;
+	++m_block_count;
+	m_block_sum=0.0;
+	m_frames_in_block=0;
+	
+	/* gating blocks of 400ms with 75% overlap, short term values for the
+	 * range every 100ms (>= 10Hz as required by Tech 3342) */
+	if(m_block_count>=MOMENTARY_BLOCKS) {
+		int bin=histogramBin(energyToLoudness(windowEnergy(MOMENTARY_BLOCKS)));
+		if(bin>=0) ++m_momentary_histogram[bin];
+	}
+	if(m_block_count>=SHORT_TERM_BLOCKS) {
+		int bin=histogramBin(energyToLoudness(windowEnergy(SHORT_TERM_BLOCKS)));
+		if(bin>=0) ++m_short_term_histogram[bin];
+	}
+}
+
+double CLoudness::gatedLoudness(const std::vector<uint32_t>& histogram, double gate) {
+	int first=histogramBin(gate);
+	if(first<0) first=0;
+	double sum=0.0;
+	uint64_t count=0;
+	for(int i=first; i<HISTOGRAM_BINS; ++i) {
+		sum+=histogram[i]*binEnergy(i);
+		count+=histogram[i];
+	}
+	if(count==0) return(-HUGE_VAL);
+	return(energyToLoudness(sum/count));
+}
+
+void CLoudness::values(SLoudness& loudness) const {
+	loudness.momentary=m_block_count>=MOMENTARY_BLOCKS ? energyToLoudness(windowEnergy(MOMENTARY_BLOCKS)) : -HUGE_VAL;
+	loudness.short_term=m_block_count>=SHORT_TERM_BLOCKS ? energyToLoudness(windowEnergy(SHORT_TERM_BLOCKS)) : -HUGE_VAL;
+	
+	/* the absolute gate (-70 LUFS) is the start of the histogram, the
+	 * relative gate is 10 LU below */
+	double ungated=gatedLoudness(m_momentary_histogram, -70.0);
+	loudness.integrated=std::isinf(ungated) ? ungated : gatedLoudness(m_momentary_histogram, ungated-10.0);
+	
+	/* range: 10th to 95th percentile of the short term values above the
+	 * relative gate of -20 LU */
+	loudness.range=-HUGE_VAL;
+	ungated=gatedLoudness(m_short_term_histogram, -70.0);
+	if(std::isinf(ungated)) return;
+	int first=histogramBin(ungated-20.0);
+	if(first<0) first=0;
+	uint64_t count=0;
+	for(int i=first; i<HISTOGRAM_BINS; ++i) count+=m_short_term_histogram[i];
+	if(count==0) return;
+	uint64_t low_rank=(uint64_t)(count*0.10), high_rank=(uint64_t)(count*0.95);
+	if(high_rank>=count) high_rank=count-1;
+	int low=-1, high=-1;
+	uint64_t seen=0;
+	for(int i=first; i<HISTOGRAM_BINS && high<0; ++i) {
+		seen+=m_short_term_histogram[i];
+		if(low<0 && seen>low_rank) low=i;
+		if(seen>high_rank) high=i;
+	}
+	loudness.range=(high-low)/10.0;
+}
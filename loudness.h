@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef LOUDNESS_H_
+#define LOUDNESS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+
+/* loudness in LUFS resp. LU, -HUGE_VAL if not measured yet */
+struct SLoudness {
+	double momentary; //400ms window
+	double short_term; //3s window
+	double integrated; //gated, since the start
+	double range; //loudness range (LRA)
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CLoudness
+ * loudness measurement as in ITU-R BS.1770-4 and EBU R128 / Tech 3342.
+ * the signal is K-weighted (a high shelf and a high pass biquad), the
+ * mean square is collected in blocks of 100ms. the gated values are
+ * kept in histograms with 0.1 LU bins, so the memory does not grow with
+ * the duration.
+ *
+ * the filters run on 4 channels at once (SSE2).
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CLoudness {
+public:
+	CLoudness();
+	
+	/* the channels are weighted like 5.1 (FL FR FC LFE RL RR) if there are
+	 * 6 channels, all other layouts get weight 1 */
+	void init(uint32_t rate, uint8_t channels);
+	void reset();
+	
+	/* interleaved float32 */
+	void process(const float* samples, size_t frames);
+	
+	void values(SLoudness& loudness) const;
+	
+private:
+	enum {
+		MAX_GROUPS = 8, //of 4 channels
+		SHORT_TERM_BLOCKS = 30,
+		MOMENTARY_BLOCKS = 4,
+		HISTOGRAM_BINS = 800 //-70 to +10 LUFS
+	};
+	
+	struct SBiquad {
+		float b0, b1, b2, a1, a2;
+	};
+	
+	void filter(const float* samples, size_t frames);
+	void finishBlock();
+	double windowEnergy(int blocks) const;
+	
+	static int histogramBin(double loudness);
+	static double binEnergy(int bin);
+	static double gatedLoudness(const std::vector<uint32_t>& histogram, double gate);
+	
+	uint32_t m_rate;
+	uint8_t m_channels;
+	uint8_t m_groups;
+	SBiquad m_shelf;
+	SBiquad m_highpass;
+	float m_weight[MAX_GROUPS*4];
+	/* filter states, per channel: shelf z1 z2, high pass z1 z2 */
+	float m_state[4][MAX_GROUPS*4];
+	
+	uint32_t m_block_frames; //100ms
+	uint32_t m_frames_in_block;
+	double m_block_sum;
+	double m_blocks[SHORT_TERM_BLOCKS]; //ring of the mean squares of the last blocks
+	uint32_t m_block_count;
+	
+	std::vector<uint32_t> m_momentary_histogram; //integrated loudness
+	std::vector<uint32_t> m_short_term_histogram; //loudness range
+};
+
+
+#endif /* LOUDNESS_H_ */
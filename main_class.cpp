@@ -14,11 +14,31 @@
 
 #include "main_class.h"
 #include "version.h"
+#include "trace.h"
+#include "pa_backend_pulse.h"
+#include "pa_backend_record.h"
+#include "pa_backend_replay.h"
+#include "pa_selector.h"
+#include "pa_meter.h"
+#include "pa_stream_meter.h"
+#include "pa_normalizer.h"
+#include "pa_ducker.h"
+#include "pa_agc.h"
+#include "pa_gate.h"
+#include "pa_spectrum.h"
+#include "pa_clip_guard.h"
+#include "pa_suspender.h"
+#include "pa_latency_probe.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstdarg>
 #include <cstring>
+#include <csignal>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <glob.h>
 
 /*////////////////////////////////////////////////////////////////////////////////////////////////
  ** class CMain
@@ -49,6 +69,11 @@ void CMain::parseCommandLine(int argc, char *argv[]) {
 	m_parameters->addSwitch("help", 'h');
 	m_parameters->addSwitch("version");
 	m_parameters->addSwitch("verbose", 'v');
+	m_parameters->addParam("trace", ' ');
+	m_parameters->addSwitch("stats");
+	m_parameters->addParam("server", ' ');
+	m_parameters->addParam("record", ' ');
+	m_parameters->addParam("replay", ' ');
 	
 	m_parameters->addParam("card", 'c');
 	m_parameters->addParam("card-name", 'C');
@@ -69,6 +94,28 @@ void CMain::parseCommandLine(int argc, char *argv[]) {
 	m_parameters->addParam("index", 'i');
 	m_parameters->addParam("client-name", 'I');
 	
+	m_parameters->addSwitch("meter");
+	m_parameters->addSwitch("meter-source");
+	m_parameters->addSwitch("meter-playback");
+	m_parameters->addSwitch("meter-peak");
+	m_parameters->addSwitch("loudness");
+	m_parameters->addParam("meter-interval", ' ');
+	m_parameters->addParam("meter-time", ' ');
+	m_parameters->addParam("normalize", ' ');
+	m_parameters->addParam("duck", ' ');
+	m_parameters->addParam("duck-ramp", ' ');
+	m_parameters->addParam("agc", ' ');
+	m_parameters->addParam("gate", ' ');
+	m_parameters->addParam("gate-hold", ' ');
+	m_parameters->addParam("spectrum", ' ');
+	m_parameters->addSwitch("spectrum-source");
+	m_parameters->addParam("spectrum-size", ' ');
+	m_parameters->addSwitch("clip-guard");
+	m_parameters->addParam("suspend-idle", ' ');
+	m_parameters->addParam("silence-level", ' ');
+	m_parameters->addSwitch("measure-latency");
+	m_parameters->addParam("measure-buffer", ' ');
+	
 	
 	m_cl_parse_result=m_parameters->parse();
 	
@@ -80,6 +127,15 @@ void CMain::printHelp() {
 		" "APP_NAME" [-v] [-c <c> or -C <c>] -s <volume> [-n <channels>]\n"
 		" "APP_NAME" [-v] [-i <idx> or -I <c>] -p <volume> [-n <channels>]\n"
 		" "APP_NAME" [-v] -c <c> or -C <c> --set-profile <profile>\n"
+		" "APP_NAME" [-v] [-c <c> or -C <c>] --meter [--meter-interval <ms>]\n"
+		" "APP_NAME" [-v] [-i <idx> or -I <c>] --normalize <LUFS>\n"
+		" "APP_NAME" [-v] --duck <triggers>:<targets>[:<dB>] [--duck-ramp <ms>]\n"
+		" "APP_NAME" [-v] [-c <c> or -C <c>] --agc <dBFS>\n"
+		" "APP_NAME" [-v] [-c <c> or -C <c>] --gate <dBFS> [--gate-hold <ms>]\n"
+		" "APP_NAME" [-v] [-c <c> or -C <c>] --spectrum <bands> [--spectrum-source]\n"
+		" "APP_NAME" [-v] [-c <c> or -C <c>] --clip-guard\n"
+		" "APP_NAME" [-v] [-c <c> or -C <c>] --suspend-idle <seconds>\n"
+		" "APP_NAME" [-v] -c <c> or -C <c> --measure-latency [--measure-buffer <ms>]\n"
 		" "APP_NAME" --version\n"
 		"\n"
 		"  -l, --list                      list all cards, sinks, sources and playbacks\n"
@@ -107,12 +163,101 @@ void CMain::printHelp() {
 		"     -n, --channels <channels>    specify channels\n"
 		"                                  (comma-separated list with channel indexes)\n"
 		
+		"\n"
+		"      --meter                     print the peak and RMS levels (dBFS) of the\n"
+		"                                  sinks as json lines, one per sink & interval\n"
+		"      --meter-source              same for the sources\n"
+		"      --meter-playback            same for the playback streams (or the ones\n"
+		"                                  selected with -i or -I)\n"
+		"      --meter-interval <ms>       interval of the levels (default 100)\n"
+		"      --meter-time <seconds>      stop after <seconds> (default: never)\n"
+		"      --meter-peak                let the server detect the peaks (less cpu,\n"
+		"                                  but no RMS)\n"
+		"      --loudness                  add the loudness (EBU R128: momentary,\n"
+		"                                  short-term & integrated LUFS, range in LU)\n"
+		"                                  to --meter*, or to the listing after\n"
+		"                                  measuring for --meter-time (default 3)\n"
+		"      --normalize <LUFS>          keep the short-term loudness of the playback\n"
+		"                                  streams (or the ones selected with -i or -I)\n"
+		"                                  near <LUFS> (eg. -23) by adjusting their\n"
+		"                                  volume every --meter-interval, until\n"
+		"                                  interrupted or --meter-time. prints the\n"
+		"                                  changes as json lines. a volume changed by\n"
+		"                                  the user is kept for 30s, the volumes are\n"
+		"                                  restored at the end\n"
+		"      --duck <triggers>:<targets>[:<dB>]\n"
+		"                                  while a playback stream with a trigger\n"
+		"                                  media.role exists, lower the streams with a\n"
+		"                                  target role by <dB> (default -20), eg.\n"
+		"                                  --duck phone,event:music,video. * is every\n"
+		"                                  other role. can be given several times,\n"
+		"                                  runs until interrupted or --meter-time\n"
+		"      --duck-ramp <ms>            duration of the volume ramps (default 150)\n"
+		"      --agc <dBFS>                automatic gain control: keep the speech level\n"
+		"                                  of the sources (or the ones selected with\n"
+		"                                  -c or -C, without monitors) near <dBFS> RMS\n"
+		"                                  (eg. -20) by adjusting their volume every\n"
+		"                                  --meter-interval, until interrupted or\n"
+		"                                  --meter-time. prints the changes as json lines\n"
+		"      --gate <dBFS>               noise gate: lower the volume of the sources\n"
+		"                                  (or the ones selected with -c or -C, without\n"
+		"                                  monitors) by 40dB when their level stays\n"
+		"                                  6dB below <dBFS> for --gate-hold, restore it\n"
+		"                                  when the level passes <dBFS>. prints the\n"
+		"                                  transitions & the latency statistics as json\n"
+		"      --gate-hold <ms>            hold time of the gate (default 1500)\n"
+		"      --spectrum <bands>          spectrum of the sink (or the one selected with\n"
+		"                                  -c or -C) every --meter-interval as json\n"
+		"                                  lines in dBFS, until interrupted or\n"
+		"                                  --meter-time. <bands> is octave, third\n"
+		"                                  (1/3 octave) or bins (every FFT bin)\n"
+		"      --spectrum-source           the spectrum of a source instead\n"
+		"      --spectrum-size <n>         FFT size, a power of 2 (default 4096), the\n"
+		"                                  transforms overlap by 75%%\n"
+		"      --clip-guard                detect clipped & near full scale (-1dBFS)\n"
+		"                                  samples on the monitors of the sinks (or the\n"
+		"                                  ones selected with -c or -C). if a sink clips\n"
+		"                                  for 0.5s, its volume or the one of its\n"
+		"                                  loudest stream is lowered by 1dB, but only\n"
+		"                                  above 100%% and not below. prints the events\n"
+		"                                  every --meter-interval as json lines, until\n"
+		"                                  interrupted or --meter-time\n"
+		"      --suspend-idle <seconds>    suspend the sinks & sources (or the ones\n"
+		"                                  selected with -c or -C) which are silent for\n"
+		"                                  <seconds> and have no playing stream, resume\n"
+		"                                  them when a stream appears.\n"
+		"                                  prints the state changes with the time in\n"
+		"                                  the previous state and the time per state at\n"
+		"                                  the end as json lines, runs until\n"
+		"                                  interrupted or --meter-time\n"
+		"      --silence-level <dBFS>      peak level below which a device is silent\n"
+		"                                  (default -80)\n"
+		"      --measure-latency           play 5 chirps into the sink selected with -c\n"
+		"                                  or -C, find them on its monitor and print\n"
+		"                                  the measured delay next to the latencies\n"
+		"                                  reported by the server as a json line.\n"
+		"                                  the chirps are audible, use a null sink\n"
+		"      --measure-buffer <ms>       buffer requested by the test stream\n"
+		"                                  (default 50)\n"
 		"\n"
 		"  -c, --card <idx>                specify card index\n"
 		"  -C, --card-name <name>          specify card name\n"
 		"                                  (can also be a substring of the name)\n"
 		"\n"
+		"      --server <server>           connect to <server> instead of the default\n"
+		"                                  server (eg. unix:/path/to/socket)\n"
+		"                                  a comma-separated list or a glob pattern of\n"
+		"                                  socket paths runs on all servers in parallel,\n"
+		"                                  the output lines are tagged with the server\n"
+		"      --record <file>             write all objects received from the server\n"
+		"                                  to a capture <file>\n"
+		"      --replay <file>             use the objects of a capture <file> instead\n"
+		"                                  of connecting to a server\n"
 		"  -v, --verbose                   print debug messages\n"
+		"      --trace <file>              write a chrome trace (json) of all pulseaudio\n"
+		"                                  operations to <file>\n"
+		"      --stats                     print latency statistics (count, p50, p90,\n"
+		"                                  p99, max) per pulseaudio operation type\n"
 		"  -h, --help                      print this message\n"
 		"  --version                       print the version\n"
 		"\n"
@@ -177,245 +322,1024 @@ void CMain::processArgs() {
 	
 	if(m_parameters->getSwitch("verbose")) CLog::getInstance().setConsoleLevel(DEBUG);
 	
-	/* connect to pulseaudio */
-	m_pa_manager.Init();
+	string trace_file;
+	if(m_parameters->getParam("trace", trace_file)) CTrace::getInstance().open(trace_file);
 	
-	/* get card */
-	uint32_t sink_card_idx=-1; //-2: card is not found, -1: use all, 0: use vector
-	vector<uint32_t> sink_card_indexes;
-	uint32_t source_card_idx=-1;
-	vector<uint32_t> source_card_indexes;
-	uint32_t card_idx=-1;
-	vector<uint32_t> card_indexes;
+	SActions actions;
+	parseActions(actions);
 	
+	vector<string> servers;
+	string server;
+	while(m_parameters->getParam("server", server)) parseServerList(server, servers);
 	
+	PABackend* backend=NULL;
+	string capture_file;
+	if(m_parameters->getParam("replay", capture_file)) {
+		ASSERT_THROW_e(servers.size()<=1, EINVALID_PARAMETER, "--replay needs a single server");
+		backend=new PAReplayBackend(capture_file);
+	}
+	if(m_parameters->getParam("record", capture_file)) {
+		if(servers.size()>1) {
+			delete(backend);
+			THROW_s(EINVALID_PARAMETER, "--record needs a single server");
+		}
+		backend=new PARecordBackend(backend ? backend : new PAPulseBackend(), capture_file);
+	}
+	
+	if(servers.size()>1 && !backend) {
+		ASSERT_THROW_e(actions.meter_time_ms>0 || (!actions.bMeter_sinks && !actions.bMeter_sources && !actions.bMeter_playback
+				&& !actions.bNormalize && actions.duck_rules.empty() && !actions.bAGC && !actions.bGate && !actions.bSpectrum && !actions.bClip_guard && !actions.bSuspend_idle)
+				, EINVALID_PARAMETER, "--meter, --normalize, --duck, --agc, --gate, --spectrum, --clip-guard or --suspend-idle"
+				" with several servers needs --meter-time");
+		runParallel(servers, actions);
+	} else {
+		/* connect to pulseaudio */
+		m_pa_manager.Init(backend, servers.empty() ? NULL : servers[0].c_str());
+		runActions(m_pa_manager, actions, cout);
+	}
+	
+	CTrace::getInstance().close();
+}
+
+void CMain::parseActions(SActions& actions) {
+	
+	/* get card */
 	string card_val;
 	if(m_parameters->getParam("card", card_val)) {
 		int t_card_idx;
 		if(sscanf(card_val.c_str(), "%i", &t_card_idx)==1) {
-			if(m_pa_manager.Sink(t_card_idx)) {
-				sink_card_indexes.push_back(t_card_idx);
-				sink_card_idx=0;
-			} else {
-				sink_card_idx=-2;
-				LOG(DEBUG, "sink with card idx %i not found", t_card_idx);
-			}
-			if(m_pa_manager.Source(t_card_idx)) {
-				source_card_indexes.push_back(t_card_idx);
-				source_card_idx=0;
-			} else {
-				source_card_idx=-2;
-				LOG(DEBUG, "source with card idx %i not found", t_card_idx);
-			}
-			if(m_pa_manager.Card(t_card_idx)) {
-				card_indexes.push_back(t_card_idx);
-				card_idx=0;
-			} else {
-				card_idx=-2;
-				LOG(DEBUG, "card idx %i not found", t_card_idx);
-			}
+			actions.card=PACmdSelector::Index(t_card_idx);
 		} else {
 			THROW_s(EINVALID_PARAMETER, "Failed to parse card idx %s", card_val.c_str());
 		}
 	} else if(m_parameters->getParam("card-name", card_val)) {
-		if(m_pa_manager.getSinks(card_val, sink_card_indexes)) {
-			sink_card_idx=0;
-		} else {
-			sink_card_idx=-2;
-			LOG(DEBUG, "sink with name %s not found", card_val.c_str());
-		}
-		if(m_pa_manager.getSources(card_val, source_card_indexes)) {
-			source_card_idx=0;
-		} else {
-			source_card_idx=-2;
-			LOG(DEBUG, "source with name %s not found", card_val.c_str());
-		}
-		if(m_pa_manager.getCard(card_val, card_indexes)) {
-			card_idx=0;
-		} else {
-			card_idx=-2;
-			LOG(DEBUG, "card with name %s not found", card_val.c_str());
-		}
+		actions.card=PACmdSelector::Name(card_val);
 	}
-	
+	actions.card_val=card_val;
 	
 	/* list devices */
-	bool bPrint_sinks=false;
-	bool bPrint_sources=false;
-	bool bPrint_playbacks=false;
-	bool bPrint_cards=false;
-	int print_multiple=0;
-	
 	if(m_parameters->setTask("list")->bGiven) {
-		bPrint_cards=bPrint_sinks=bPrint_sources=bPrint_playbacks=true;
-		print_multiple=4;
+		actions.bPrint_cards=actions.bPrint_sinks=actions.bPrint_sources=actions.bPrint_playbacks=true;
+		actions.print_multiple=4;
 	} else {
 		if(m_parameters->setTask("list-cards")->bGiven) {
-			bPrint_cards=true;
-			++print_multiple;
+			actions.bPrint_cards=true;
+			++actions.print_multiple;
 		}
 		if(m_parameters->setTask("list-sink")->bGiven) {
-			bPrint_sinks=true;
-			++print_multiple;
+			actions.bPrint_sinks=true;
+			++actions.print_multiple;
 		}
 		if(m_parameters->setTask("list-source")->bGiven) {
-			bPrint_sources=true;
-			++print_multiple;
+			actions.bPrint_sources=true;
+			++actions.print_multiple;
 		}
 		if(m_parameters->setTask("list-playback")->bGiven) {
-			bPrint_playbacks=true;
-			++print_multiple;
+			actions.bPrint_playbacks=true;
+			++actions.print_multiple;
 		}
 	}
 	
-	if(print_multiple>1 && bPrint_cards) cout << "cards:" << endl << endl;
-	if(bPrint_cards) {
-		if(card_idx==(uint32_t)-2) {
-			THROW_s(EINVALID_PARAMETER, "specified card not found");
-		} else if(card_idx==(uint32_t)-1) {
-			for(pa_card_list::const_iterator iter=m_pa_manager.Cards().begin(); 
-					iter!=m_pa_manager.Cards().end(); ++iter) {
-				cout << iter->second->Info() << endl << endl;
-			}
+	actions.bSet_profile=m_parameters->getParam("set-profile", actions.profile);
+	
+	/* parse channels */
+	string channel_str;
+	if(m_parameters->getParam("channels", channel_str)) parseIntList(channel_str, actions.channels);
+	
+	actions.bSet_volume=m_parameters->getParam("set-volume", actions.volume);
+	actions.bSet_source_volume=m_parameters->getParam("set-source-volume", actions.source_volume);
+	
+	uint32_t playback_idx;
+	string s;
+	if(m_parameters->getParam("index", s)) {
+		if(sscanf(s.c_str(), "%i", &playback_idx)!=1) {
+			LOG(WARN, "failed to parse specified index %s", s.c_str());
 		} else {
-			for(size_t i=0; i<card_indexes.size(); ++i)
-				cout << m_pa_manager.Card(card_indexes[i])->Info() << endl << endl;
+			actions.playback=PACmdSelector::Index(playback_idx);
 		}
+	} else if(m_parameters->getParam("client-name", s)) {
+		actions.playback=PACmdSelector::Name(s);
 	}
+	actions.bSet_playback_volume=m_parameters->getParam("set-playback-volume", actions.playback_volume);
 	
-	if(print_multiple>1 && bPrint_sinks) cout << "sinks:" << endl << endl;
-	if(bPrint_sinks) {
-		if(sink_card_idx==(uint32_t)-2) {
-			THROW_s(EINVALID_PARAMETER, "specified sink not found");
-		} else if(sink_card_idx==(uint32_t)-1) {
-			for(pa_dev_list::const_iterator iter=m_pa_manager.Sinks().begin(); iter!=m_pa_manager.Sinks().end(); ++iter) {
-				cout << iter->second->Info() << endl << endl;
-			}
-		} else {
-			for(size_t i=0; i<sink_card_indexes.size(); ++i)
-				cout << m_pa_manager.Sink(sink_card_indexes[i])->Info() << endl << endl;
+	actions.bStats=m_parameters->getSwitch("stats");
+	
+	actions.bMeter_sinks=m_parameters->getSwitch("meter");
+	actions.bMeter_sources=m_parameters->getSwitch("meter-source");
+	actions.bMeter_playback=m_parameters->getSwitch("meter-playback");
+	actions.bMeter_peak=m_parameters->getSwitch("meter-peak");
+	actions.bLoudness=m_parameters->getSwitch("loudness");
+	ASSERT_THROW_e(!actions.bLoudness || !actions.bMeter_peak, EINVALID_PARAMETER, "--loudness needs the signal, not --meter-peak");
+	int val;
+	if(m_parameters->getParam("meter-interval", s)) {
+		ASSERT_THROW_e(isInteger(s, &val) && val>0, EINVALID_PARAMETER, "invalid meter interval %s", s.c_str());
+		actions.meter_interval_ms=(uint32_t)val;
+	}
+	if(m_parameters->getParam("meter-time", s)) {
+		double seconds;
+		ASSERT_THROW_e(sscanf(s.c_str(), "%lf", &seconds)==1 && seconds>0.0, EINVALID_PARAMETER
+				, "invalid meter time %s", s.c_str());
+		actions.meter_time_ms=(uint32_t)(seconds*1000.0);
+	}
+	if(m_parameters->getParam("normalize", s)) {
+		ASSERT_THROW_e(sscanf(s.c_str(), "%lf", &actions.normalize_lufs)==1 && actions.normalize_lufs<0.0
+				, EINVALID_PARAMETER, "invalid loudness target %s (LUFS, eg. -23)", s.c_str());
+		actions.bNormalize=true;
+	}
+	while(m_parameters->getParam("duck", s)) actions.duck_rules.push_back(PADuckRule::parse(s));
+	if(m_parameters->getParam("duck-ramp", s)) {
+		ASSERT_THROW_e(isInteger(s, &val) && val>=0, EINVALID_PARAMETER, "invalid duck ramp %s", s.c_str());
+		actions.duck_ramp_ms=(uint32_t)val;
+	}
+	if(m_parameters->getParam("agc", s)) {
+		ASSERT_THROW_e(sscanf(s.c_str(), "%lf", &actions.agc_db)==1 && actions.agc_db<0.0
+				, EINVALID_PARAMETER, "invalid speech level %s (dBFS, eg. -20)", s.c_str());
+		actions.bAGC=true;
+	}
+	if(m_parameters->getParam("gate", s)) {
+		ASSERT_THROW_e(sscanf(s.c_str(), "%lf", &actions.gate_db)==1 && actions.gate_db<0.0
+				, EINVALID_PARAMETER, "invalid gate threshold %s (dBFS, eg. -45)", s.c_str());
+		actions.bGate=true;
+	}
+	if(m_parameters->getParam("gate-hold", s)) {
+		ASSERT_THROW_e(isInteger(s, &val) && val>=0, EINVALID_PARAMETER, "invalid gate hold time %s", s.c_str());
+		actions.gate_hold_ms=(uint32_t)val;
+	}
+	if(m_parameters->getParam("spectrum", s)) {
+		if(s=="octave") actions.spectrum_bands=Spectrum_octave;
+		else if(s=="third") actions.spectrum_bands=Spectrum_third_octave;
+		else if(s=="bins") actions.spectrum_bands=Spectrum_bins;
+		else THROW_s(EINVALID_PARAMETER, "invalid spectrum bands %s (octave, third or bins)", s.c_str());
+		actions.bSpectrum=true;
+	}
+	actions.bSpectrum_source=m_parameters->getSwitch("spectrum-source");
+	if(m_parameters->getParam("spectrum-size", s)) {
+		ASSERT_THROW_e(isInteger(s, &val) && val>=16 && val<=65536 && (val&(val-1))==0, EINVALID_PARAMETER
+				, "invalid spectrum size %s (a power of 2, eg. 4096)", s.c_str());
+		actions.spectrum_size=(uint32_t)val;
+	}
+	actions.bClip_guard=m_parameters->getSwitch("clip-guard");
+	if(m_parameters->getParam("suspend-idle", s)) {
+		double seconds;
+		ASSERT_THROW_e(sscanf(s.c_str(), "%lf", &seconds)==1 && seconds>0.0, EINVALID_PARAMETER
+				, "invalid idle time %s", s.c_str());
+		actions.idle_ms=(uint32_t)(seconds*1000.0);
+		actions.bSuspend_idle=true;
+	}
+	if(m_parameters->getParam("silence-level", s)) {
+		ASSERT_THROW_e(sscanf(s.c_str(), "%lf", &actions.silence_db)==1 && actions.silence_db<0.0
+				, EINVALID_PARAMETER, "invalid silence level %s (dBFS, eg. -80)", s.c_str());
+	}
+	actions.bMeasure_latency=m_parameters->getSwitch("measure-latency");
+	if(m_parameters->getParam("measure-buffer", s)) {
+		ASSERT_THROW_e(isInteger(s, &val) && val>=1 && val<=2000, EINVALID_PARAMETER
+				, "invalid buffer %s (ms, eg. 50)", s.c_str());
+		actions.measure_buffer_ms=(uint32_t)val;
+	}
+}
+
+void CMain::runActions(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	vector<uint32_t> sink_card_indexes;
+	bool bSink_found=selectSinks(manager, actions.card, sink_card_indexes);
+	if(!bSink_found) LOG(DEBUG, "sink %s not found", actions.card_val.c_str());
+	vector<uint32_t> source_card_indexes;
+	bool bSource_found=selectSources(manager, actions.card, source_card_indexes);
+	if(!bSource_found) LOG(DEBUG, "source %s not found", actions.card_val.c_str());
+	vector<uint32_t> card_indexes;
+	bool bCard_found=selectCards(manager, actions.card, card_indexes);
+	if(!bCard_found) LOG(DEBUG, "card %s not found", actions.card_val.c_str());
+	
+	/* loudness in the listing: the listed objects are measured first */
+	bool bList_loudness=actions.bLoudness && !actions.bMeter_sinks && !actions.bMeter_sources && !actions.bMeter_playback
+		&& (actions.bPrint_sinks || actions.bPrint_sources || actions.bPrint_playbacks);
+	PAMeter loudness_meter(manager);
+	PAStreamMeter loudness_streams(manager, bList_loudness && actions.bPrint_playbacks ? 256 : 0);
+	if(bList_loudness) {
+		loudness_meter.setLoudness(true);
+		if(actions.bPrint_sinks) {
+			for(size_t i=0; i<sink_card_indexes.size(); ++i) loudness_meter.addSink(sink_card_indexes[i]);
+		}
+		if(actions.bPrint_sources) {
+			for(size_t i=0; i<source_card_indexes.size(); ++i) loudness_meter.addSource(source_card_indexes[i]);
 		}
+		if(actions.bPrint_playbacks) {
+			loudness_streams.setLoudness(true);
+			loudness_streams.sync();
+		}
+		uint64_t end=getTimeUsec()+(actions.meter_time_ms>0 ? actions.meter_time_ms : 3000)*1000ULL;
+		for(uint64_t now=getTimeUsec(); now<end; now=getTimeUsec()) manager.iterate((int)((end-now+999)/1000));
 	}
+	SLoudness loudness;
+	SLevelEntry entry;
 	
-	if(print_multiple>1 && bPrint_sources) cout << "sources:" << endl << endl;
-	if(bPrint_sources) {
-		if(source_card_idx==(uint32_t)-2) {
-			THROW_s(EINVALID_PARAMETER, "specified source not found");
-		} else if(source_card_idx==(uint32_t)-1) {
-			for(pa_dev_list::const_iterator iter=m_pa_manager.Sources().begin(); iter!=m_pa_manager.Sources().end(); ++iter) {
-				cout << iter->second->Info() << endl << endl;
-			}
-		} else {
-			for(size_t i=0; i<source_card_indexes.size(); ++i)
-				cout << m_pa_manager.Source(source_card_indexes[i])->Info() << endl << endl;
+	
+	/* list devices */
+	if(actions.print_multiple>1 && actions.bPrint_cards) out << "cards:" << endl << endl;
+	if(actions.bPrint_cards) {
+		ASSERT_THROW_e(bCard_found, EINVALID_PARAMETER, "specified card not found");
+		for(size_t i=0; i<card_indexes.size(); ++i)
+			out << manager.Card(card_indexes[i])->Info() << endl << endl;
+	}
+	
+	if(actions.print_multiple>1 && actions.bPrint_sinks) out << "sinks:" << endl << endl;
+	if(actions.bPrint_sinks) {
+		ASSERT_THROW_e(bSink_found, EINVALID_PARAMETER, "specified sink not found");
+		for(size_t i=0; i<sink_card_indexes.size(); ++i) {
+			out << manager.Sink(sink_card_indexes[i])->Info() << endl;
+			if(loudness_meter.loudness(PADev_sink, sink_card_indexes[i], loudness)) out << loudnessStr(loudness) << endl;
+			out << endl;
 		}
 	}
 	
-	if(print_multiple>1 && bPrint_playbacks) cout << "playback:" << endl << endl;
-	if(bPrint_playbacks) {
-		if(sink_card_idx==(uint32_t)-2) {
+	if(actions.print_multiple>1 && actions.bPrint_sources) out << "sources:" << endl << endl;
+	if(actions.bPrint_sources) {
+		ASSERT_THROW_e(bSource_found, EINVALID_PARAMETER, "specified source not found");
+		for(size_t i=0; i<source_card_indexes.size(); ++i) {
+			out << manager.Source(source_card_indexes[i])->Info() << endl;
+			if(loudness_meter.loudness(PADev_source, source_card_indexes[i], loudness)) out << loudnessStr(loudness) << endl;
+			out << endl;
+		}
+	}
+	
+	if(actions.print_multiple>1 && actions.bPrint_playbacks) out << "playback:" << endl << endl;
+	if(actions.bPrint_playbacks) {
+		if(!bSink_found) {
 			THROW_s(EINVALID_PARAMETER, "specified source not found");
 		} else {
-			for(pa_sink_input_list::const_iterator iter=m_pa_manager.SinkInputs().begin(); iter!=m_pa_manager.SinkInputs().end(); ++iter) {
-				if(sink_card_idx==(uint32_t)-1) {
-					cout << iter->second->Info() << endl << endl;
-				} else {
-					for(size_t i=0; i<sink_card_indexes.size(); ++i) {
-						if(iter->second->sink == sink_card_indexes[i]) {
-							cout << iter->second->Info() << endl << endl;
-						}
-					}
-				}
+			for(pa_sink_input_list::const_iterator iter=manager.SinkInputs().begin(); iter!=manager.SinkInputs().end(); ++iter) {
+				bool bPrint=actions.card.all();
+				for(size_t i=0; i<sink_card_indexes.size() && !bPrint; ++i) bPrint=iter->second->sink == sink_card_indexes[i];
+				if(!bPrint) continue;
+				out << iter->second->Info() << endl;
+				if(bList_loudness && loudness_streams.table().find(iter->first, entry) && entry.updates>0)
+					out << loudnessStr(entry.loudness) << endl;
+				out << endl;
 			}
 		}
 	}
 	
 	/* set active profile */
-	string new_profile;
-	if(m_parameters->getParam("set-profile", new_profile)) {
-		ASSERT_THROW_e(card_idx!=(uint32_t)-2, EINVALID_PARAMETER, "specified card not found");
-		ASSERT_THROW_e(card_idx!=(uint32_t)-1, EINVALID_PARAMETER, "no card specified");
+	if(actions.bSet_profile) {
+		ASSERT_THROW_e(bCard_found, EINVALID_PARAMETER, "specified card not found");
+		ASSERT_THROW_e(!actions.card.all(), EINVALID_PARAMETER, "no card specified");
 		for(size_t i=0; i<card_indexes.size(); ++i) {
-			PACardInfo* card = m_pa_manager.Card(card_indexes[i]);
+			PACardInfo* card = manager.Card(card_indexes[i]);
 			if(card) {
-				string profile_name = m_pa_manager.cardProfileName(card, new_profile);
-				m_pa_manager.setCardProfile(card, profile_name);
+				string profile_name = manager.cardProfileName(card, actions.profile);
+				manager.setCardProfile(card, profile_name);
 			} else {
 				THROW_s(EINVALID_PARAMETER, "card with index %i not found", card_indexes[i]);
 			}
 		}
 	}
 	
-	/* parse channels */
-	vector<int> channels;
-	string channel_str;
-	if(m_parameters->getParam("channels", channel_str)) parseIntList(channel_str, channels);
-	
 	
-	/* change volume */
+	/* change volume: all changes are sent at once and flushed at the end */
+	manager.beginBatch();
 	
-	string vol_change;
-	if(m_parameters->getParam("set-volume", vol_change)) {
+	if(actions.bSet_volume) {
 		
 		/* change sink volume */
-		if(sink_card_idx==(uint32_t)-2) {
-			THROW_s(EINVALID_PARAMETER, "specified sink not found");
-		} else if(sink_card_idx==(uint32_t)-1) {
-			for(pa_dev_list::const_iterator iter=m_pa_manager.Sinks().begin(); iter!=m_pa_manager.Sinks().end(); ++iter) {
-				m_pa_manager.setSinkVolume(iter->first, vol_change, &channels);
-			}
-		} else {
-			for(size_t i=0; i<sink_card_indexes.size(); ++i) {
-				m_pa_manager.setSinkVolume(sink_card_indexes[i], vol_change, &channels);
-			}
+		ASSERT_THROW_e(bSink_found, EINVALID_PARAMETER, "specified sink not found");
+		for(size_t i=0; i<sink_card_indexes.size(); ++i) {
+			manager.setSinkVolume(sink_card_indexes[i], actions.volume, &actions.channels);
 		}
 	}
 	
-	if(m_parameters->getParam("set-source-volume", vol_change)) {
+	if(actions.bSet_source_volume) {
 		
 		/* change source volume */
-		if(source_card_idx==(uint32_t)-2) {
-			THROW_s(EINVALID_PARAMETER, "specified source not found");
-		} else if(source_card_idx==(uint32_t)-1) {
-			for(pa_dev_list::const_iterator iter=m_pa_manager.Sources().begin(); iter!=m_pa_manager.Sources().end(); ++iter) {
-				m_pa_manager.setSourceVolume(iter->first, vol_change, &channels);
-			}
-		} else {
-			for(size_t i=0; i<source_card_indexes.size(); ++i) {
-				m_pa_manager.setSourceVolume(source_card_indexes[i], vol_change, &channels);
-			}
+		ASSERT_THROW_e(bSource_found, EINVALID_PARAMETER, "specified source not found");
+		for(size_t i=0; i<source_card_indexes.size(); ++i) {
+			manager.setSourceVolume(source_card_indexes[i], actions.source_volume, &actions.channels);
 		}
 	}
 	
-	vector<uint32_t> playback_indexes;
-	uint32_t playback_idx;
-	string s;
-	if(m_parameters->getParam("index", s)) {
-		if(sscanf(s.c_str(), "%i", &playback_idx)!=1) {
-			LOG(WARN, "failed to parse specified index %s", s.c_str());
-		} else {
-			playback_indexes.push_back(playback_idx);
+	if(actions.bSet_playback_volume) {
+		
+		/* change playback volume */
+		vector<uint32_t> playback_indexes;
+		if(!selectSinkInputs(manager, actions.playback, playback_indexes)) {
+			if(actions.playback.type==PACmdSelect_name)
+				THROW_s(EINVALID_PARAMETER, "client name %s not found", actions.playback.name.c_str());
+			THROW_s(EINVALID_PARAMETER, "playback with idx %i not found", actions.playback.index);
+		}
+		for(size_t i=0; i<playback_indexes.size(); ++i) {
+			manager.setSinkInputVolume(playback_indexes[i], actions.playback_volume, &actions.channels);
 		}
-	} else if(m_parameters->getParam("client-name", s)) {
-		m_pa_manager.getSinkInputsFromClient(s, playback_indexes);
-		ASSERT_THROW_e(playback_indexes.size()!=0, EINVALID_PARAMETER, "client name %s not found", s.c_str());
 	}
 	
-	if(m_parameters->getParam("set-playback-volume", vol_change)) {
+	if(!manager.flush()) LOG(WARN, "not all volume changes were applied");
+	
+	if(actions.bMeter_sinks || actions.bMeter_sources || actions.bMeter_playback) runMeter(manager, actions, out);
+	if(actions.bNormalize) runNormalize(manager, actions, out);
+	if(!actions.duck_rules.empty()) runDuck(manager, actions, out);
+	if(actions.bAGC) runAGC(manager, actions, out);
+	if(actions.bGate) runGate(manager, actions, out);
+	if(actions.bSpectrum) runSpectrum(manager, actions, out);
+	if(actions.bClip_guard) runClipGuard(manager, actions, out);
+	if(actions.bSuspend_idle) runSuspendIdle(manager, actions, out);
+	if(actions.bMeasure_latency) runMeasureLatency(manager, actions, out);
+	
+	if(actions.bStats) out << manager.LatencyStatsInfo() << endl;
+}
+
+static void syncStreamMeter(pa_subscription_event_type_t, uint32_t, void* userdata) {
+	((PAStreamMeter*)userdata)->sync();
+}
+
+/* json lines with the levels of the playback streams of the last window */
+static void reportPlayback(PAManager& manager, const PAStreamMeter& stream_meter, const PACmdSelector& selector
+		, bool bLoudness, ostream& out, double time) {
+	
+	vector<uint32_t> indexes;
+	if(!selector.all() && !selectSinkInputs(manager, selector, indexes)) return;
+	
+	vector<SLevelEntry> entries;
+	stream_meter.table().snapshot(entries);
+	char buffer[32];
+	for(size_t i=0; i<entries.size(); ++i) {
+		const SLevelEntry& entry=entries[i];
+		PASinkInputInfo* sink_input=manager.SinkInput(entry.key);
+		if(!sink_input || entry.updates==0) continue;
+		if(!selector.all() && find(indexes.begin(), indexes.end(), entry.key)==indexes.end()) continue;
 		
-		/* change playback volume */
-		if(playback_indexes.empty()) {
-			for(pa_dev_list::const_iterator iter=m_pa_manager.Sinks().begin(); iter!=m_pa_manager.Sinks().end(); ++iter) {
-				m_pa_manager.setSinkInputVolume(iter->first, vol_change, &channels);
+		snprintf(buffer, sizeof(buffer), "%.3f", time);
+		out << "{\"time\":" << buffer << ",\"type\":\"playback\",\"index\":" << entry.key
+			<< ",\"name\":" << jsonStr(sink_input->name)
+			<< ",\"client\":" << jsonStr(sink_input->client_obj ? sink_input->client_obj->name : string());
+		out << ",\"peak\":[";
+		for(uint8_t k=0; k<entry.channels; ++k) {
+			snprintf(buffer, sizeof(buffer), "%s%.1f", k>0 ? "," : "", levelToDb(entry.peak[k]));
+			out << buffer;
+		}
+		out << "],\"rms\":[";
+		for(uint8_t k=0; k<entry.channels; ++k) {
+			snprintf(buffer, sizeof(buffer), "%s%.1f", k>0 ? "," : "", levelToDb(entry.rms[k]));
+			out << buffer;
+		}
+		out << "]";
+		if(bLoudness) out << loudnessJson(entry.loudness);
+		out << "}" << endl;
+	}
+}
+
+static volatile sig_atomic_t g_bInterrupted=0;
+
+static void interruptHandler(int) {
+	g_bInterrupted=1;
+}
+
+/* set while a CInterruptScope has the handlers installed. only changed by
+ * the main thread, runParallel() sets it before the threads start */
+static bool g_bInterrupt_installed=false;
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CInterruptScope
+ * installs interruptHandler for SIGINT & SIGTERM and restores the previous
+ * handlers at the end of the scope. nested scopes (eg. in the threads of
+ * runParallel()) do nothing, so the handlers are not swapped concurrently.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CInterruptScope {
+public:
+	CInterruptScope() : m_bInstalled(!g_bInterrupt_installed), m_old_int(NULL), m_old_term(NULL) {
+		if(!m_bInstalled) return;
+		g_bInterrupt_installed=true;
+		m_old_int=signal(SIGINT, interruptHandler);
+		m_old_term=signal(SIGTERM, interruptHandler);
+	}
+	~CInterruptScope() {
+		if(!m_bInstalled) return;
+		signal(SIGINT, m_old_int);
+		signal(SIGTERM, m_old_term);
+		g_bInterrupt_installed=false;
+	}
+	
+private:
+	CInterruptScope(const CInterruptScope&);
+	CInterruptScope& operator=(const CInterruptScope&);
+	
+	bool m_bInstalled;
+	void (*m_old_int)(int);
+	void (*m_old_term)(int);
+};
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CRunLoop
+ * main loop of the daemon modes: runs the event loop of the manager until
+ * interrupted (see CInterruptScope) or for time_ms (0: no limit). with an
+ * interval, iterate() returns after every wait and due() is true once per
+ * interval. without, every iteration is due:
+ *
+ *   CRunLoop loop(manager, actions.meter_time_ms, actions.meter_interval_ms);
+ *   while(loop.iterate() && agc.active()) {
+ *       if(!loop.due()) continue;
+ *       ...
+ *   }
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CRunLoop {
+public:
+	CRunLoop(PAManager& manager, uint32_t time_ms, uint32_t interval_ms=0);
+	
+	/* wait for events, at most wait_ms (-1: no limit) if there is no
+	 * interval. returns false when the loop ends */
+	bool iterate(int wait_ms=-1);
+	bool due() const { return(m_bDue); }
+	/* seconds since the start: the end of the interval if it's due,
+	 * otherwise now */
+	double time() const;
+	
+private:
+	PAManager& m_manager;
+	uint64_t m_start;
+	uint64_t m_end;
+	uint64_t m_interval; //0: no interval
+	uint64_t m_next; //end of the current interval
+	bool m_bDue;
+};
+
+CRunLoop::CRunLoop(PAManager& manager, uint32_t time_ms, uint32_t interval_ms) : m_manager(manager)
+	, m_start(getTimeUsec()), m_interval(interval_ms*1000ULL), m_bDue(false) {
+	m_end=time_ms>0 ? m_start+time_ms*1000ULL : (uint64_t)-1;
+	m_next=m_start+m_interval;
+}
+
+bool CRunLoop::iterate(int wait_ms) {
+	if(m_bDue) m_next+=m_interval;
+	m_bDue=false;
+	if(g_bInterrupted) return(false);
+	
+	uint64_t now=getTimeUsec();
+	if(m_interval>0) {
+		if(m_next>m_end) return(false);
+		if(now<m_next) m_manager.iterate((int)((m_next-now+999)/1000));
+		else m_bDue=true;
+		return(true);
+	}
+	if(now>=m_end) return(false);
+	if(m_end!=(uint64_t)-1 && (wait_ms<0 || (uint64_t)wait_ms*1000>m_end-now)) wait_ms=(int)((m_end-now+999)/1000);
+	m_manager.iterate(wait_ms);
+	m_bDue=true;
+	return(true);
+}
+
+double CRunLoop::time() const {
+	uint64_t time=m_bDue && m_interval>0 ? m_next : getTimeUsec();
+	return((double)(time-m_start)/1000000.0);
+}
+
+void CMain::runMeter(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	PAMeter meter(manager);
+	/* fragments of at most 10ms, but not more than 2 per interval */
+	uint32_t fragment_usec=actions.meter_interval_ms*500;
+	if(fragment_usec>10000) fragment_usec=10000;
+	meter.setMode(actions.bMeter_peak, fragment_usec);
+	meter.setLoudness(actions.bLoudness);
+	
+	vector<uint32_t> indexes;
+	if(actions.bMeter_sinks) {
+		ASSERT_THROW_e(selectSinks(manager, actions.card, indexes), EINVALID_PARAMETER, "specified sink not found");
+		for(size_t i=0; i<indexes.size(); ++i) meter.addSink(indexes[i]);
+	}
+	if(actions.bMeter_sources) {
+		ASSERT_THROW_e(selectSources(manager, actions.card, indexes), EINVALID_PARAMETER, "specified source not found");
+		for(size_t i=0; i<indexes.size(); ++i) meter.addSource(indexes[i]);
+	}
+	ASSERT_THROW_e(meter.count()>0 || !(actions.bMeter_sinks || actions.bMeter_sources), EDEVICE
+			, "failed to open the record streams");
+	
+	/* the playback streams come and go, so they are followed with events */
+	PAStreamMeter stream_meter(manager);
+	if(actions.bMeter_playback) {
+		stream_meter.setMode(actions.meter_interval_ms*1000);
+		stream_meter.setLoudness(actions.bLoudness);
+		manager.subscribe((pa_subscription_mask_t)(PA_SUBSCRIPTION_MASK_SINK_INPUT | PA_SUBSCRIPTION_MASK_SINK
+				| PA_SUBSCRIPTION_MASK_CLIENT), syncStreamMeter, &stream_meter);
+		stream_meter.sync();
+	}
+	
+	CRunLoop loop(manager, actions.meter_time_ms, actions.meter_interval_ms);
+	while(loop.iterate() && (meter.active() || actions.bMeter_playback)) {
+		if(!loop.due()) continue;
+		meter.report(out, loop.time());
+		if(actions.bMeter_playback) reportPlayback(manager, stream_meter, actions.playback, actions.bLoudness, out, loop.time());
+	}
+	/* all streams ended */
+	if(meter.count()>0 && !meter.active()) meter.report(out, loop.time());
+}
+
+/* the playback streams selected with -i or -I */
+struct SPlaybackFilter {
+	PAManager* manager;
+	const PACmdSelector* selector;
+	PANormalizer* normalizer;
+	set<uint32_t> selected; //selected sink inputs, updated once per sync()
+};
+
+static void selectPlayback(SPlaybackFilter& filter) {
+	filter.selected.clear();
+	vector<uint32_t> indexes;
+	if(filter.selector->all() || !selectSinkInputs(*filter.manager, *filter.selector, indexes)) return;
+	filter.selected.insert(indexes.begin(), indexes.end());
+}
+
+static bool filterPlayback(const PASinkInputInfo& sink_input, void* userdata) {
+	SPlaybackFilter* filter=(SPlaybackFilter*)userdata;
+	if(filter->selector->all()) return(true);
+	return(filter->selected.find(sink_input.index)!=filter->selected.end());
+}
+
+static void syncNormalizer(pa_subscription_event_type_t, uint32_t, void* userdata) {
+	SPlaybackFilter* filter=(SPlaybackFilter*)userdata;
+	selectPlayback(*filter);
+	filter->normalizer->sync();
+}
+
+void CMain::runNormalize(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	PANormalizeConfig config;
+	config.target_lufs=actions.normalize_lufs;
+	PANormalizer normalizer(manager);
+	normalizer.setConfig(config);
+	normalizer.setInterval(actions.meter_interval_ms);
+	SPlaybackFilter filter;
+	filter.manager=&manager;
+	filter.selector=&actions.playback;
+	filter.normalizer=&normalizer;
+	normalizer.setFilter(filterPlayback, &filter);
+	manager.subscribe((pa_subscription_mask_t)(PA_SUBSCRIPTION_MASK_SINK_INPUT | PA_SUBSCRIPTION_MASK_SINK
+			| PA_SUBSCRIPTION_MASK_CLIENT), syncNormalizer, &filter);
+	selectPlayback(filter);
+	normalizer.sync();
+	
+	/* the volumes are restored on an interrupt as well */
+	CInterruptScope interrupt;
+	
+	CRunLoop loop(manager, actions.meter_time_ms, actions.meter_interval_ms);
+	vector<PANormalizeChange> changes;
+	char buffer[32];
+	while(loop.iterate()) {
+		if(!loop.due()) continue;
+		changes.clear();
+		normalizer.tick(&changes);
+		for(size_t i=0; i<changes.size(); ++i) {
+			PASinkInputInfo* sink_input=manager.SinkInput(changes[i].sink_input);
+			if(!sink_input) continue;
+			snprintf(buffer, sizeof(buffer), "%.3f", loop.time());
+			out << "{\"time\":" << buffer << ",\"type\":\"normalize\",\"index\":" << changes[i].sink_input
+				<< ",\"name\":" << jsonStr(sink_input->name)
+				<< ",\"client\":" << jsonStr(sink_input->client_obj ? sink_input->client_obj->name : string());
+			snprintf(buffer, sizeof(buffer), "%.1f", changes[i].loudness);
+			out << ",\"loudness\":" << buffer;
+			snprintf(buffer, sizeof(buffer), "%.1f", changes[i].gain_db);
+			out << ",\"gain\":" << buffer << "}" << endl;
+		}
+	}
+	
+	normalizer.close();
+}
+
+static void syncDucker(pa_subscription_event_type_t, uint32_t, void* userdata) {
+	PADucker* ducker=(PADucker*)userdata;
+	ducker->sync(ducker->Manager().eventTime());
+}
+
+void CMain::runDuck(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	PADucker ducker(manager);
+	for(size_t i=0; i<actions.duck_rules.size(); ++i) ducker.addRule(actions.duck_rules[i]);
+	ducker.setRamp(actions.duck_ramp_ms);
+	manager.subscribe(PA_SUBSCRIPTION_MASK_SINK_INPUT, syncDucker, &ducker);
+	ducker.sync();
+	
+	CInterruptScope interrupt;
+	
+	CRunLoop loop(manager, actions.meter_time_ms);
+	vector<PADuckChange> changes;
+	char buffer[32];
+	/* wait for the next event, or for the next step of a ramp */
+	while(loop.iterate(ducker.ramping() ? (int)ducker.stepMs() : -1)) {
+		changes.clear();
+		ducker.tick(&changes);
+		for(size_t i=0; i<changes.size(); ++i) {
+			PASinkInputInfo* sink_input=manager.SinkInput(changes[i].sink_input);
+			if(!sink_input) continue;
+			snprintf(buffer, sizeof(buffer), "%.3f", loop.time());
+			out << "{\"time\":" << buffer << ",\"type\":\"" << (changes[i].gain_db<0.0 ? "duck" : "restore")
+				<< "\",\"index\":" << changes[i].sink_input << ",\"name\":" << jsonStr(sink_input->name)
+				<< ",\"role\":" << jsonStr(sink_input->media_role);
+			snprintf(buffer, sizeof(buffer), "%.1f", changes[i].gain_db);
+			out << ",\"gain\":" << buffer;
+			snprintf(buffer, sizeof(buffer), "%.2f", changes[i].reaction_usec/1000.0);
+			out << ",\"reaction_ms\":" << buffer << "}" << endl;
+		}
+	}
+	
+	ducker.close();
+}
+
+void CMain::runAGC(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	PAAGCConfig config;
+	config.target_db=actions.agc_db;
+	PASourceAGC agc(manager);
+	agc.setConfig(config);
+	
+	vector<uint32_t> indexes;
+	ASSERT_THROW_e(selectSources(manager, actions.card, indexes), EINVALID_PARAMETER, "specified source not found");
+	for(size_t i=0; i<indexes.size(); ++i) {
+		PADeviceInfo* source=manager.Source(indexes[i]);
+		if(source && source->monitor_index==PA_INVALID_INDEX) agc.addSource(indexes[i]);
+	}
+	ASSERT_THROW_e(agc.count()>0, EDEVICE, "no source to control");
+	/* keeps the volumes up to date, a change by the user pauses the control */
+	manager.subscribe(PA_SUBSCRIPTION_MASK_SOURCE);
+	
+	CInterruptScope interrupt;
+	
+	CRunLoop loop(manager, actions.meter_time_ms, actions.meter_interval_ms);
+	vector<PAAGCChange> changes;
+	char buffer[32];
+	while(loop.iterate() && agc.active()) {
+		if(!loop.due()) continue;
+		changes.clear();
+		agc.tick(actions.meter_interval_ms, &changes);
+		for(size_t i=0; i<changes.size(); ++i) {
+			PADeviceInfo* source=manager.Source(changes[i].source);
+			if(!source) continue;
+			snprintf(buffer, sizeof(buffer), "%.3f", loop.time());
+			out << "{\"time\":" << buffer << ",\"type\":\"agc\",\"index\":" << changes[i].source
+				<< ",\"name\":" << jsonStr(source->name);
+			snprintf(buffer, sizeof(buffer), "%.1f", changes[i].speech_db);
+			out << ",\"speech\":" << buffer;
+			snprintf(buffer, sizeof(buffer), "%.1f", changes[i].noise_db);
+			out << ",\"noise\":" << buffer;
+			snprintf(buffer, sizeof(buffer), "%.1f", (double)changes[i].volume/PA_VOLUME_NORM*100.0);
+			out << ",\"volume\":" << buffer << "}" << endl;
+		}
+	}
+	
+	agc.close();
+}
+
+static void syncGate(pa_subscription_event_type_t, uint32_t, void* userdata) {
+	((PASourceGate*)userdata)->sync();
+}
+
+/* json members with the statistics of a latency histogram in ms */
+static string latencyJson(const char* key, const CLatencyHistogram& histogram) {
+	char buffer[160];
+	snprintf(buffer, sizeof(buffer), ",\"%s\":{\"count\":%llu,\"p50_ms\":%.2f,\"p90_ms\":%.2f,\"p99_ms\":%.2f,\"max_ms\":%.2f}"
+		, key, (unsigned long long)histogram.count(), histogram.percentile(50)/1000.0
+		, histogram.percentile(90)/1000.0, histogram.percentile(99)/1000.0, histogram.max()/1000.0);
+	return(buffer);
+}
+
+void CMain::runGate(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	PAGateConfig config;
+	config.open_db=actions.gate_db;
+	config.close_db=actions.gate_db-6.0;
+	config.hold_ms=actions.gate_hold_ms;
+	PASourceGate gate(manager);
+	gate.setConfig(config);
+	
+	vector<uint32_t> indexes;
+	ASSERT_THROW_e(selectSources(manager, actions.card, indexes), EINVALID_PARAMETER, "specified source not found");
+	for(size_t i=0; i<indexes.size(); ++i) {
+		PADeviceInfo* source=manager.Source(indexes[i]);
+		if(source && source->monitor_index==PA_INVALID_INDEX) gate.addSource(indexes[i]);
+	}
+	ASSERT_THROW_e(gate.count()>0, EDEVICE, "no source to gate");
+	manager.subscribe(PA_SUBSCRIPTION_MASK_SOURCE, syncGate, &gate);
+	
+	CInterruptScope interrupt;
+	
+	/* the gate runs in the record callbacks, the loop only prints */
+	CRunLoop loop(manager, actions.meter_time_ms);
+	vector<PAGateEvent> events;
+	char buffer[32];
+	while(gate.active() && loop.iterate(100)) {
+		events.clear();
+		gate.takeEvents(events);
+		for(size_t i=0; i<events.size(); ++i) {
+			PADeviceInfo* source=manager.Source(events[i].source);
+			snprintf(buffer, sizeof(buffer), "%.3f", loop.time());
+			out << "{\"time\":" << buffer << ",\"type\":\"gate\",\"index\":" << events[i].source
+				<< ",\"name\":" << jsonStr(source ? source->name : string())
+				<< ",\"state\":\"" << (events[i].bOpen ? "open" : "closed") << "\"";
+			snprintf(buffer, sizeof(buffer), "%.2f", events[i].latency_usec/1000.0);
+			out << ",\"latency_ms\":" << buffer << "}" << endl;
+		}
+	}
+	
+	gate.close();
+	
+	snprintf(buffer, sizeof(buffer), "%.3f", loop.time());
+	out << "{\"time\":" << buffer << ",\"type\":\"gate_stats\"" << latencyJson("open", gate.openLatency())
+		<< latencyJson("close", gate.closeLatency()) << "}" << endl;
+}
+
+void CMain::runSpectrum(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	PASpectrumConfig config;
+	config.size=actions.spectrum_size;
+	config.hop=actions.spectrum_size/4;
+	config.bands=actions.spectrum_bands;
+	PASpectrum spectrum(manager);
+	spectrum.setConfig(config);
+	
+	vector<uint32_t> indexes;
+	if(actions.bSpectrum_source) {
+		ASSERT_THROW_e(selectSources(manager, actions.card, indexes), EINVALID_PARAMETER, "specified source not found");
+		ASSERT_THROW_e(indexes.size()==1, EINVALID_PARAMETER, "--spectrum needs one source, select it with -c or -C");
+		ASSERT_THROW_e(spectrum.openSource(indexes[0]), EDEVICE, "failed to open the record stream");
+	} else {
+		ASSERT_THROW_e(selectSinks(manager, actions.card, indexes), EINVALID_PARAMETER, "specified sink not found");
+		ASSERT_THROW_e(indexes.size()==1, EINVALID_PARAMETER, "--spectrum needs one sink, select it with -c or -C");
+		ASSERT_THROW_e(spectrum.openSink(indexes[0]), EDEVICE, "failed to open the record stream");
+	}
+	
+	CInterruptScope interrupt;
+	
+	CRunLoop loop(manager, actions.meter_time_ms, actions.meter_interval_ms);
+	while(loop.iterate() && spectrum.active()) {
+		if(loop.due()) spectrum.report(out, loop.time());
+	}
+	
+	spectrum.close();
+	if(spectrum.dropped()>0) LOG(WARN, "the analysis fell behind, %llu samples were dropped"
+			, (unsigned long long)spectrum.dropped());
+}
+
+void CMain::runClipGuard(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	PAClipGuard guard(manager);
+	vector<uint32_t> indexes;
+	ASSERT_THROW_e(selectSinks(manager, actions.card, indexes), EINVALID_PARAMETER, "specified sink not found");
+	for(size_t i=0; i<indexes.size(); ++i) guard.addSink(indexes[i]);
+	ASSERT_THROW_e(guard.count()>0, EDEVICE, "failed to open the record streams");
+	/* the volumes & the sink inputs of the sinks have to be up to date */
+	manager.subscribe((pa_subscription_mask_t)(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SINK_INPUT));
+	
+	CInterruptScope interrupt;
+	
+	CRunLoop loop(manager, actions.meter_time_ms, actions.meter_interval_ms);
+	vector<PAClipEvent> events;
+	char buffer[32];
+	while(loop.iterate() && guard.active()) {
+		if(!loop.due()) continue;
+		events.clear();
+		guard.tick(&events);
+		for(size_t i=0; i<events.size(); ++i) {
+			const PAClipEvent& event=events[i];
+			PADeviceInfo* sink=manager.Sink(event.sink);
+			if(!sink) continue;
+			snprintf(buffer, sizeof(buffer), "%.3f", loop.time());
+			out << "{\"time\":" << buffer << ",\"type\":\"clip\",\"index\":" << event.sink
+				<< ",\"name\":" << jsonStr(sink->name) << ",\"clipped\":" << event.counts.clipped
+				<< ",\"near\":" << event.counts.near;
+			snprintf(buffer, sizeof(buffer), "%.2f", levelToDb(event.counts.peak));
+			out << ",\"peak\":" << buffer;
+			if(event.target!=Clip_none) {
+				snprintf(buffer, sizeof(buffer), "%.1f", (double)event.volume/PA_VOLUME_NORM*100.0);
+				out << ",\"lowered\":{\"type\":\"" << (event.target==Clip_sink ? "sink" : "sink_input")
+					<< "\",\"index\":" << event.target_index << ",\"volume\":" << buffer << "}";
 			}
-		} else {
-			for(size_t i=0; i<playback_indexes.size(); ++i) {
-				m_pa_manager.setSinkInputVolume(playback_indexes[i], vol_change, &channels);
+			out << "}" << endl;
+		}
+	}
+	
+	guard.close();
+}
+
+static void idleEvent(pa_subscription_event_type_t type, uint32_t idx, void* userdata) {
+	((PAIdleSuspender*)userdata)->event(type, idx);
+}
+
+static const char* deviceTypeStr(EPADeviceType type) {
+	return(type==PADev_sink ? "sink" : "source");
+}
+
+void CMain::runSuspendIdle(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	PAIdleConfig config;
+	config.silent_ms=actions.idle_ms;
+	config.silence_db=actions.silence_db;
+	PAIdleSuspender suspender(manager);
+	suspender.setConfig(config);
+	
+	vector<uint32_t> indexes;
+	if(selectSinks(manager, actions.card, indexes)) {
+		for(size_t i=0; i<indexes.size(); ++i) suspender.addSink(indexes[i]);
+	}
+	if(selectSources(manager, actions.card, indexes)) {
+		for(size_t i=0; i<indexes.size(); ++i) {
+			PADeviceInfo* source=manager.Source(indexes[i]);
+			if(source && source->monitor_index==PA_INVALID_INDEX) suspender.addSource(indexes[i]);
+		}
+	}
+	ASSERT_THROW_e(suspender.count()>0, EDEVICE, "no device to suspend");
+	manager.subscribe((pa_subscription_mask_t)(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE
+			| PA_SUBSCRIPTION_MASK_SINK_INPUT | PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT), idleEvent, &suspender);
+	
+	CInterruptScope interrupt;
+	
+	/* a resume is issued right after the event of the stream */
+	CRunLoop loop(manager, actions.meter_time_ms);
+	vector<PAIdleEvent> events;
+	char buffer[32];
+	while(suspender.active() && loop.iterate(100)) {
+		events.clear();
+		suspender.tick(&events);
+		for(size_t i=0; i<events.size(); ++i) {
+			const PAIdleEvent& event=events[i];
+			PADeviceInfo* device=event.dev_type==PADev_sink ? manager.Sink(event.index) : manager.Source(event.index);
+			snprintf(buffer, sizeof(buffer), "%.3f", loop.time());
+			out << "{\"time\":" << buffer << ",\"type\":\""
+				<< (event.type==Idle_state ? "state" : event.type==Idle_suspend ? "suspend" : "resume")
+				<< "\",\"device\":\"" << deviceTypeStr(event.dev_type) << "\",\"index\":" << event.index
+				<< ",\"name\":" << jsonStr(device ? device->name : string());
+			if(event.type==Idle_state) {
+				snprintf(buffer, sizeof(buffer), "%.3f", event.previous_usec/1000000.0);
+				out << ",\"state\":" << jsonStr(event.state) << ",\"previous\":" << jsonStr(event.previous)
+					<< ",\"previous_s\":" << buffer;
+			} else if(event.type==Idle_suspend) {
+				snprintf(buffer, sizeof(buffer), "%.1f", event.silent_usec/1000000.0);
+				out << ",\"silent_s\":" << buffer;
+			} else {
+				if(event.sink_input!=PA_INVALID_INDEX) out << ",\"sink_input\":" << event.sink_input;
+				snprintf(buffer, sizeof(buffer), "%.2f", event.latency_usec/1000.0);
+				out << ",\"latency_ms\":" << buffer;
 			}
+			out << "}" << endl;
+		}
+	}
+	
+	vector<PAIdleStats> stats;
+	suspender.stats(stats);
+	for(size_t i=0; i<stats.size(); ++i) {
+		PADeviceInfo* device=stats[i].dev_type==PADev_sink ? manager.Sink(stats[i].index) : manager.Source(stats[i].index);
+		snprintf(buffer, sizeof(buffer), "%.3f", loop.time());
+		out << "{\"time\":" << buffer << ",\"type\":\"idle_stats\",\"device\":\"" << deviceTypeStr(stats[i].dev_type)
+			<< "\",\"index\":" << stats[i].index << ",\"name\":" << jsonStr(device ? device->name : string())
+			<< ",\"suspends\":" << stats[i].suspends;
+		snprintf(buffer, sizeof(buffer), "%.3f", stats[i].saved_usec/1000000.0);
+		out << ",\"saved_s\":" << buffer << ",\"states\":{";
+		for(map<string, uint64_t>::const_iterator it=stats[i].state_usec.begin(); it!=stats[i].state_usec.end(); ++it) {
+			snprintf(buffer, sizeof(buffer), "%.3f", it->second/1000000.0);
+			out << (it!=stats[i].state_usec.begin() ? "," : "") << jsonStr(it->first) << ":" << buffer;
 		}
+		out << "}}" << endl;
 	}
 	
+	suspender.close();
+}
+
+void CMain::runMeasureLatency(PAManager& manager, const SActions& actions, ostream& out) {
+	
+	PALatencyConfig config;
+	config.latency_usec=actions.measure_buffer_ms*1000;
+	PALatencyProbe probe(manager);
+	probe.setConfig(config);
 	
+	vector<uint32_t> indexes;
+	ASSERT_THROW_e(selectSinks(manager, actions.card, indexes), EINVALID_PARAMETER, "specified sink not found");
+	ASSERT_THROW_e(indexes.size()==1, EINVALID_PARAMETER, "--measure-latency needs one sink, select it with -c or -C");
+	ASSERT_THROW_e(probe.open(indexes[0]), EDEVICE, "failed to open the streams");
+	
+	{
+		/* the chirps & the longest delay, plus the time to fill the buffer */
+		CInterruptScope interrupt;
+		CRunLoop loop(manager, config.warmup_ms + (config.count+1)*config.interval_ms + actions.measure_buffer_ms + 2000);
+		while(!probe.done() && loop.iterate(10)) {}
+	}
+	ASSERT_THROW_e(!probe.failed(), EDEVICE, "the streams of the probe ended");
+	ASSERT_THROW_e(probe.done() || g_bInterrupted, EDEVICE, "the server did not play the probe");
+	
+	PALatencyResult result;
+	probe.measure(result);
+	probe.close();
+	
+	PADeviceInfo* sink=manager.Sink(indexes[0]);
+	vector<double> delays;
+	double min_match=1.0;
+	char buffer[32];
+	out << "{\"type\":\"latency\",\"index\":" << indexes[0] << ",\"name\":" << jsonStr(sink ? sink->name : string())
+		<< ",\"measured_ms\":[";
+	for(size_t i=0; i<result.delay_usec.size(); ++i) {
+		if(result.delay_usec[i]>=0.0) {
+			snprintf(buffer, sizeof(buffer), "%.2f", result.delay_usec[i]/1000.0);
+			delays.push_back(result.delay_usec[i]);
+		} else {
+			snprintf(buffer, sizeof(buffer), "null");
+		}
+		out << (i>0 ? "," : "") << buffer;
+		min_match=min(min_match, result.match[i]);
+	}
+	snprintf(buffer, sizeof(buffer), "%.3f", result.delay_usec.empty() ? 0.0 : min_match);
+	out << "],\"lost\":" << result.delay_usec.size()-delays.size() << ",\"min_match\":" << buffer;
+	double median=0.0;
+	if(!delays.empty()) {
+		sort(delays.begin(), delays.end());
+		median=delays[delays.size()/2];
+		snprintf(buffer, sizeof(buffer), "%.2f", median/1000.0);
+		out << ",\"median_ms\":" << buffer;
+		snprintf(buffer, sizeof(buffer), "%.2f", (delays.back()-delays.front())/1000.0);
+		out << ",\"spread_ms\":" << buffer;
+	}
+	if(result.bReported) {
+		double reported=(double)(result.buffer_usec+result.sink_usec);
+		snprintf(buffer, sizeof(buffer), "%.2f", result.latency/1000.0);
+		out << ",\"latency_ms\":" << buffer;
+		snprintf(buffer, sizeof(buffer), "%.2f", result.configured_latency/1000.0);
+		out << ",\"configured_latency_ms\":" << buffer;
+		snprintf(buffer, sizeof(buffer), "%.2f", result.buffer_usec/1000.0);
+		out << ",\"buffer_ms\":" << buffer;
+		snprintf(buffer, sizeof(buffer), "%.2f", result.sink_usec/1000.0);
+		out << ",\"sink_ms\":" << buffer;
+		snprintf(buffer, sizeof(buffer), "%.2f", reported/1000.0);
+		out << ",\"reported_ms\":" << buffer;
+		if(!delays.empty()) {
+			snprintf(buffer, sizeof(buffer), "%.2f", (median-reported)/1000.0);
+			out << ",\"difference_ms\":" << buffer;
+		}
+	}
+	out << "}" << endl;
+	if(delays.empty()) LOG(WARN, "no chirp was found on the monitor of the sink (muted?)");
+}
+
+void CMain::runServer(const SActions* actions, SServerRun* run) {
+	try {
+		PAManager manager;
+		manager.Init(NULL, run->server.c_str());
+		runActions(manager, *actions, run->out);
+	} catch(Exception& e) {
+		run->bFailed=true;
+		run->error=e.getErrorStr();
+	} catch(std::exception& e) {
+		run->bFailed=true;
+		run->error=e.what();
+	}
+}
+
+void CMain::runParallel(const vector<string>& servers, const SActions& actions) {
+	
+	/* a thread per server, so the wall time is the one of the slowest server.
+	 * the signal handlers are installed once for all of them */
+	CInterruptScope interrupt;
+	vector<SServerRun> runs(servers.size());
+	vector<thread> threads;
+	for(size_t i=0; i<servers.size(); ++i) {
+		runs[i].server=servers[i];
+		threads.push_back(thread(runServer, &actions, &runs[i]));
+	}
+	for(size_t i=0; i<threads.size(); ++i) threads[i].join();
+	
+	/* merge the output in the order of the servers, every line is tagged */
+	int failed=0;
+	for(size_t i=0; i<runs.size(); ++i) {
+		istringstream lines(runs[i].out.str());
+		string line;
+		while(getline(lines, line)) {
+			cout << "[" << runs[i].server << "]" << (line.empty() ? "" : " ") << line << endl;
+		}
+		if(runs[i].bFailed) {
+			cout << "[" << runs[i].server << "] failed: " << runs[i].error << endl;
+			++failed;
+		}
+	}
+	ASSERT_THROW_e(failed==0, EDEVICE, "%i of %i servers failed", failed, (int)runs.size());
+}
+
+void CMain::parseServerList(const string& str, vector<string>& servers) {
+	string s=str+",";
+	while(s.length()>0) {
+		string server=trim(s.substr(0, s.find(',')));
+		s=s.substr(s.find(',')+1);
+		if(server.empty()) continue;
+		
+		/* socket paths can be a glob pattern (eg. /run/pulse-container-?/native) */
+		string path=server.compare(0, 5, "unix:")==0 ? server.substr(5) : server;
+		if(path.find_first_of("*?[")==string::npos) {
+			servers.push_back(server);
+			continue;
+		}
+		glob_t matches;
+		memset(&matches, 0, sizeof(matches));
+		int ret=glob(path.c_str(), 0, NULL, &matches);
+		if(ret==0) {
+			for(size_t i=0; i<matches.gl_pathc; ++i) servers.push_back(string("unix:")+matches.gl_pathv[i]);
+		}
+		globfree(&matches);
+		if(ret==GLOB_NOMATCH) THROW_s(EINVALID_PARAMETER, "no socket matches %s", path.c_str());
+		if(ret!=0) THROW_s(EINVALID_PARAMETER, "failed to expand %s", path.c_str());
+	}
 }
 
 void CMain::parseIntList(const string& str, vector<int>& v) {
@@ -18,7 +18,94 @@
 #include "global.h"
 #include "command_line.h"
 #include "pa_manager.h"
+#include "pacmdvolume.h"
+#include "pa_ducker.h"
+#include "spectrum.h"
 
+#include <sstream>
+
+
+/* what to do on a server, parsed once from the command line */
+struct SActions {
+	SActions() : bPrint_cards(false), bPrint_sinks(false), bPrint_sources(false), bPrint_playbacks(false)
+		, print_multiple(0), bSet_profile(false), bSet_volume(false), bSet_source_volume(false)
+		, bSet_playback_volume(false), bStats(false), bMeter_sinks(false), bMeter_sources(false)
+		, bMeter_playback(false), bMeter_peak(false), bLoudness(false), meter_interval_ms(100), meter_time_ms(0)
+		, bNormalize(false), normalize_lufs(-23.0), duck_ramp_ms(150)
+		, bAGC(false), agc_db(-20.0), bGate(false), gate_db(-45.0), gate_hold_ms(1500)
+		, bSpectrum(false), bSpectrum_source(false), spectrum_bands(Spectrum_third_octave), spectrum_size(4096)
+		, bClip_guard(false), bSuspend_idle(false), idle_ms(10000), silence_db(-80.0)
+		, bMeasure_latency(false), measure_buffer_ms(50) {}
+	
+	PACmdSelector card; //-c or -C
+	string card_val;
+	
+	bool bPrint_cards;
+	bool bPrint_sinks;
+	bool bPrint_sources;
+	bool bPrint_playbacks;
+	int print_multiple;
+	
+	bool bSet_profile;
+	string profile;
+	
+	vector<int> channels;
+	bool bSet_volume;
+	string volume;
+	bool bSet_source_volume;
+	string source_volume;
+	
+	PACmdSelector playback; //-i or -I
+	bool bSet_playback_volume;
+	string playback_volume;
+	
+	bool bStats;
+	
+	bool bMeter_sinks;
+	bool bMeter_sources;
+	bool bMeter_playback;
+	bool bMeter_peak;
+	bool bLoudness;
+	uint32_t meter_interval_ms;
+	uint32_t meter_time_ms; //0: until interrupted
+	
+	bool bNormalize;
+	double normalize_lufs; //target
+	
+	vector<PADuckRule> duck_rules;
+	uint32_t duck_ramp_ms;
+	
+	bool bAGC;
+	double agc_db; //target speech level
+	
+	bool bGate;
+	double gate_db; //open threshold
+	uint32_t gate_hold_ms;
+	
+	bool bSpectrum;
+	bool bSpectrum_source; //a source instead of the monitor of a sink
+	ESpectrumBands spectrum_bands;
+	uint32_t spectrum_size; //of the transforms
+	
+	bool bClip_guard;
+	
+	bool bSuspend_idle;
+	uint32_t idle_ms; //silent period before the suspend
+	double silence_db;
+	
+	bool bMeasure_latency;
+	uint32_t measure_buffer_ms; //requested buffer of the probe stream
+};
+
+/* the run of the actions on one of several servers */
+struct SServerRun {
+	SServerRun() : bFailed(false) {}
+	
+	string server;
+	ostringstream out;
+	bool bFailed;
+	string error;
+};
 
 /*////////////////////////////////////////////////////////////////////////////////////////////////
  ** class CMain
@@ -46,6 +133,32 @@ private:
 	void parseIntList(const string& str, vector<int>& v);
 	
 	void processArgs();
+	void parseActions(SActions& actions);
+	//split a comma-separated server list & expand glob patterns of socket paths
+	void parseServerList(const string& str, vector<string>& servers);
+	
+	static void runActions(PAManager& manager, const SActions& actions, ostream& out);
+	/* print the levels of the selected devices as json lines */
+	static void runMeter(PAManager& manager, const SActions& actions, ostream& out);
+	/* the loudness normalization loop of the playback streams */
+	static void runNormalize(PAManager& manager, const SActions& actions, ostream& out);
+	/* ducking by media.role until interrupted */
+	static void runDuck(PAManager& manager, const SActions& actions, ostream& out);
+	/* automatic gain control of the sources until interrupted */
+	static void runAGC(PAManager& manager, const SActions& actions, ostream& out);
+	/* noise gate of the sources until interrupted */
+	static void runGate(PAManager& manager, const SActions& actions, ostream& out);
+	/* spectrum of a sink or source every --meter-interval until interrupted */
+	static void runSpectrum(PAManager& manager, const SActions& actions, ostream& out);
+	/* clipping detection & headroom protection of the sinks until interrupted */
+	static void runClipGuard(PAManager& manager, const SActions& actions, ostream& out);
+	/* suspend silent sinks & sources until interrupted */
+	static void runSuspendIdle(PAManager& manager, const SActions& actions, ostream& out);
+	/* end-to-end output latency of a sink with a test signal */
+	static void runMeasureLatency(PAManager& manager, const SActions& actions, ostream& out);
+	/* run the actions on every server in parallel & print the tagged output */
+	void runParallel(const vector<string>& servers, const SActions& actions);
+	static void runServer(const SActions* actions, SServerRun* run);
 	
 	
 	CCommandLineParser* m_parameters;
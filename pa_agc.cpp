@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_agc.h"
+#include <cmath>
+
+
+#define NOISE_FALL 0.1 //per frame: the noise floor follows quiet frames within ~100ms
+#define NOISE_RISE_DB 0.01 //per frame: 1dB/s
+#define SPEECH_ALPHA 0.0247 //per frame: 1-exp(-10ms/400ms)
+#define SILENCE_DB -70.0 //quieter frames are never speech
+
+
+PAAGCConfig::PAAGCConfig() : target_db(-20.0), deadband_db(2.0), attack_db_s(20.0), release_db_s(3.0)
+	, speech_margin_db(10.0), max_noise_db(-50.0), peak_limit_db(-3.0), max_boost_db(6.0)
+	, min_gain_db(-40.0), override_hold_ms(30000) {
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PASourceAGC
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PASourceAGC::PASourceAGC(PAManager& manager) : m_manager(manager) {
+}
+
+PASourceAGC::~PASourceAGC() {
+	close();
+}
+
+bool PASourceAGC::addSource(uint32_t idx) {
+	PABackend* backend=m_manager.Backend();
+	PADeviceInfo* device=m_manager.Source(idx);
+	if(!backend || !device) return(false);
+	
+	PARecordSpec spec;
+	spec.source=device->name;
+	spec.rate=AGC_RATE;
+	spec.channels=1;
+	spec.fragment_usec=1000000*AGC_FRAME/AGC_RATE;
+	
+	SAGCSource* source=new SAGCSource();
+	source->agc=this;
+	source->index=idx;
+	source->bEnded=false;
+	source->frame.reset(1);
+	source->bNoise_init=false;
+	source->noise_db=SILENCE_DB;
+	source->speech_db=-HUGE_VAL;
+	source->peak_db=-HUGE_VAL;
+	source->speech_frames=0;
+	source->pending_db=0.0;
+	source->written=device->volume;
+	source->previous=device->volume;
+	source->hold_until=0;
+	source->id=backend->openRecordStream(spec, recordCb, source);
+	if(source->id==0) {
+		LOG(WARN, "failed to open a record stream on %s", device->name.c_str());
+		delete(source);
+		return(false);
+	}
+	m_sources.push_back(source);
+	return(true);
+}
+
+void PASourceAGC::close() {
+	PABackend* backend=m_manager.Backend();
+	for(size_t i=0; i<m_sources.size(); ++i) {
+		if(backend && !m_sources[i]->bEnded) backend->closeStream(m_sources[i]->id);
+		delete(m_sources[i]);
+	}
+	m_sources.clear();
+}
+
+bool PASourceAGC::active() const {
+	for(size_t i=0; i<m_sources.size(); ++i) {
+		if(!m_sources[i]->bEnded) return(true);
+	}
+	return(false);
+}
+
+void PASourceAGC::recordCb(const float* samples, size_t frames, void* userdata) {
+	SAGCSource* source=(SAGCSource*)userdata;
+	if(!samples) {
+		source->bEnded=true;
+		return;
+	}
+	while(frames>0) {
+		size_t count=AGC_FRAME-source->frame.frames;
+		if(count>frames) count=frames;
+		source->frame.add(samples, count);
+		samples+=count;
+		frames-=count;
+		if(source->frame.frames>=AGC_FRAME) source->agc->processFrame(*source);
+	}
+}
+
+void PASourceAGC::processFrame(SAGCSource& source) {
+	double level_db=levelToDb(source.frame.rms(0));
+	double peak_db=levelToDb(source.frame.peak[0]);
+	source.frame.reset(1);
+	
+	if(!source.bNoise_init) {
+		source.noise_db=level_db;
+		source.bNoise_init=true;
+	}
+	if(level_db<source.noise_db) source.noise_db+=(level_db-source.noise_db)*NOISE_FALL;
+	else source.noise_db+=level_db-source.noise_db<NOISE_RISE_DB ? level_db-source.noise_db : NOISE_RISE_DB;
+	
+	if(level_db<source.noise_db+m_config.speech_margin_db || level_db<SILENCE_DB) return;
+	
+	/* the speech level is averaged in the power domain */
+	if(source.speech_db==-HUGE_VAL) {
+		source.speech_db=level_db;
+	} else {
+		double power=pow(10.0, source.speech_db/10.0);
+		power+=(pow(10.0, level_db/10.0)-power)*SPEECH_ALPHA;
+		source.speech_db=10.0*log10(power);
+	}
+	if(peak_db>source.peak_db) source.peak_db=peak_db;
+	++source.speech_frames;
+}
+
+bool PASourceAGC::control(SAGCSource& source, const PADeviceInfo& device, uint32_t interval_ms, pa_cvolume& volume) {
+	/* nothing is changed in pauses, so the noise is not pumped up */
+	if(source.speech_frames==0 || source.speech_db==-HUGE_VAL) return(false);
+	if(pa_cvolume_max(&device.volume)==PA_VOLUME_MUTED) return(false);
+	
+	double error=m_config.target_db-source.speech_db;
+	if(source.peak_db>m_config.peak_limit_db && m_config.peak_limit_db-source.peak_db<error)
+		error=m_config.peak_limit_db-source.peak_db;
+	if(fabs(error)<=m_config.deadband_db) {
+		source.pending_db=0.0;
+		return(false);
+	}
+	
+	/* rate limited, the steps accumulate until they move the volume */
+	double max_delta=(error<0.0 ? m_config.attack_db_s : m_config.release_db_s)*interval_ms/1000.0;
+	double delta=source.pending_db+(error<-max_delta ? -max_delta : (error>max_delta ? max_delta : error));
+	if(fabs(delta)>fabs(error)) delta=error;
+	if(delta>0.0 && source.noise_db+delta>m_config.max_noise_db) delta=m_config.max_noise_db-source.noise_db;
+	if(error>0.0 && delta<=0.0) {
+		source.pending_db=0.0;
+		return(false);
+	}
+	source.pending_db=delta;
+	
+	/* limits around the base volume, on the grid of the hardware steps */
+	pa_volume_t step=device.n_volume_steps>1 ? PA_VOLUME_NORM/(device.n_volume_steps-1) : 1;
+	if(step==0) step=1;
+	pa_volume_t max_volume=pa_sw_volume_multiply(device.base_volume, pa_sw_volume_from_dB(m_config.max_boost_db));
+	pa_volume_t min_volume=pa_sw_volume_multiply(device.base_volume, pa_sw_volume_from_dB(m_config.min_gain_db));
+	pa_volume_t gain=pa_sw_volume_from_dB(delta);
+	bool bChange=false;
+	volume=device.volume;
+	for(uint8_t i=0; i<volume.channels; ++i) {
+		pa_volume_t value=pa_sw_volume_multiply(device.volume.values[i], gain);
+		if(value>max_volume) value=max_volume;
+		if(value<min_volume) value=min_volume;
+		value=(value+step/2)/step*step;
+		if(value>max_volume && value>=step) value-=step;
+		volume.values[i]=value;
+		pa_volume_t diff=value>device.volume.values[i] ? value-device.volume.values[i] : device.volume.values[i]-value;
+		if(diff>=step) bChange=true;
+	}
+	if(!bChange) return(false);
+	
+	/* the estimates follow the change, so it does not trigger the next one */
+	double applied=pa_sw_volume_to_dB(pa_cvolume_max(&volume))-pa_sw_volume_to_dB(pa_cvolume_max(&device.volume));
+	if(std::isfinite(applied)) {
+		source.speech_db+=applied;
+		source.noise_db+=applied;
+	}
+	source.pending_db=0.0;
+	return(true);
+}
+
+size_t PASourceAGC::tick(uint32_t interval_ms, vector<PAAGCChange>* changes) {
+	uint64_t now=getTimeUsec();
+	size_t writes=0;
+	
+	for(size_t i=0; i<m_sources.size(); ++i) {
+		SAGCSource& source=*m_sources[i];
+		PADeviceInfo* device=m_manager.Source(source.index);
+		if(source.bEnded || !device) continue;
+		
+		if(PAManager::volumeClose(device->volume, source.written)) {
+			source.previous=source.written; //the write arrived
+		} else if(!PAManager::volumeClose(device->volume, source.previous)) {
+			LOG(DEBUG, "volume of source %u changed by the user, pausing the gain control", source.index);
+			source.written=device->volume;
+			source.previous=device->volume;
+			source.hold_until=now+m_config.override_hold_ms*1000ULL;
+			source.pending_db=0.0;
+		}
+		
+		PAAGCChange change;
+		change.source=source.index;
+		change.speech_db=source.speech_db;
+		change.noise_db=source.noise_db;
+		pa_cvolume volume;
+		bool bWrite=now>=source.hold_until && !device->mute && control(source, *device, interval_ms, volume);
+		source.speech_frames=0;
+		source.peak_db=-HUGE_VAL;
+		if(!bWrite) continue;
+		
+		source.previous=source.written;
+		source.written=volume;
+		if(writes==0) m_manager.beginBatch();
+		m_manager.setSourceVolume(source.index, volume);
+		++writes;
+		change.volume=pa_cvolume_max(&volume);
+		if(changes) changes->push_back(change);
+	}
+	
+	if(writes>0 && !m_manager.flush()) LOG(WARN, "not all volume changes of the gain control were applied");
+	return(writes);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_AGC_H_
+#define PA_AGC_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include "levels.h"
+
+
+/* control loop of the automatic gain control */
+struct PAAGCConfig {
+	PAAGCConfig();
+	
+	double target_db; //RMS of speech in dBFS
+	double deadband_db; //no correction while the speech level is this close to the target
+	double attack_db_s; //max. rate to lower the volume (dB/s)
+	double release_db_s; //max. rate to raise the volume (dB/s)
+	double speech_margin_db; //a frame is speech if it is this much above the noise floor
+	double max_noise_db; //the volume is not raised if it would lift the noise floor above this
+	double peak_limit_db; //the volume is lowered if a peak of speech gets above this
+	double max_boost_db; //limits of the volume, relative to the base volume of the source
+	double min_gain_db;
+	uint32_t override_hold_ms; //the source is left alone for this long after the user changed its volume
+};
+
+/* a volume change of a tick */
+struct PAAGCChange {
+	uint32_t source;
+	double speech_db; //speech level & noise floor before the change
+	double noise_db;
+	pa_volume_t volume; //new volume (max. of the channels)
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PASourceAGC
+ * automatic gain control of sources: every source is recorded mono at
+ * 16kHz and the levels of 10ms frames are measured (measureLevels). the
+ * noise floor follows the quiet frames down fast and rises slowly, frames
+ * well above it are speech and give the speech level.
+ *
+ * tick() moves the volume toward the target with separate rates for
+ * lowering & raising. against pumping the volume is only changed while
+ * there is speech, not raised if that would lift the noise floor too
+ * high, and the level estimates are shifted by every change, so a change
+ * does not trigger the next. a volume is only written if it differs by at
+ * least one hardware step (n_volume_steps) and it stays within limits
+ * around the base volume.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PASourceAGC {
+public:
+	PASourceAGC(PAManager& manager);
+	~PASourceAGC();
+	
+	void setConfig(const PAAGCConfig& config) { m_config = config; }
+	
+	/* returns false if the source does not exist or could not be recorded */
+	bool addSource(uint32_t idx);
+	void close();
+	
+	size_t count() const { return(m_sources.size()); }
+	/* a source was not removed yet */
+	bool active() const;
+	
+	/* one step of the control loop. interval_ms is the time since the
+	 * last tick. returns the number of volume writes, the changes are
+	 * appended to changes */
+	size_t tick(uint32_t interval_ms, vector<PAAGCChange>* changes=NULL);
+	
+private:
+	enum { AGC_RATE=16000, AGC_FRAME=160 }; //10ms frames
+	
+	struct SAGCSource {
+		PASourceAGC* agc;
+		uint32_t id;
+		uint32_t index;
+		bool bEnded;
+		
+		SLevels frame; //the current frame
+		bool bNoise_init;
+		double noise_db;
+		double speech_db; //-HUGE_VAL until there was speech
+		double peak_db; //max. peak of speech since the last tick
+		uint32_t speech_frames; //since the last tick
+		double pending_db; //correction not written yet, it was less than a hardware step
+		
+		pa_cvolume written; //last volume written by us
+		pa_cvolume previous; //the volume before, as long as the event of the write is pending
+		uint64_t hold_until;
+	};
+	
+	static void recordCb(const float* samples, size_t frames, void* userdata);
+	/* the estimates of a completed frame */
+	void processFrame(SAGCSource& source);
+	/* returns true if the volume needs to be written */
+	bool control(SAGCSource& source, const PADeviceInfo& device, uint32_t interval_ms, pa_cvolume& volume);
+	
+	PAManager& m_manager;
+	PAAGCConfig m_config;
+	vector<SAGCSource*> m_sources;
+};
+
+
+#endif /* PA_AGC_H_ */
@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_async_manager.h"
+#include "pa_backend_pulse.h"
+
+#include <unistd.h>
+
+
+/* the poll interval of the event loop thread for backends without an own thread */
+#define LOOP_POLL_USEC 200
+
+template<class Object>
+static void copyObjects(const map<uint32_t, Object*>& from, map<uint32_t, Object*>& to) {
+	for(typename map<uint32_t, Object*>::const_iterator iter=from.begin(); iter!=from.end(); ++iter) {
+		to.insert(to.end(), make_pair(iter->first, new Object(*iter->second)));
+	}
+}
+
+template<class Object>
+static void deleteObjects(map<uint32_t, Object*>& objects) {
+	for(typename map<uint32_t, Object*>::iterator iter=objects.begin(); iter!=objects.end(); ++iter) {
+		delete(iter->second);
+	}
+	objects.clear();
+}
+
+template<class Object>
+static Object* findObject(const map<uint32_t, Object*>& objects, uint32_t idx) {
+	typename map<uint32_t, Object*>::const_iterator iter=objects.find(idx);
+	if(iter==objects.end()) return(NULL);
+	return(iter->second);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PASnapshot
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PASnapshot::PASnapshot(const PAManager& manager, uint64_t generation) : m_generation(generation) {
+	copyObjects(manager.Sinks(), m_sinks);
+	copyObjects(manager.Sources(), m_sources);
+	copyObjects(manager.Clients(), m_clients);
+	copyObjects(manager.SinkInputs(), m_sink_inputs);
+	copyObjects(manager.Cards(), m_cards);
+	
+	for(pa_sink_input_list::iterator iter=m_sink_inputs.begin(); iter!=m_sink_inputs.end(); ++iter) {
+		iter->second->client_obj=findObject(m_clients, iter->second->client);
+		iter->second->sink_obj=findObject(m_sinks, iter->second->sink);
+	}
+}
+
+PASnapshot::~PASnapshot() {
+	deleteObjects(m_sinks);
+	deleteObjects(m_sources);
+	deleteObjects(m_clients);
+	deleteObjects(m_sink_inputs);
+	deleteObjects(m_cards);
+}
+
+const PADeviceInfo* PASnapshot::Sink(uint32_t idx) const { return(findObject(m_sinks, idx)); }
+const PADeviceInfo* PASnapshot::Source(uint32_t idx) const { return(findObject(m_sources, idx)); }
+const PAClientInfo* PASnapshot::Client(uint32_t idx) const { return(findObject(m_clients, idx)); }
+const PASinkInputInfo* PASnapshot::SinkInput(uint32_t idx) const { return(findObject(m_sink_inputs, idx)); }
+const PACardInfo* PASnapshot::Card(uint32_t idx) const { return(findObject(m_cards, idx)); }
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAAsyncManager
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAAsyncManager::SAsyncOp::SAsyncOp(PAAsyncManager* op_owner, EPAOpType op_type, uint32_t op_index
+		, pa_async_done_cb_t op_cb, void* op_userdata)
+	: PAPendingOp(&op_owner->m_manager, op_type, op_index), owner(op_owner), mute(0)
+	, cb(op_cb), userdata(op_userdata) {
+	pa_cvolume_init(&volume);
+}
+
+PAAsyncManager::PAAsyncManager() : m_bOwn_loop(false), m_bStop(false), m_generation(0) {
+}
+
+PAAsyncManager::~PAAsyncManager() {
+	DeInit();
+}
+
+void PAAsyncManager::Init(PABackend* backend, const char* server) {
+	if(m_manager.Backend()) {
+		delete(backend);
+		THROW(EALREADY_INITIALIZED);
+	}
+	if(!backend) backend=new PAPulseBackend(true);
+	m_bOwn_loop=!backend->threaded();
+	
+	/* a threaded backend starts its thread on connect, so everything up to
+	 * the first snapshot is done with the lock held */
+	backend->lock();
+	try {
+		m_manager.Init(backend, server);
+		m_manager.subscribe((pa_subscription_mask_t)(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE
+				| PA_SUBSCRIPTION_MASK_CLIENT | PA_SUBSCRIPTION_MASK_SINK_INPUT | PA_SUBSCRIPTION_MASK_CARD)
+				, eventCb, this);
+		publish();
+	} catch(...) {
+		backend->unlock();
+		backend->stopThread();
+		m_manager.DeInit();
+		throw;
+	}
+	backend->unlock();
+	
+	if(m_bOwn_loop) {
+		m_bStop=false;
+		m_loop_thread=thread(&PAAsyncManager::loop, this);
+	}
+}
+
+void PAAsyncManager::DeInit() {
+	if(!m_manager.Backend()) return;
+	
+	if(m_bOwn_loop) {
+		m_bStop=true;
+		if(m_loop_thread.joinable()) m_loop_thread.join();
+	} else {
+		m_manager.Backend()->stopThread();
+	}
+	m_manager.DeInit();
+	
+	/* no callback will come for the remaining operations */
+	while(!m_pending_ops.empty()) finishOperation(**m_pending_ops.begin(), false);
+	
+	lock_guard<mutex> guard(m_snapshot_mutex);
+	m_snapshot.reset();
+}
+
+void PAAsyncManager::lock() {
+	if(m_bOwn_loop) m_loop_mutex.lock();
+	/* a completion callback issuing an operation holds the lock already */
+	else if(!m_manager.Backend()->inLoopThread()) m_manager.Backend()->lock();
+}
+
+void PAAsyncManager::unlock() {
+	if(m_bOwn_loop) m_loop_mutex.unlock();
+	else if(!m_manager.Backend()->inLoopThread()) m_manager.Backend()->unlock();
+}
+
+void PAAsyncManager::loop() {
+	while(!m_bStop) {
+		lock();
+		try {
+			m_manager.Backend()->iterate(0);
+		} catch(Exception& e) {
+			LOG(ERROR, "event loop: %s", e.getErrorStr().c_str());
+		}
+		unlock();
+		usleep(LOOP_POLL_USEC);
+	}
+}
+
+shared_ptr<const PASnapshot> PAAsyncManager::snapshot() const {
+	lock_guard<mutex> guard(m_snapshot_mutex);
+	return(m_snapshot);
+}
+
+void PAAsyncManager::eventCb(pa_subscription_event_type_t, uint32_t, void* userdata) {
+	((PAAsyncManager*)userdata)->publish();
+}
+
+void PAAsyncManager::publish() {
+	/* the copy is made outside of the snapshot lock, readers only wait for
+	 * the pointer swap. the old snapshot is freed by its last reader */
+	shared_ptr<const PASnapshot> objects(new PASnapshot(m_manager, ++m_generation));
+	lock_guard<mutex> guard(m_snapshot_mutex);
+	m_snapshot.swap(objects);
+}
+
+
+future<bool> PAAsyncManager::setSinkVolume(uint32_t idx, const pa_cvolume& volume) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_sink_volume, idx);
+	op->volume=volume;
+	return(issueFuture(op));
+}
+
+future<bool> PAAsyncManager::setSinkMute(uint32_t idx, int mute) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_sink_mute, idx);
+	op->mute=mute;
+	return(issueFuture(op));
+}
+
+future<bool> PAAsyncManager::setSourceVolume(uint32_t idx, const pa_cvolume& volume) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_source_volume, idx);
+	op->volume=volume;
+	return(issueFuture(op));
+}
+
+future<bool> PAAsyncManager::setSourceMute(uint32_t idx, int mute) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_source_mute, idx);
+	op->mute=mute;
+	return(issueFuture(op));
+}
+
+future<bool> PAAsyncManager::setSinkInputVolume(uint32_t idx, const pa_cvolume& volume) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_sink_input_volume, idx);
+	op->volume=volume;
+	return(issueFuture(op));
+}
+
+future<bool> PAAsyncManager::setSinkInputMute(uint32_t idx, int mute) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_sink_input_mute, idx);
+	op->mute=mute;
+	return(issueFuture(op));
+}
+
+future<bool> PAAsyncManager::setCardProfile(uint32_t idx, const string& profile_name) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_card_profile, idx);
+	op->profile=profile_name;
+	return(issueFuture(op));
+}
+
+void PAAsyncManager::setSinkVolume(uint32_t idx, const pa_cvolume& volume, pa_async_done_cb_t cb, void* userdata) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_sink_volume, idx, cb, userdata);
+	op->volume=volume;
+	issue(op);
+}
+
+void PAAsyncManager::setSinkMute(uint32_t idx, int mute, pa_async_done_cb_t cb, void* userdata) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_sink_mute, idx, cb, userdata);
+	op->mute=mute;
+	issue(op);
+}
+
+void PAAsyncManager::setSourceVolume(uint32_t idx, const pa_cvolume& volume, pa_async_done_cb_t cb, void* userdata) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_source_volume, idx, cb, userdata);
+	op->volume=volume;
+	issue(op);
+}
+
+void PAAsyncManager::setSourceMute(uint32_t idx, int mute, pa_async_done_cb_t cb, void* userdata) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_source_mute, idx, cb, userdata);
+	op->mute=mute;
+	issue(op);
+}
+
+void PAAsyncManager::setSinkInputVolume(uint32_t idx, const pa_cvolume& volume, pa_async_done_cb_t cb, void* userdata) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_sink_input_volume, idx, cb, userdata);
+	op->volume=volume;
+	issue(op);
+}
+
+void PAAsyncManager::setSinkInputMute(uint32_t idx, int mute, pa_async_done_cb_t cb, void* userdata) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_sink_input_mute, idx, cb, userdata);
+	op->mute=mute;
+	issue(op);
+}
+
+void PAAsyncManager::setCardProfile(uint32_t idx, const string& profile_name, pa_async_done_cb_t cb, void* userdata) {
+	SAsyncOp* op=new SAsyncOp(this, PAOp_set_card_profile, idx, cb, userdata);
+	op->profile=profile_name;
+	issue(op);
+}
+
+future<bool> PAAsyncManager::setSinkVolume(uint32_t idx, const string& volume, const vector<int>* channel_list) {
+	shared_ptr<const PASnapshot> objects=snapshot();
+	const PADeviceInfo* sink=objects ? objects->Sink(idx) : NULL;
+	ASSERT_THROW_e(sink, EINVALID_PARAMETER, "sink with idx %i not found", idx);
+	ASSERT_THROW(volume.length()>0, EINVALID_PARAMETER);
+	
+	if(volume=="mute") return(setSinkMute(idx, 1));
+	if(volume=="unmute") return(setSinkMute(idx, 0));
+	pa_cvolume new_volume=sink->volume;
+	PAManager::applyVolumeChannel(volume, new_volume, channel_list);
+	return(setSinkVolume(idx, new_volume));
+}
+
+future<bool> PAAsyncManager::setSourceVolume(uint32_t idx, const string& volume, const vector<int>* channel_list) {
+	shared_ptr<const PASnapshot> objects=snapshot();
+	const PADeviceInfo* source=objects ? objects->Source(idx) : NULL;
+	ASSERT_THROW_e(source, EINVALID_PARAMETER, "source with idx %i not found", idx);
+	ASSERT_THROW(volume.length()>0, EINVALID_PARAMETER);
+	
+	if(volume=="mute") return(setSourceMute(idx, 1));
+	if(volume=="unmute") return(setSourceMute(idx, 0));
+	pa_cvolume new_volume=source->volume;
+	PAManager::applyVolumeChannel(volume, new_volume, channel_list);
+	return(setSourceVolume(idx, new_volume));
+}
+
+future<bool> PAAsyncManager::setSinkInputVolume(uint32_t idx, const string& volume, const vector<int>* channel_list) {
+	shared_ptr<const PASnapshot> objects=snapshot();
+	const PASinkInputInfo* sink_input=objects ? objects->SinkInput(idx) : NULL;
+	ASSERT_THROW_e(sink_input, EINVALID_PARAMETER, "playback with idx %i not found", idx);
+	ASSERT_THROW(volume.length()>0, EINVALID_PARAMETER);
+	
+	if(volume=="mute") return(setSinkInputMute(idx, 1));
+	if(volume=="unmute") return(setSinkInputMute(idx, 0));
+	pa_cvolume new_volume=sink_input->volume;
+	PAManager::applyVolumeChannel(volume, new_volume, channel_list);
+	return(setSinkInputVolume(idx, new_volume));
+}
+
+
+future<bool> PAAsyncManager::issueFuture(SAsyncOp* op) {
+	future<bool> result=op->result.get_future();
+	issue(op);
+	return(result);
+}
+
+void PAAsyncManager::issue(SAsyncOp* op) {
+	PABackend* backend=m_manager.Backend();
+	if(!backend) {
+		delete(op);
+		THROW(ENOT_INITIALIZED);
+	}
+	op->done=opDone;
+	
+	lock();
+	m_pending_ops.insert(op);
+	op->start=getTimeUsec(); //without the time waiting for the lock
+	
+	bool bIssued=false;
+	switch(op->type) {
+	case PAOp_set_sink_volume:
+		bIssued=backend->setSinkVolume(op->index, op->volume, pa_success_cb, op);
+		break;
+	case PAOp_set_sink_mute:
+		bIssued=backend->setSinkMute(op->index, op->mute, pa_success_cb, op);
+		break;
+	case PAOp_set_source_volume:
+		bIssued=backend->setSourceVolume(op->index, op->volume, pa_success_cb, op);
+		break;
+	case PAOp_set_source_mute:
+		bIssued=backend->setSourceMute(op->index, op->mute, pa_success_cb, op);
+		break;
+	case PAOp_set_sink_input_volume:
+		bIssued=backend->setSinkInputVolume(op->index, op->volume, pa_success_cb, op);
+		break;
+	case PAOp_set_sink_input_mute:
+		bIssued=backend->setSinkInputMute(op->index, op->mute, pa_success_cb, op);
+		break;
+	case PAOp_set_card_profile:
+		bIssued=backend->setCardProfile(op->index, op->profile.c_str(), pa_success_cb, op);
+		break;
+	default:
+		break;
+	}
+	if(!bIssued) {
+		LOG(ERROR, "%s for index %i failed", paOpName(op->type), op->index);
+		finishOperation(*op, false);
+	}
+	unlock();
+}
+
+void PAAsyncManager::opDone(PAPendingOp* op) {
+	SAsyncOp* async_op=static_cast<SAsyncOp*>(op);
+	async_op->owner->m_pending_ops.erase(async_op);
+	bool bSuccess=op->ready==1;
+	if(async_op->cb) async_op->cb(bSuccess, async_op->userdata);
+	else async_op->result.set_value(bSuccess);
+	delete(async_op);
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_ASYNC_MANAGER_H_
+#define PA_ASYNC_MANAGER_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+
+/* completion of an asynchronous operation, success is true if the server applied it */
+typedef void (*pa_async_done_cb_t)(bool success, void* userdata);
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PASnapshot
+ * immutable copy of the object tables of a PAAsyncManager. the snapshot
+ * owns its objects, sink_obj & client_obj of the sink inputs point into it
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PASnapshot {
+public:
+	PASnapshot(const PAManager& manager, uint64_t generation);
+	~PASnapshot();
+	
+	/* incremented with every published snapshot */
+	uint64_t Generation() const { return(m_generation); }
+	
+	const pa_dev_list& Sinks() const { return(m_sinks); }
+	const PADeviceInfo* Sink(uint32_t idx) const; /* returns NULL if not found */
+	const pa_dev_list& Sources() const { return(m_sources); }
+	const PADeviceInfo* Source(uint32_t idx) const; /* returns NULL if not found */
+	const pa_client_list& Clients() const { return(m_clients); }
+	const PAClientInfo* Client(uint32_t idx) const; /* returns NULL if not found */
+	const pa_sink_input_list& SinkInputs() const { return(m_sink_inputs); }
+	const PASinkInputInfo* SinkInput(uint32_t idx) const; /* returns NULL if not found */
+	const pa_card_list& Cards() const { return(m_cards); }
+	const PACardInfo* Card(uint32_t idx) const; /* returns NULL if not found */
+	
+private:
+	PASnapshot(const PASnapshot&);
+	PASnapshot& operator=(const PASnapshot&);
+	
+	uint64_t m_generation;
+	pa_dev_list m_sinks;
+	pa_dev_list m_sources;
+	pa_client_list m_clients;
+	pa_sink_input_list m_sink_inputs;
+	pa_card_list m_cards;
+};
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAAsyncManager
+ * thread-safe PAManager: the event loop runs in a background thread (a
+ * pa_threaded_mainloop with libpulse) and keeps the object tables up to
+ * date. any thread can get a snapshot of the tables and issue changes
+ * without waiting for the server.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAAsyncManager {
+public:
+	PAAsyncManager();
+	~PAAsyncManager();
+	
+	/* connect, get all objects & subscribe to changes, then start the event
+	 * loop thread. PAAsyncManager takes ownership of backend, if it's NULL
+	 * libpulse with a threaded mainloop is used. server NULL means default
+	 * server */
+	void Init(PABackend* backend=NULL, const char* server=NULL);
+	/* stops the event loop, pending operations fail */
+	void DeInit();
+	
+	/* the current object tables. never waits for the event loop */
+	shared_ptr<const PASnapshot> snapshot() const;
+	
+	/* changes: they return after issuing the operation, the result is true
+	 * once the server applied it */
+	future<bool> setSinkVolume(uint32_t idx, const pa_cvolume& volume);
+	future<bool> setSinkMute(uint32_t idx, int mute);
+	future<bool> setSourceVolume(uint32_t idx, const pa_cvolume& volume);
+	future<bool> setSourceMute(uint32_t idx, int mute);
+	future<bool> setSinkInputVolume(uint32_t idx, const pa_cvolume& volume);
+	future<bool> setSinkInputMute(uint32_t idx, int mute);
+	future<bool> setCardProfile(uint32_t idx, const string& profile_name);
+	
+	/* the same with a completion callback. cb is called from the event loop
+	 * thread (or from the calling thread if the operation cannot be issued)
+	 * and must not block. it may issue new operations */
+	void setSinkVolume(uint32_t idx, const pa_cvolume& volume, pa_async_done_cb_t cb, void* userdata);
+	void setSinkMute(uint32_t idx, int mute, pa_async_done_cb_t cb, void* userdata);
+	void setSourceVolume(uint32_t idx, const pa_cvolume& volume, pa_async_done_cb_t cb, void* userdata);
+	void setSourceMute(uint32_t idx, int mute, pa_async_done_cb_t cb, void* userdata);
+	void setSinkInputVolume(uint32_t idx, const pa_cvolume& volume, pa_async_done_cb_t cb, void* userdata);
+	void setSinkInputMute(uint32_t idx, int mute, pa_async_done_cb_t cb, void* userdata);
+	void setCardProfile(uint32_t idx, const string& profile_name, pa_async_done_cb_t cb, void* userdata);
+	
+	/* volume format see PAManager::applyVolume(). relative changes apply to
+	 * the volume of the current snapshot, so concurrent relative changes of
+	 * the same object can overwrite each other */
+	future<bool> setSinkVolume(uint32_t idx, const string& volume, const vector<int>* channel_list=NULL);
+	future<bool> setSourceVolume(uint32_t idx, const string& volume, const vector<int>* channel_list=NULL);
+	future<bool> setSinkInputVolume(uint32_t idx, const string& volume, const vector<int>* channel_list=NULL);
+	
+	const CLatencyHistogram& latencyStats(EPAOpType type) const { return(m_manager.latencyStats(type)); }
+	
+private:
+	struct SAsyncOp : public PAPendingOp {
+		SAsyncOp(PAAsyncManager* op_owner, EPAOpType op_type, uint32_t op_index
+				, pa_async_done_cb_t op_cb=NULL, void* op_userdata=NULL);
+		
+		PAAsyncManager* owner;
+		pa_cvolume volume;
+		int mute;
+		string profile;
+		
+		pa_async_done_cb_t cb; //if NULL, result is set
+		void* userdata;
+		promise<bool> result;
+	};
+	
+	/* the event loop lock: the backend's lock if it runs an own thread */
+	void lock();
+	void unlock();
+	/* event loop for backends without an own thread */
+	void loop();
+	
+	future<bool> issueFuture(SAsyncOp* op);
+	void issue(SAsyncOp* op);
+	static void opDone(PAPendingOp* op);
+	
+	static void eventCb(pa_subscription_event_type_t type, uint32_t idx, void* userdata);
+	/* replace the snapshot with the current tables, called with the lock held */
+	void publish();
+	
+	PAManager m_manager; //only used with the lock held
+	set<SAsyncOp*> m_pending_ops;
+	
+	bool m_bOwn_loop;
+	recursive_mutex m_loop_mutex;
+	thread m_loop_thread;
+	atomic<bool> m_bStop;
+	
+	mutable mutex m_snapshot_mutex;
+	shared_ptr<const PASnapshot> m_snapshot;
+	uint64_t m_generation;
+};
+
+
+#endif /* PA_ASYNC_MANAGER_H_ */
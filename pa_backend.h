@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_BACKEND_H_
+#define PA_BACKEND_H_
+
+#include <pulse/pulseaudio.h>
+#include <string>
+
+
+enum EPABackendState {
+	PABackend_connecting=0,
+	PABackend_ready,
+	PABackend_failed
+};
+
+/* info callbacks: called once per object with eol=0, then once with eol=1 at
+ * the end of the list. on error they are called once with eol<0 and info=NULL */
+typedef void (*pa_backend_sink_info_cb_t)(const pa_sink_info* info, int eol, void* userdata);
+typedef void (*pa_backend_source_info_cb_t)(const pa_source_info* info, int eol, void* userdata);
+typedef void (*pa_backend_client_info_cb_t)(const pa_client_info* info, int eol, void* userdata);
+typedef void (*pa_backend_sink_input_info_cb_t)(const pa_sink_input_info* info, int eol, void* userdata);
+typedef void (*pa_backend_card_info_cb_t)(const pa_card_info* info, int eol, void* userdata);
+
+/* completion of a mutation, success is 1 on success */
+typedef void (*pa_backend_success_cb_t)(int success, void* userdata);
+
+/* subscription event (PA_SUBSCRIPTION_EVENT_* facility | type) */
+typedef void (*pa_backend_event_cb_t)(pa_subscription_event_type_t type, uint32_t idx, void* userdata);
+
+/* fragment of a record stream: frames of interleaved float32 samples. it's
+ * called once with samples=NULL when the stream failed or ended */
+typedef void (*pa_backend_record_cb_t)(const float* samples, size_t frames, void* userdata);
+
+/* a record stream, eg. for level meters */
+struct PARecordSpec {
+	PARecordSpec() : sink_input(PA_INVALID_INDEX), rate(0), channels(0), fragment_usec(10000), bPeak_detect(false) {
+		channel_map.channels=0;
+	}
+
+	std::string source; //source name
+	/* record only this sink input (pa_stream_set_monitor_stream). source
+	 * must be the monitor of its sink */
+	uint32_t sink_input;
+	uint32_t rate;
+	uint8_t channels;
+	/* positions of the channels, eg. the channel_map of the device. if its
+	 * channels differ from channels, the default order is used */
+	pa_channel_map channel_map;
+	uint32_t fragment_usec; //requested fragment size
+	bool bPeak_detect; //the server reduces the signal to the peaks at rate (PA_STREAM_PEAK_DETECT)
+};
+
+/* request of a playback stream: fill frames of interleaved float32 samples.
+ * it's called once with samples=NULL when the stream failed or ended */
+typedef void (*pa_backend_playback_cb_t)(float* samples, size_t frames, void* userdata);
+
+/* a playback stream, eg. for test signals */
+struct PAPlaybackSpec {
+	PAPlaybackSpec() : rate(0), channels(0), latency_usec(50000) {
+		channel_map.channels=0;
+	}
+
+	std::string sink; //sink name
+	uint32_t rate;
+	uint8_t channels;
+	pa_channel_map channel_map; //see PARecordSpec
+	uint32_t latency_usec; //requested target latency (tlength) of the stream buffer
+};
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PABackend
+ * interface to an audio server as used by PAManager: enumeration, by-index
+ * queries, mutations and subscription events. all requests are asynchronous,
+ * the callbacks are called from iterate().
+ *
+ * every request returns false if it could not be issued. otherwise its
+ * callback is called exactly once with eol!=0 (info) resp. once (success),
+ * unless the connection is lost.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PABackend {
+public:
+	virtual ~PABackend() {}
+
+	/* start connecting. server can be NULL for the default server */
+	virtual void connect(const char* server) = 0;
+	virtual void disconnect() = 0;
+	virtual EPABackendState state() = 0;
+
+	/* run the event loop once and wait at most timeout_ms for events (-1: block) */
+	virtual void iterate(int timeout_ms) = 0;
+
+	/* backends with an own event loop thread (threaded() returns true) call
+	 * the callbacks from that thread with lock() held. other threads must
+	 * hold lock() while using the backend, iterate() then waits for the
+	 * next callback or the timeout. stopThread() must be called without holding the lock.
+	 * inLoopThread() is true in the callbacks, where the lock is already
+	 * held and must not be taken again */
+	virtual bool threaded() { return(false); }
+	virtual bool inLoopThread() { return(false); }
+	virtual void lock() {}
+	virtual void unlock() {}
+	virtual void stopThread() {}
+
+	/* enumeration */
+	virtual bool getSinkInfoList(pa_backend_sink_info_cb_t cb, void* userdata) = 0;
+	virtual bool getSourceInfoList(pa_backend_source_info_cb_t cb, void* userdata) = 0;
+	virtual bool getClientInfoList(pa_backend_client_info_cb_t cb, void* userdata) = 0;
+	virtual bool getSinkInputInfoList(pa_backend_sink_input_info_cb_t cb, void* userdata) = 0;
+	virtual bool getCardInfoList(pa_backend_card_info_cb_t cb, void* userdata) = 0;
+
+	/* by-index queries */
+	virtual bool getSinkInfo(uint32_t idx, pa_backend_sink_info_cb_t cb, void* userdata) = 0;
+	virtual bool getSourceInfo(uint32_t idx, pa_backend_source_info_cb_t cb, void* userdata) = 0;
+	virtual bool getClientInfo(uint32_t idx, pa_backend_client_info_cb_t cb, void* userdata) = 0;
+	virtual bool getSinkInputInfo(uint32_t idx, pa_backend_sink_input_info_cb_t cb, void* userdata) = 0;
+	virtual bool getCardInfo(uint32_t idx, pa_backend_card_info_cb_t cb, void* userdata) = 0;
+
+	/* mutations */
+	virtual bool setSinkVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata) = 0;
+	virtual bool setSinkMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata) = 0;
+	virtual bool setSourceVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata) = 0;
+	virtual bool setSourceMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata) = 0;
+	virtual bool setSinkInputVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata) = 0;
+	virtual bool setSinkInputMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata) = 0;
+	virtual bool setCardProfile(uint32_t idx, const char* profile, pa_backend_success_cb_t cb, void* userdata) = 0;
+	virtual bool moveSinkInput(uint32_t idx, uint32_t sink_idx, pa_backend_success_cb_t cb, void* userdata) = 0;
+	/* suspend (suspend!=0) or resume a device */
+	virtual bool suspendSink(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata) = 0;
+	virtual bool suspendSource(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata) = 0;
+
+	/* subscription: cb is called for every event matching mask. a second call
+	 * replaces the previous subscription */
+	virtual bool subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb, void* userdata) = 0;
+
+	/* record streams: returns a stream id, 0 if the backend has no streams
+	 * or the stream could not be created. cb is called from iterate()
+	 * until closeStream(). disconnect() closes all streams */
+	virtual uint32_t openRecordStream(const PARecordSpec&, pa_backend_record_cb_t, void*) { return(0); }
+	/* playback streams: like record streams, cb is called from iterate()
+	 * whenever the server requests samples */
+	virtual uint32_t openPlaybackStream(const PAPlaybackSpec&, pa_backend_playback_cb_t, void*) { return(0); }
+	/* sink input index of a playback stream, PA_INVALID_INDEX as long as
+	 * it's not connected */
+	virtual uint32_t streamIndex(uint32_t) { return(PA_INVALID_INDEX); }
+	virtual void closeStream(uint32_t) {}
+};
+
+
+#endif /* PA_BACKEND_H_ */
@@ -0,0 +1,803 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_backend_fake.h"
+
+#include <cstring>
+#include <unistd.h>
+
+
+PAFakeConfig::PAFakeConfig() : sinks(2), sources(1), cards(2), profiles(4)
+	, clients(3), sink_inputs(3), channels(2), latency_usec(0), fail_connect(false) {
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAFakeBackend
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAFakeBackend::SFakeRequest::SFakeRequest(EFakeRequest req_type, uint32_t req_index, void* req_userdata)
+	: type(req_type), index(req_index), userdata(req_userdata), mute(0), target(PA_INVALID_INDEX)
+	, event(PA_SUBSCRIPTION_EVENT_CHANGE) {
+	cb.success = NULL;
+	memset(&volume, 0, sizeof(volume));
+}
+
+PAFakeBackend::PAFakeBackend() : m_state(PABackend_failed), m_connect_done(0)
+	, m_bFail_connect(false), m_down_until(0), m_latency_usec(0), m_event_mask(PA_SUBSCRIPTION_MASK_NULL)
+	, m_event_cb(NULL), m_event_userdata(NULL), m_next_stream_id(1) {
+}
+
+PAFakeBackend::PAFakeBackend(const PAFakeConfig& config) : m_state(PABackend_failed), m_connect_done(0)
+	, m_bFail_connect(config.fail_connect), m_down_until(0), m_latency_usec(config.latency_usec)
+	, m_event_mask(PA_SUBSCRIPTION_MASK_NULL), m_event_cb(NULL), m_event_userdata(NULL), m_next_stream_id(1) {
+	synthesize(config);
+}
+
+PAFakeBackend::~PAFakeBackend() {
+}
+
+static const char* fake_profile_names[] = {
+	"output:analog-stereo+input:analog-stereo",
+	"output:analog-stereo",
+	"output:hdmi-stereo",
+	"output:analog-surround-51",
+	"input:analog-stereo",
+	"off"
+};
+
+void PAFakeBackend::synthesize(const PAFakeConfig& config) {
+	m_store.clear();
+
+	pa_sample_spec spec;
+	spec.format = PA_SAMPLE_FLOAT32LE;
+	spec.rate = 48000;
+	spec.channels = config.channels;
+	pa_channel_map channel_map;
+	pa_channel_map_init_auto(&channel_map, config.channels, PA_CHANNEL_MAP_DEFAULT);
+
+	const uint32_t n_profile_names = sizeof(fake_profile_names)/sizeof(fake_profile_names[0]);
+	for(uint32_t i=0; i<config.cards; ++i) {
+		string name = "alsa_card.fake_" + toStr(i);
+		vector<string> names, descriptions;
+		vector<pa_card_profile_info> profiles(config.profiles);
+		for(uint32_t k=0; k<config.profiles; ++k) {
+			names.push_back(fake_profile_names[k%n_profile_names]);
+			if(k >= n_profile_names) names.back() += "-" + toStr(k/n_profile_names);
+			descriptions.push_back("Fake Profile " + toStr(k));
+		}
+		for(uint32_t k=0; k<config.profiles; ++k) {
+			profiles[k].name = names[k].c_str();
+			profiles[k].description = descriptions[k].c_str();
+			profiles[k].n_sinks = 1;
+			profiles[k].n_sources = 1;
+			profiles[k].priority = config.profiles-k;
+		}
+
+		pa_card_info info;
+		memset(&info, 0, sizeof(info));
+		info.index = i;
+		info.name = name.c_str();
+		info.owner_module = i;
+		info.driver = "module-alsa-card.c";
+		info.n_profiles = config.profiles;
+		info.profiles = profiles.empty() ? NULL : &profiles[0];
+		info.active_profile = info.profiles;
+		m_store.addCard(info);
+	}
+
+	for(uint32_t i=0; i<config.sinks; ++i) {
+		string name = "alsa_output.fake_" + toStr(i) + ".analog-stereo";
+		string description = "Fake Output " + toStr(i);
+		string monitor = name + ".monitor";
+
+		pa_sink_info info;
+		memset(&info, 0, sizeof(info));
+		info.name = name.c_str();
+		info.index = i;
+		info.description = description.c_str();
+		info.sample_spec = spec;
+		info.channel_map = channel_map;
+		info.owner_module = config.cards > 0 ? i%config.cards : PA_INVALID_INDEX;
+		pa_cvolume_set(&info.volume, config.channels, (pa_volume_t)(PA_VOLUME_NORM/100*(30+i%70)));
+		info.monitor_source = i;
+		info.monitor_source_name = monitor.c_str();
+		info.latency = 20000;
+		info.driver = "module-alsa-card.c";
+		info.flags = (pa_sink_flags_t)(PA_SINK_HW_VOLUME_CTRL | PA_SINK_LATENCY | PA_SINK_HARDWARE | PA_SINK_DECIBEL_VOLUME);
+		info.configured_latency = 25000;
+		info.base_volume = PA_VOLUME_NORM;
+		info.state = i%2 == 0 ? PA_SINK_RUNNING : PA_SINK_IDLE;
+		info.n_volume_steps = PA_VOLUME_NORM+1;
+		info.card = config.cards > 0 ? i%config.cards : PA_INVALID_INDEX;
+		m_store.addSink(info);
+
+		/* monitor source */
+		string monitor_description = "Monitor of " + description;
+		pa_source_info source;
+		memset(&source, 0, sizeof(source));
+		source.name = monitor.c_str();
+		source.index = i;
+		source.description = monitor_description.c_str();
+		source.sample_spec = spec;
+		source.channel_map = channel_map;
+		source.owner_module = info.owner_module;
+		pa_cvolume_set(&source.volume, config.channels, PA_VOLUME_NORM);
+		source.monitor_of_sink = i;
+		source.monitor_of_sink_name = info.name;
+		source.latency = 20000;
+		source.driver = "module-alsa-card.c";
+		source.flags = (pa_source_flags_t)(PA_SOURCE_LATENCY | PA_SOURCE_DECIBEL_VOLUME);
+		source.configured_latency = 25000;
+		source.base_volume = PA_VOLUME_NORM;
+		source.state = PA_SOURCE_IDLE;
+		source.n_volume_steps = PA_VOLUME_NORM+1;
+		source.card = info.card;
+		m_store.addSource(source);
+	}
+
+	for(uint32_t i=0; i<config.sources; ++i) {
+		uint32_t idx = config.sinks + i;
+		string name = "alsa_input.fake_" + toStr(i) + ".analog-stereo";
+		string description = "Fake Input " + toStr(i);
+
+		pa_source_info info;
+		memset(&info, 0, sizeof(info));
+		info.name = name.c_str();
+		info.index = idx;
+		info.description = description.c_str();
+		info.sample_spec = spec;
+		info.channel_map = channel_map;
+		info.owner_module = config.cards > 0 ? i%config.cards : PA_INVALID_INDEX;
+		pa_cvolume_set(&info.volume, config.channels, (pa_volume_t)(PA_VOLUME_NORM/100*(50+i%50)));
+		info.monitor_of_sink = PA_INVALID_INDEX;
+		info.latency = 10000;
+		info.driver = "module-alsa-card.c";
+		info.flags = (pa_source_flags_t)(PA_SOURCE_HW_VOLUME_CTRL | PA_SOURCE_LATENCY | PA_SOURCE_HARDWARE | PA_SOURCE_DECIBEL_VOLUME);
+		info.configured_latency = 10000;
+		info.base_volume = PA_VOLUME_NORM/4;
+		info.state = PA_SOURCE_SUSPENDED;
+		info.n_volume_steps = 65;
+		info.card = config.cards > 0 ? i%config.cards : PA_INVALID_INDEX;
+		m_store.addSource(info);
+	}
+
+	for(uint32_t i=0; i<config.clients; ++i) {
+		string name = "Fake Client " + toStr(i);
+		pa_client_info info;
+		memset(&info, 0, sizeof(info));
+		info.index = i;
+		info.name = name.c_str();
+		info.owner_module = PA_INVALID_INDEX;
+		info.driver = "protocol-native.c";
+		info.proplist = pa_proplist_new();
+		pa_proplist_sets(info.proplist, PA_PROP_APPLICATION_NAME, name.c_str());
+		pa_proplist_sets(info.proplist, PA_PROP_APPLICATION_PROCESS_ID, toStr(1000+i).c_str());
+		m_store.addClient(info);
+		pa_proplist_free(info.proplist);
+	}
+
+	for(uint32_t i=0; i<config.sink_inputs; ++i) {
+		string name = "Playback Stream " + toStr(i);
+		pa_sink_input_info info;
+		memset(&info, 0, sizeof(info));
+		info.index = i;
+		info.name = name.c_str();
+		info.owner_module = PA_INVALID_INDEX;
+		info.client = config.clients > 0 ? i%config.clients : PA_INVALID_INDEX;
+		info.sink = config.sinks > 0 ? i%config.sinks : PA_INVALID_INDEX;
+		info.sample_spec = spec;
+		info.channel_map = channel_map;
+		pa_cvolume_set(&info.volume, config.channels, PA_VOLUME_NORM);
+		info.buffer_usec = 50000;
+		info.sink_usec = 20000;
+		info.driver = "protocol-native.c";
+		info.has_volume = 1;
+		info.volume_writable = 1;
+		info.proplist = pa_proplist_new();
+		pa_proplist_sets(info.proplist, PA_PROP_MEDIA_NAME, name.c_str());
+		pa_proplist_sets(info.proplist, PA_PROP_MEDIA_ROLE, "music");
+		if(config.clients > 0) {
+			string client_name = "Fake Client " + toStr(i%config.clients);
+			pa_proplist_sets(info.proplist, PA_PROP_APPLICATION_NAME, client_name.c_str());
+		}
+		m_store.addSinkInput(info);
+		pa_proplist_free(info.proplist);
+	}
+}
+
+void PAFakeBackend::connect(const char*) {
+	ASSERT_THROW(m_state!=PABackend_connecting && m_state!=PABackend_ready, EALREADY_INITIALIZED);
+	m_state = PABackend_connecting;
+	m_connect_done = getTimeUsec() + m_latency_usec;
+}
+
+void PAFakeBackend::disconnect() {
+	m_state = PABackend_failed;
+	m_requests.clear();
+	m_event_cb = NULL;
+	m_streams.clear();
+	for(map<uint32_t, SFakePlayback>::iterator iter=m_playback.begin(); iter!=m_playback.end(); ++iter) {
+		m_store.removeSinkInput(iter->second.sink_input);
+	}
+	m_playback.clear();
+}
+
+void PAFakeBackend::crash(uint32_t restart_usec) {
+	disconnect();
+	m_down_until = getTimeUsec() + restart_usec;
+}
+
+void PAFakeBackend::iterate(int timeout_ms) {
+	uint64_t now = getTimeUsec();
+	uint64_t next = (uint64_t)-1;
+	if(m_state == PABackend_connecting) {
+		next = m_connect_done;
+	} else {
+		if(!m_requests.empty()) next = m_requests.begin()->first;
+		for(map<uint32_t, SFakeStream>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ++iter) {
+			if(iter->second.due < next) next = iter->second.due;
+		}
+		for(map<uint32_t, SFakePlayback>::iterator iter=m_playback.begin(); iter!=m_playback.end(); ++iter) {
+			if(iter->second.due < next) next = iter->second.due;
+		}
+	}
+	if(next == (uint64_t)-1) {
+		/* nothing will happen, so don't block forever */
+		if(timeout_ms > 0) usleep((useconds_t)timeout_ms*1000);
+		return;
+	}
+
+	if(next > now) {
+		uint64_t wait = next - now;
+		if(timeout_ms >= 0 && wait > (uint64_t)timeout_ms*1000) wait = (uint64_t)timeout_ms*1000;
+		if(wait > 0) usleep((useconds_t)wait);
+		now = getTimeUsec();
+	}
+
+	if(m_state == PABackend_connecting && now >= m_connect_done) {
+		m_state = m_bFail_connect || now < m_down_until ? PABackend_failed : PABackend_ready;
+	}
+
+	while(!m_requests.empty() && m_requests.begin()->first <= now) {
+		SFakeRequest req = m_requests.begin()->second;
+		m_requests.erase(m_requests.begin());
+		dispatch(req);
+	}
+
+	/* the callbacks can close streams. the playback comes first, so the
+	 * monitors see its frames */
+	vector<uint32_t> due_streams;
+	for(map<uint32_t, SFakePlayback>::iterator iter=m_playback.begin(); iter!=m_playback.end(); ++iter) {
+		if(iter->second.due <= now) due_streams.push_back(iter->first);
+	}
+	for(size_t i=0; i<due_streams.size(); ++i) playbackStream(due_streams[i], now);
+	due_streams.clear();
+	for(map<uint32_t, SFakeStream>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ++iter) {
+		if(iter->second.due <= now) due_streams.push_back(iter->first);
+	}
+	for(size_t i=0; i<due_streams.size(); ++i) recordStream(due_streams[i], now);
+}
+
+uint32_t PAFakeBackend::openRecordStream(const PARecordSpec& spec, pa_backend_record_cb_t cb, void* userdata) {
+	if(m_state != PABackend_ready || spec.channels == 0 || spec.channels > PA_CHANNELS_MAX || spec.rate == 0
+			|| spec.fragment_usec == 0) return(0);
+
+	SFakeStream stream;
+	stream.spec = spec;
+	stream.cb = cb;
+	stream.userdata = userdata;
+	stream.due = getTimeUsec() + m_latency_usec + spec.fragment_usec;
+	stream.phase = 0.0;
+	uint32_t id = m_next_stream_id++;
+	m_streams[id] = stream;
+	return(id);
+}
+
+uint32_t PAFakeBackend::openPlaybackStream(const PAPlaybackSpec& spec, pa_backend_playback_cb_t cb, void* userdata) {
+	if(m_state != PABackend_ready || spec.channels == 0 || spec.channels > PA_CHANNELS_MAX || spec.rate == 0
+			|| spec.latency_usec < 4) return(0);
+
+	const map<uint32_t, PAStoredSink*>& sinks = m_store.Sinks();
+	map<uint32_t, PAStoredSink*>::const_iterator sink = sinks.begin();
+	while(sink != sinks.end() && spec.sink != sink->second->info.name) ++sink;
+	if(sink == sinks.end()) return(0);
+
+	const map<uint32_t, PAStoredSinkInput*>& sink_inputs = m_store.SinkInputs();
+	uint32_t idx = sink_inputs.empty() ? 0 : sink_inputs.rbegin()->first+1;
+	string name = "Playback Stream " + toStr(idx);
+	pa_sink_input_info info;
+	memset(&info, 0, sizeof(info));
+	info.index = idx;
+	info.name = name.c_str();
+	info.owner_module = PA_INVALID_INDEX;
+	info.client = PA_INVALID_INDEX;
+	info.sink = sink->first;
+	info.sample_spec.format = PA_SAMPLE_FLOAT32LE;
+	info.sample_spec.rate = spec.rate;
+	info.sample_spec.channels = spec.channels;
+	pa_channel_map_init_auto(&info.channel_map, spec.channels, PA_CHANNEL_MAP_DEFAULT);
+	pa_cvolume_set(&info.volume, spec.channels, PA_VOLUME_NORM);
+	info.buffer_usec = spec.latency_usec;
+	info.sink_usec = sink->second->info.latency;
+	info.driver = "protocol-native.c";
+	info.has_volume = 1;
+	info.volume_writable = 1;
+	info.proplist = pa_proplist_new();
+	pa_proplist_sets(info.proplist, PA_PROP_MEDIA_NAME, name.c_str());
+	m_store.addSinkInput(info);
+	pa_proplist_free(info.proplist);
+	emitEvent((pa_subscription_event_type_t)(PA_SUBSCRIPTION_EVENT_SINK_INPUT | PA_SUBSCRIPTION_EVENT_NEW), idx);
+
+	/* a stream resumes the sink */
+	if(sink->second->info.state == PA_SINK_SUSPENDED) {
+		sink->second->info.state = PA_SINK_RUNNING;
+		emitEvent((pa_subscription_event_type_t)(PA_SUBSCRIPTION_EVENT_SINK | PA_SUBSCRIPTION_EVENT_CHANGE), sink->first);
+	}
+
+	SFakePlayback stream;
+	stream.spec = spec;
+	stream.cb = cb;
+	stream.userdata = userdata;
+	stream.sink = sink->first;
+	stream.sink_input = idx;
+	stream.due = getTimeUsec() + m_latency_usec;
+	stream.requested = stream.due;
+	stream.start = stream.due + sink->second->info.latency;
+	stream.frames = 0;
+	stream.first = 0;
+	uint32_t id = m_next_stream_id++;
+	m_playback[id] = stream;
+	return(id);
+}
+
+uint32_t PAFakeBackend::streamIndex(uint32_t id) {
+	map<uint32_t, SFakePlayback>::iterator iter = m_playback.find(id);
+	if(iter == m_playback.end()) return(PA_INVALID_INDEX);
+	return(iter->second.sink_input);
+}
+
+void PAFakeBackend::closeStream(uint32_t id) {
+	m_streams.erase(id);
+	map<uint32_t, SFakePlayback>::iterator iter = m_playback.find(id);
+	if(iter == m_playback.end()) return;
+	uint32_t idx = iter->second.sink_input;
+	m_playback.erase(iter);
+	if(m_store.removeSinkInput(idx))
+		emitEvent((pa_subscription_event_type_t)(PA_SUBSCRIPTION_EVENT_SINK_INPUT | PA_SUBSCRIPTION_EVENT_REMOVE), idx);
+}
+
+void PAFakeBackend::playbackStream(uint32_t id, uint64_t now) {
+	map<uint32_t, SFakePlayback>::iterator iter = m_playback.find(id);
+	if(iter == m_playback.end()) return;
+	SFakePlayback& stream = iter->second;
+	const PAPlaybackSpec& spec = stream.spec;
+
+	if(!m_store.Sink(stream.sink) || !m_store.SinkInput(stream.sink_input)) {
+		pa_backend_playback_cb_t cb = stream.cb;
+		void* userdata = stream.userdata;
+		m_playback.erase(iter);
+		cb(NULL, 0, userdata);
+		return;
+	}
+
+	/* the buffer stays filled up to latency_usec ahead of the requests */
+	uint32_t minreq = spec.latency_usec/4;
+	while(stream.due <= now) {
+		uint64_t target = (uint64_t)spec.rate*(spec.latency_usec + (stream.due-stream.requested))/1000000;
+		stream.due += minreq;
+		if(target <= stream.frames) continue;
+		size_t frames = (size_t)(target - stream.frames);
+		m_request.resize(frames*spec.channels);
+		stream.cb(&m_request[0], frames, stream.userdata);
+		/* the callback can close the stream */
+		iter = m_playback.find(id);
+		if(iter == m_playback.end()) return;
+
+		for(size_t i=0; i<frames; ++i) stream.played.push_back(m_request[i*spec.channels]);
+		stream.frames = target;
+		/* keep the last 2s */
+		if(stream.played.size() > 4*(size_t)spec.rate) {
+			size_t drop = stream.played.size() - 2*(size_t)spec.rate;
+			stream.played.erase(stream.played.begin(), stream.played.begin()+drop);
+			stream.first += drop;
+		}
+	}
+}
+
+uint32_t PAFakeBackend::streamSink(const SFakeStream& stream) {
+	if(stream.spec.sink_input != PA_INVALID_INDEX) {
+		PAStoredSinkInput* sink_input = m_store.SinkInput(stream.spec.sink_input);
+		return(sink_input ? sink_input->info.sink : PA_INVALID_INDEX);
+	}
+	const map<uint32_t, PAStoredSource*>& sources = m_store.Sources();
+	for(map<uint32_t, PAStoredSource*>::const_iterator iter=sources.begin(); iter!=sources.end(); ++iter) {
+		if(stream.spec.source == iter->second->info.name) return(iter->second->info.monitor_of_sink);
+	}
+	return(PA_INVALID_INDEX);
+}
+
+void PAFakeBackend::mixPlayback(const SFakeStream& stream, uint32_t sink, const double* amplitude, uint64_t end, size_t frames) {
+	const PARecordSpec& spec = stream.spec;
+	for(map<uint32_t, SFakePlayback>::const_iterator iter=m_playback.begin(); iter!=m_playback.end(); ++iter) {
+		const SFakePlayback& playback = iter->second;
+		if(playback.sink != sink) continue;
+		if(spec.sink_input != PA_INVALID_INDEX && spec.sink_input != playback.sink_input) continue;
+
+		/* frame i of the fragment was played at end-(frames-i)/rate. the
+		 * amplitude of the sine is 0.5, the played frames get the same gain */
+		for(size_t i=0; i<frames; ++i) {
+			uint64_t offset = (uint64_t)(frames-i)*1000000/spec.rate;
+			if(end < playback.start + offset) continue;
+			uint64_t frame = (end - offset - playback.start)*playback.spec.rate/1000000;
+			if(frame < playback.first || frame >= playback.first + playback.played.size()) continue;
+			float value = playback.played[frame - playback.first];
+			for(uint8_t k=0; k<spec.channels; ++k) m_fragment[i*spec.channels+k] += (float)(2.0*amplitude[k]*value);
+		}
+	}
+}
+
+bool PAFakeBackend::streamAmplitude(const SFakeStream& stream, uint8_t channel, double& amplitude) {
+	if(stream.spec.sink_input != PA_INVALID_INDEX) {
+		PAStoredSinkInput* sink_input = m_store.SinkInput(stream.spec.sink_input);
+		if(!sink_input) return(false);
+		const pa_sink_input_info& info = sink_input->info;
+		amplitude = 0.5;
+		if(info.mute) amplitude = 0.0;
+		else if(channel < info.volume.channels) amplitude *= pa_sw_volume_to_linear(info.volume.values[channel]);
+		return(true);
+	}
+
+	const map<uint32_t, PAStoredSource*>& sources = m_store.Sources();
+	for(map<uint32_t, PAStoredSource*>::const_iterator iter=sources.begin(); iter!=sources.end(); ++iter) {
+		const pa_source_info& source = iter->second->info;
+		if(stream.spec.source != source.name) continue;
+
+		amplitude = 0.5;
+		if(source.mute) amplitude = 0.0;
+		else if(channel < source.volume.channels) amplitude *= pa_sw_volume_to_linear(source.volume.values[channel]);
+
+		PAStoredSink* sink = m_store.Sink(source.monitor_of_sink);
+		if(source.monitor_of_sink != PA_INVALID_INDEX && sink) {
+			if(sink->info.mute) amplitude = 0.0;
+			else if(channel < sink->info.volume.channels) amplitude *= pa_sw_volume_to_linear(sink->info.volume.values[channel]);
+		}
+		return(true);
+	}
+	return(false);
+}
+
+bool PAFakeBackend::streamSuspended(const SFakeStream& stream) {
+	if(stream.spec.sink_input != PA_INVALID_INDEX) {
+		PAStoredSinkInput* sink_input = m_store.SinkInput(stream.spec.sink_input);
+		PAStoredSink* sink = sink_input ? m_store.Sink(sink_input->info.sink) : NULL;
+		return(sink && sink->info.state == PA_SINK_SUSPENDED);
+	}
+	const map<uint32_t, PAStoredSource*>& sources = m_store.Sources();
+	for(map<uint32_t, PAStoredSource*>::const_iterator iter=sources.begin(); iter!=sources.end(); ++iter) {
+		const pa_source_info& source = iter->second->info;
+		if(stream.spec.source != source.name) continue;
+		if(source.state == PA_SOURCE_SUSPENDED) return(true);
+		PAStoredSink* sink = m_store.Sink(source.monitor_of_sink);
+		return(source.monitor_of_sink != PA_INVALID_INDEX && sink && sink->info.state == PA_SINK_SUSPENDED);
+	}
+	return(false);
+}
+
+void PAFakeBackend::recordStream(uint32_t id, uint64_t now) {
+	map<uint32_t, SFakeStream>::iterator iter = m_streams.find(id);
+	if(iter == m_streams.end()) return;
+	SFakeStream& stream = iter->second;
+	const PARecordSpec& spec = stream.spec;
+
+	double amplitude[PA_CHANNELS_MAX];
+	for(uint8_t k=0; k<spec.channels; ++k) {
+		if(!streamAmplitude(stream, k, amplitude[k])) {
+			pa_backend_record_cb_t cb = stream.cb;
+			void* userdata = stream.userdata;
+			m_streams.erase(iter);
+			cb(NULL, 0, userdata);
+			return;
+		}
+	}
+
+	/* don't catch up after a long block */
+	if(now - stream.due > 1000000) stream.due = now;
+	if(streamSuspended(stream)) {
+		while(stream.due <= now) stream.due += spec.fragment_usec;
+		return;
+	}
+
+	size_t frames = (size_t)((uint64_t)spec.rate*spec.fragment_usec/1000000);
+	if(frames == 0) frames = 1;
+	m_fragment.resize(frames*spec.channels);
+	double step = 2.0*M_PI*1000.0/spec.rate;
+	uint32_t sink = m_playback.empty() || spec.bPeak_detect ? PA_INVALID_INDEX : streamSink(stream);
+	while(stream.due <= now) {
+		for(size_t i=0; i<frames; ++i) {
+			/* peak detection delivers the peak of every period */
+			double value = spec.bPeak_detect ? 1.0 : sin(stream.phase);
+			stream.phase = fmod(stream.phase + step, 2.0*M_PI);
+			for(uint8_t k=0; k<spec.channels; ++k) m_fragment[i*spec.channels+k] = (float)(amplitude[k]*value);
+		}
+		if(sink != PA_INVALID_INDEX) mixPlayback(stream, sink, amplitude, stream.due, frames);
+		stream.due += spec.fragment_usec;
+		stream.cb(&m_fragment[0], frames, stream.userdata);
+		/* the callback can close the stream */
+		iter = m_streams.find(id);
+		if(iter == m_streams.end()) return;
+	}
+}
+
+bool PAFakeBackend::queue(const SFakeRequest& req) {
+	if(m_state != PABackend_ready) return(false);
+	uint64_t due = getTimeUsec();
+	if(req.type != Fake_event) due += m_latency_usec;
+	m_requests.insert(make_pair(due, req));
+	return(true);
+}
+
+void PAFakeBackend::emitEvent(pa_subscription_event_type_t type, uint32_t idx) {
+	int facility = type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+	if(!m_event_cb || !(m_event_mask & (1<<facility))) return;
+
+	SFakeRequest req(Fake_event, idx, NULL);
+	req.event = type;
+	queue(req);
+}
+
+template<class Entry, class Cb>
+static void dispatchList(const map<uint32_t, Entry*>& entries, Cb cb, void* userdata) {
+	for(typename map<uint32_t, Entry*>::const_iterator iter=entries.begin(); iter!=entries.end(); ++iter) {
+		cb(&iter->second->info, 0, userdata);
+	}
+	cb(NULL, 1, userdata);
+}
+
+template<class Entry, class Cb>
+static void dispatchSingle(Entry* entry, Cb cb, void* userdata) {
+	if(!entry) {
+		cb(NULL, -1, userdata);
+		return;
+	}
+	cb(&entry->info, 0, userdata);
+	cb(NULL, 1, userdata);
+}
+
+void PAFakeBackend::dispatch(const SFakeRequest& req) {
+	switch(req.type) {
+	case Fake_sink_list: dispatchList(m_store.Sinks(), req.cb.sink, req.userdata); break;
+	case Fake_source_list: dispatchList(m_store.Sources(), req.cb.source, req.userdata); break;
+	case Fake_client_list: dispatchList(m_store.Clients(), req.cb.client, req.userdata); break;
+	case Fake_sink_input_list: dispatchList(m_store.SinkInputs(), req.cb.sink_input, req.userdata); break;
+	case Fake_card_list: dispatchList(m_store.Cards(), req.cb.card, req.userdata); break;
+	case Fake_sink: dispatchSingle(m_store.Sink(req.index), req.cb.sink, req.userdata); break;
+	case Fake_source: dispatchSingle(m_store.Source(req.index), req.cb.source, req.userdata); break;
+	case Fake_client: dispatchSingle(m_store.Client(req.index), req.cb.client, req.userdata); break;
+	case Fake_sink_input: dispatchSingle(m_store.SinkInput(req.index), req.cb.sink_input, req.userdata); break;
+	case Fake_card: dispatchSingle(m_store.Card(req.index), req.cb.card, req.userdata); break;
+	case Fake_event:
+		if(m_event_cb) m_event_cb(req.event, req.index, m_event_userdata);
+		break;
+	default:
+		req.cb.success(apply(req) ? 1 : 0, req.userdata);
+		break;
+	}
+}
+
+bool PAFakeBackend::apply(const SFakeRequest& req) {
+	pa_subscription_event_type_t facility;
+	switch(req.type) {
+	case Fake_set_sink_volume:
+	case Fake_set_sink_mute: {
+		PAStoredSink* sink = m_store.Sink(req.index);
+		if(!sink) return(false);
+		if(req.type == Fake_set_sink_mute) {
+			sink->info.mute = req.mute;
+		} else {
+			if(req.volume.channels != sink->info.volume.channels) return(false);
+			sink->info.volume = req.volume;
+		}
+		facility = PA_SUBSCRIPTION_EVENT_SINK;
+		break;
+	}
+	case Fake_set_source_volume:
+	case Fake_set_source_mute: {
+		PAStoredSource* source = m_store.Source(req.index);
+		if(!source) return(false);
+		if(req.type == Fake_set_source_mute) {
+			source->info.mute = req.mute;
+		} else {
+			if(req.volume.channels != source->info.volume.channels) return(false);
+			source->info.volume = req.volume;
+		}
+		facility = PA_SUBSCRIPTION_EVENT_SOURCE;
+		break;
+	}
+	case Fake_set_sink_input_volume:
+	case Fake_set_sink_input_mute: {
+		PAStoredSinkInput* input = m_store.SinkInput(req.index);
+		if(!input) return(false);
+		if(req.type == Fake_set_sink_input_mute) {
+			input->info.mute = req.mute;
+		} else {
+			if(req.volume.channels != input->info.volume.channels) return(false);
+			input->info.volume = req.volume;
+		}
+		facility = PA_SUBSCRIPTION_EVENT_SINK_INPUT;
+		break;
+	}
+	case Fake_set_card_profile: {
+		PAStoredCard* card = m_store.Card(req.index);
+		if(!card || !card->setActiveProfile(req.profile)) return(false);
+		facility = PA_SUBSCRIPTION_EVENT_CARD;
+		break;
+	}
+	case Fake_move_sink_input: {
+		PAStoredSinkInput* input = m_store.SinkInput(req.index);
+		if(!input || !m_store.Sink(req.target)) return(false);
+		input->info.sink = req.target;
+		facility = PA_SUBSCRIPTION_EVENT_SINK_INPUT;
+		break;
+	}
+	case Fake_suspend_sink: {
+		PAStoredSink* sink = m_store.Sink(req.index);
+		if(!sink) return(false);
+		/* a resumed sink runs if it has streams */
+		sink->info.state = PA_SINK_IDLE;
+		const map<uint32_t, PAStoredSinkInput*>& inputs = m_store.SinkInputs();
+		for(map<uint32_t, PAStoredSinkInput*>::const_iterator iter=inputs.begin(); iter!=inputs.end(); ++iter) {
+			if(iter->second->info.sink == req.index) sink->info.state = PA_SINK_RUNNING;
+		}
+		if(req.mute) sink->info.state = PA_SINK_SUSPENDED;
+		facility = PA_SUBSCRIPTION_EVENT_SINK;
+		break;
+	}
+	case Fake_suspend_source: {
+		PAStoredSource* source = m_store.Source(req.index);
+		if(!source) return(false);
+		source->info.state = req.mute ? PA_SOURCE_SUSPENDED : PA_SOURCE_IDLE;
+		facility = PA_SUBSCRIPTION_EVENT_SOURCE;
+		break;
+	}
+	default:
+		return(false);
+	}
+	emitEvent((pa_subscription_event_type_t)(facility | PA_SUBSCRIPTION_EVENT_CHANGE), req.index);
+	return(true);
+}
+
+#define FAKE_INFO_REQUEST(req_type, idx, member) \
+	SFakeRequest req(req_type, idx, userdata); \
+	req.cb.member = cb; \
+	return(queue(req))
+
+bool PAFakeBackend::getSinkInfoList(pa_backend_sink_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_sink_list, PA_INVALID_INDEX, sink);
+}
+
+bool PAFakeBackend::getSourceInfoList(pa_backend_source_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_source_list, PA_INVALID_INDEX, source);
+}
+
+bool PAFakeBackend::getClientInfoList(pa_backend_client_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_client_list, PA_INVALID_INDEX, client);
+}
+
+bool PAFakeBackend::getSinkInputInfoList(pa_backend_sink_input_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_sink_input_list, PA_INVALID_INDEX, sink_input);
+}
+
+bool PAFakeBackend::getCardInfoList(pa_backend_card_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_card_list, PA_INVALID_INDEX, card);
+}
+
+bool PAFakeBackend::getSinkInfo(uint32_t idx, pa_backend_sink_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_sink, idx, sink);
+}
+
+bool PAFakeBackend::getSourceInfo(uint32_t idx, pa_backend_source_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_source, idx, source);
+}
+
+bool PAFakeBackend::getClientInfo(uint32_t idx, pa_backend_client_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_client, idx, client);
+}
+
+bool PAFakeBackend::getSinkInputInfo(uint32_t idx, pa_backend_sink_input_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_sink_input, idx, sink_input);
+}
+
+bool PAFakeBackend::getCardInfo(uint32_t idx, pa_backend_card_info_cb_t cb, void* userdata) {
+	FAKE_INFO_REQUEST(Fake_card, idx, card);
+}
+
+bool PAFakeBackend::setSinkVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_set_sink_volume, idx, userdata);
+	req.cb.success = cb;
+	req.volume = volume;
+	return(queue(req));
+}
+
+bool PAFakeBackend::setSinkMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_set_sink_mute, idx, userdata);
+	req.cb.success = cb;
+	req.mute = mute;
+	return(queue(req));
+}
+
+bool PAFakeBackend::setSourceVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_set_source_volume, idx, userdata);
+	req.cb.success = cb;
+	req.volume = volume;
+	return(queue(req));
+}
+
+bool PAFakeBackend::setSourceMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_set_source_mute, idx, userdata);
+	req.cb.success = cb;
+	req.mute = mute;
+	return(queue(req));
+}
+
+bool PAFakeBackend::setSinkInputVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_set_sink_input_volume, idx, userdata);
+	req.cb.success = cb;
+	req.volume = volume;
+	return(queue(req));
+}
+
+bool PAFakeBackend::setSinkInputMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_set_sink_input_mute, idx, userdata);
+	req.cb.success = cb;
+	req.mute = mute;
+	return(queue(req));
+}
+
+bool PAFakeBackend::setCardProfile(uint32_t idx, const char* profile, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_set_card_profile, idx, userdata);
+	req.cb.success = cb;
+	req.profile = profile ? profile : "";
+	return(queue(req));
+}
+
+bool PAFakeBackend::moveSinkInput(uint32_t idx, uint32_t sink_idx, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_move_sink_input, idx, userdata);
+	req.cb.success = cb;
+	req.target = sink_idx;
+	return(queue(req));
+}
+
+/* suspend is passed in mute */
+bool PAFakeBackend::suspendSink(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_suspend_sink, idx, userdata);
+	req.cb.success = cb;
+	req.mute = suspend;
+	return(queue(req));
+}
+
+bool PAFakeBackend::suspendSource(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata) {
+	SFakeRequest req(Fake_suspend_source, idx, userdata);
+	req.cb.success = cb;
+	req.mute = suspend;
+	return(queue(req));
+}
+
+bool PAFakeBackend::subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb, void* userdata) {
+	if(m_state != PABackend_ready) return(false);
+	m_event_mask = mask;
+	m_event_cb = cb;
+	m_event_userdata = userdata;
+	return(true);
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_BACKEND_FAKE_H_
+#define PA_BACKEND_FAKE_H_
+
+#include "global.h"
+#include "pa_backend.h"
+#include "pa_info_store.h"
+#include <map>
+
+
+/* layout of the synthesized server */
+struct PAFakeConfig {
+	PAFakeConfig();
+
+	uint32_t sinks; //every sink also gets a monitor source
+	uint32_t sources; //sources in addition to the monitors
+	uint32_t cards; //sinks & sources are assigned round-robin to the cards
+	uint32_t profiles; //per card
+	uint32_t clients;
+	uint32_t sink_inputs; //assigned round-robin to clients & sinks
+	uint8_t channels;
+
+	uint32_t latency_usec; //time until a request completes (round trip)
+	bool fail_connect;
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAFakeBackend
+ * in-memory PABackend without a server. it synthesizes a configurable
+ * layout, applies mutations to it and emits subscription events. every
+ * request completes after the configured latency, so pipelining behaves
+ * like with a real server.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAFakeBackend : public PABackend {
+public:
+	PAFakeBackend(const PAFakeConfig& config);
+	virtual ~PAFakeBackend();
+
+	/* the objects of the fake server. can be modified directly, use
+	 * emitEvent() to notify subscribers */
+	PAInfoStore& store() { return(m_store); }
+	void emitEvent(pa_subscription_event_type_t type, uint32_t idx);
+
+	void setLatency(uint32_t usec) { m_latency_usec = usec; }
+	/* simulate a server crash: the connection fails and connecting fails
+	 * for the next restart_usec */
+	void crash(uint32_t restart_usec);
+
+	virtual void connect(const char* server);
+	virtual void disconnect();
+	virtual EPABackendState state() { return(m_state); }
+
+	virtual void iterate(int timeout_ms);
+
+	virtual bool getSinkInfoList(pa_backend_sink_info_cb_t cb, void* userdata);
+	virtual bool getSourceInfoList(pa_backend_source_info_cb_t cb, void* userdata);
+	virtual bool getClientInfoList(pa_backend_client_info_cb_t cb, void* userdata);
+	virtual bool getSinkInputInfoList(pa_backend_sink_input_info_cb_t cb, void* userdata);
+	virtual bool getCardInfoList(pa_backend_card_info_cb_t cb, void* userdata);
+
+	virtual bool getSinkInfo(uint32_t idx, pa_backend_sink_info_cb_t cb, void* userdata);
+	virtual bool getSourceInfo(uint32_t idx, pa_backend_source_info_cb_t cb, void* userdata);
+	virtual bool getClientInfo(uint32_t idx, pa_backend_client_info_cb_t cb, void* userdata);
+	virtual bool getSinkInputInfo(uint32_t idx, pa_backend_sink_input_info_cb_t cb, void* userdata);
+	virtual bool getCardInfo(uint32_t idx, pa_backend_card_info_cb_t cb, void* userdata);
+
+	virtual bool setSinkVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSinkMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSourceVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSourceMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSinkInputVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSinkInputMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setCardProfile(uint32_t idx, const char* profile, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool moveSinkInput(uint32_t idx, uint32_t sink_idx, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool suspendSink(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool suspendSource(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata);
+
+	virtual bool subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb, void* userdata);
+
+	/* the streams record a 1kHz sine with amplitude 0.5, scaled by the
+	 * volume & mute of the source (and of the sink of a monitor source),
+	 * resp. of the sink input. a suspended source (or the monitor of a
+	 * suspended sink) delivers nothing */
+	virtual uint32_t openRecordStream(const PARecordSpec& spec, pa_backend_record_cb_t cb, void* userdata);
+	/* a playback stream gets a sink input. the server requests the
+	 * buffer (latency_usec) at once and then keeps it filled in quarters,
+	 * a frame is played the sink latency after the buffer before it. the
+	 * played frames are mixed into the monitor streams of the sink */
+	virtual uint32_t openPlaybackStream(const PAPlaybackSpec& spec, pa_backend_playback_cb_t cb, void* userdata);
+	virtual uint32_t streamIndex(uint32_t id);
+	virtual void closeStream(uint32_t id);
+
+protected:
+	/* for subclasses which fill store() themselves */
+	PAFakeBackend();
+
+private:
+	enum EFakeRequest {
+		Fake_sink_list,
+		Fake_source_list,
+		Fake_client_list,
+		Fake_sink_input_list,
+		Fake_card_list,
+		Fake_sink,
+		Fake_source,
+		Fake_client,
+		Fake_sink_input,
+		Fake_card,
+		Fake_set_sink_volume,
+		Fake_set_sink_mute,
+		Fake_set_source_volume,
+		Fake_set_source_mute,
+		Fake_set_sink_input_volume,
+		Fake_set_sink_input_mute,
+		Fake_set_card_profile,
+		Fake_move_sink_input,
+		Fake_suspend_sink,
+		Fake_suspend_source,
+		Fake_event
+	};
+
+	struct SFakeRequest {
+		SFakeRequest(EFakeRequest req_type, uint32_t req_index, void* req_userdata);
+
+		EFakeRequest type;
+		uint32_t index;
+		union {
+			pa_backend_sink_info_cb_t sink;
+			pa_backend_source_info_cb_t source;
+			pa_backend_client_info_cb_t client;
+			pa_backend_sink_input_info_cb_t sink_input;
+			pa_backend_card_info_cb_t card;
+			pa_backend_success_cb_t success;
+		} cb;
+		void* userdata;
+
+		pa_cvolume volume;
+		int mute;
+		string profile;
+		uint32_t target; //sink of a move
+		pa_subscription_event_type_t event;
+	};
+
+	struct SFakeStream {
+		PARecordSpec spec;
+		pa_backend_record_cb_t cb;
+		void* userdata;
+		uint64_t due; //time of the next fragment
+		double phase;
+	};
+
+	struct SFakePlayback {
+		PAPlaybackSpec spec;
+		pa_backend_playback_cb_t cb;
+		void* userdata;
+		uint32_t sink;
+		uint32_t sink_input;
+		uint64_t due; //time of the next request
+		uint64_t requested; //time of the first request
+		uint64_t start; //time the first frame is played
+		uint64_t frames; //requested so far
+		uint64_t first; //frame number of played[0]
+		vector<float> played; //first channel of the recent frames, for the monitors
+	};
+
+	void synthesize(const PAFakeConfig& config);
+	/* record the fragments of the stream which are due */
+	void recordStream(uint32_t id, uint64_t now);
+	/* signal amplitude of a channel, false if the source does not exist */
+	bool streamAmplitude(const SFakeStream& stream, uint8_t channel, double& amplitude);
+	bool streamSuspended(const SFakeStream& stream);
+	/* the sink the stream records from, PA_INVALID_INDEX if it's no monitor */
+	uint32_t streamSink(const SFakeStream& stream);
+	/* request the frames of the playback stream which are due */
+	void playbackStream(uint32_t id, uint64_t now);
+	/* add the frames played on the sink during the fragment ending at end */
+	void mixPlayback(const SFakeStream& stream, uint32_t sink, const double* amplitude, uint64_t end, size_t frames);
+
+	/* queue a request to be dispatched after the latency */
+	bool queue(const SFakeRequest& req);
+	void dispatch(const SFakeRequest& req);
+	/* apply a mutation, returns false if the object does not exist */
+	bool apply(const SFakeRequest& req);
+
+	PAInfoStore m_store;
+	multimap<uint64_t, SFakeRequest> m_requests; //key is due time
+
+	EPABackendState m_state;
+	uint64_t m_connect_done;
+	bool m_bFail_connect;
+	uint64_t m_down_until; //crash(): connecting fails until then
+	uint32_t m_latency_usec;
+
+	pa_subscription_mask_t m_event_mask;
+	pa_backend_event_cb_t m_event_cb;
+	void* m_event_userdata;
+
+	map<uint32_t, SFakeStream> m_streams; //key is the stream id
+	map<uint32_t, SFakePlayback> m_playback; //key is the stream id
+	uint32_t m_next_stream_id;
+	vector<float> m_fragment;
+	vector<float> m_request;
+};
+
+
+#endif /* PA_BACKEND_FAKE_H_ */
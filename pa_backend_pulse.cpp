@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_backend_pulse.h"
+
+#include <sys/time.h>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** libpulse callback wrappers
+ * the libpulse callbacks get the context as first argument. these wrappers
+ * forward to the backend callbacks and free the request on completion. in
+ * threaded mode they wake up a thread waiting in iterate().
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<class Cb>
+struct SPulseRequest {
+	SPulseRequest(Cb request_cb, void* request_userdata, pa_threaded_mainloop* request_mainloop)
+		: cb(request_cb), userdata(request_userdata), mainloop(request_mainloop) {}
+	Cb cb;
+	void* userdata;
+	pa_threaded_mainloop* mainloop; //NULL if not threaded
+};
+
+template<class Info, class Cb>
+static void pulse_info_cb(pa_context*, const Info* i, int eol, void* userdata) {
+	SPulseRequest<Cb>* req = (SPulseRequest<Cb>*)userdata;
+	req->cb(eol<0 ? NULL : i, eol, req->userdata);
+	if(req->mainloop) pa_threaded_mainloop_signal(req->mainloop, 0);
+	if(eol!=0) delete(req);
+}
+
+static void pulse_success_cb(pa_context*, int success, void* userdata) {
+	SPulseRequest<pa_backend_success_cb_t>* req = (SPulseRequest<pa_backend_success_cb_t>*)userdata;
+	req->cb(success, req->userdata);
+	if(req->mainloop) pa_threaded_mainloop_signal(req->mainloop, 0);
+	delete(req);
+}
+
+/* takes care of the returned operation: unref it or free the request if
+ * issuing failed */
+template<class Cb>
+static bool issued(pa_operation* o, SPulseRequest<Cb>* req) {
+	if(!o) {
+		delete(req);
+		return(false);
+	}
+	pa_operation_unref(o);
+	return(true);
+}
+
+#define INFO_REQUEST(info_type, cb_type, pa_call, ...) \
+	SPulseRequest<cb_type>* req = new SPulseRequest<cb_type>(cb, userdata, m_pa_threaded_mainloop); \
+	return(issued(pa_call(m_pa_context, ## __VA_ARGS__, pulse_info_cb<info_type, cb_type>, req), req))
+
+#define SUCCESS_REQUEST(pa_call, ...) \
+	SPulseRequest<pa_backend_success_cb_t>* req = new SPulseRequest<pa_backend_success_cb_t>(cb, userdata, m_pa_threaded_mainloop); \
+	return(issued(pa_call(m_pa_context, __VA_ARGS__, pulse_success_cb, req), req))
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAPulseBackend
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAPulseBackend::PAPulseBackend(bool bThreaded) : m_pa_context(NULL), m_pa_mainloop(NULL)
+	, m_pa_threaded_mainloop(NULL), m_event_loop(NULL), m_bThread_running(false), m_wait_event(NULL)
+	, m_event_cb(NULL), m_event_userdata(NULL), m_next_stream_id(1) {
+
+	// the threaded mainloop exists from the start, so lock() can be used before connect()
+	if(bThreaded) {
+		ASSERT_THROW_e(m_pa_threaded_mainloop = pa_threaded_mainloop_new(), EASSERT
+				, "Failed to create PulseAudio threaded MainLoop");
+	}
+}
+
+PAPulseBackend::PAPulseBackend(PAEventLoop* event_loop) : m_pa_context(NULL), m_pa_mainloop(NULL)
+	, m_pa_threaded_mainloop(NULL), m_event_loop(event_loop), m_bThread_running(false), m_wait_event(NULL)
+	, m_event_cb(NULL), m_event_userdata(NULL), m_next_stream_id(1) {
+	ASSERT_THROW(m_event_loop, EINVALID_PARAMETER);
+}
+
+PAPulseBackend::~PAPulseBackend() {
+	stopThread();
+	disconnect();
+	if(m_wait_event) pa_threaded_mainloop_get_api(m_pa_threaded_mainloop)->time_free(m_wait_event);
+	if(m_pa_threaded_mainloop) pa_threaded_mainloop_free(m_pa_threaded_mainloop);
+}
+
+void PAPulseBackend::connect(const char* server) {
+	ASSERT_THROW(m_pa_context==NULL, EALREADY_INITIALIZED);
+
+	pa_mainloop_api *pa_mlapi;
+	// Create a mainloop API and connection to the server
+	if(m_event_loop) {
+		pa_mlapi = m_event_loop->api();
+	} else if(m_pa_threaded_mainloop) {
+		ASSERT_THROW_e(pa_mlapi = pa_threaded_mainloop_get_api(m_pa_threaded_mainloop), EASSERT, "Failed to create PulseAudio MainLoop");
+	} else {
+		ASSERT_THROW_e(m_pa_mainloop = pa_mainloop_new(), EASSERT, "Failed to create PulseAudio MainLoop");
+		ASSERT_THROW_e(pa_mlapi = pa_mainloop_get_api(m_pa_mainloop), EASSERT, "Failed to create PulseAudio MainLoop");
+	}
+	ASSERT_THROW_e(m_pa_context = pa_context_new(pa_mlapi, APP_NAME), EDEVICE, "Failed to get a PulseAudio Context Object");
+
+	// the state is polled with state(), failures are reported there
+	if(m_pa_threaded_mainloop) pa_context_set_state_callback(m_pa_context, stateCb, this);
+	pa_context_connect(m_pa_context, server, (pa_context_flags_t)0, NULL);
+
+	if(m_pa_threaded_mainloop && !m_bThread_running) {
+		ASSERT_THROW_e(pa_threaded_mainloop_start(m_pa_threaded_mainloop) >= 0, EDEVICE
+				, "Failed to start the PulseAudio MainLoop thread");
+		m_bThread_running=true;
+	}
+}
+
+void PAPulseBackend::disconnect() {
+	for(map<uint32_t, SPulseStream*>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ++iter) {
+		freeStream(iter->second);
+	}
+	m_streams.clear();
+	if(m_pa_context) {
+		pa_context_disconnect(m_pa_context);
+		pa_context_unref(m_pa_context);
+		m_pa_context=NULL;
+	}
+	if(m_pa_mainloop) {
+		pa_mainloop_free(m_pa_mainloop);
+		m_pa_mainloop=NULL;
+	}
+}
+
+EPABackendState PAPulseBackend::state() {
+	if(!m_pa_context) return(PABackend_failed);
+
+	switch(pa_context_get_state(m_pa_context)) {
+	case PA_CONTEXT_READY:
+		return(PABackend_ready);
+	case PA_CONTEXT_FAILED:
+	case PA_CONTEXT_TERMINATED:
+		return(PABackend_failed);
+	default:
+		break;
+	}
+	return(PABackend_connecting);
+}
+
+void PAPulseBackend::iterate(int timeout_ms) {
+	if(m_pa_threaded_mainloop) {
+		ASSERT_THROW(m_bThread_running, ENOT_INITIALIZED);
+		if(timeout_ms==0) return;
+		// the callbacks run in the mainloop thread, wait until one signals
+		// or the timer does. the lock is held, so the timer can be set here
+		pa_mainloop_api* api = pa_threaded_mainloop_get_api(m_pa_threaded_mainloop);
+		if(timeout_ms > 0) {
+			struct timeval tv;
+			gettimeofday(&tv, NULL);
+			tv.tv_sec += timeout_ms/1000;
+			tv.tv_usec += (timeout_ms%1000)*1000;
+			if(tv.tv_usec >= 1000000) {
+				++tv.tv_sec;
+				tv.tv_usec -= 1000000;
+			}
+			if(m_wait_event) api->time_restart(m_wait_event, &tv);
+			else m_wait_event = api->time_new(api, &tv, waitTimeoutCb, this);
+		}
+		pa_threaded_mainloop_wait(m_pa_threaded_mainloop);
+		// woken by a callback: disable the timer, it would wake a later wait
+		if(timeout_ms > 0 && m_wait_event) api->time_restart(m_wait_event, NULL);
+		return;
+	}
+	if(m_event_loop) {
+		m_event_loop->iterate(timeout_ms);
+		return;
+	}
+	ASSERT_THROW(m_pa_mainloop, ENOT_INITIALIZED);
+
+	int timeout_usec = -1;
+	if(timeout_ms >= 0) timeout_usec = timeout_ms < 2000000 ? timeout_ms*1000 : 2000000000;
+
+	if(pa_mainloop_prepare(m_pa_mainloop, timeout_usec) < 0) return;
+	if(pa_mainloop_poll(m_pa_mainloop) < 0) return;
+	pa_mainloop_dispatch(m_pa_mainloop);
+}
+
+void PAPulseBackend::lock() {
+	if(m_pa_threaded_mainloop) pa_threaded_mainloop_lock(m_pa_threaded_mainloop);
+}
+
+void PAPulseBackend::unlock() {
+	if(m_pa_threaded_mainloop) pa_threaded_mainloop_unlock(m_pa_threaded_mainloop);
+}
+
+void PAPulseBackend::stopThread() {
+	if(!m_bThread_running) return;
+	pa_threaded_mainloop_stop(m_pa_threaded_mainloop);
+	m_bThread_running=false;
+}
+
+void PAPulseBackend::waitTimeoutCb(pa_mainloop_api*, pa_time_event*, const struct timeval*, void* userdata) {
+	PAPulseBackend* backend = (PAPulseBackend*)userdata;
+	pa_threaded_mainloop_signal(backend->m_pa_threaded_mainloop, 0);
+}
+
+void PAPulseBackend::stateCb(pa_context*, void* userdata) {
+	PAPulseBackend* backend = (PAPulseBackend*)userdata;
+	pa_threaded_mainloop_signal(backend->m_pa_threaded_mainloop, 0);
+}
+
+bool PAPulseBackend::getSinkInfoList(pa_backend_sink_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_sink_info, pa_backend_sink_info_cb_t, pa_context_get_sink_info_list);
+}
+
+bool PAPulseBackend::getSourceInfoList(pa_backend_source_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_source_info, pa_backend_source_info_cb_t, pa_context_get_source_info_list);
+}
+
+bool PAPulseBackend::getClientInfoList(pa_backend_client_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_client_info, pa_backend_client_info_cb_t, pa_context_get_client_info_list);
+}
+
+bool PAPulseBackend::getSinkInputInfoList(pa_backend_sink_input_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_sink_input_info, pa_backend_sink_input_info_cb_t, pa_context_get_sink_input_info_list);
+}
+
+bool PAPulseBackend::getCardInfoList(pa_backend_card_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_card_info, pa_backend_card_info_cb_t, pa_context_get_card_info_list);
+}
+
+bool PAPulseBackend::getSinkInfo(uint32_t idx, pa_backend_sink_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_sink_info, pa_backend_sink_info_cb_t, pa_context_get_sink_info_by_index, idx);
+}
+
+bool PAPulseBackend::getSourceInfo(uint32_t idx, pa_backend_source_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_source_info, pa_backend_source_info_cb_t, pa_context_get_source_info_by_index, idx);
+}
+
+bool PAPulseBackend::getClientInfo(uint32_t idx, pa_backend_client_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_client_info, pa_backend_client_info_cb_t, pa_context_get_client_info, idx);
+}
+
+bool PAPulseBackend::getSinkInputInfo(uint32_t idx, pa_backend_sink_input_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_sink_input_info, pa_backend_sink_input_info_cb_t, pa_context_get_sink_input_info, idx);
+}
+
+bool PAPulseBackend::getCardInfo(uint32_t idx, pa_backend_card_info_cb_t cb, void* userdata) {
+	INFO_REQUEST(pa_card_info, pa_backend_card_info_cb_t, pa_context_get_card_info_by_index, idx);
+}
+
+bool PAPulseBackend::setSinkVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_set_sink_volume_by_index, idx, &volume);
+}
+
+bool PAPulseBackend::setSinkMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_set_sink_mute_by_index, idx, mute);
+}
+
+bool PAPulseBackend::setSourceVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_set_source_volume_by_index, idx, &volume);
+}
+
+bool PAPulseBackend::setSourceMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_set_source_mute_by_index, idx, mute);
+}
+
+bool PAPulseBackend::setSinkInputVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_set_sink_input_volume, idx, &volume);
+}
+
+bool PAPulseBackend::setSinkInputMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_set_sink_input_mute, idx, mute);
+}
+
+bool PAPulseBackend::setCardProfile(uint32_t idx, const char* profile, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_set_card_profile_by_index, idx, profile);
+}
+
+bool PAPulseBackend::moveSinkInput(uint32_t idx, uint32_t sink_idx, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_move_sink_input_by_index, idx, sink_idx);
+}
+
+bool PAPulseBackend::suspendSink(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_suspend_sink_by_index, idx, suspend);
+}
+
+bool PAPulseBackend::suspendSource(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata) {
+	SUCCESS_REQUEST(pa_context_suspend_source_by_index, idx, suspend);
+}
+
+void PAPulseBackend::subscribeCb(pa_context*, pa_subscription_event_type_t t, uint32_t idx, void* userdata) {
+	PAPulseBackend* backend = (PAPulseBackend*)userdata;
+	if(backend->m_event_cb) backend->m_event_cb(t, idx, backend->m_event_userdata);
+	if(backend->m_pa_threaded_mainloop) pa_threaded_mainloop_signal(backend->m_pa_threaded_mainloop, 0);
+}
+
+bool PAPulseBackend::subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb, void* userdata) {
+	ASSERT_THROW(m_pa_context, ENOT_INITIALIZED);
+
+	m_event_cb = cb;
+	m_event_userdata = userdata;
+	pa_context_set_subscribe_callback(m_pa_context, subscribeCb, this);
+
+	pa_operation* o = pa_context_subscribe(m_pa_context, mask, NULL, NULL);
+	if(!o) return(false);
+	pa_operation_unref(o);
+	return(true);
+}
+
+/* the map of a stream with channels: the requested one if it fits,
+ * otherwise the default order, which libpulse only has up to 6 channels
+ * (extended with aux channels) */
+static const pa_channel_map* streamChannelMap(const pa_channel_map& map, uint8_t channels, pa_channel_map& fallback) {
+	if(map.channels == channels && pa_channel_map_valid(&map)) return(&map);
+	return(pa_channel_map_init_extend(&fallback, channels, PA_CHANNEL_MAP_DEFAULT));
+}
+
+uint32_t PAPulseBackend::openRecordStream(const PARecordSpec& spec, pa_backend_record_cb_t cb, void* userdata) {
+	ASSERT_THROW(m_pa_context, ENOT_INITIALIZED);
+
+	pa_sample_spec sample_spec;
+	sample_spec.format = PA_SAMPLE_FLOAT32NE;
+	sample_spec.rate = spec.rate;
+	sample_spec.channels = spec.channels;
+
+	SPulseStream* stream = new SPulseStream();
+	stream->channels = spec.channels;
+	stream->cb = cb;
+	stream->playback_cb = NULL;
+	stream->userdata = userdata;
+	stream->bEnded = false;
+	pa_channel_map fallback;
+	const pa_channel_map* channel_map = streamChannelMap(spec.channel_map, spec.channels, fallback);
+	stream->stream = pa_stream_new(m_pa_context, APP_NAME " meter", &sample_spec, channel_map);
+	if(!stream->stream) {
+		delete(stream);
+		return(0);
+	}
+	pa_stream_set_state_callback(stream->stream, streamStateCb, stream);
+	pa_stream_set_read_callback(stream->stream, streamReadCb, stream);
+
+	/* small fragments for a low latency. the stream must not keep the
+	 * device from suspending */
+	pa_buffer_attr attr;
+	attr.maxlength = (uint32_t)-1;
+	attr.tlength = attr.prebuf = attr.minreq = (uint32_t)-1;
+	attr.fragsize = (uint32_t)pa_usec_to_bytes(spec.fragment_usec, &sample_spec);
+	int flags = PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_MOVE | PA_STREAM_DONT_INHIBIT_AUTO_SUSPEND;
+	if(spec.bPeak_detect) flags |= PA_STREAM_PEAK_DETECT;
+	if(spec.sink_input != PA_INVALID_INDEX && pa_stream_set_monitor_stream(stream->stream, spec.sink_input) < 0) {
+		freeStream(stream);
+		return(0);
+	}
+	if(pa_stream_connect_record(stream->stream, spec.source.c_str(), &attr, (pa_stream_flags_t)flags) < 0) {
+		freeStream(stream);
+		return(0);
+	}
+
+	uint32_t id = m_next_stream_id++;
+	m_streams[id] = stream;
+	return(id);
+}
+
+uint32_t PAPulseBackend::openPlaybackStream(const PAPlaybackSpec& spec, pa_backend_playback_cb_t cb, void* userdata) {
+	ASSERT_THROW(m_pa_context, ENOT_INITIALIZED);
+
+	pa_sample_spec sample_spec;
+	sample_spec.format = PA_SAMPLE_FLOAT32NE;
+	sample_spec.rate = spec.rate;
+	sample_spec.channels = spec.channels;
+
+	SPulseStream* stream = new SPulseStream();
+	stream->channels = spec.channels;
+	stream->cb = NULL;
+	stream->playback_cb = cb;
+	stream->userdata = userdata;
+	stream->bEnded = false;
+	pa_channel_map fallback;
+	const pa_channel_map* channel_map = streamChannelMap(spec.channel_map, spec.channels, fallback);
+	stream->stream = pa_stream_new(m_pa_context, APP_NAME " latency probe", &sample_spec, channel_map);
+	if(!stream->stream) {
+		delete(stream);
+		return(0);
+	}
+	pa_stream_set_state_callback(stream->stream, streamStateCb, stream);
+	pa_stream_set_write_callback(stream->stream, streamWriteCb, stream);
+
+	/* the server keeps the buffer filled to tlength and adjusts the sink
+	 * latency to it */
+	pa_buffer_attr attr;
+	attr.maxlength = (uint32_t)-1;
+	attr.tlength = (uint32_t)pa_usec_to_bytes(spec.latency_usec, &sample_spec);
+	attr.prebuf = attr.minreq = attr.fragsize = (uint32_t)-1;
+	int flags = PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_MOVE;
+	if(pa_stream_connect_playback(stream->stream, spec.sink.c_str(), &attr, (pa_stream_flags_t)flags, NULL, NULL) < 0) {
+		freeStream(stream);
+		return(0);
+	}
+
+	uint32_t id = m_next_stream_id++;
+	m_streams[id] = stream;
+	return(id);
+}
+
+uint32_t PAPulseBackend::streamIndex(uint32_t id) {
+	map<uint32_t, SPulseStream*>::iterator iter = m_streams.find(id);
+	if(iter == m_streams.end() || pa_stream_get_state(iter->second->stream) != PA_STREAM_READY)
+		return(PA_INVALID_INDEX);
+	return(pa_stream_get_index(iter->second->stream));
+}
+
+void PAPulseBackend::closeStream(uint32_t id) {
+	map<uint32_t, SPulseStream*>::iterator iter = m_streams.find(id);
+	if(iter == m_streams.end()) return;
+	freeStream(iter->second);
+	m_streams.erase(iter);
+}
+
+void PAPulseBackend::freeStream(SPulseStream* stream) {
+	pa_stream_set_state_callback(stream->stream, NULL, NULL);
+	pa_stream_set_read_callback(stream->stream, NULL, NULL);
+	pa_stream_set_write_callback(stream->stream, NULL, NULL);
+	pa_stream_disconnect(stream->stream);
+	pa_stream_unref(stream->stream);
+	delete(stream);
+}
+
+void PAPulseBackend::streamStateCb(pa_stream* s, void* userdata) {
+	SPulseStream* stream = (SPulseStream*)userdata;
+	switch(pa_stream_get_state(s)) {
+	case PA_STREAM_FAILED:
+	case PA_STREAM_TERMINATED:
+		if(!stream->bEnded) {
+			stream->bEnded = true;
+			if(stream->cb) stream->cb(NULL, 0, stream->userdata);
+			else stream->playback_cb(NULL, 0, stream->userdata);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void PAPulseBackend::streamReadCb(pa_stream* s, size_t, void* userdata) {
+	SPulseStream* stream = (SPulseStream*)userdata;
+	size_t frame_size = sizeof(float)*stream->channels;
+	const void* data;
+	size_t nbytes;
+	while(pa_stream_peek(s, &data, &nbytes) == 0 && nbytes > 0) {
+		/* data is NULL for a hole in the stream */
+		if(data) stream->cb((const float*)data, nbytes/frame_size, stream->userdata);
+		pa_stream_drop(s);
+	}
+}
+
+void PAPulseBackend::streamWriteCb(pa_stream* s, size_t nbytes, void* userdata) {
+	SPulseStream* stream = (SPulseStream*)userdata;
+	size_t frames = nbytes/(sizeof(float)*stream->channels);
+	if(frames == 0) return;
+	/* grows to the largest request, then no more allocations */
+	if(stream->buffer.size() < frames*stream->channels) stream->buffer.resize(frames*stream->channels);
+	stream->playback_cb(&stream->buffer[0], frames, stream->userdata);
+	pa_stream_write(s, &stream->buffer[0], frames*sizeof(float)*stream->channels, NULL, 0, PA_SEEK_RELATIVE);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_BACKEND_PULSE_H_
+#define PA_BACKEND_PULSE_H_
+
+#include "global.h"
+#include "pa_backend.h"
+#include <map>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAEventLoop
+ * an event loop owned by the application, which libpulse uses through its
+ * pa_mainloop_api (eg. PAEpollMainloop)
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAEventLoop {
+public:
+	virtual ~PAEventLoop() {}
+
+	virtual pa_mainloop_api* api() = 0;
+	/* dispatch the pending events, wait at most timeout_ms for one (-1: block) */
+	virtual void iterate(int timeout_ms) = 0;
+};
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAPulseBackend
+ * PABackend implementation using libpulse with its own pa_mainloop, or
+ * with bThreaded with a pa_threaded_mainloop (see PABackend::threaded()).
+ * in threaded mode iterate() waits until a callback signals the mainloop
+ * or the timeout expires (a timer event of the mainloop thread).
+ * with an event loop of the application no extra mainloop is created
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAPulseBackend : public PABackend {
+public:
+	PAPulseBackend(bool bThreaded=false);
+	/* use event_loop, which must outlive the backend */
+	PAPulseBackend(PAEventLoop* event_loop);
+	virtual ~PAPulseBackend();
+
+	virtual void connect(const char* server);
+	virtual void disconnect();
+	virtual EPABackendState state();
+
+	virtual void iterate(int timeout_ms);
+
+	virtual bool threaded() { return(m_pa_threaded_mainloop!=NULL); }
+	virtual bool inLoopThread() { return(m_pa_threaded_mainloop && pa_threaded_mainloop_in_thread(m_pa_threaded_mainloop)); }
+	virtual void lock();
+	virtual void unlock();
+	virtual void stopThread();
+
+	virtual bool getSinkInfoList(pa_backend_sink_info_cb_t cb, void* userdata);
+	virtual bool getSourceInfoList(pa_backend_source_info_cb_t cb, void* userdata);
+	virtual bool getClientInfoList(pa_backend_client_info_cb_t cb, void* userdata);
+	virtual bool getSinkInputInfoList(pa_backend_sink_input_info_cb_t cb, void* userdata);
+	virtual bool getCardInfoList(pa_backend_card_info_cb_t cb, void* userdata);
+
+	virtual bool getSinkInfo(uint32_t idx, pa_backend_sink_info_cb_t cb, void* userdata);
+	virtual bool getSourceInfo(uint32_t idx, pa_backend_source_info_cb_t cb, void* userdata);
+	virtual bool getClientInfo(uint32_t idx, pa_backend_client_info_cb_t cb, void* userdata);
+	virtual bool getSinkInputInfo(uint32_t idx, pa_backend_sink_input_info_cb_t cb, void* userdata);
+	virtual bool getCardInfo(uint32_t idx, pa_backend_card_info_cb_t cb, void* userdata);
+
+	virtual bool setSinkVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSinkMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSourceVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSourceMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSinkInputVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setSinkInputMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool setCardProfile(uint32_t idx, const char* profile, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool moveSinkInput(uint32_t idx, uint32_t sink_idx, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool suspendSink(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata);
+	virtual bool suspendSource(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata);
+
+	virtual bool subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb, void* userdata);
+
+	virtual uint32_t openRecordStream(const PARecordSpec& spec, pa_backend_record_cb_t cb, void* userdata);
+	virtual uint32_t openPlaybackStream(const PAPlaybackSpec& spec, pa_backend_playback_cb_t cb, void* userdata);
+	virtual uint32_t streamIndex(uint32_t id);
+	virtual void closeStream(uint32_t id);
+
+private:
+	struct SPulseStream {
+		pa_stream* stream;
+		uint8_t channels;
+		pa_backend_record_cb_t cb; //NULL for a playback stream
+		pa_backend_playback_cb_t playback_cb;
+		void* userdata;
+		bool bEnded;
+		vector<float> buffer; //of the playback requests
+	};
+
+	static void subscribeCb(pa_context* c, pa_subscription_event_type_t t, uint32_t idx, void* userdata);
+	static void stateCb(pa_context* c, void* userdata);
+	static void streamStateCb(pa_stream* s, void* userdata);
+	static void streamReadCb(pa_stream* s, size_t nbytes, void* userdata);
+	static void streamWriteCb(pa_stream* s, size_t nbytes, void* userdata);
+	static void waitTimeoutCb(pa_mainloop_api* a, pa_time_event* e, const struct timeval* tv, void* userdata);
+	void freeStream(SPulseStream* stream);
+
+	pa_context* m_pa_context;
+	pa_mainloop* m_pa_mainloop;
+	pa_threaded_mainloop* m_pa_threaded_mainloop; //NULL if not threaded
+	PAEventLoop* m_event_loop; //not owned, NULL if not used
+	bool m_bThread_running;
+	pa_time_event* m_wait_event; //timeout of iterate() in threaded mode, NULL until used
+
+	pa_backend_event_cb_t m_event_cb;
+	void* m_event_userdata;
+
+	map<uint32_t, SPulseStream*> m_streams; //key is the stream id
+	uint32_t m_next_stream_id;
+};
+
+
+#endif /* PA_BACKEND_PULSE_H_ */
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_backend_record.h"
+
+
+/* wraps the callback of a request: the info is written before it's forwarded */
+template<class Info>
+struct SRecordRequest {
+	typedef void (*cb_t)(const Info* info, int eol, void* userdata);
+	SRecordRequest(PACaptureWriter* request_writer, cb_t request_cb, void* request_userdata)
+		: writer(request_writer), cb(request_cb), userdata(request_userdata) {}
+	PACaptureWriter* writer;
+	cb_t cb;
+	void* userdata;
+};
+
+template<class Info>
+static void record_info_cb(const Info* info, int eol, void* userdata) {
+	SRecordRequest<Info>* req=(SRecordRequest<Info>*)userdata;
+	if(eol==0 && info) req->writer->write(*info);
+	req->cb(info, eol, req->userdata);
+	if(eol!=0) delete(req);
+}
+
+template<class Info>
+static SRecordRequest<Info>* newRequest(PACaptureWriter* writer, void (*cb)(const Info*, int, void*), void* userdata) {
+	return(new SRecordRequest<Info>(writer, cb, userdata));
+}
+
+/* frees the request if it could not be issued */
+template<class Info>
+static bool issued(bool bIssued, SRecordRequest<Info>* req) {
+	if(!bIssued) delete(req);
+	return(bIssued);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PARecordBackend
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PARecordBackend::PARecordBackend(PABackend* backend, const string& file) : m_backend(backend) {
+	try {
+		m_writer.open(file);
+	} catch(...) {
+		delete(m_backend);
+		throw;
+	}
+}
+
+PARecordBackend::~PARecordBackend() {
+	delete(m_backend);
+	LOG(DEBUG, "%u records captured", m_writer.records());
+}
+
+bool PARecordBackend::getSinkInfoList(pa_backend_sink_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_sink_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getSinkInfoList(record_info_cb<pa_sink_info>, req), req));
+}
+
+bool PARecordBackend::getSourceInfoList(pa_backend_source_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_source_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getSourceInfoList(record_info_cb<pa_source_info>, req), req));
+}
+
+bool PARecordBackend::getClientInfoList(pa_backend_client_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_client_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getClientInfoList(record_info_cb<pa_client_info>, req), req));
+}
+
+bool PARecordBackend::getSinkInputInfoList(pa_backend_sink_input_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_sink_input_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getSinkInputInfoList(record_info_cb<pa_sink_input_info>, req), req));
+}
+
+bool PARecordBackend::getCardInfoList(pa_backend_card_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_card_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getCardInfoList(record_info_cb<pa_card_info>, req), req));
+}
+
+bool PARecordBackend::getSinkInfo(uint32_t idx, pa_backend_sink_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_sink_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getSinkInfo(idx, record_info_cb<pa_sink_info>, req), req));
+}
+
+bool PARecordBackend::getSourceInfo(uint32_t idx, pa_backend_source_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_source_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getSourceInfo(idx, record_info_cb<pa_source_info>, req), req));
+}
+
+bool PARecordBackend::getClientInfo(uint32_t idx, pa_backend_client_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_client_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getClientInfo(idx, record_info_cb<pa_client_info>, req), req));
+}
+
+bool PARecordBackend::getSinkInputInfo(uint32_t idx, pa_backend_sink_input_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_sink_input_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getSinkInputInfo(idx, record_info_cb<pa_sink_input_info>, req), req));
+}
+
+bool PARecordBackend::getCardInfo(uint32_t idx, pa_backend_card_info_cb_t cb, void* userdata) {
+	SRecordRequest<pa_card_info>* req=newRequest(&m_writer, cb, userdata);
+	return(issued(m_backend->getCardInfo(idx, record_info_cb<pa_card_info>, req), req));
+}
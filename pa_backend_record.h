@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_BACKEND_RECORD_H_
+#define PA_BACKEND_RECORD_H_
+
+#include "global.h"
+#include "pa_backend.h"
+#include "pa_capture.h"
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PARecordBackend
+ * forwards everything to another backend and writes every received info
+ * struct to a capture file, which can be replayed with PAReplayBackend
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PARecordBackend : public PABackend {
+public:
+	/* takes ownership of backend */
+	PARecordBackend(PABackend* backend, const string& file);
+	virtual ~PARecordBackend();
+
+	PACaptureWriter& writer() { return(m_writer); }
+
+	virtual void connect(const char* server) { m_backend->connect(server); }
+	virtual void disconnect() { m_backend->disconnect(); }
+	virtual EPABackendState state() { return(m_backend->state()); }
+
+	virtual void iterate(int timeout_ms) { m_backend->iterate(timeout_ms); }
+
+	virtual bool threaded() { return(m_backend->threaded()); }
+	virtual bool inLoopThread() { return(m_backend->inLoopThread()); }
+	virtual void lock() { m_backend->lock(); }
+	virtual void unlock() { m_backend->unlock(); }
+	virtual void stopThread() { m_backend->stopThread(); }
+
+	virtual bool getSinkInfoList(pa_backend_sink_info_cb_t cb, void* userdata);
+	virtual bool getSourceInfoList(pa_backend_source_info_cb_t cb, void* userdata);
+	virtual bool getClientInfoList(pa_backend_client_info_cb_t cb, void* userdata);
+	virtual bool getSinkInputInfoList(pa_backend_sink_input_info_cb_t cb, void* userdata);
+	virtual bool getCardInfoList(pa_backend_card_info_cb_t cb, void* userdata);
+
+	virtual bool getSinkInfo(uint32_t idx, pa_backend_sink_info_cb_t cb, void* userdata);
+	virtual bool getSourceInfo(uint32_t idx, pa_backend_source_info_cb_t cb, void* userdata);
+	virtual bool getClientInfo(uint32_t idx, pa_backend_client_info_cb_t cb, void* userdata);
+	virtual bool getSinkInputInfo(uint32_t idx, pa_backend_sink_input_info_cb_t cb, void* userdata);
+	virtual bool getCardInfo(uint32_t idx, pa_backend_card_info_cb_t cb, void* userdata);
+
+	virtual bool setSinkVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->setSinkVolume(idx, volume, cb, userdata)); }
+	virtual bool setSinkMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->setSinkMute(idx, mute, cb, userdata)); }
+	virtual bool setSourceVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->setSourceVolume(idx, volume, cb, userdata)); }
+	virtual bool setSourceMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->setSourceMute(idx, mute, cb, userdata)); }
+	virtual bool setSinkInputVolume(uint32_t idx, const pa_cvolume& volume, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->setSinkInputVolume(idx, volume, cb, userdata)); }
+	virtual bool setSinkInputMute(uint32_t idx, int mute, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->setSinkInputMute(idx, mute, cb, userdata)); }
+	virtual bool setCardProfile(uint32_t idx, const char* profile, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->setCardProfile(idx, profile, cb, userdata)); }
+	virtual bool moveSinkInput(uint32_t idx, uint32_t sink_idx, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->moveSinkInput(idx, sink_idx, cb, userdata)); }
+	virtual bool suspendSink(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->suspendSink(idx, suspend, cb, userdata)); }
+	virtual bool suspendSource(uint32_t idx, int suspend, pa_backend_success_cb_t cb, void* userdata)
+		{ return(m_backend->suspendSource(idx, suspend, cb, userdata)); }
+
+	virtual bool subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb, void* userdata)
+		{ return(m_backend->subscribe(mask, cb, userdata)); }
+
+	virtual uint32_t openRecordStream(const PARecordSpec& spec, pa_backend_record_cb_t cb, void* userdata)
+		{ return(m_backend->openRecordStream(spec, cb, userdata)); }
+	virtual uint32_t openPlaybackStream(const PAPlaybackSpec& spec, pa_backend_playback_cb_t cb, void* userdata)
+		{ return(m_backend->openPlaybackStream(spec, cb, userdata)); }
+	virtual uint32_t streamIndex(uint32_t id) { return(m_backend->streamIndex(id)); }
+	virtual void closeStream(uint32_t id) { m_backend->closeStream(id); }
+
+private:
+	PABackend* m_backend;
+	PACaptureWriter m_writer;
+};
+
+
+#endif /* PA_BACKEND_RECORD_H_ */
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_backend_replay.h"
+#include "pa_capture.h"
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAReplayBackend
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAReplayBackend::PAReplayBackend(const string& file) {
+	PACaptureReader::read(file, store());
+	LOG(DEBUG, "replaying %s: %u sinks, %u sources, %u sink inputs", file.c_str(),
+		(uint)store().Sinks().size(), (uint)store().Sources().size(), (uint)store().SinkInputs().size());
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_BACKEND_REPLAY_H_
+#define PA_BACKEND_REPLAY_H_
+
+#include "global.h"
+#include "pa_backend_fake.h"
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAReplayBackend
+ * serves the objects of a capture written by PARecordBackend, without a
+ * server. requests complete in order of issue and mutations are applied
+ * to the replayed objects, so runs are deterministic.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAReplayBackend : public PAFakeBackend {
+public:
+	PAReplayBackend(const string& file);
+};
+
+
+#endif /* PA_BACKEND_REPLAY_H_ */
@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_capture.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#define CAPTURE_MAGIC "PACAPTUR"
+#define CAPTURE_MAGIC_LEN 8
+#define CAPTURE_VERSION 1
+#define CAPTURE_NULL_STR 0xffffffff
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACaptureWriter
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PACaptureWriter::PACaptureWriter() : m_file(NULL), m_records(0) {
+}
+
+PACaptureWriter::~PACaptureWriter() {
+	close();
+}
+
+void PACaptureWriter::open(const string& file) {
+	ASSERT_THROW(m_file==NULL, EALREADY_INITIALIZED);
+	ASSERT_THROW_e(m_file=fopen(file.c_str(), "wb"), EUNABLE_TO_OPEN_FILE, "failed to open %s", file.c_str());
+	
+	m_buffer.assign(CAPTURE_MAGIC, CAPTURE_MAGIC_LEN);
+	putU32(CAPTURE_VERSION);
+	fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+	m_buffer.clear();
+	m_records=0;
+}
+
+void PACaptureWriter::close() {
+	if(!m_file) return;
+	if(fclose(m_file)!=0) LOG(ERROR, "failed to write the capture");
+	m_file=NULL;
+}
+
+void PACaptureWriter::writeRecord(ECaptureRecord type) {
+	if(!m_file) {
+		m_buffer.clear();
+		return;
+	}
+	string payload;
+	payload.swap(m_buffer);
+	putU8((uint8_t)type);
+	putU32((uint32_t)payload.size());
+	m_buffer+=payload;
+	if(fwrite(m_buffer.data(), 1, m_buffer.size(), m_file)!=m_buffer.size()) {
+		LOG(ERROR, "failed to write the capture");
+	}
+	m_buffer.clear();
+	++m_records;
+}
+
+void PACaptureWriter::putU8(uint8_t val) {
+	m_buffer+=(char)val;
+}
+
+void PACaptureWriter::putU32(uint32_t val) {
+	for(int i=0; i<4; ++i) m_buffer+=(char)((val>>(i*8)) & 0xff);
+}
+
+void PACaptureWriter::putU64(uint64_t val) {
+	putU32((uint32_t)val);
+	putU32((uint32_t)(val>>32));
+}
+
+void PACaptureWriter::putStr(const char* str) {
+	if(!str) {
+		putU32(CAPTURE_NULL_STR);
+		return;
+	}
+	size_t len=strlen(str);
+	putU32((uint32_t)len);
+	m_buffer.append(str, len);
+}
+
+void PACaptureWriter::putProplist(const pa_proplist* proplist) {
+	vector<pair<const char*, const char*> > props;
+	if(proplist) {
+		void* state=NULL;
+		const char* key;
+		while((key=pa_proplist_iterate(proplist, &state))) {
+			const char* value=pa_proplist_gets(proplist, key);
+			if(value) props.push_back(make_pair(key, value));
+		}
+	}
+	putU32((uint32_t)props.size());
+	for(size_t i=0; i<props.size(); ++i) {
+		putStr(props[i].first);
+		putStr(props[i].second);
+	}
+}
+
+void PACaptureWriter::putSampleSpec(const pa_sample_spec& spec) {
+	putU32((uint32_t)spec.format);
+	putU32(spec.rate);
+	putU8(spec.channels);
+}
+
+void PACaptureWriter::putChannelMap(const pa_channel_map& map) {
+	putU8(map.channels);
+	for(uint8_t i=0; i<map.channels && i<PA_CHANNELS_MAX; ++i) putU32((uint32_t)map.map[i]);
+}
+
+void PACaptureWriter::putCVolume(const pa_cvolume& volume) {
+	putU8(volume.channels);
+	for(uint8_t i=0; i<volume.channels && i<PA_CHANNELS_MAX; ++i) putU32(volume.values[i]);
+}
+
+void PACaptureWriter::write(const pa_sink_info& info) {
+	putU32(info.index);
+	putStr(info.name);
+	putStr(info.description);
+	putSampleSpec(info.sample_spec);
+	putChannelMap(info.channel_map);
+	putU32(info.owner_module);
+	putCVolume(info.volume);
+	putU32((uint32_t)info.mute);
+	putU32(info.monitor_source);
+	putStr(info.monitor_source_name);
+	putU64(info.latency);
+	putStr(info.driver);
+	putU32((uint32_t)info.flags);
+	putProplist(info.proplist);
+	putU64(info.configured_latency);
+	putU32(info.base_volume);
+	putU32((uint32_t)info.state);
+	putU32(info.n_volume_steps);
+	putU32(info.card);
+	writeRecord(Capture_sink);
+}
+
+void PACaptureWriter::write(const pa_source_info& info) {
+	putU32(info.index);
+	putStr(info.name);
+	putStr(info.description);
+	putSampleSpec(info.sample_spec);
+	putChannelMap(info.channel_map);
+	putU32(info.owner_module);
+	putCVolume(info.volume);
+	putU32((uint32_t)info.mute);
+	putU32(info.monitor_of_sink);
+	putStr(info.monitor_of_sink_name);
+	putU64(info.latency);
+	putStr(info.driver);
+	putU32((uint32_t)info.flags);
+	putProplist(info.proplist);
+	putU64(info.configured_latency);
+	putU32(info.base_volume);
+	putU32((uint32_t)info.state);
+	putU32(info.n_volume_steps);
+	putU32(info.card);
+	writeRecord(Capture_source);
+}
+
+void PACaptureWriter::write(const pa_client_info& info) {
+	putU32(info.index);
+	putStr(info.name);
+	putU32(info.owner_module);
+	putStr(info.driver);
+	putProplist(info.proplist);
+	writeRecord(Capture_client);
+}
+
+void PACaptureWriter::write(const pa_sink_input_info& info) {
+	putU32(info.index);
+	putStr(info.name);
+	putU32(info.owner_module);
+	putU32(info.client);
+	putU32(info.sink);
+	putSampleSpec(info.sample_spec);
+	putChannelMap(info.channel_map);
+	putCVolume(info.volume);
+	putU64(info.buffer_usec);
+	putU64(info.sink_usec);
+	putStr(info.resample_method);
+	putStr(info.driver);
+	putU32((uint32_t)info.mute);
+	putProplist(info.proplist);
+	putU32((uint32_t)info.corked);
+	putU32((uint32_t)info.has_volume);
+	putU32((uint32_t)info.volume_writable);
+	writeRecord(Capture_sink_input);
+}
+
+void PACaptureWriter::write(const pa_card_info& info) {
+	putU32(info.index);
+	putStr(info.name);
+	putU32(info.owner_module);
+	putStr(info.driver);
+	putU32(info.n_profiles);
+	uint32_t active=PA_INVALID_INDEX;
+	for(uint32_t i=0; i<info.n_profiles; ++i) {
+		const pa_card_profile_info& profile=info.profiles[i];
+		if(info.active_profile==info.profiles+i) active=i;
+		putStr(profile.name);
+		putStr(profile.description);
+		putU32(profile.n_sinks);
+		putU32(profile.n_sources);
+		putU32(profile.priority);
+	}
+	putU32(active);
+	putProplist(info.proplist);
+	writeRecord(Capture_card);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACaptureReader
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PACaptureReader::PACaptureReader(const string& data) : m_data(data), m_pos(0), m_end(data.size()) {
+}
+
+void PACaptureReader::read(const string& file, PAInfoStore& store) {
+	ifstream in(file.c_str(), ios::in | ios::binary);
+	ASSERT_THROW_e(in, EUNABLE_TO_OPEN_FILE, "failed to open %s", file.c_str());
+	ostringstream data;
+	data << in.rdbuf();
+	string contents=data.str();
+	
+	ASSERT_THROW_e(contents.compare(0, CAPTURE_MAGIC_LEN, CAPTURE_MAGIC)==0
+			, EFILE_PARSING_ERROR, "%s is not a capture file", file.c_str());
+	
+	PACaptureReader reader(contents);
+	reader.m_pos=CAPTURE_MAGIC_LEN;
+	uint32_t version=reader.getU32();
+	ASSERT_THROW_e(version==CAPTURE_VERSION, EFILE_PARSING_ERROR, "unsupported capture version %u", version);
+	
+	while(reader.m_pos<contents.size()) {
+		reader.m_end=contents.size();
+		uint8_t type=reader.getU8();
+		uint32_t len=reader.getU32();
+		ASSERT_THROW_e(len<=contents.size()-reader.m_pos, EFILE_PARSING_ERROR, "truncated capture file");
+		reader.m_end=reader.m_pos+len;
+		reader.readRecord(type, store);
+		reader.m_pos=reader.m_end; //skips unknown trailing fields
+	}
+}
+
+void PACaptureReader::readRecord(uint8_t type, PAInfoStore& store) {
+	string name, description, monitor, driver, resample_method;
+	
+	switch(type) {
+	case Capture_sink: {
+		pa_sink_info info;
+		memset(&info, 0, sizeof(info));
+		info.index=getU32();
+		info.name=getStr(name);
+		info.description=getStr(description);
+		getSampleSpec(info.sample_spec);
+		getChannelMap(info.channel_map);
+		info.owner_module=getU32();
+		getCVolume(info.volume);
+		info.mute=(int)getU32();
+		info.monitor_source=getU32();
+		info.monitor_source_name=getStr(monitor);
+		info.latency=getU64();
+		info.driver=getStr(driver);
+		info.flags=(pa_sink_flags_t)getU32();
+		info.proplist=getProplist();
+		info.configured_latency=getU64();
+		info.base_volume=getU32();
+		info.state=(pa_sink_state_t)getU32();
+		info.n_volume_steps=getU32();
+		info.card=getU32();
+		store.addSink(info);
+		pa_proplist_free(info.proplist);
+		break;
+	}
+	case Capture_source: {
+		pa_source_info info;
+		memset(&info, 0, sizeof(info));
+		info.index=getU32();
+		info.name=getStr(name);
+		info.description=getStr(description);
+		getSampleSpec(info.sample_spec);
+		getChannelMap(info.channel_map);
+		info.owner_module=getU32();
+		getCVolume(info.volume);
+		info.mute=(int)getU32();
+		info.monitor_of_sink=getU32();
+		info.monitor_of_sink_name=getStr(monitor);
+		info.latency=getU64();
+		info.driver=getStr(driver);
+		info.flags=(pa_source_flags_t)getU32();
+		info.proplist=getProplist();
+		info.configured_latency=getU64();
+		info.base_volume=getU32();
+		info.state=(pa_source_state_t)getU32();
+		info.n_volume_steps=getU32();
+		info.card=getU32();
+		store.addSource(info);
+		pa_proplist_free(info.proplist);
+		break;
+	}
+	case Capture_client: {
+		pa_client_info info;
+		memset(&info, 0, sizeof(info));
+		info.index=getU32();
+		info.name=getStr(name);
+		info.owner_module=getU32();
+		info.driver=getStr(driver);
+		info.proplist=getProplist();
+		store.addClient(info);
+		pa_proplist_free(info.proplist);
+		break;
+	}
+	case Capture_sink_input: {
+		pa_sink_input_info info;
+		memset(&info, 0, sizeof(info));
+		info.index=getU32();
+		info.name=getStr(name);
+		info.owner_module=getU32();
+		info.client=getU32();
+		info.sink=getU32();
+		getSampleSpec(info.sample_spec);
+		getChannelMap(info.channel_map);
+		getCVolume(info.volume);
+		info.buffer_usec=getU64();
+		info.sink_usec=getU64();
+		info.resample_method=getStr(resample_method);
+		info.driver=getStr(driver);
+		info.mute=(int)getU32();
+		info.proplist=getProplist();
+		info.corked=(int)getU32();
+		info.has_volume=(int)getU32();
+		info.volume_writable=(int)getU32();
+		store.addSinkInput(info);
+		pa_proplist_free(info.proplist);
+		break;
+	}
+	case Capture_card: {
+		pa_card_info info;
+		memset(&info, 0, sizeof(info));
+		info.index=getU32();
+		info.name=getStr(name);
+		info.owner_module=getU32();
+		info.driver=getStr(driver);
+		info.n_profiles=getU32();
+		/* every profile needs at least 5*4 bytes */
+		ASSERT_THROW_e(info.n_profiles<=(m_end-m_pos)/20, EFILE_PARSING_ERROR, "corrupt card record");
+		vector<string> profile_names(info.n_profiles), profile_descriptions(info.n_profiles);
+		vector<pa_card_profile_info> profiles(info.n_profiles);
+		for(uint32_t i=0; i<info.n_profiles; ++i) {
+			profiles[i].name=getStr(profile_names[i]);
+			profiles[i].description=getStr(profile_descriptions[i]);
+			profiles[i].n_sinks=getU32();
+			profiles[i].n_sources=getU32();
+			profiles[i].priority=getU32();
+		}
+		info.profiles=profiles.empty() ? NULL : &profiles[0];
+		uint32_t active=getU32();
+		info.active_profile=active<info.n_profiles ? &profiles[active] : NULL;
+		info.proplist=getProplist();
+		store.addCard(info);
+		pa_proplist_free(info.proplist);
+		break;
+	}
+	default:
+		LOG(DEBUG, "skipping unknown capture record type %i", (int)type);
+		break;
+	}
+}
+
+uint8_t PACaptureReader::getU8() {
+	ASSERT_THROW_e(m_pos+1<=m_end, EFILE_PARSING_ERROR, "truncated capture record");
+	return((uint8_t)m_data[m_pos++]);
+}
+
+uint32_t PACaptureReader::getU32() {
+	ASSERT_THROW_e(m_pos+4<=m_end, EFILE_PARSING_ERROR, "truncated capture record");
+	uint32_t val=0;
+	for(int i=0; i<4; ++i) val|=(uint32_t)(uint8_t)m_data[m_pos++]<<(i*8);
+	return(val);
+}
+
+uint64_t PACaptureReader::getU64() {
+	uint64_t low=getU32();
+	uint64_t high=getU32();
+	return(low | (high<<32));
+}
+
+const char* PACaptureReader::getStr(string& str) {
+	uint32_t len=getU32();
+	if(len==CAPTURE_NULL_STR) return(NULL);
+	ASSERT_THROW_e(len<=m_end-m_pos, EFILE_PARSING_ERROR, "truncated capture record");
+	str.assign(m_data, m_pos, len);
+	m_pos+=len;
+	return(str.c_str());
+}
+
+pa_proplist* PACaptureReader::getProplist() {
+	uint32_t count=getU32();
+	pa_proplist* proplist=pa_proplist_new();
+	string key, value;
+	try {
+		for(uint32_t i=0; i<count; ++i) {
+			const char* k=getStr(key);
+			const char* v=getStr(value);
+			if(k && v) pa_proplist_sets(proplist, k, v);
+		}
+	} catch(...) {
+		pa_proplist_free(proplist);
+		throw;
+	}
+	return(proplist);
+}
+
+void PACaptureReader::getSampleSpec(pa_sample_spec& spec) {
+	spec.format=(pa_sample_format_t)getU32();
+	spec.rate=getU32();
+	spec.channels=getU8();
+}
+
+void PACaptureReader::getChannelMap(pa_channel_map& map) {
+	uint8_t channels=getU8();
+	ASSERT_THROW_e(channels<=PA_CHANNELS_MAX, EFILE_PARSING_ERROR, "corrupt channel map");
+	map.channels=channels;
+	for(uint8_t i=0; i<channels; ++i) map.map[i]=(pa_channel_position_t)getU32();
+}
+
+void PACaptureReader::getCVolume(pa_cvolume& volume) {
+	uint8_t channels=getU8();
+	ASSERT_THROW_e(channels<=PA_CHANNELS_MAX, EFILE_PARSING_ERROR, "corrupt volume");
+	volume.channels=channels;
+	for(uint8_t i=0; i<channels; ++i) volume.values[i]=getU32();
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_CAPTURE_H_
+#define PA_CAPTURE_H_
+
+#include "global.h"
+#include "pa_info_store.h"
+#include <pulse/pulseaudio.h>
+
+
+/* capture file format (all integers little endian):
+ * header: "PACAPTUR" u32 version
+ * records: u8 type, u32 payload length, payload
+ * strings are u32 length + bytes, length 0xffffffff is a NULL string.
+ * proplists are u32 count + key/value strings (only string values).
+ * a later record of the same object replaces the earlier one. */
+
+enum ECaptureRecord {
+	Capture_sink=1,
+	Capture_source,
+	Capture_client,
+	Capture_sink_input,
+	Capture_card
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACaptureWriter
+ * writes info structs to a capture file
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PACaptureWriter {
+public:
+	PACaptureWriter();
+	~PACaptureWriter();
+	
+	void open(const string& file);
+	void close();
+	
+	void write(const pa_sink_info& info);
+	void write(const pa_source_info& info);
+	void write(const pa_client_info& info);
+	void write(const pa_sink_input_info& info);
+	void write(const pa_card_info& info);
+	
+	uint32_t records() const { return(m_records); }
+	
+private:
+	void writeRecord(ECaptureRecord type);
+	
+	void putU8(uint8_t val);
+	void putU32(uint32_t val);
+	void putU64(uint64_t val);
+	void putStr(const char* str);
+	void putProplist(const pa_proplist* proplist);
+	void putSampleSpec(const pa_sample_spec& spec);
+	void putChannelMap(const pa_channel_map& map);
+	void putCVolume(const pa_cvolume& volume);
+	
+	FILE* m_file;
+	string m_buffer; //payload of the current record
+	uint32_t m_records;
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACaptureReader
+ * reads a capture file into a PAInfoStore
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PACaptureReader {
+public:
+	/* throws if the file cannot be read or is corrupt */
+	static void read(const string& file, PAInfoStore& store);
+	
+private:
+	PACaptureReader(const string& data);
+	
+	void readRecord(uint8_t type, PAInfoStore& store);
+	
+	uint8_t getU8();
+	uint32_t getU32();
+	uint64_t getU64();
+	/* returns NULL for a NULL string, the pointer is valid until the next get */
+	const char* getStr(string& str);
+	pa_proplist* getProplist(); //caller frees
+	void getSampleSpec(pa_sample_spec& spec);
+	void getChannelMap(pa_channel_map& map);
+	void getCVolume(pa_cvolume& volume);
+	
+	const string& m_data;
+	size_t m_pos;
+	size_t m_end; //end of the current record
+};
+
+
+#endif /* PA_CAPTURE_H_ */
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_clip_guard.h"
+
+#include <cmath>
+
+
+PAClipConfig::PAClipConfig() : clip_db(-0.01), near_db(-1.0), min_clipped(8), persist_ms(500), step_db(-1.0) {
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAClipGuard
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAClipGuard::PAClipGuard(PAManager& manager) : m_manager(manager) {
+	setConfig(m_config);
+}
+
+PAClipGuard::~PAClipGuard() {
+	close();
+}
+
+void PAClipGuard::setConfig(const PAClipConfig& config) {
+	m_config=config;
+	m_clip_level=(float)pow(10.0, config.clip_db/20.0);
+	m_near_level=(float)pow(10.0, config.near_db/20.0);
+}
+
+bool PAClipGuard::addSink(uint32_t idx) {
+	PABackend* backend=m_manager.Backend();
+	PADeviceInfo* device=m_manager.Sink(idx);
+	if(!backend || !device) return(false);
+	
+	/* no resampling or remixing, which could hide or add clipping */
+	PARecordSpec spec;
+	spec.source=device->monitor_name;
+	spec.rate=device->sample_spec.rate;
+	spec.channels=device->sample_spec.channels;
+	spec.channel_map=device->channel_map;
+	
+	SClipSink* sink=new SClipSink();
+	sink->guard=this;
+	sink->index=idx;
+	sink->channels=spec.channels;
+	sink->bEnded=false;
+	sink->counts.clipped=0;
+	sink->counts.near=0;
+	sink->counts.peak=0.0f;
+	sink->clipping_since=0;
+	sink->id=backend->openRecordStream(spec, recordCb, sink);
+	if(sink->id==0) {
+		LOG(WARN, "failed to open a record stream on %s", device->monitor_name.c_str());
+		delete(sink);
+		return(false);
+	}
+	m_sinks.push_back(sink);
+	return(true);
+}
+
+void PAClipGuard::close() {
+	PABackend* backend=m_manager.Backend();
+	for(size_t i=0; i<m_sinks.size(); ++i) {
+		if(backend && !m_sinks[i]->bEnded) backend->closeStream(m_sinks[i]->id);
+		delete(m_sinks[i]);
+	}
+	m_sinks.clear();
+}
+
+bool PAClipGuard::active() const {
+	for(size_t i=0; i<m_sinks.size(); ++i) {
+		if(!m_sinks[i]->bEnded) return(true);
+	}
+	return(false);
+}
+
+void PAClipGuard::recordCb(const float* samples, size_t frames, void* userdata) {
+	SClipSink* sink=(SClipSink*)userdata;
+	if(!samples) {
+		sink->bEnded=true;
+		return;
+	}
+	PAClipGuard* guard=sink->guard;
+	countPeaks(samples, frames*sink->channels, guard->m_clip_level, guard->m_near_level, sink->counts);
+}
+
+bool PAClipGuard::stepDown(const pa_cvolume& volume, pa_cvolume& lowered) const {
+	pa_volume_t max=pa_cvolume_max(&volume);
+	if(max<=PA_VOLUME_NORM) return(false);
+	/* the factor which brings the max. to 0dB (volumes multiply as
+	 * a*b/PA_VOLUME_NORM) */
+	pa_volume_t factor=pa_sw_volume_from_dB(m_config.step_db);
+	pa_volume_t to_norm=(pa_volume_t)((uint64_t)PA_VOLUME_NORM*PA_VOLUME_NORM/max);
+	if(to_norm>factor) factor=to_norm;
+	lowered=volume;
+	for(uint8_t i=0; i<volume.channels; ++i) lowered.values[i]=pa_sw_volume_multiply(volume.values[i], factor);
+	return(true);
+}
+
+bool PAClipGuard::lower(const PADeviceInfo& sink, PAClipEvent& event) {
+	pa_cvolume volume;
+	if(stepDown(sink.volume, volume)) {
+		m_manager.setSinkVolume(sink.index, volume);
+		event.target=Clip_sink;
+		event.target_index=sink.index;
+		event.volume=pa_cvolume_max(&volume);
+		return(true);
+	}
+	
+	/* the loudest stream above 0dB */
+	PASinkInputInfo* loudest=NULL;
+	const pa_sink_input_list& sink_inputs=m_manager.SinkInputs();
+	for(pa_sink_input_list::const_iterator it=sink_inputs.begin(); it!=sink_inputs.end(); ++it) {
+		PASinkInputInfo* sink_input=it->second;
+		if(sink_input->sink!=sink.index || pa_cvolume_max(&sink_input->volume)<=PA_VOLUME_NORM) continue;
+		if(!loudest || pa_cvolume_max(&sink_input->volume)>pa_cvolume_max(&loudest->volume)) loudest=sink_input;
+	}
+	if(!loudest || !stepDown(loudest->volume, volume)) return(false);
+	m_manager.setSinkInputVolume(loudest->index, volume);
+	event.target=Clip_sink_input;
+	event.target_index=loudest->index;
+	event.volume=pa_cvolume_max(&volume);
+	return(true);
+}
+
+size_t PAClipGuard::tick(vector<PAClipEvent>* events) {
+	uint64_t now=getTimeUsec();
+	size_t writes=0;
+	bool bBatch=false;
+	
+	for(size_t i=0; i<m_sinks.size(); ++i) {
+		SClipSink& sink=*m_sinks[i];
+		PAClipEvent event;
+		event.sink=sink.index;
+		event.counts=sink.counts;
+		event.target=Clip_none;
+		event.target_index=PA_INVALID_INDEX;
+		event.volume=PA_VOLUME_MUTED;
+		sink.counts.clipped=0;
+		sink.counts.near=0;
+		sink.counts.peak=0.0f;
+		
+		PADeviceInfo* device=m_manager.Sink(sink.index);
+		if(sink.bEnded || !device) continue;
+		
+		if(event.counts.clipped<m_config.min_clipped) {
+			sink.clipping_since=0;
+		} else if(sink.clipping_since==0) {
+			sink.clipping_since=now;
+		} else if(now-sink.clipping_since>=m_config.persist_ms*1000ULL) {
+			if(!bBatch) m_manager.beginBatch();
+			bBatch=true;
+			if(lower(*device, event)) ++writes;
+			/* the next step needs clipping for another persist_ms */
+			sink.clipping_since=now;
+		}
+		if(events && event.counts.near>0) events->push_back(event);
+	}
+	
+	if(bBatch && !m_manager.flush()) LOG(WARN, "not all volume changes of the clipping guard were applied");
+	return(writes);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_CLIP_GUARD_H_
+#define PA_CLIP_GUARD_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include "levels.h"
+
+
+struct PAClipConfig {
+	PAClipConfig();
+	
+	double clip_db; //a sample at or above this level is clipped
+	double near_db; //near full scale
+	uint32_t min_clipped; //clipped samples per tick which count as clipping
+	uint32_t persist_ms; //clipping in every tick for this long lowers a volume
+	double step_db; //of a volume step (negative)
+};
+
+/* which volume was lowered */
+enum EClipTarget {
+	Clip_none, //clipping, but no volume above 0dB
+	Clip_sink,
+	Clip_sink_input
+};
+
+/* a sink with clipped or near full scale samples in a tick */
+struct PAClipEvent {
+	uint32_t sink;
+	SPeakCount counts;
+	EClipTarget target; //Clip_none if no volume was lowered
+	uint32_t target_index;
+	pa_volume_t volume; //new volume of the target (max. of the channels)
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAClipGuard
+ * clipping detector with headroom protection: the monitor of every sink
+ * is recorded at the rate & channels of the sink and every fragment is
+ * scanned for clipped & near full scale samples (countPeaks).
+ *
+ * if a sink clips in every tick for persist_ms, a volume above 0dB
+ * (PA_VOLUME_NORM) is lowered by step_db, but not below 0dB: the sink
+ * volume if it's above, otherwise the loudest of its sink inputs above.
+ * the next step follows if the clipping persists for another persist_ms.
+ * volumes at or below 0dB are never touched, the clipping is only
+ * reported then.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAClipGuard {
+public:
+	PAClipGuard(PAManager& manager);
+	~PAClipGuard();
+	
+	void setConfig(const PAClipConfig& config);
+	
+	/* returns false if the sink does not exist or could not be recorded */
+	bool addSink(uint32_t idx);
+	void close();
+	
+	size_t count() const { return(m_sinks.size()); }
+	/* a sink was not removed yet */
+	bool active() const;
+	
+	/* evaluate the samples since the last tick. returns the number of
+	 * volume writes, the events are appended to events */
+	size_t tick(vector<PAClipEvent>* events=NULL);
+	
+private:
+	struct SClipSink {
+		PAClipGuard* guard;
+		uint32_t id;
+		uint32_t index;
+		uint8_t channels;
+		bool bEnded;
+		
+		SPeakCount counts; //since the last tick
+		uint64_t clipping_since; //0 if the last tick did not clip
+	};
+	
+	static void recordCb(const float* samples, size_t frames, void* userdata);
+	/* lower the volume above 0dB to fix the clipping of sink */
+	bool lower(const PADeviceInfo& sink, PAClipEvent& event);
+	/* volume lowered by step_db but not below 0dB, false if it's not above */
+	bool stepDown(const pa_cvolume& volume, pa_cvolume& lowered) const;
+	
+	PAManager& m_manager;
+	PAClipConfig m_config;
+	float m_clip_level;
+	float m_near_level;
+	vector<SClipSink*> m_sinks;
+};
+
+
+#endif /* PA_CLIP_GUARD_H_ */
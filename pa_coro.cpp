@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_coro.h"
+
+#include <algorithm>
+#include <new>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACoroFramePool
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define FRAME_POOL_MIN_SHIFT 6 //smallest size class: 64 bytes
+#define FRAME_POOL_CLASSES 8 //largest size class: 8 KiB, larger frames are not pooled
+
+struct SFramePool {
+	SFramePool() : heap_allocations(0) {
+		for(int i=0; i<FRAME_POOL_CLASSES; ++i) free_frames[i]=NULL;
+	}
+	~SFramePool() {
+		for(int i=0; i<FRAME_POOL_CLASSES; ++i) {
+			while(free_frames[i]) {
+				void* frame=free_frames[i];
+				free_frames[i]=*(void**)frame;
+				::operator delete(frame);
+			}
+		}
+	}
+	
+	void* free_frames[FRAME_POOL_CLASSES]; //the first word of a free frame points to the next
+	uint64_t heap_allocations;
+};
+
+static thread_local SFramePool frame_pool;
+
+static int frameSizeClass(size_t size) {
+	int size_class=0;
+	while(size_class<FRAME_POOL_CLASSES && ((size_t)1<<(FRAME_POOL_MIN_SHIFT+size_class)) < size) ++size_class;
+	return(size_class);
+}
+
+void* PACoroFramePool::allocate(size_t size) {
+	int size_class=frameSizeClass(size);
+	if(size_class<FRAME_POOL_CLASSES && frame_pool.free_frames[size_class]) {
+		void* frame=frame_pool.free_frames[size_class];
+		frame_pool.free_frames[size_class]=*(void**)frame;
+		return(frame);
+	}
+	++frame_pool.heap_allocations;
+	if(size_class>=FRAME_POOL_CLASSES) return(::operator new(size));
+	return(::operator new((size_t)1<<(FRAME_POOL_MIN_SHIFT+size_class)));
+}
+
+void PACoroFramePool::deallocate(void* frame, size_t size) {
+	int size_class=frameSizeClass(size);
+	if(size_class>=FRAME_POOL_CLASSES) {
+		::operator delete(frame);
+		return;
+	}
+	*(void**)frame=frame_pool.free_frames[size_class];
+	frame_pool.free_frames[size_class]=frame;
+}
+
+uint64_t PACoroFramePool::heapAllocations() {
+	return(frame_pool.heap_allocations);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAOpAwaiter
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PACoroOp::PACoroOp(PAManager* op_manager, EPAOpType op_type, void* op_list, uint32_t op_index)
+	: PAListOp(op_manager, op_type, op_list, op_index), mute(0), sink(PA_INVALID_INDEX) {
+	pa_cvolume_init(&volume);
+}
+
+PAOpAwaiter::PAOpAwaiter(PAManager& manager, EPAOpType type, uint32_t idx, void* list)
+	: m_manager(manager), m_op(new PACoroOp(&manager, type, list, idx)) {
+}
+
+PAOpAwaiter::~PAOpAwaiter() {
+	if(!m_op) return;
+	/* the frame is destroyed while the operation is pending: the callback
+	 * still has the op, resumeOp() frees it */
+	if(m_op->ready==0 && m_op->handle) {
+		m_op->handle=nullptr;
+		return;
+	}
+	delete(m_op);
+}
+
+bool PAOpAwaiter::await_suspend(coroutine_handle<> handle) {
+	PABackend* backend=m_manager.Backend();
+	ASSERT_THROW(backend, ENOT_INITIALIZED);
+	m_op->start=getTimeUsec();
+	PAListOp* op=m_op; //the callbacks cast their userdata to the base
+	
+	bool bIssued=false;
+	switch(m_op->type) {
+	case PAOp_sink_list: bIssued=backend->getSinkInfoList(pa_sinklist_cb, op); break;
+	case PAOp_source_list: bIssued=backend->getSourceInfoList(pa_sourcelist_cb, op); break;
+	case PAOp_client_list: bIssued=backend->getClientInfoList(pa_client_cb, op); break;
+	case PAOp_sink_input_list: bIssued=backend->getSinkInputInfoList(pa_sink_input_cb, op); break;
+	case PAOp_card_list: bIssued=backend->getCardInfoList(pa_card_cb, op); break;
+	case PAOp_sink_info: bIssued=backend->getSinkInfo(m_op->index, pa_sinklist_cb, op); break;
+	case PAOp_source_info: bIssued=backend->getSourceInfo(m_op->index, pa_sourcelist_cb, op); break;
+	case PAOp_client_info: bIssued=backend->getClientInfo(m_op->index, pa_client_cb, op); break;
+	case PAOp_sink_input_info: bIssued=backend->getSinkInputInfo(m_op->index, pa_sink_input_cb, op); break;
+	case PAOp_card_info: bIssued=backend->getCardInfo(m_op->index, pa_card_cb, op); break;
+	case PAOp_set_sink_volume:
+		bIssued=backend->setSinkVolume(m_op->index, m_op->volume, pa_success_cb, op);
+		break;
+	case PAOp_set_sink_mute:
+		bIssued=backend->setSinkMute(m_op->index, m_op->mute, pa_success_cb, op);
+		break;
+	case PAOp_set_source_volume:
+		bIssued=backend->setSourceVolume(m_op->index, m_op->volume, pa_success_cb, op);
+		break;
+	case PAOp_set_source_mute:
+		bIssued=backend->setSourceMute(m_op->index, m_op->mute, pa_success_cb, op);
+		break;
+	case PAOp_set_sink_input_volume:
+		bIssued=backend->setSinkInputVolume(m_op->index, m_op->volume, pa_success_cb, op);
+		break;
+	case PAOp_set_sink_input_mute:
+		bIssued=backend->setSinkInputMute(m_op->index, m_op->mute, pa_success_cb, op);
+		break;
+	case PAOp_set_card_profile:
+		bIssued=backend->setCardProfile(m_op->index, m_op->profile.c_str(), pa_success_cb, op);
+		break;
+	case PAOp_move_sink_input:
+		bIssued=backend->moveSinkInput(m_op->index, m_op->sink, pa_success_cb, op);
+		break;
+	default:
+		break;
+	}
+	
+	if(!bIssued) {
+		LOG(ERROR, "%s for index %i failed", paOpName(m_op->type), m_op->index);
+		finishOperation(*m_op, false);
+		return(false);
+	}
+	/* the callbacks are called from iterate(), so the hook is not too late */
+	m_op->handle=handle;
+	m_op->done=resumeOp;
+	return(true);
+}
+
+void PAOpAwaiter::resumeOp(PAPendingOp* op) {
+	PACoroOp* coro_op=static_cast<PACoroOp*>(op);
+	if(!coro_op->handle) { //detached by the awaiter
+		delete(coro_op);
+		return;
+	}
+	/* the awaiter (and op) may be gone after resuming */
+	coro_op->handle.resume();
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAEventAwaiter
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAEventAwaiter::PAEventAwaiter(PACoro& coro, int facility, int type) : m_coro(coro)
+	, m_facility(facility), m_type(type), m_bFired(false), m_index(PA_INVALID_INDEX) {
+	m_coro.m_waiters.push_back(this);
+}
+
+PAEventAwaiter::~PAEventAwaiter() {
+	if(!m_bFired) {
+		vector<PAEventAwaiter*>& waiters=m_coro.m_waiters;
+		waiters.erase(remove(waiters.begin(), waiters.end(), this), waiters.end());
+		return;
+	}
+	/* fired but not resumed yet: the coroutine which resumed before left
+	 * the scope of this awaiter or destroyed the task holding it (which
+	 * destroys the awaiters of its frame) */
+	vector<PACoro::SPendingResume>& resume=m_coro.m_resume;
+	for(size_t i=0; i<resume.size(); ) {
+		if(resume[i].awaiter==this) resume.erase(resume.begin()+i);
+		else ++i;
+	}
+}
+
+bool PAEventAwaiter::fire(pa_subscription_event_type_t type, uint32_t idx) {
+	if((type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK)!=m_facility
+			|| (type & PA_SUBSCRIPTION_EVENT_TYPE_MASK)!=m_type) return(false);
+	m_bFired=true;
+	m_index=idx;
+	return(true);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACoro
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PACoro::PACoro(PAManager& manager) : m_manager(manager), m_event_cb(NULL), m_event_userdata(NULL) {
+}
+
+PACoro::~PACoro() {
+	if(!m_waiters.empty()) LOG(WARN, "%i coroutines still wait for an event", (int)m_waiters.size());
+	/* the events go to the forwarded callback again */
+	if(m_manager.m_event_cb==eventCb && m_manager.m_event_userdata==this) {
+		m_manager.m_event_cb=m_event_cb;
+		m_manager.m_event_userdata=m_event_userdata;
+	}
+}
+
+PAOpAwaiter PACoro::setSinkVolume(uint32_t idx, const pa_cvolume& volume) {
+	PAOpAwaiter awaiter(m_manager, PAOp_set_sink_volume, idx);
+	awaiter.op().volume=volume;
+	return(awaiter);
+}
+
+PAOpAwaiter PACoro::setSinkMute(uint32_t idx, int mute) {
+	PAOpAwaiter awaiter(m_manager, PAOp_set_sink_mute, idx);
+	awaiter.op().mute=mute;
+	return(awaiter);
+}
+
+PAOpAwaiter PACoro::setSourceVolume(uint32_t idx, const pa_cvolume& volume) {
+	PAOpAwaiter awaiter(m_manager, PAOp_set_source_volume, idx);
+	awaiter.op().volume=volume;
+	return(awaiter);
+}
+
+PAOpAwaiter PACoro::setSourceMute(uint32_t idx, int mute) {
+	PAOpAwaiter awaiter(m_manager, PAOp_set_source_mute, idx);
+	awaiter.op().mute=mute;
+	return(awaiter);
+}
+
+PAOpAwaiter PACoro::setSinkInputVolume(uint32_t idx, const pa_cvolume& volume) {
+	PAOpAwaiter awaiter(m_manager, PAOp_set_sink_input_volume, idx);
+	awaiter.op().volume=volume;
+	return(awaiter);
+}
+
+PAOpAwaiter PACoro::setSinkInputMute(uint32_t idx, int mute) {
+	PAOpAwaiter awaiter(m_manager, PAOp_set_sink_input_mute, idx);
+	awaiter.op().mute=mute;
+	return(awaiter);
+}
+
+PAOpAwaiter PACoro::setCardProfile(uint32_t idx, const string& profile_name) {
+	PAOpAwaiter awaiter(m_manager, PAOp_set_card_profile, idx);
+	awaiter.op().profile=profile_name;
+	return(awaiter);
+}
+
+PAOpAwaiter PACoro::moveSinkInput(uint32_t idx, uint32_t sink_idx) {
+	PAOpAwaiter awaiter(m_manager, PAOp_move_sink_input, idx);
+	awaiter.op().sink=sink_idx;
+	return(awaiter);
+}
+
+void PACoro::subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb, void* userdata) {
+	m_event_cb=cb;
+	m_event_userdata=userdata;
+	m_manager.subscribe(mask, eventCb, this);
+}
+
+void PACoro::eventCb(pa_subscription_event_type_t type, uint32_t idx, void* userdata) {
+	PACoro* coro=(PACoro*)userdata;
+	
+	/* collect first: resumed coroutines can add & remove waiters. waiters
+	 * added meanwhile did not see this event. the handles are resumed from
+	 * m_resume, a fired awaiter destroyed by an earlier resume removes its
+	 * entry there */
+	vector<PAEventAwaiter*>& waiters=coro->m_waiters;
+	for(size_t i=0; i<waiters.size(); ) {
+		if(waiters[i]->fire(type, idx)) {
+			if(waiters[i]->m_handle) {
+				PACoro::SPendingResume pending;
+				pending.awaiter=waiters[i];
+				pending.handle=waiters[i]->m_handle;
+				coro->m_resume.push_back(pending);
+			}
+			waiters.erase(waiters.begin()+i);
+		} else {
+			++i;
+		}
+	}
+	while(!coro->m_resume.empty()) {
+		coroutine_handle<> handle=coro->m_resume.front().handle;
+		coro->m_resume.erase(coro->m_resume.begin());
+		handle.resume();
+	}
+	
+	if(coro->m_event_cb) coro->m_event_cb(type, idx, coro->m_event_userdata);
+}
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_CORO_H_
+#define PA_CORO_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+
+/*
+ * C++20 coroutine interface of PAManager. every operation has an awaitable
+ * which issues it and resumes the coroutine from the completion callback,
+ * so multi-step flows can be written linearly without blocking:
+ *
+ *   PATask<bool> switchProfile(PACoro& pa, uint32_t card, string profile, uint32_t input) {
+ *       PAEventAwaiter new_sink=pa.event(PA_SUBSCRIPTION_EVENT_SINK, PA_SUBSCRIPTION_EVENT_NEW);
+ *       if(!co_await pa.setCardProfile(card, profile)) co_return(false);
+ *       uint32_t sink=co_await new_sink;
+ *       co_return(co_await pa.moveSinkInput(input, sink));
+ *   }
+ *
+ *   PACoro pa(manager);
+ *   pa.subscribe(PA_SUBSCRIPTION_MASK_SINK);
+ *   bool bSuccess=pa.run(switchProfile(pa, 0, "hdmi", 3));
+ *
+ * everything runs in the thread iterating the manager.
+ */
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACoroFramePool
+ * allocator of the coroutine frames. freed frames are kept in a free list
+ * per size class and reused, so a steady state does not allocate. the pool
+ * is per thread: a frame must be freed by the thread which created it.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PACoroFramePool {
+public:
+	static void* allocate(size_t size);
+	static void deallocate(void* frame, size_t size);
+	
+	/* number of frames this thread allocated from the heap */
+	static uint64_t heapAllocations();
+};
+
+
+/* common part of the promise types: pooled frames, lazy start & resuming
+ * the awaiting coroutine at the end */
+struct PACoroPromiseBase {
+	static void* operator new(size_t size) { return(PACoroFramePool::allocate(size)); }
+	static void operator delete(void* frame, size_t size) { PACoroFramePool::deallocate(frame, size); }
+	
+	struct SFinalAwaiter {
+		bool await_ready() noexcept { return(false); }
+		template<class Promise>
+		coroutine_handle<> await_suspend(coroutine_handle<Promise> handle) noexcept {
+			coroutine_handle<> continuation=handle.promise().continuation;
+			if(continuation) return(continuation);
+			return(noop_coroutine());
+		}
+		void await_resume() noexcept {}
+	};
+	
+	suspend_always initial_suspend() noexcept { return(suspend_always()); }
+	SFinalAwaiter final_suspend() noexcept { return(SFinalAwaiter()); }
+	void unhandled_exception() { exception=current_exception(); }
+	
+	coroutine_handle<> continuation; //the coroutine awaiting this one
+	exception_ptr exception;
+};
+
+template<class T>
+struct PATaskResult {
+	void return_value(T value) { result=std::move(value); }
+	T get() { return(std::move(result)); }
+	T result;
+};
+
+template<>
+struct PATaskResult<void> {
+	void return_void() {}
+	void get() {}
+};
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PATask
+ * coroutine with a result of type T (default constructible or void). it
+ * starts when it's awaited or with start(), the task owns the frame.
+ * destroying a task which waits for an operation detaches the operation:
+ * its completion only frees it.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<class T=void>
+class PATask {
+public:
+	struct promise_type : public PACoroPromiseBase, public PATaskResult<T> {
+		PATask get_return_object() { return(PATask(coroutine_handle<promise_type>::from_promise(*this))); }
+	};
+	
+	PATask(PATask&& task) noexcept : m_handle(task.m_handle), m_bStarted(task.m_bStarted) {
+		task.m_handle=nullptr;
+	}
+	~PATask() { if(m_handle) m_handle.destroy(); }
+	
+	/* start a task which is not awaited by another coroutine */
+	void start() {
+		ASSERT_THROW(m_handle && !m_bStarted, EINVALID_PARAMETER);
+		m_bStarted=true;
+		m_handle.resume();
+	}
+	bool done() const { return(!m_handle || m_handle.done()); }
+	/* the result of a finished task, rethrows its exception */
+	T result() {
+		ASSERT_THROW_e(m_handle && m_handle.done(), EINVALID_PARAMETER, "task not finished");
+		if(m_handle.promise().exception) rethrow_exception(m_handle.promise().exception);
+		return(m_handle.promise().get());
+	}
+	
+	bool await_ready() const noexcept { return(false); }
+	coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept {
+		m_handle.promise().continuation=awaiting;
+		m_bStarted=true;
+		return(m_handle);
+	}
+	T await_resume() { return(result()); }
+	
+private:
+	explicit PATask(coroutine_handle<promise_type> handle) : m_handle(handle), m_bStarted(false) {}
+	PATask(const PATask&);
+	PATask& operator=(const PATask&);
+	
+	coroutine_handle<promise_type> m_handle;
+	bool m_bStarted;
+};
+
+
+/* operation issued by an awaiter, the completion resumes the coroutine.
+ * it's allocated from the frame pool and outlives a destroyed awaiter
+ * while it is pending (handle is then reset) */
+struct PACoroOp : public PAListOp {
+	PACoroOp(PAManager* op_manager, EPAOpType op_type, void* op_list, uint32_t op_index);
+	virtual ~PACoroOp() {}
+	
+	static void* operator new(size_t size) { return(PACoroFramePool::allocate(size)); }
+	static void operator delete(void* op, size_t size) { PACoroFramePool::deallocate(op, size); }
+	
+	pa_cvolume volume;
+	int mute;
+	string profile;
+	uint32_t sink; //target of a move
+	
+	coroutine_handle<> handle;
+};
+
+/* enumeration: the objects are collected in the op until the list is
+ * complete */
+template<class Object>
+struct PACoroListOp : public PACoroOp {
+	PACoroListOp(PAManager* op_manager, EPAOpType op_type)
+		: PACoroOp(op_manager, op_type, &objects, PA_INVALID_INDEX) {}
+	~PACoroListOp() {
+		for(typename map<uint32_t, Object*>::iterator iter=objects.begin(); iter!=objects.end(); ++iter) {
+			delete(iter->second);
+		}
+	}
+	
+	map<uint32_t, Object*> objects;
+};
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAOpAwaiter
+ * awaitable of a single operation. the result is true on success. if the
+ * operation cannot be issued the coroutine continues without suspending.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAOpAwaiter {
+public:
+	PAOpAwaiter(PAManager& manager, EPAOpType type, uint32_t idx=PA_INVALID_INDEX, void* list=NULL);
+	PAOpAwaiter(PAOpAwaiter&& awaiter) noexcept : m_manager(awaiter.m_manager), m_op(awaiter.m_op) {
+		awaiter.m_op=NULL;
+	}
+	~PAOpAwaiter();
+	
+	PACoroOp& op() { return(*m_op); }
+	
+	bool await_ready() const { return(false); }
+	bool await_suspend(coroutine_handle<> handle);
+	bool await_resume() const { return(m_op->ready==1); }
+	
+protected:
+	/* takes ownership of op */
+	PAOpAwaiter(PAManager& manager, PACoroOp* op) : m_manager(manager), m_op(op) {}
+	
+	/* set sink_obj & client_obj of the manager's sink inputs */
+	void linkSinkInputs() { m_manager.linkSinkInputs(); }
+	
+	PAManager& m_manager;
+	PACoroOp* m_op;
+	
+private:
+	PAOpAwaiter(const PAOpAwaiter&);
+	PAOpAwaiter& operator=(const PAOpAwaiter&);
+	
+	static void resumeOp(PAPendingOp* op);
+};
+
+/* by-index fetch: updates the object in the manager's table. the result is
+ * the object, NULL if it does not exist */
+template<class Object>
+class PAFetchAwaiter : public PAOpAwaiter {
+public:
+	PAFetchAwaiter(PAManager& manager, EPAOpType type, map<uint32_t, Object*>* table, uint32_t idx)
+		: PAOpAwaiter(manager, type, idx, table), m_table(table) {}
+	
+	Object* await_resume() {
+		if(m_op->ready!=1) return(NULL);
+		linkSinkInputs();
+		typename map<uint32_t, Object*>::iterator iter=m_table->find(m_op->index);
+		return(iter==m_table->end() ? NULL : iter->second);
+	}
+	
+private:
+	map<uint32_t, Object*>* m_table;
+};
+
+/* enumeration: replaces the manager's table on success. the result is
+ * true on success */
+template<class Object>
+class PAListAwaiter : public PAOpAwaiter {
+public:
+	PAListAwaiter(PAManager& manager, EPAOpType type, map<uint32_t, Object*>* table)
+		: PAOpAwaiter(manager, new PACoroListOp<Object>(&manager, type)), m_table(table) {}
+	PAListAwaiter(PAListAwaiter&& awaiter)=default;
+	
+	bool await_resume() {
+		if(m_op->ready!=1) return(false);
+		m_table->swap(static_cast<PACoroListOp<Object>*>(m_op)->objects); //the old objects are deleted with the op
+		linkSinkInputs();
+		return(true);
+	}
+	
+private:
+	map<uint32_t, Object*>* m_table;
+};
+
+class PACoro;
+
+/* waits for a subscription event, see PACoro::event(). the result is the
+ * object index */
+class PAEventAwaiter {
+public:
+	PAEventAwaiter(PACoro& coro, int facility, int type);
+	~PAEventAwaiter();
+	
+	bool await_ready() const { return(m_bFired); }
+	void await_suspend(coroutine_handle<> handle) { m_handle=handle; }
+	uint32_t await_resume() const { return(m_index); }
+	
+private:
+	friend class PACoro;
+	PAEventAwaiter(const PAEventAwaiter&);
+	PAEventAwaiter& operator=(const PAEventAwaiter&);
+	
+	/* returns true if the event matches */
+	bool fire(pa_subscription_event_type_t type, uint32_t idx);
+	
+	PACoro& m_coro;
+	int m_facility;
+	int m_type;
+	bool m_bFired;
+	uint32_t m_index;
+	coroutine_handle<> m_handle;
+};
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACoro
+ * awaitables of the PAManager operations
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PACoro {
+public:
+	PACoro(PAManager& manager);
+	~PACoro();
+	
+	PAManager& Manager() { return(m_manager); }
+	
+	/* enumeration: replace the manager's table */
+	PAListAwaiter<PADeviceInfo> sinks() { return(PAListAwaiter<PADeviceInfo>(m_manager, PAOp_sink_list, &m_manager.m_sinks)); }
+	PAListAwaiter<PADeviceInfo> sources() { return(PAListAwaiter<PADeviceInfo>(m_manager, PAOp_source_list, &m_manager.m_sources)); }
+	PAListAwaiter<PAClientInfo> clients() { return(PAListAwaiter<PAClientInfo>(m_manager, PAOp_client_list, &m_manager.m_clients)); }
+	PAListAwaiter<PASinkInputInfo> sinkInputs() { return(PAListAwaiter<PASinkInputInfo>(m_manager, PAOp_sink_input_list, &m_manager.m_sink_inputs)); }
+	PAListAwaiter<PACardInfo> cards() { return(PAListAwaiter<PACardInfo>(m_manager, PAOp_card_list, &m_manager.m_cards)); }
+	
+	/* by-index fetch: update a single object of the manager */
+	PAFetchAwaiter<PADeviceInfo> sink(uint32_t idx) { return(PAFetchAwaiter<PADeviceInfo>(m_manager, PAOp_sink_info, &m_manager.m_sinks, idx)); }
+	PAFetchAwaiter<PADeviceInfo> source(uint32_t idx) { return(PAFetchAwaiter<PADeviceInfo>(m_manager, PAOp_source_info, &m_manager.m_sources, idx)); }
+	PAFetchAwaiter<PAClientInfo> client(uint32_t idx) { return(PAFetchAwaiter<PAClientInfo>(m_manager, PAOp_client_info, &m_manager.m_clients, idx)); }
+	PAFetchAwaiter<PASinkInputInfo> sinkInput(uint32_t idx) { return(PAFetchAwaiter<PASinkInputInfo>(m_manager, PAOp_sink_input_info, &m_manager.m_sink_inputs, idx)); }
+	PAFetchAwaiter<PACardInfo> card(uint32_t idx) { return(PAFetchAwaiter<PACardInfo>(m_manager, PAOp_card_info, &m_manager.m_cards, idx)); }
+	
+	/* mutations */
+	PAOpAwaiter setSinkVolume(uint32_t idx, const pa_cvolume& volume);
+	PAOpAwaiter setSinkMute(uint32_t idx, int mute);
+	PAOpAwaiter setSourceVolume(uint32_t idx, const pa_cvolume& volume);
+	PAOpAwaiter setSourceMute(uint32_t idx, int mute);
+	PAOpAwaiter setSinkInputVolume(uint32_t idx, const pa_cvolume& volume);
+	PAOpAwaiter setSinkInputMute(uint32_t idx, int mute);
+	PAOpAwaiter setCardProfile(uint32_t idx, const string& profile_name);
+	PAOpAwaiter moveSinkInput(uint32_t idx, uint32_t sink_idx);
+	
+	/* events: subscribe() replaces the manager's event callback (cb is
+	 * forwarded). event() waits for the next event of a facility
+	 * (PA_SUBSCRIPTION_EVENT_SINK, ...) and type (PA_SUBSCRIPTION_EVENT_NEW,
+	 * ...). it listens from its creation on, so it can be created before
+	 * the operation which causes the event. when it's resumed the object
+	 * is already in the manager's table */
+	void subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb=NULL, void* userdata=NULL);
+	PAEventAwaiter event(int facility, int type) { return(PAEventAwaiter(*this, facility, type)); }
+	
+	/* start task and run the manager's event loop until it is done.
+	 * returns its result */
+	template<class T>
+	T run(PATask<T>&& task) {
+		task.start();
+		while(!task.done()) m_manager.iterate(-1);
+		return(task.result());
+	}
+	
+private:
+	friend class PAEventAwaiter;
+	PACoro(const PACoro&);
+	PACoro& operator=(const PACoro&);
+	
+	static void eventCb(pa_subscription_event_type_t type, uint32_t idx, void* userdata);
+	
+	/* a fired awaiter whose coroutine was not resumed yet */
+	struct SPendingResume {
+		PAEventAwaiter* awaiter; //only compared, never dereferenced
+		coroutine_handle<> handle;
+	};
+	
+	PAManager& m_manager;
+	vector<PAEventAwaiter*> m_waiters;
+	vector<SPendingResume> m_resume;
+	pa_backend_event_cb_t m_event_cb;
+	void* m_event_userdata;
+};
+
+
+#endif /* PA_CORO_H_ */
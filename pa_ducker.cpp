@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_ducker.h"
+#include <cstdio>
+#include <algorithm>
+
+
+static void splitRoles(const string& str, vector<string>& roles) {
+	string s=str+",";
+	while(s.length()>0) {
+		string role=trim(s.substr(0, s.find(',')));
+		s=s.substr(s.find(',')+1);
+		if(!role.empty()) roles.push_back(role);
+	}
+}
+
+PADuckRule PADuckRule::parse(const string& str) {
+	PADuckRule rule;
+	size_t pos=str.find(':');
+	ASSERT_THROW_e(pos!=string::npos, EINVALID_PARAMETER, "invalid duck rule %s (<triggers>:<targets>[:<dB>])", str.c_str());
+	splitRoles(str.substr(0, pos), rule.triggers);
+	string targets=str.substr(pos+1);
+	pos=targets.find(':');
+	if(pos!=string::npos) {
+		ASSERT_THROW_e(sscanf(targets.substr(pos+1).c_str(), "%lf", &rule.duck_db)==1 && rule.duck_db<0.0
+				, EINVALID_PARAMETER, "invalid duck gain in %s (dB, eg. -20)", str.c_str());
+		targets=targets.substr(0, pos);
+	}
+	splitRoles(targets, rule.targets);
+	ASSERT_THROW_e(!rule.triggers.empty() && !rule.targets.empty(), EINVALID_PARAMETER
+			, "invalid duck rule %s (<triggers>:<targets>[:<dB>])", str.c_str());
+	return(rule);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PADucker
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PADucker::PADucker(PAManager& manager) : m_manager(manager), m_ramp_usec(150000) {
+}
+
+bool PADucker::matches(const vector<string>& roles, const string& role) {
+	for(size_t i=0; i<roles.size(); ++i) {
+		if(roles[i]==role || roles[i]=="*") return(true);
+	}
+	return(false);
+}
+
+double PADucker::duckGain(const PASinkInputInfo& sink_input, const vector<bool>& active) const {
+	double gain=0.0;
+	for(size_t i=0; i<m_rules.size(); ++i) {
+		if(!active[i] || find(m_rules[i].triggers.begin(), m_rules[i].triggers.end(), sink_input.media_role)
+				!=m_rules[i].triggers.end()) continue;
+		if(matches(m_rules[i].targets, sink_input.media_role) && m_rules[i].duck_db<gain) gain=m_rules[i].duck_db;
+	}
+	return(gain);
+}
+
+void PADucker::sync(uint64_t event_time) {
+	const pa_sink_input_list& sink_inputs=m_manager.SinkInputs();
+	uint64_t start=event_time>0 ? event_time : getTimeUsec();
+	
+	/* the rules with a trigger stream */
+	vector<bool> active(m_rules.size(), false);
+	for(pa_sink_input_list::const_iterator iter=sink_inputs.begin(); iter!=sink_inputs.end(); ++iter) {
+		for(size_t i=0; i<m_rules.size(); ++i) {
+			if(find(m_rules[i].triggers.begin(), m_rules[i].triggers.end(), iter->second->media_role)
+					!=m_rules[i].triggers.end()) active[i]=true;
+		}
+	}
+	
+	for(map<uint32_t, SDuckStream>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ) {
+		if(sink_inputs.find(iter->first)==sink_inputs.end()) m_streams.erase(iter++);
+		else ++iter;
+	}
+	
+	for(pa_sink_input_list::const_iterator iter=sink_inputs.begin(); iter!=sink_inputs.end(); ++iter) {
+		const PASinkInputInfo& sink_input=*iter->second;
+		double gain=duckGain(sink_input, active);
+		map<uint32_t, SDuckStream>::iterator stream_iter=m_streams.find(iter->first);
+		
+		if(stream_iter==m_streams.end()) {
+			if(gain==0.0) continue;
+			SDuckStream& stream=m_streams[iter->first];
+			stream.original=sink_input.volume;
+			stream.written=sink_input.volume;
+			stream.previous=sink_input.volume;
+			stream.gain_db=0.0;
+			stream.from_db=0.0;
+			stream.target_db=gain;
+			stream.start=start;
+			stream.bReported=false;
+			continue;
+		}
+		
+		SDuckStream& stream=stream_iter->second;
+		if(stream.target_db==gain) continue;
+		if(gain==0.0 && !PAManager::volumeClose(sink_input.volume, stream.written)
+				&& !PAManager::volumeClose(sink_input.volume, stream.previous)) {
+			LOG(DEBUG, "volume of sink input %u was changed during the duck, not restoring it", iter->first);
+			m_streams.erase(stream_iter);
+			continue;
+		}
+		stream.from_db=stream.gain_db;
+		stream.target_db=gain;
+		stream.start=start;
+		stream.bReported=false;
+	}
+}
+
+bool PADucker::ramping() const {
+	for(map<uint32_t, SDuckStream>::const_iterator iter=m_streams.begin(); iter!=m_streams.end(); ++iter) {
+		if(iter->second.gain_db!=iter->second.target_db) return(true);
+	}
+	return(false);
+}
+
+void PADucker::duckedVolume(const SDuckStream& stream, pa_cvolume& volume) {
+	volume=stream.original;
+	if(stream.gain_db==0.0) return;
+	pa_volume_t gain=pa_sw_volume_from_dB(stream.gain_db);
+	for(uint8_t i=0; i<volume.channels; ++i) volume.values[i]=pa_sw_volume_multiply(stream.original.values[i], gain);
+}
+
+size_t PADucker::tick(vector<PADuckChange>* changes) {
+	uint64_t now=getTimeUsec();
+	size_t writes=0;
+	
+	for(map<uint32_t, SDuckStream>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ++iter) {
+		SDuckStream& stream=iter->second;
+		if(stream.gain_db==stream.target_db || !m_manager.SinkInput(iter->first)) continue;
+		
+		/* the first step is written at once */
+		double progress=m_ramp_usec>0 ? (double)(now-stream.start+DUCK_STEP_USEC)/m_ramp_usec : 1.0;
+		stream.gain_db=progress>=1.0 ? stream.target_db : stream.from_db+(stream.target_db-stream.from_db)*progress;
+		pa_cvolume volume;
+		duckedVolume(stream, volume);
+		stream.previous=stream.written;
+		stream.written=volume;
+		
+		if(writes==0) m_manager.beginBatch();
+		m_manager.setSinkInputVolume(iter->first, volume);
+		++writes;
+		
+		if(!stream.bReported && changes) {
+			PADuckChange change;
+			change.sink_input=iter->first;
+			change.gain_db=stream.target_db;
+			change.reaction_usec=now-stream.start;
+			changes->push_back(change);
+		}
+		stream.bReported=true;
+	}
+	if(writes>0 && !m_manager.flush()) LOG(WARN, "not all volume changes of the ducking were applied");
+	
+	/* restored streams are not ducked anymore */
+	for(map<uint32_t, SDuckStream>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ) {
+		if(iter->second.target_db==0.0 && iter->second.gain_db==0.0) m_streams.erase(iter++);
+		else ++iter;
+	}
+	return(writes);
+}
+
+void PADucker::close() {
+	size_t writes=0;
+	for(map<uint32_t, SDuckStream>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ++iter) {
+		SDuckStream& stream=iter->second;
+		PASinkInputInfo* sink_input=m_manager.SinkInput(iter->first);
+		if(!sink_input || stream.gain_db==0.0) continue;
+		if(!PAManager::volumeClose(sink_input->volume, stream.written)
+				&& !PAManager::volumeClose(sink_input->volume, stream.previous)) continue;
+		if(writes==0) m_manager.beginBatch();
+		m_manager.setSinkInputVolume(iter->first, stream.original);
+		++writes;
+	}
+	m_streams.clear();
+	
+	if(writes>0 && !m_manager.flush()) LOG(WARN, "not all ducked volumes were restored");
+}
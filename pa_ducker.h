@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_DUCKER_H_
+#define PA_DUCKER_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include <map>
+
+
+/* while a playback stream with one of the trigger roles exists, the
+ * streams with one of the target roles are lowered by duck_db. the roles
+ * are values of the media.role property, the target "*" matches every
+ * stream which is not a trigger */
+struct PADuckRule {
+	PADuckRule() : duck_db(-20.0) {}
+	
+	/* format: <triggers>:<targets>[:<dB>], eg. phone,event:music,video:-20 */
+	static PADuckRule parse(const string& str);
+	
+	vector<string> triggers;
+	vector<string> targets;
+	double duck_db;
+};
+
+/* the start of a ramp */
+struct PADuckChange {
+	uint32_t sink_input;
+	double gain_db; //target of the ramp, 0 if the stream is restored
+	uint64_t reaction_usec; //from the arrival of the event to the first write
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PADucker
+ * ducking of playback streams by their media.role. sync() is called from
+ * the subscription callback with PAManager::eventTime(): when a trigger stream appears, the target
+ * streams get a ramp down, when the last trigger of a rule is removed a
+ * ramp back to their volume. tick() writes the steps of the ramps (the
+ * first one at once), all writes of a step in a single batch.
+ * a volume changed by the user during the duck is not restored.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PADucker {
+public:
+	PADucker(PAManager& manager);
+	
+	PAManager& Manager() { return(m_manager); }
+	void addRule(const PADuckRule& rule) { m_rules.push_back(rule); }
+	/* duration of a ramp (0: jump) */
+	void setRamp(uint32_t ramp_ms) { m_ramp_usec = ramp_ms*1000; }
+	uint32_t stepMs() const { return(DUCK_STEP_USEC/1000); }
+	
+	/* follow new & removed sink inputs. event_time is the arrival of the
+	 * subscription event (PAManager::eventTime()), the ramps start there,
+	 * so the reaction includes the fetch of the new stream. 0 is now */
+	void sync(uint64_t event_time=0);
+	/* true while a ramp is running, tick() needs to be called every step */
+	bool ramping() const;
+	/* write the current step of the ramps. returns the number of writes,
+	 * the started ramps are appended to changes */
+	size_t tick(vector<PADuckChange>* changes=NULL);
+	/* restore the ducked streams at once */
+	void close();
+	
+	size_t count() const { return(m_streams.size()); }
+	
+private:
+	enum { DUCK_STEP_USEC=10000 };
+	
+	struct SDuckStream {
+		pa_cvolume original; //volume before the duck
+		pa_cvolume written; //last volume written by us
+		pa_cvolume previous; //the volume before, as long as the event of the write is pending
+		double gain_db; //of the last write
+		double from_db; //start of the ramp
+		double target_db;
+		uint64_t start; //time of the event which started the ramp
+		bool bReported;
+	};
+	
+	static bool matches(const vector<string>& roles, const string& role);
+	/* gain of a sink input with the active rules (0: not ducked) */
+	double duckGain(const PASinkInputInfo& sink_input, const vector<bool>& active) const;
+	static void duckedVolume(const SDuckStream& stream, pa_cvolume& volume);
+	
+	PAManager& m_manager;
+	vector<PADuckRule> m_rules;
+	map<uint32_t, SDuckStream> m_streams; //ducked streams, key is the sink input index
+	uint32_t m_ramp_usec;
+};
+
+
+#endif /* PA_DUCKER_H_ */
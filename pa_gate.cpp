@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_gate.h"
+#include "levels.h"
+#include <cmath>
+
+
+#define ENVELOPE_RELEASE_MS 50.0
+#define SETTLE_USEC 20000
+
+
+PAGateConfig::PAGateConfig() : open_db(-45.0), close_db(-51.0), hold_ms(1500), range_db(-40.0)
+	, fragment_usec(2000) {
+}
+
+PASourceGate::SGateOp::SGateOp(PAManager* op_manager, SGateSource* op_source, bool bOp_open)
+	: PAPendingOp(op_manager, PAOp_set_source_volume, op_source->index), source(op_source), bOpen(bOp_open)
+	, detected(op_source->detected) {
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PASourceGate
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PASourceGate::PASourceGate(PAManager& manager) : m_manager(manager)
+	, m_release((float)exp(-1000.0*(double)GATE_BLOCK/(double)GATE_RATE/ENVELOPE_RELEASE_MS)) {
+}
+
+PASourceGate::~PASourceGate() {
+	close();
+}
+
+void PASourceGate::setOpenVolume(SGateSource& source, const pa_cvolume& volume) {
+	source.open_volume=volume;
+	source.closed_volume=volume;
+	pa_volume_t range=pa_sw_volume_from_dB(m_config.range_db);
+	for(uint8_t i=0; i<volume.channels; ++i) source.closed_volume.values[i]=pa_sw_volume_multiply(volume.values[i], range);
+}
+
+bool PASourceGate::addSource(uint32_t idx) {
+	PABackend* backend=m_manager.Backend();
+	PADeviceInfo* device=m_manager.Source(idx);
+	if(!backend || !device) return(false);
+	
+	PARecordSpec spec;
+	spec.source=device->name;
+	spec.rate=GATE_RATE;
+	spec.channels=1;
+	spec.fragment_usec=m_config.fragment_usec;
+	
+	SGateSource* source=new SGateSource();
+	source->gate=this;
+	source->index=idx;
+	source->bEnded=false;
+	source->envelope=0.0f;
+	source->last_active=getTimeUsec();
+	source->bOpen=true;
+	source->bWant_open=true;
+	source->detected=0;
+	source->settle_until=0;
+	source->bIn_flight=false;
+	setOpenVolume(*source, device->volume);
+	source->id=backend->openRecordStream(spec, recordCb, source);
+	if(source->id==0) {
+		LOG(WARN, "failed to open a record stream on %s", device->name.c_str());
+		delete(source);
+		return(false);
+	}
+	m_sources.push_back(source);
+	return(true);
+}
+
+void PASourceGate::close() {
+	if(m_sources.empty()) return;
+	PABackend* backend=m_manager.Backend();
+	
+	/* open the gates and wait for the writes in flight, their replies
+	 * point to the sources */
+	for(size_t i=0; i<m_sources.size(); ++i) {
+		m_sources[i]->bWant_open=true;
+		m_sources[i]->detected=getTimeUsec();
+		issue(*m_sources[i]);
+	}
+	uint64_t end=getTimeUsec()+1000000;
+	bool bIn_flight=true;
+	while(bIn_flight && backend && backend->state()==PABackend_ready && getTimeUsec()<end) {
+		bIn_flight=false;
+		for(size_t i=0; i<m_sources.size(); ++i) bIn_flight=bIn_flight || m_sources[i]->bIn_flight;
+		if(bIn_flight) m_manager.iterate(10);
+	}
+	
+	for(size_t i=0; i<m_sources.size(); ++i) {
+		if(backend && !m_sources[i]->bEnded) backend->closeStream(m_sources[i]->id);
+		/* without a reply the source must stay valid, the late reply is ignored */
+		if(m_sources[i]->bIn_flight) {
+			LOG(WARN, "no reply for the gate of source %u", m_sources[i]->index);
+			m_sources[i]->gate=NULL;
+		} else {
+			delete(m_sources[i]);
+		}
+	}
+	m_sources.clear();
+}
+
+bool PASourceGate::active() const {
+	for(size_t i=0; i<m_sources.size(); ++i) {
+		if(!m_sources[i]->bEnded) return(true);
+	}
+	return(false);
+}
+
+void PASourceGate::sync() {
+	for(size_t i=0; i<m_sources.size(); ++i) {
+		SGateSource& source=*m_sources[i];
+		PADeviceInfo* device=m_manager.Source(source.index);
+		if(!device || source.bIn_flight) continue;
+		/* our writes (or the event of an earlier one) */
+		if(PAManager::volumeClose(device->volume, source.open_volume)
+				|| PAManager::volumeClose(device->volume, source.closed_volume)) continue;
+		LOG(DEBUG, "volume of source %u changed by the user, it's the new open volume", source.index);
+		setOpenVolume(source, device->volume);
+		source.bOpen=true;
+		source.bWant_open=true;
+		source.last_active=getTimeUsec();
+	}
+}
+
+void PASourceGate::recordCb(const float* samples, size_t frames, void* userdata) {
+	SGateSource* source=(SGateSource*)userdata;
+	if(!samples) {
+		source->bEnded=true;
+		return;
+	}
+	PASourceGate* gate=source->gate;
+	const PAGateConfig& config=gate->m_config;
+	
+	float peak=followEnvelope(samples, frames, GATE_BLOCK, gate->m_release, source->envelope);
+	double level_db=levelToDb(peak)-(source->bOpen ? 0.0 : config.range_db);
+	uint64_t now=getTimeUsec();
+	if(level_db>=config.close_db) source->last_active=now;
+	
+	bool bWant_open=source->bWant_open;
+	if(!bWant_open && level_db>=config.open_db && now>=source->settle_until) bWant_open=true;
+	else if(bWant_open && now-source->last_active>config.hold_ms*1000ULL) bWant_open=false;
+	if(bWant_open!=source->bWant_open) {
+		source->bWant_open=bWant_open;
+		source->detected=now;
+	}
+	gate->issue(*source);
+}
+
+void PASourceGate::issue(SGateSource& source) {
+	if(source.bIn_flight || source.bEnded || source.bWant_open==source.bOpen) return;
+	PABackend* backend=m_manager.Backend();
+	if(!backend) return;
+	
+	SGateOp* op=new SGateOp(&m_manager, &source, source.bWant_open);
+	op->done=opDone;
+	if(!backend->setSourceVolume(source.index, source.bWant_open ? source.open_volume : source.closed_volume
+			, pa_success_cb, op)) {
+		LOG(ERROR, "failed to set the volume of source %u", source.index);
+		delete(op);
+		return;
+	}
+	source.bIn_flight=true;
+}
+
+void PASourceGate::opDone(PAPendingOp* op) {
+	SGateOp* gate_op=static_cast<SGateOp*>(op);
+	SGateSource* source=gate_op->source;
+	PASourceGate* gate=source->gate;
+	source->bIn_flight=false;
+	if(!gate) {
+		/* close() left the source to this late reply */
+		delete(source);
+		delete(gate_op);
+		return;
+	}
+	
+	if(op->ready==1) {
+		source->bOpen=gate_op->bOpen;
+		/* the envelope continues at the new volume */
+		float range=(float)pow(10.0, gate->m_config.range_db/20.0);
+		if(source->bOpen) {
+			source->envelope/=range;
+		} else {
+			source->envelope*=range;
+			source->settle_until=getTimeUsec()+SETTLE_USEC;
+		}
+		PAGateEvent event;
+		event.source=source->index;
+		event.bOpen=gate_op->bOpen;
+		event.latency_usec=getTimeUsec()-gate_op->detected;
+		(event.bOpen ? gate->m_open_latency : gate->m_close_latency).record(event.latency_usec);
+		gate->m_events.push_back(event);
+	} else {
+		LOG(WARN, "failed to %s the gate of source %u", gate_op->bOpen ? "open" : "close", source->index);
+		source->bWant_open=source->bOpen; //until the next detection
+	}
+	delete(gate_op);
+	
+	/* the wanted state changed meanwhile */
+	gate->issue(*source);
+}
+
+void PASourceGate::takeEvents(vector<PAGateEvent>& events) {
+	events.insert(events.end(), m_events.begin(), m_events.end());
+	m_events.clear();
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_GATE_H_
+#define PA_GATE_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include "latency_histogram.h"
+
+
+/* thresholds of the noise gate */
+struct PAGateConfig {
+	PAGateConfig();
+	
+	double open_db; //envelope in dBFS (at the open volume) which opens the gate
+	double close_db; //the gate closes if the envelope stays below this for hold_ms
+	uint32_t hold_ms;
+	double range_db; //attenuation of a closed gate
+	uint32_t fragment_usec; //of the record streams, bounds the detection delay
+};
+
+/* a completed transition of a gate */
+struct PAGateEvent {
+	uint32_t source;
+	bool bOpen;
+	uint64_t latency_usec; //from the detection to the reply of the server
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PASourceGate
+ * noise gate of sources: every source is recorded mono in small fragments
+ * and a peak envelope follower (followEnvelope) runs on every fragment,
+ * in the record callback. the gate opens as soon as the envelope passes
+ * open_db and closes when it stayed below close_db for hold_ms.
+ *
+ * a closed gate lowers the volume of the source by range_db instead of
+ * muting it: a muted source delivers silence to every stream including
+ * ours, so the onset of speech could not be detected anymore. the
+ * envelope of a closed gate is corrected by the range; right after closing
+ * the fragments recorded before the write still have the open level, so
+ * the gate does not reopen during a short settle time.
+ *
+ * the volume writes are issued from the callback without waiting and at
+ * most one per source is in flight; a state which changed meanwhile is
+ * written when the reply arrives.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PASourceGate {
+public:
+	PASourceGate(PAManager& manager);
+	~PASourceGate();
+	
+	void setConfig(const PAGateConfig& config) { m_config = config; }
+	
+	/* the gate starts open. returns false if the source does not exist or
+	 * could not be recorded */
+	bool addSource(uint32_t idx);
+	/* open the closed gates & stop */
+	void close();
+	
+	size_t count() const { return(m_sources.size()); }
+	/* a source was not removed yet */
+	bool active() const;
+	
+	/* take a volume changed by the user as the open volume. call it after
+	 * the sources changed, eg. from the subscription callback */
+	void sync();
+	
+	/* the transitions since the last call */
+	void takeEvents(vector<PAGateEvent>& events);
+	const CLatencyHistogram& openLatency() const { return(m_open_latency); }
+	const CLatencyHistogram& closeLatency() const { return(m_close_latency); }
+	
+private:
+	enum { GATE_RATE=16000, GATE_BLOCK=16 }; //the envelope has 1ms steps
+	
+	struct SGateSource {
+		PASourceGate* gate;
+		uint32_t id;
+		uint32_t index;
+		bool bEnded;
+		
+		float envelope;
+		uint64_t last_active; //the envelope was above close_db
+		bool bOpen; //as applied by the server
+		bool bWant_open;
+		uint64_t detected; //time bWant_open changed
+		uint64_t settle_until; //no reopening before (just closed)
+		bool bIn_flight;
+		
+		pa_cvolume open_volume;
+		pa_cvolume closed_volume;
+	};
+	
+	/* the volume write of a transition */
+	struct SGateOp : public PAPendingOp {
+		SGateOp(PAManager* op_manager, SGateSource* op_source, bool bOp_open);
+		
+		SGateSource* source;
+		bool bOpen;
+		uint64_t detected;
+	};
+	
+	static void recordCb(const float* samples, size_t frames, void* userdata);
+	/* write the wanted state if it differs & nothing is in flight */
+	void issue(SGateSource& source);
+	static void opDone(PAPendingOp* op);
+	void setOpenVolume(SGateSource& source, const pa_cvolume& volume);
+	
+	PAManager& m_manager;
+	PAGateConfig m_config;
+	float m_release; //of the envelope per block
+	vector<SGateSource*> m_sources;
+	
+	vector<PAGateEvent> m_events;
+	CLatencyHistogram m_open_latency;
+	CLatencyHistogram m_close_latency;
+};
+
+
+#endif /* PA_GATE_H_ */
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_info_store.h"
+
+
+/* NULL strings are stored as "" and restored as NULL */
+static string copyStr(const char* str) {
+	return(str ? string(str) : string());
+}
+
+static const char* ownedStr(const char* orig, const string& copy) {
+	return(orig ? copy.c_str() : NULL);
+}
+
+static pa_proplist* copyProplist(const pa_proplist* p) {
+	return(p ? pa_proplist_copy(p) : NULL);
+}
+
+
+PAStoredSink::PAStoredSink(const pa_sink_info& sink_info) : info(sink_info)
+	, name(copyStr(sink_info.name)), description(copyStr(sink_info.description))
+	, monitor_source_name(copyStr(sink_info.monitor_source_name)), driver(copyStr(sink_info.driver)) {
+
+	info.name = ownedStr(sink_info.name, name);
+	info.description = ownedStr(sink_info.description, description);
+	info.monitor_source_name = ownedStr(sink_info.monitor_source_name, monitor_source_name);
+	info.driver = ownedStr(sink_info.driver, driver);
+	info.proplist = copyProplist(sink_info.proplist);
+	info.n_ports = 0;
+	info.ports = NULL;
+	info.active_port = NULL;
+	info.n_formats = 0;
+	info.formats = NULL;
+}
+
+PAStoredSink::~PAStoredSink() {
+	if(info.proplist) pa_proplist_free(info.proplist);
+}
+
+PAStoredSource::PAStoredSource(const pa_source_info& source_info) : info(source_info)
+	, name(copyStr(source_info.name)), description(copyStr(source_info.description))
+	, monitor_of_sink_name(copyStr(source_info.monitor_of_sink_name)), driver(copyStr(source_info.driver)) {
+
+	info.name = ownedStr(source_info.name, name);
+	info.description = ownedStr(source_info.description, description);
+	info.monitor_of_sink_name = ownedStr(source_info.monitor_of_sink_name, monitor_of_sink_name);
+	info.driver = ownedStr(source_info.driver, driver);
+	info.proplist = copyProplist(source_info.proplist);
+	info.n_ports = 0;
+	info.ports = NULL;
+	info.active_port = NULL;
+	info.n_formats = 0;
+	info.formats = NULL;
+}
+
+PAStoredSource::~PAStoredSource() {
+	if(info.proplist) pa_proplist_free(info.proplist);
+}
+
+PAStoredClient::PAStoredClient(const pa_client_info& client_info) : info(client_info)
+	, name(copyStr(client_info.name)), driver(copyStr(client_info.driver)) {
+
+	info.name = ownedStr(client_info.name, name);
+	info.driver = ownedStr(client_info.driver, driver);
+	info.proplist = copyProplist(client_info.proplist);
+}
+
+PAStoredClient::~PAStoredClient() {
+	if(info.proplist) pa_proplist_free(info.proplist);
+}
+
+PAStoredSinkInput::PAStoredSinkInput(const pa_sink_input_info& sink_input_info) : info(sink_input_info)
+	, name(copyStr(sink_input_info.name)), resample_method(copyStr(sink_input_info.resample_method))
+	, driver(copyStr(sink_input_info.driver)) {
+
+	info.name = ownedStr(sink_input_info.name, name);
+	info.resample_method = ownedStr(sink_input_info.resample_method, resample_method);
+	info.driver = ownedStr(sink_input_info.driver, driver);
+	info.proplist = copyProplist(sink_input_info.proplist);
+	info.format = NULL;
+}
+
+PAStoredSinkInput::~PAStoredSinkInput() {
+	if(info.proplist) pa_proplist_free(info.proplist);
+}
+
+PAStoredCard::PAStoredCard(const pa_card_info& card_info) : info(card_info)
+	, name(copyStr(card_info.name)), driver(copyStr(card_info.driver)) {
+
+	info.name = ownedStr(card_info.name, name);
+	info.driver = ownedStr(card_info.driver, driver);
+	info.proplist = copyProplist(card_info.proplist);
+	info.n_ports = 0;
+	info.ports = NULL;
+	info.profiles2 = NULL;
+	info.active_profile2 = NULL;
+
+	/* strings first, the vectors must not reallocate afterwards */
+	profile_names.reserve(card_info.n_profiles);
+	profile_descriptions.reserve(card_info.n_profiles);
+	profiles.reserve(card_info.n_profiles);
+	int active = -1;
+	for(uint32_t i=0; i<card_info.n_profiles; ++i) {
+		const pa_card_profile_info& profile = card_info.profiles[i];
+		if(card_info.active_profile == card_info.profiles+i) active = (int)i;
+		profile_names.push_back(copyStr(profile.name));
+		profile_descriptions.push_back(copyStr(profile.description));
+	}
+	for(uint32_t i=0; i<card_info.n_profiles; ++i) {
+		pa_card_profile_info profile = card_info.profiles[i];
+		profile.name = profile_names[i].c_str();
+		profile.description = profile_descriptions[i].c_str();
+		profiles.push_back(profile);
+	}
+	info.profiles = profiles.empty() ? NULL : &profiles[0];
+	info.active_profile = active >= 0 ? &profiles[active] : NULL;
+}
+
+PAStoredCard::~PAStoredCard() {
+	if(info.proplist) pa_proplist_free(info.proplist);
+}
+
+bool PAStoredCard::setActiveProfile(const string& profile_name) {
+	for(size_t i=0; i<profiles.size(); ++i) {
+		if(profile_names[i] == profile_name) {
+			info.active_profile = &profiles[i];
+			return(true);
+		}
+	}
+	return(false);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAInfoStore
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<class Entry, class Info>
+static void addEntry(map<uint32_t, Entry*>& entries, const Info& info) {
+	/* info may point into the entry it replaces, so copy first */
+	Entry* entry = new Entry(info);
+	typename map<uint32_t, Entry*>::iterator iter = entries.find(info.index);
+	if(iter != entries.end()) {
+		delete(iter->second);
+		iter->second = entry;
+	} else {
+		entries[info.index] = entry;
+	}
+}
+
+template<class Entry>
+static bool removeEntry(map<uint32_t, Entry*>& entries, uint32_t idx) {
+	typename map<uint32_t, Entry*>::iterator iter = entries.find(idx);
+	if(iter == entries.end()) return(false);
+	delete(iter->second);
+	entries.erase(iter);
+	return(true);
+}
+
+template<class Entry>
+static Entry* findEntry(map<uint32_t, Entry*>& entries, uint32_t idx) {
+	typename map<uint32_t, Entry*>::iterator iter = entries.find(idx);
+	if(iter == entries.end()) return(NULL);
+	return(iter->second);
+}
+
+template<class Entry>
+static void clearEntries(map<uint32_t, Entry*>& entries) {
+	for(typename map<uint32_t, Entry*>::iterator iter=entries.begin(); iter!=entries.end(); ++iter) {
+		delete(iter->second);
+	}
+	entries.clear();
+}
+
+
+PAInfoStore::PAInfoStore() {
+}
+
+PAInfoStore::~PAInfoStore() {
+	clear();
+}
+
+void PAInfoStore::addSink(const pa_sink_info& info) { addEntry(m_sinks, info); }
+void PAInfoStore::addSource(const pa_source_info& info) { addEntry(m_sources, info); }
+void PAInfoStore::addClient(const pa_client_info& info) { addEntry(m_clients, info); }
+void PAInfoStore::addSinkInput(const pa_sink_input_info& info) { addEntry(m_sink_inputs, info); }
+void PAInfoStore::addCard(const pa_card_info& info) { addEntry(m_cards, info); }
+
+bool PAInfoStore::removeSink(uint32_t idx) { return(removeEntry(m_sinks, idx)); }
+bool PAInfoStore::removeSource(uint32_t idx) { return(removeEntry(m_sources, idx)); }
+bool PAInfoStore::removeClient(uint32_t idx) { return(removeEntry(m_clients, idx)); }
+bool PAInfoStore::removeSinkInput(uint32_t idx) { return(removeEntry(m_sink_inputs, idx)); }
+bool PAInfoStore::removeCard(uint32_t idx) { return(removeEntry(m_cards, idx)); }
+
+PAStoredSink* PAInfoStore::Sink(uint32_t idx) { return(findEntry(m_sinks, idx)); }
+PAStoredSource* PAInfoStore::Source(uint32_t idx) { return(findEntry(m_sources, idx)); }
+PAStoredClient* PAInfoStore::Client(uint32_t idx) { return(findEntry(m_clients, idx)); }
+PAStoredSinkInput* PAInfoStore::SinkInput(uint32_t idx) { return(findEntry(m_sink_inputs, idx)); }
+PAStoredCard* PAInfoStore::Card(uint32_t idx) { return(findEntry(m_cards, idx)); }
+
+void PAInfoStore::clear() {
+	clearEntries(m_sinks);
+	clearEntries(m_sources);
+	clearEntries(m_clients);
+	clearEntries(m_sink_inputs);
+	clearEntries(m_cards);
+}
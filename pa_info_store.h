@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_INFO_STORE_H_
+#define PA_INFO_STORE_H_
+
+#include "global.h"
+#include <map>
+#include <pulse/pulseaudio.h>
+
+
+/* owned copies of the libpulse info structs. the string pointers of info
+ * point into the entry, so an entry must not be copied */
+
+struct PAStoredSink {
+	PAStoredSink(const pa_sink_info& sink_info);
+	~PAStoredSink();
+
+	pa_sink_info info;
+	string name, description, monitor_source_name, driver;
+};
+
+struct PAStoredSource {
+	PAStoredSource(const pa_source_info& source_info);
+	~PAStoredSource();
+
+	pa_source_info info;
+	string name, description, monitor_of_sink_name, driver;
+};
+
+struct PAStoredClient {
+	PAStoredClient(const pa_client_info& client_info);
+	~PAStoredClient();
+
+	pa_client_info info;
+	string name, driver;
+};
+
+struct PAStoredSinkInput {
+	PAStoredSinkInput(const pa_sink_input_info& sink_input_info);
+	~PAStoredSinkInput();
+
+	pa_sink_input_info info;
+	string name, resample_method, driver;
+};
+
+struct PAStoredCard {
+	PAStoredCard(const pa_card_info& card_info);
+	~PAStoredCard();
+
+	/* sets info.active_profile, returns false if there is no such profile */
+	bool setActiveProfile(const string& profile_name);
+
+	pa_card_info info;
+	string name, driver;
+	vector<pa_card_profile_info> profiles;
+	vector<string> profile_names, profile_descriptions;
+};
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAInfoStore
+ * container of owned info structs, indexed by object index
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAInfoStore {
+public:
+	typedef map<uint32_t, PAStoredSink*> sink_map;
+	typedef map<uint32_t, PAStoredSource*> source_map;
+	typedef map<uint32_t, PAStoredClient*> client_map;
+	typedef map<uint32_t, PAStoredSinkInput*> sink_input_map;
+	typedef map<uint32_t, PAStoredCard*> card_map;
+
+	PAInfoStore();
+	~PAInfoStore();
+
+	/* add a copy, an existing object with the same index is replaced */
+	void addSink(const pa_sink_info& info);
+	void addSource(const pa_source_info& info);
+	void addClient(const pa_client_info& info);
+	void addSinkInput(const pa_sink_input_info& info);
+	void addCard(const pa_card_info& info);
+
+	/* return false if not found */
+	bool removeSink(uint32_t idx);
+	bool removeSource(uint32_t idx);
+	bool removeClient(uint32_t idx);
+	bool removeSinkInput(uint32_t idx);
+	bool removeCard(uint32_t idx);
+
+	/* return NULL if not found */
+	PAStoredSink* Sink(uint32_t idx);
+	PAStoredSource* Source(uint32_t idx);
+	PAStoredClient* Client(uint32_t idx);
+	PAStoredSinkInput* SinkInput(uint32_t idx);
+	PAStoredCard* Card(uint32_t idx);
+
+	const sink_map& Sinks() const { return(m_sinks); }
+	const source_map& Sources() const { return(m_sources); }
+	const client_map& Clients() const { return(m_clients); }
+	const sink_input_map& SinkInputs() const { return(m_sink_inputs); }
+	const card_map& Cards() const { return(m_cards); }
+
+	void clear();
+
+private:
+	sink_map m_sinks;
+	source_map m_sources;
+	client_map m_clients;
+	sink_input_map m_sink_inputs;
+	card_map m_cards;
+};
+
+
+#endif /* PA_INFO_STORE_H_ */
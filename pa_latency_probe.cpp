@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+
+#include "pa_latency_probe.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+PALatencyConfig::PALatencyConfig() : rate(48000), latency_usec(50000), chirp_ms(50), count(5)
+	, interval_ms(500), warmup_ms(300), fragment_usec(5000), min_match(0.3) {
+}
+
+PALatencyResult::PALatencyResult() : sink_input(PA_INVALID_INDEX), latency(0), configured_latency(0)
+	, buffer_usec(0), sink_usec(0), bReported(false) {
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PALatencyProbe
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PALatencyProbe::PALatencyProbe(PAManager& manager) : m_manager(manager), m_sink(PA_INVALID_INDEX)
+	, m_playback_id(0), m_record_id(0), m_bEnded(false), m_played(0), m_next(0), m_chirp_pos(0)
+	, m_result(NULL), m_pending(0) {
+}
+
+PALatencyProbe::~PALatencyProbe() {
+	close();
+}
+
+bool PALatencyProbe::open(uint32_t sink_idx) {
+	PABackend* backend=m_manager.Backend();
+	PADeviceInfo* sink=m_manager.Sink(sink_idx);
+	if(!backend || !sink || m_playback_id!=0 || m_record_id!=0) return(false);
+	if(m_config.interval_ms<=m_config.chirp_ms || m_config.count==0) return(false);
+	
+	/* linear sweep from 200Hz to 1/3 of the rate, the ends faded with 5ms
+	 * of a raised cosine. its autocorrelation is a narrow peak */
+	size_t size=(size_t)m_config.rate*m_config.chirp_ms/1000;
+	size_t fade=min((size_t)m_config.rate*5/1000, size/2);
+	double duration=(double)size/m_config.rate;
+	double f0=200.0, f1=m_config.rate/3.0;
+	m_chirp.resize(size);
+	for(size_t i=0; i<size; ++i) {
+		double t=(double)i/m_config.rate;
+		double value=0.5*sin(2.0*M_PI*(f0*t + 0.5*(f1-f0)/duration*t*t));
+		if(i<fade) value*=0.5 - 0.5*cos(M_PI*i/fade);
+		else if(i>=size-fade) value*=0.5 - 0.5*cos(M_PI*(size-1-i)/fade);
+		m_chirp[i]=(float)value;
+	}
+	m_correlation.init(&m_chirp[0], size);
+	
+	/* everything is allocated here, not in the callbacks */
+	uint64_t total_ms=m_config.warmup_ms + (uint64_t)(m_config.count+1)*m_config.interval_ms
+		+ m_config.latency_usec/1000 + 1000;
+	m_recording.clear();
+	m_recording.reserve((size_t)(total_ms*m_config.rate/1000));
+	m_fragments.clear();
+	m_fragments.reserve((size_t)(total_ms*1000/m_config.fragment_usec) + 16);
+	m_written.clear();
+	m_written.reserve(m_config.count);
+	m_played=0;
+	m_next=0;
+	m_chirp_pos=size;
+	m_bEnded=false;
+	m_sink=sink_idx;
+	
+	/* the monitor has to run before the first chirp */
+	PARecordSpec record;
+	record.source=sink->monitor_name;
+	record.rate=m_config.rate;
+	record.channels=1;
+	record.fragment_usec=m_config.fragment_usec;
+	m_record_id=backend->openRecordStream(record, recordCb, this);
+	if(m_record_id==0) {
+		LOG(WARN, "failed to open a record stream on %s", sink->monitor_name.c_str());
+		return(false);
+	}
+	
+	PAPlaybackSpec playback;
+	playback.sink=sink->name;
+	playback.rate=m_config.rate;
+	playback.channels=1;
+	playback.latency_usec=m_config.latency_usec;
+	m_playback_id=backend->openPlaybackStream(playback, playbackCb, this);
+	if(m_playback_id==0) {
+		LOG(WARN, "failed to open a playback stream on %s", sink->name.c_str());
+		close();
+		return(false);
+	}
+	return(true);
+}
+
+void PALatencyProbe::close() {
+	PABackend* backend=m_manager.Backend();
+	if(backend && !m_bEnded) {
+		if(m_playback_id!=0) backend->closeStream(m_playback_id);
+		if(m_record_id!=0) backend->closeStream(m_record_id);
+	}
+	m_playback_id=m_record_id=0;
+}
+
+bool PALatencyProbe::done() const {
+	if(m_bEnded) return(true);
+	if(m_next<m_config.count || m_fragments.empty()) return(false);
+	return(m_fragments.back().time >= m_written.back() + m_config.interval_ms*1000ULL);
+}
+
+void PALatencyProbe::playbackCb(float* samples, size_t frames, void* userdata) {
+	PALatencyProbe* probe=(PALatencyProbe*)userdata;
+	if(!samples) {
+		probe->m_bEnded=true;
+		return;
+	}
+	
+	/* a chirp starts with a request, never in the middle of one */
+	uint64_t start=(uint64_t)probe->m_config.rate*(probe->m_config.warmup_ms
+		+ (uint64_t)probe->m_next*probe->m_config.interval_ms)/1000;
+	if(probe->m_chirp_pos>=probe->m_chirp.size() && probe->m_next<probe->m_config.count && probe->m_played>=start) {
+		probe->m_chirp_pos=0;
+		probe->m_written.push_back(getTimeUsec());
+		++probe->m_next;
+	}
+	
+	for(size_t i=0; i<frames; ++i) {
+		samples[i]=probe->m_chirp_pos<probe->m_chirp.size() ? probe->m_chirp[probe->m_chirp_pos++] : 0.0f;
+	}
+	probe->m_played+=frames;
+}
+
+void PALatencyProbe::recordCb(const float* samples, size_t frames, void* userdata) {
+	PALatencyProbe* probe=(PALatencyProbe*)userdata;
+	if(!samples) {
+		probe->m_bEnded=true;
+		return;
+	}
+	if(probe->done() || probe->m_recording.size()+frames > probe->m_recording.capacity()) return;
+	
+	probe->m_recording.insert(probe->m_recording.end(), samples, samples+frames);
+	SFragment fragment;
+	fragment.end=probe->m_recording.size();
+	fragment.time=getTimeUsec();
+	probe->m_fragments.push_back(fragment);
+}
+
+double PALatencyProbe::frameTime(double frame) const {
+	/* the last frame of a fragment was received with it */
+	size_t i=0;
+	while(i+1<m_fragments.size() && m_fragments[i].end<=frame) ++i;
+	return((double)m_fragments[i].time - ((double)m_fragments[i].end - 1.0 - frame)*1000000.0/m_config.rate);
+}
+
+uint64_t PALatencyProbe::frameAt(uint64_t time) const {
+	for(size_t i=0; i<m_fragments.size(); ++i) {
+		if(m_fragments[i].time<time) continue;
+		uint64_t begin=i>0 ? m_fragments[i-1].end : 0;
+		uint64_t back=(m_fragments[i].time-time)*m_config.rate/1000000;
+		if(back+1>=m_fragments[i].end-begin) return(begin);
+		return(m_fragments[i].end-1-back);
+	}
+	return(m_recording.size());
+}
+
+void PALatencyProbe::measure(PALatencyResult& result, int timeout_ms) {
+	result=PALatencyResult();
+	for(size_t j=0; j<m_written.size(); ++j) {
+		uint64_t from=frameAt(m_written[j]);
+		uint64_t to=frameAt(m_written[j] + m_config.interval_ms*1000ULL);
+		double lag=0.0;
+		double match=to>from ? m_correlation.find(&m_recording[from], (size_t)(to-from), lag) : 0.0;
+		result.match.push_back(match);
+		result.delay_usec.push_back(match>=m_config.min_match ? frameTime((double)from+lag) - (double)m_written[j] : -1.0);
+	}
+	
+	/* the reported latencies while the probe stream still plays */
+	PABackend* backend=m_manager.Backend();
+	if(!backend || m_bEnded) return;
+	result.sink_input=backend->streamIndex(m_playback_id);
+	if(result.sink_input==PA_INVALID_INDEX) return;
+	m_result=&result;
+	m_pending=0;
+	if(backend->getSinkInfo(m_sink, sinkInfoCb, this)) ++m_pending;
+	if(backend->getSinkInputInfo(result.sink_input, sinkInputInfoCb, this)) ++m_pending;
+	uint64_t end=getTimeUsec() + timeout_ms*1000ULL;
+	while(m_pending>0 && getTimeUsec()<end) m_manager.iterate(10);
+	if(m_pending>0) LOG(WARN, "the server did not report the latencies within %ims", timeout_ms);
+	result.bReported=m_pending==0;
+	m_result=NULL;
+}
+
+void PALatencyProbe::sinkInfoCb(const pa_sink_info* info, int eol, void* userdata) {
+	PALatencyProbe* probe=(PALatencyProbe*)userdata;
+	if(!probe->m_result) return;
+	if(info && eol==0) {
+		probe->m_result->latency=info->latency;
+		probe->m_result->configured_latency=info->configured_latency;
+	}
+	if(eol!=0) --probe->m_pending;
+}
+
+void PALatencyProbe::sinkInputInfoCb(const pa_sink_input_info* info, int eol, void* userdata) {
+	PALatencyProbe* probe=(PALatencyProbe*)userdata;
+	if(!probe->m_result) return;
+	if(info && eol==0) {
+		probe->m_result->buffer_usec=info->buffer_usec;
+		probe->m_result->sink_usec=info->sink_usec;
+	}
+	if(eol!=0) --probe->m_pending;
+}
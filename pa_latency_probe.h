@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+
+#ifndef PA_LATENCY_PROBE_H_
+#define PA_LATENCY_PROBE_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include "correlation.h"
+
+
+struct PALatencyConfig {
+	PALatencyConfig();
+	
+	uint32_t rate;
+	uint32_t latency_usec; //requested buffer of the playback stream
+	uint32_t chirp_ms;
+	uint32_t count; //of chirps
+	uint32_t interval_ms; //between the chirps, also the longest delay found
+	uint32_t warmup_ms; //silence before the first chirp, until the buffer is filled
+	uint32_t fragment_usec; //of the monitor stream
+	double min_match; //normalized correlation below which a chirp counts as lost
+};
+
+struct PALatencyResult {
+	PALatencyResult();
+	
+	uint32_t sink_input; //of the probe stream
+	vector<double> delay_usec; //per chirp, negative if it was not found
+	vector<double> match; //normalized correlation per chirp
+	/* reported by the server at the end of the measurement: the sink and
+	 * the sink input of the probe stream */
+	pa_usec_t latency;
+	pa_usec_t configured_latency;
+	pa_usec_t buffer_usec;
+	pa_usec_t sink_usec;
+	bool bReported; //the values above were received
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PALatencyProbe
+ * measures the output latency of a sink end-to-end: a playback stream
+ * plays chirps into the sink while its monitor source is recorded. the
+ * time from writing the first sample of a chirp until it's recorded is
+ * found by cross-correlation (CCrossCorrelation) and compared with the
+ * latencies reported by the server. the chirps always start at the
+ * beginning of a request of the server, so the delay is that of the
+ * first sample of a write. the delay includes the record fragment of the
+ * monitor.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PALatencyProbe {
+public:
+	PALatencyProbe(PAManager& manager);
+	~PALatencyProbe();
+	
+	/* before open */
+	void setConfig(const PALatencyConfig& config) { m_config=config; }
+	
+	/* start recording the monitor & playing the chirps. returns false if
+	 * the sink does not exist or a stream could not be opened */
+	bool open(uint32_t sink_idx);
+	void close();
+	
+	/* all chirps were played & recorded, or a stream ended */
+	bool done() const;
+	bool failed() const { return(m_bEnded); }
+	
+	/* after done(): find the chirps in the recording and get the reported
+	 * latencies (waits at most timeout_ms for the server) */
+	void measure(PALatencyResult& result, int timeout_ms=2000);
+	
+private:
+	struct SFragment {
+		uint64_t end; //frame after the fragment
+		uint64_t time; //when it was received
+	};
+	
+	static void playbackCb(float* samples, size_t frames, void* userdata);
+	static void recordCb(const float* samples, size_t frames, void* userdata);
+	static void sinkInfoCb(const pa_sink_info* info, int eol, void* userdata);
+	static void sinkInputInfoCb(const pa_sink_input_info* info, int eol, void* userdata);
+	
+	/* receive time of a recorded frame, resp. the first frame received at
+	 * or after time */
+	double frameTime(double frame) const;
+	uint64_t frameAt(uint64_t time) const;
+	
+	PAManager& m_manager;
+	PALatencyConfig m_config;
+	uint32_t m_sink;
+	uint32_t m_playback_id; //0 if not open
+	uint32_t m_record_id;
+	bool m_bEnded;
+	
+	vector<float> m_chirp;
+	CCrossCorrelation m_correlation;
+	uint64_t m_played; //frames
+	uint32_t m_next; //chirp to be written next
+	size_t m_chirp_pos; //in the current chirp, m_chirp.size() if none is playing
+	vector<uint64_t> m_written; //time of the first sample per chirp
+	
+	vector<float> m_recording;
+	vector<SFragment> m_fragments;
+	
+	PALatencyResult* m_result; //while measure() waits for the server
+	int m_pending;
+};
+
+
+#endif /* PA_LATENCY_PROBE_H_ */
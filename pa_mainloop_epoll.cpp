@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_mainloop_epoll.h"
+
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+
+/* the event structs are opaque to libpulse, the mainloop implementation defines them */
+
+struct pa_io_event : public SEpollEntry {
+	pa_io_event() : SEpollEntry(Epoll_io) {}
+
+	PAEpollMainloop* loop;
+	int fd;
+	pa_io_event_cb_t cb;
+	pa_io_event_destroy_cb_t destroy;
+	void* userdata;
+};
+
+struct pa_time_event : public SEpollEntry {
+	pa_time_event() : SEpollEntry(Epoll_time) {}
+
+	PAEpollMainloop* loop;
+	int timer_fd;
+	bool bEnabled;
+	struct timeval tv; //deadline passed to the callback
+	pa_time_event_cb_t cb;
+	pa_time_event_destroy_cb_t destroy;
+	void* userdata;
+};
+
+struct pa_defer_event : public SEpollEntry {
+	pa_defer_event() : SEpollEntry(Epoll_defer) {}
+
+	PAEpollMainloop* loop;
+	bool bEnabled;
+	pa_defer_event_cb_t cb;
+	pa_defer_event_destroy_cb_t destroy;
+	void* userdata;
+};
+
+#define MAX_EPOLL_EVENTS 32
+
+static uint32_t toEpoll(pa_io_event_flags_t events) {
+	uint32_t ret = 0;
+	if(events & PA_IO_EVENT_INPUT) ret |= EPOLLIN;
+	if(events & PA_IO_EVENT_OUTPUT) ret |= EPOLLOUT;
+	// EPOLLHUP and EPOLLERR are always reported
+	return(ret);
+}
+
+static pa_io_event_flags_t fromEpoll(uint32_t events) {
+	int ret = PA_IO_EVENT_NULL;
+	if(events & EPOLLIN) ret |= PA_IO_EVENT_INPUT;
+	if(events & EPOLLOUT) ret |= PA_IO_EVENT_OUTPUT;
+	if(events & EPOLLHUP) ret |= PA_IO_EVENT_HANGUP;
+	if(events & EPOLLERR) ret |= PA_IO_EVENT_ERROR;
+	return((pa_io_event_flags_t)ret);
+}
+
+/* libpulse passes absolute wall clock deadlines to foreign mainloops */
+static void armTimer(int timer_fd, const struct timeval* tv) {
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	if(tv) {
+		spec.it_value.tv_sec = tv->tv_sec;
+		spec.it_value.tv_nsec = (long)tv->tv_usec*1000;
+		// a zero deadline would disarm the timer
+		if(spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+	}
+	if(timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+		LOG(ERROR, "timerfd_settime failed: %s", strerror(errno));
+	}
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAEpollMainloop
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAEpollMainloop::PAEpollMainloop() : m_epoll_fd(-1), m_defer_fd(-1), m_bDefer_signaled(false)
+	, m_enabled_defers(0), m_bHas_dead(false), m_bQuit(false), m_quit_retval(0) {
+
+	ASSERT_THROW_e((m_epoll_fd = epoll_create1(EPOLL_CLOEXEC)) >= 0, EDEVICE, "epoll_create1 failed: %s", strerror(errno));
+	m_defer_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(m_defer_fd < 0) {
+		close(m_epoll_fd);
+		THROW_s(EDEVICE, "eventfd failed: %s", strerror(errno));
+	}
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL; //the defer fd
+	epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_defer_fd, &ev);
+
+	memset(&m_api, 0, sizeof(m_api));
+	m_api.userdata = this;
+	m_api.io_new = ioNew;
+	m_api.io_enable = ioEnable;
+	m_api.io_free = ioFree;
+	m_api.io_set_destroy = ioSetDestroy;
+	m_api.time_new = timeNew;
+	m_api.time_restart = timeRestart;
+	m_api.time_free = timeFree;
+	m_api.time_set_destroy = timeSetDestroy;
+	m_api.defer_new = deferNew;
+	m_api.defer_enable = deferEnable;
+	m_api.defer_free = deferFree;
+	m_api.defer_set_destroy = deferSetDestroy;
+	m_api.quit = quit;
+}
+
+PAEpollMainloop::~PAEpollMainloop() {
+	/* the libpulse objects should be gone, free what's left like pa_mainloop does */
+	for(size_t i=0; i<m_io_events.size(); ++i) m_io_events[i]->bDead = true;
+	for(size_t i=0; i<m_time_events.size(); ++i) {
+		if(!m_time_events[i]->bDead) close(m_time_events[i]->timer_fd);
+		m_time_events[i]->bDead = true;
+	}
+	for(size_t i=0; i<m_defer_events.size(); ++i) m_defer_events[i]->bDead = true;
+	m_bHas_dead = true;
+	collectDead();
+
+	close(m_defer_fd);
+	close(m_epoll_fd);
+}
+
+void PAEpollMainloop::iterate(int timeout_ms) {
+	if(m_enabled_defers > 0) timeout_ms = 0;
+
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+	int count = epoll_wait(m_epoll_fd, events, MAX_EPOLL_EVENTS, timeout_ms);
+	if(count < 0 && errno != EINTR) LOG(ERROR, "epoll_wait failed: %s", strerror(errno));
+
+	for(int i=0; i<count; ++i) {
+		if(events[i].data.ptr) dispatchEvent((SEpollEntry*)events[i].data.ptr, events[i].events);
+	}
+
+	/* defer events run once per iteration as long as they are enabled,
+	 * events created by the callbacks wait for the next iteration */
+	size_t defer_count = m_defer_events.size();
+	for(size_t i=0; i<defer_count && m_enabled_defers > 0; ++i) {
+		pa_defer_event* e = m_defer_events[i];
+		if(!e->bDead && e->bEnabled) e->cb(&m_api, e, e->userdata);
+	}
+
+	collectDead();
+}
+
+void PAEpollMainloop::dispatchEvent(SEpollEntry* entry, uint32_t epoll_events) {
+	if(entry->bDead) return;
+
+	switch(entry->type) {
+	case Epoll_io: {
+		pa_io_event* e = (pa_io_event*)entry;
+		e->cb(&m_api, e, e->fd, fromEpoll(epoll_events), e->userdata);
+		break;
+	}
+	case Epoll_time: {
+		pa_time_event* e = (pa_time_event*)entry;
+		uint64_t expirations;
+		if(read(e->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+			LOG(ERROR, "timerfd read failed: %s", strerror(errno));
+		}
+		if(!e->bEnabled) break;
+		// a time event fires once, the callback can restart it
+		e->bEnabled = false;
+		struct timeval tv = e->tv;
+		e->cb(&m_api, e, &tv, e->userdata);
+		break;
+	}
+	case Epoll_defer:
+		break;
+	}
+}
+
+void PAEpollMainloop::updateDeferFd() {
+	bool bSignal = m_enabled_defers > 0;
+	if(bSignal == m_bDefer_signaled) return;
+
+	uint64_t value = 1;
+	if(bSignal) {
+		if(write(m_defer_fd, &value, sizeof(value)) < 0) LOG(ERROR, "eventfd write failed: %s", strerror(errno));
+	} else {
+		if(read(m_defer_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+			LOG(ERROR, "eventfd read failed: %s", strerror(errno));
+		}
+	}
+	m_bDefer_signaled = bSignal;
+}
+
+template<class Event>
+static void collectEvents(pa_mainloop_api* api, vector<Event*>& events) {
+	for(size_t i=0; i<events.size(); ) {
+		Event* e = events[i];
+		if(!e->bDead) {
+			++i;
+			continue;
+		}
+		if(e->destroy) e->destroy(api, e, e->userdata);
+		delete(e);
+		events[i] = events.back();
+		events.pop_back();
+	}
+}
+
+void PAEpollMainloop::collectDead() {
+	if(!m_bHas_dead) return;
+	m_bHas_dead = false;
+
+	collectEvents(&m_api, m_io_events);
+	collectEvents(&m_api, m_time_events);
+	collectEvents(&m_api, m_defer_events);
+}
+
+
+/* pa_mainloop_api functions */
+
+pa_io_event* PAEpollMainloop::ioNew(pa_mainloop_api* a, int fd, pa_io_event_flags_t events, pa_io_event_cb_t cb, void* userdata) {
+	PAEpollMainloop* loop = (PAEpollMainloop*)a->userdata;
+
+	pa_io_event* e = new pa_io_event();
+	e->loop = loop;
+	e->fd = fd;
+	e->cb = cb;
+	e->destroy = NULL;
+	e->userdata = userdata;
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = toEpoll(events);
+	ev.data.ptr = (SEpollEntry*)e;
+	if(epoll_ctl(loop->m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		LOG(ERROR, "epoll_ctl(ADD, %i) failed: %s", fd, strerror(errno));
+	}
+	loop->m_io_events.push_back(e);
+	return(e);
+}
+
+void PAEpollMainloop::ioEnable(pa_io_event* e, pa_io_event_flags_t events) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = toEpoll(events);
+	ev.data.ptr = (SEpollEntry*)e;
+	if(epoll_ctl(e->loop->m_epoll_fd, EPOLL_CTL_MOD, e->fd, &ev) < 0) {
+		LOG(ERROR, "epoll_ctl(MOD, %i) failed: %s", e->fd, strerror(errno));
+	}
+}
+
+void PAEpollMainloop::ioFree(pa_io_event* e) {
+	// the fd is still open here, libpulse closes it afterwards
+	epoll_ctl(e->loop->m_epoll_fd, EPOLL_CTL_DEL, e->fd, NULL);
+	e->bDead = true;
+	e->loop->m_bHas_dead = true;
+}
+
+void PAEpollMainloop::ioSetDestroy(pa_io_event* e, pa_io_event_destroy_cb_t cb) {
+	e->destroy = cb;
+}
+
+pa_time_event* PAEpollMainloop::timeNew(pa_mainloop_api* a, const struct timeval* tv, pa_time_event_cb_t cb, void* userdata) {
+	PAEpollMainloop* loop = (PAEpollMainloop*)a->userdata;
+
+	int timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	if(timer_fd < 0) {
+		LOG(ERROR, "timerfd_create failed: %s", strerror(errno));
+		return(NULL);
+	}
+
+	pa_time_event* e = new pa_time_event();
+	e->loop = loop;
+	e->timer_fd = timer_fd;
+	e->bEnabled = false;
+	memset(&e->tv, 0, sizeof(e->tv));
+	e->cb = cb;
+	e->destroy = NULL;
+	e->userdata = userdata;
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = (SEpollEntry*)e;
+	epoll_ctl(loop->m_epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+	loop->m_time_events.push_back(e);
+
+	timeRestart(e, tv);
+	return(e);
+}
+
+void PAEpollMainloop::timeRestart(pa_time_event* e, const struct timeval* tv) {
+	e->bEnabled = tv != NULL;
+	if(tv) e->tv = *tv;
+	armTimer(e->timer_fd, tv);
+}
+
+void PAEpollMainloop::timeFree(pa_time_event* e) {
+	epoll_ctl(e->loop->m_epoll_fd, EPOLL_CTL_DEL, e->timer_fd, NULL);
+	close(e->timer_fd);
+	e->bEnabled = false;
+	e->bDead = true;
+	e->loop->m_bHas_dead = true;
+}
+
+void PAEpollMainloop::timeSetDestroy(pa_time_event* e, pa_time_event_destroy_cb_t cb) {
+	e->destroy = cb;
+}
+
+pa_defer_event* PAEpollMainloop::deferNew(pa_mainloop_api* a, pa_defer_event_cb_t cb, void* userdata) {
+	PAEpollMainloop* loop = (PAEpollMainloop*)a->userdata;
+
+	pa_defer_event* e = new pa_defer_event();
+	e->loop = loop;
+	e->bEnabled = true; //like pa_mainloop, a new defer event is enabled
+	e->cb = cb;
+	e->destroy = NULL;
+	e->userdata = userdata;
+	loop->m_defer_events.push_back(e);
+
+	++loop->m_enabled_defers;
+	loop->updateDeferFd();
+	return(e);
+}
+
+void PAEpollMainloop::deferEnable(pa_defer_event* e, int b) {
+	bool bEnable = b != 0;
+	if(e->bDead || e->bEnabled == bEnable) return;
+	e->bEnabled = bEnable;
+	if(bEnable) ++e->loop->m_enabled_defers;
+	else --e->loop->m_enabled_defers;
+	e->loop->updateDeferFd();
+}
+
+void PAEpollMainloop::deferFree(pa_defer_event* e) {
+	deferEnable(e, 0);
+	e->bDead = true;
+	e->loop->m_bHas_dead = true;
+}
+
+void PAEpollMainloop::deferSetDestroy(pa_defer_event* e, pa_defer_event_destroy_cb_t cb) {
+	e->destroy = cb;
+}
+
+void PAEpollMainloop::quit(pa_mainloop_api* a, int retval) {
+	PAEpollMainloop* loop = (PAEpollMainloop*)a->userdata;
+	loop->m_bQuit = true;
+	loop->m_quit_retval = retval;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_MAINLOOP_EPOLL_H_
+#define PA_MAINLOOP_EPOLL_H_
+
+#include "global.h"
+#include "pa_backend_pulse.h"
+#include <sys/epoll.h>
+
+
+enum EEpollEntry {
+	Epoll_io,
+	Epoll_time,
+	Epoll_defer
+};
+
+/* common head of the event structs, it's the epoll data pointer */
+struct SEpollEntry {
+	SEpollEntry(EEpollEntry entry_type) : type(entry_type), bDead(false) {}
+
+	EEpollEntry type;
+	bool bDead; //freed by libpulse, deleted after the dispatching
+};
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAEpollMainloop
+ * pa_mainloop_api implementation on a single epoll fd: io events are
+ * registered directly, every time event has a timerfd and the defer events
+ * keep an eventfd readable while one of them is enabled. so fd() is
+ * readable whenever there is something to dispatch and it can be added to
+ * the epoll/poll loop of the application, which then calls dispatch(). no
+ * extra thread is needed.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAEpollMainloop : public PAEventLoop {
+public:
+	PAEpollMainloop();
+	virtual ~PAEpollMainloop();
+
+	virtual pa_mainloop_api* api() { return(&m_api); }
+	virtual void iterate(int timeout_ms);
+
+	/* readable when events are pending */
+	int fd() const { return(m_epoll_fd); }
+	/* dispatch the pending events without waiting */
+	void dispatch() { iterate(0); }
+
+	/* quit() was called through the api */
+	bool quitRequested() const { return(m_bQuit); }
+	int quitRetval() const { return(m_quit_retval); }
+
+private:
+	static pa_io_event* ioNew(pa_mainloop_api* a, int fd, pa_io_event_flags_t events, pa_io_event_cb_t cb, void* userdata);
+	static void ioEnable(pa_io_event* e, pa_io_event_flags_t events);
+	static void ioFree(pa_io_event* e);
+	static void ioSetDestroy(pa_io_event* e, pa_io_event_destroy_cb_t cb);
+	static pa_time_event* timeNew(pa_mainloop_api* a, const struct timeval* tv, pa_time_event_cb_t cb, void* userdata);
+	static void timeRestart(pa_time_event* e, const struct timeval* tv);
+	static void timeFree(pa_time_event* e);
+	static void timeSetDestroy(pa_time_event* e, pa_time_event_destroy_cb_t cb);
+	static pa_defer_event* deferNew(pa_mainloop_api* a, pa_defer_event_cb_t cb, void* userdata);
+	static void deferEnable(pa_defer_event* e, int b);
+	static void deferFree(pa_defer_event* e);
+	static void deferSetDestroy(pa_defer_event* e, pa_defer_event_destroy_cb_t cb);
+	static void quit(pa_mainloop_api* a, int retval);
+
+	/* keep m_defer_fd readable as long as a defer event is enabled */
+	void updateDeferFd();
+	void dispatchEvent(SEpollEntry* entry, uint32_t epoll_events);
+	/* delete the events freed by libpulse (calls the destroy callbacks) */
+	void collectDead();
+
+	pa_mainloop_api m_api;
+	int m_epoll_fd;
+	int m_defer_fd; //eventfd
+	bool m_bDefer_signaled;
+
+	vector<pa_io_event*> m_io_events;
+	vector<pa_time_event*> m_time_events;
+	vector<pa_defer_event*> m_defer_events;
+	uint32_t m_enabled_defers;
+	bool m_bHas_dead;
+
+	bool m_bQuit;
+	int m_quit_retval;
+};
+
+
+#endif /* PA_MAINLOOP_EPOLL_H_ */
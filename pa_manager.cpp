@@ -15,6 +15,8 @@
 #include <sstream>
 
 #include "pa_manager.h"
+#include "pa_backend_pulse.h"
+#include "trace.h"
 
 PADeviceInfo::PADeviceInfo(const pa_sink_info& sink_info)
 	: name(sink_info.name ? sink_info.name : ""), index(sink_info.index)
@@ -84,11 +86,16 @@ PAClientInfo::PAClientInfo(const pa_client_info& info)
 	, driver(info.driver ? info.driver : "") {
 }
 
+static string proplistStr(const pa_proplist* proplist, const char* key) {
+	const char* value=proplist ? pa_proplist_gets(proplist, key) : NULL;
+	return(value ? value : "");
+}
+
 PASinkInputInfo::PASinkInputInfo(const pa_sink_input_info& info)
 	: index(info.index), name(info.name ? info.name : ""), owner_module(info.owner_module)
-	, client(info.client), sink(info.sink), sample_spec(info.sample_spec), volume(info.volume)
+	, client(info.client), sink(info.sink), sample_spec(info.sample_spec), channel_map(info.channel_map), volume(info.volume)
 	, buffer_usec(info.buffer_usec), sink_usec(info.sink_usec), driver(info.driver ? info.driver : "")
-	, mute(info.mute)
+	, mute(info.mute), corked(info.corked), media_role(proplistStr(info.proplist, PA_PROP_MEDIA_ROLE))
 	, sink_obj(NULL), client_obj(NULL) {
 }
 
@@ -134,6 +141,15 @@ PACardInfo::PACardInfo(const pa_card_info& card)
 	}
 }
 
+PACardInfo::PACardInfo(const PACardInfo& card) 
+	: index(card.index), name(card.name), owner_module(card.owner_module)
+	, driver(card.driver), active_profile(card.active_profile) {
+	
+	for(size_t i=0; i<card.profiles.size(); ++i) {
+		profiles.push_back(new PACardProfileInfo(*card.profiles[i]));
+	}
+}
+
 PACardInfo::~PACardInfo() {
 	for(size_t i=0; i<profiles.size(); ++i) delete(profiles[i]);
 }
@@ -160,130 +176,153 @@ string PACardInfo::Info(bool with_profiles) const {
 }
 
 
+const char* paOpName(EPAOpType type) {
+	switch(type) {
+	case PAOp_connect: return("connect");
+	case PAOp_init: return("init");
+	case PAOp_sink_list: return("sink list");
+	case PAOp_source_list: return("source list");
+	case PAOp_client_list: return("client list");
+	case PAOp_sink_input_list: return("sink input list");
+	case PAOp_card_list: return("card list");
+	case PAOp_sink_info: return("sink info");
+	case PAOp_source_info: return("source info");
+	case PAOp_client_info: return("client info");
+	case PAOp_sink_input_info: return("sink input info");
+	case PAOp_card_info: return("card info");
+	case PAOp_set_sink_volume: return("set sink volume");
+	case PAOp_set_sink_mute: return("set sink mute");
+	case PAOp_set_source_volume: return("set source volume");
+	case PAOp_set_source_mute: return("set source mute");
+	case PAOp_set_sink_input_volume: return("set sink input volume");
+	case PAOp_set_sink_input_mute: return("set sink input mute");
+	case PAOp_set_card_profile: return("set card profile");
+	case PAOp_move_sink_input: return("move sink input");
+	case PAOp_suspend_sink: return("suspend sink");
+	case PAOp_suspend_source: return("suspend source");
+	case PAOp_count: break;
+	}
+	return("unknown");
+}
+
+PAPendingOp::PAPendingOp(PAManager* op_manager, EPAOpType op_type, uint32_t op_index)
+	: manager(op_manager), type(op_type), index(op_index), start(getTimeUsec()), ready(0)
+	, done(NULL) {
+}
+
+PAListOp::PAListOp(PAManager* op_manager, EPAOpType op_type, void* op_list, uint32_t op_index)
+	: PAPendingOp(op_manager, op_type, op_index), list(op_list)
+	, event(PA_SUBSCRIPTION_EVENT_CHANGE) {
+}
+
+void finishOperation(PAPendingOp& op, bool success) {
+	op.ready = success ? 1 : -1;
+	uint64_t end = getTimeUsec();
+	op.manager->latencyStats(op.type).record(end - op.start);
+	if(CTrace::enabled()) CTrace::getInstance().span(paOpName(op.type), op.start, end, op.index, success);
+	if(op.done) op.done(&op);
+}
+
+/* remove an object from a list */
+template<class Object>
+static void removeObject(map<uint32_t, Object*>& list, uint32_t idx) {
+	typename map<uint32_t, Object*>::iterator iter=list.find(idx);
+	if(iter==list.end()) return;
+	delete(iter->second);
+	list.erase(iter);
+}
+
+
 /*////////////////////////////////////////////////////////////////////////////////////////////////
  ** PulseAudio Callback functions
 /*////////////////////////////////////////////////////////////////////////////////////////////////
 
-// This callback gets called when our context changes state.  We really only
-// care about when it's ready or if it has failed
-void pa_state_cb(pa_context *c, void *userdata) {
-	
-	pa_context_state_t state;
-	int *pa_ready = (int*)userdata;
-
-	state = pa_context_get_state(c);
-	switch  (state) {
-	// There are just here for reference
-	case PA_CONTEXT_UNCONNECTED:
-	case PA_CONTEXT_CONNECTING:
-	case PA_CONTEXT_AUTHORIZING:
-	case PA_CONTEXT_SETTING_NAME:
-	default:
-		break;
-	case PA_CONTEXT_FAILED:
-	case PA_CONTEXT_TERMINATED:
-		*pa_ready = 2;
-		break;
-	case PA_CONTEXT_READY:
-		*pa_ready = 1;
-		break;
+/* insert an object into a list, an existing object with the same index is replaced */
+template<class Object, class Info>
+static void insertObject(map<uint32_t, Object*>* list, const Info& info) {
+	typename map<uint32_t, Object*>::iterator iter=list->find(info.index);
+	if(iter!=list->end()) {
+		delete(iter->second);
+		iter->second=new Object(info);
+	} else {
+		(*list)[info.index]=new Object(info);
 	}
 }
 
-// pa_mainloop will call this function when it's ready to tell us about a sink.
+/* handle the end of a list/by-index fetch. returns true if the list is done */
+static bool listDone(PAListOp* op, int eol) {
+	if(eol==0) return(false);
+	
+	if(eol<0 && op->index==PA_INVALID_INDEX) { //by-index fetches fail if the object is gone
+		LOG(ERROR, "%s callback error", paOpName(op->type));
+	}
+	finishOperation(*op, eol>0);
+	return(true);
+}
+
+// the backend will call this function when it's ready to tell us about a sink.
 // Since we're not threading, there's no need for mutexes on the devicelist
 // structure
-void pa_sinklist_cb(pa_context *c, const pa_sink_info *l, int eol, void *userdata) {
+void pa_sinklist_cb(const pa_sink_info *l, int eol, void *userdata) {
+	
+	PAListOp* op = (PAListOp*) userdata;
 	
-	pa_dev_list *pa_device_list = (pa_dev_list*) userdata;
-
 	// If eol is set to a positive number, you're at the end of the list
-	if (eol > 0) {
+	if (listDone(op, eol)) {
 		return;
 	}
-	PADeviceInfo* device=new PADeviceInfo(*l);
-	(*pa_device_list)[l->index]=device;
-	
+	insertObject((pa_dev_list*)op->list, *l);
 }
 
 // See above.  This callback is pretty much identical to the previous
-void pa_sourcelist_cb(pa_context *c, const pa_source_info *l, int eol, void *userdata) {
+void pa_sourcelist_cb(const pa_source_info *l, int eol, void *userdata) {
 	
-	pa_dev_list *pa_device_list = (pa_dev_list*)userdata;
-
-	if (eol > 0) {
+	PAListOp* op = (PAListOp*) userdata;
+	
+	if (listDone(op, eol)) {
 		return;
 	}
-	
-	PADeviceInfo* device=new PADeviceInfo(*l);
-	(*pa_device_list)[l->index]=device;
+	insertObject((pa_dev_list*)op->list, *l);
 }
 
 
-void pa_client_cb(pa_context * context, const pa_client_info *i, int eol, void *userdata) {
-
-	pa_client_list* client_list = (pa_client_list*) userdata;
+void pa_client_cb(const pa_client_info *i, int eol, void *userdata) {
 	
-	if (eol < 0) {
-		if (pa_context_errno(context) == PA_ERR_NOENTITY)
-			return;
-
-		LOG(ERROR, "client callback error");
-		return;
-	}
-
-	if (eol > 0) {
+	PAListOp* op = (PAListOp*) userdata;
+	
+	if (listDone(op, eol)) {
 		return;
 	}
-
-	PAClientInfo* client=new PAClientInfo(*i);
-	(*client_list)[i->index]=client;
+	insertObject((pa_client_list*)op->list, *i);
 }
 
-void pa_sink_input_cb(pa_context * context, const pa_sink_input_info *i, int eol, void *userdata) {
+void pa_sink_input_cb(const pa_sink_input_info *i, int eol, void *userdata) {
 	
-	pa_sink_input_list* sink_inputs = (pa_sink_input_list*) userdata;
+	PAListOp* op = (PAListOp*) userdata;
 	
-	if (eol < 0) {
-		if (pa_context_errno(context) == PA_ERR_NOENTITY)
-			return;
-		
-		LOG(ERROR, "sink input callback error");
+	if (listDone(op, eol)) { //end of list
 		return;
 	}
-
-	if (eol > 0) { //end of list
-		return;
-	}
-
-	PASinkInputInfo* input=new PASinkInputInfo(*i);
-	(*sink_inputs)[i->index]=input;
+	insertObject((pa_sink_input_list*)op->list, *i);
 }
 
 //volume change callback
-void pa_context_success_cb(pa_context* c, int success, void *userdata) {
+void pa_success_cb(int success, void *userdata) {
 	
-	int* ready=(int*)userdata;
-	if(success==1) *ready=1;
-	else *ready=-1;
+	PAPendingOp* op=(PAPendingOp*)userdata;
+	finishOperation(*op, success==1);
 }
 
 //cards
-void pa_card_cb(pa_context *, const pa_card_info *i, int eol, void *userdata) {
+void pa_card_cb(const pa_card_info *i, int eol, void *userdata) {
 	
-	pa_card_list* cards = static_cast<pa_card_list*>(userdata);
-
-    if (eol < 0) {
-        return;
-    }
-
-    if (eol > 0) {
-    	//all cards done
-        return;
-    }
-    
-    PACardInfo* card = new PACardInfo(*i);
-    (*cards)[i->index]=card;
+	PAListOp* op = (PAListOp*) userdata;
+	
+	if (listDone(op, eol)) {
+		//all cards done
+		return;
+	}
+	insertObject((pa_card_list*)op->list, *i);
 }
 
 
@@ -293,7 +332,9 @@ void pa_card_cb(pa_context *, const pa_card_info *i, int eol, void *userdata) {
  ** class PAManager
 /*////////////////////////////////////////////////////////////////////////////////////////////////
 
-PAManager::PAManager() : m_pa_context(NULL), m_pa_mainloop(NULL) {
+PAManager::PAManager() : m_backend(NULL), m_connect_start(0), m_bBatch(false)
+	, m_bSubscribed(false), m_subscription_mask(PA_SUBSCRIPTION_MASK_NULL), m_event_cb(NULL), m_event_userdata(NULL)
+	, m_event_time(0) {
 	
 }
 
@@ -302,39 +343,69 @@ PAManager::~PAManager() {
 }
 
 
-void PAManager::Init() {
-	ASSERT_THROW(m_pa_context==NULL, EALREADY_INITIALIZED);
+void PAManager::Init(PABackend* backend, const char* server) {
+	if(m_backend) {
+		delete(backend);
+		THROW(EALREADY_INITIALIZED);
+	}
 	
-	/* init pa context */
-	pa_mainloop_api *pa_mlapi;
-	// Create a mainloop API and connection to the default server
-	ASSERT_THROW_e(m_pa_mainloop = pa_mainloop_new(), EASSERT, "Failed to create PulseAudio MainLoop");
-	ASSERT_THROW_e(pa_mlapi = pa_mainloop_get_api(m_pa_mainloop), EASSERT, "Failed to create PulseAudio MainLoop");
-	ASSERT_THROW_e(m_pa_context = pa_context_new(pa_mlapi, APP_NAME), EDEVICE, "Failed to get a PulseAudio Context Object");
+	m_backend = backend ? backend : new PAPulseBackend();
+	m_server = server ? server : "";
 	
 	// This function connects to the pulse server
-	pa_context_connect(m_pa_context, NULL, (pa_context_flags_t)0, NULL);
+	m_connect_start=getTimeUsec();
+	m_backend->connect(server);
+	
+
+	InitPAInfo();
 	
+}
 
+void PAManager::reconnect() {
+	ASSERT_THROW(m_backend, ENOT_INITIALIZED);
+	
+	m_backend->disconnect();
+	dropOperations();
+	
+	m_connect_start=getTimeUsec();
+	m_backend->connect(m_server.empty() ? NULL : m_server.c_str());
 	InitPAInfo();
 	
+	if(m_bSubscribed) {
+		ASSERT_THROW_e(m_backend->subscribe(m_subscription_mask, eventCb, this), EGENERAL, "subscribe failed");
+	}
+}
+
+void PAManager::dropOperations() {
+	for(deque<PAPendingOp>::iterator iter=m_operations.begin(); iter!=m_operations.end(); ++iter) {
+		if(iter->ready==0) finishOperation(*iter, false);
+	}
+	m_operations.clear();
+	m_bBatch=false;
+	
+	for(set<PAListOp*>::iterator iter=m_event_ops.begin(); iter!=m_event_ops.end(); ++iter) {
+		delete(*iter);
+	}
+	m_event_ops.clear();
 }
 
 void PAManager::DeInit() {
 	
 	/* disconnect */
-	if(m_pa_context) {
-		pa_context_disconnect(m_pa_context);
-		pa_context_unref(m_pa_context);
-		m_pa_context=NULL;
-		
-	}
-	if(m_pa_mainloop) {
-		pa_mainloop_free(m_pa_mainloop);
-		m_pa_mainloop=NULL;
+	if(m_backend) {
+		m_backend->disconnect();
+		delete(m_backend);
+		m_backend=NULL;
 	}
+	m_bSubscribed=false;
+	m_event_cb=NULL;
+	dropOperations();
 	
 	/* delete devices */
+	clearLists();
+}
+
+void PAManager::clearLists() {
 	
 	for(pa_dev_list::iterator iter=m_sinks.begin(); iter!=m_sinks.end(); ++iter) {
 		delete(iter->second);
@@ -365,121 +436,164 @@ void PAManager::DeInit() {
 
 
 void PAManager::InitPAInfo() {
-
 	
-	int state = 0;
-	m_pa_ready=0;
-	pa_operation *pa_op=NULL;
-	bool bDone=false;
+	PAPendingOp init_op(this, PAOp_init);
 	
-
-	// This function defines a callback so the server will tell us it's state.
-	// Our callback will wait for the state to be ready.  The callback will
-	// modify the variable to 1 so we know when we have a connection and it's
-	// ready.
-	// If there's an error, the callback will set pa_ready to 2
-	pa_context_set_state_callback(m_pa_context, pa_state_cb, &m_pa_ready);
-
-	
-	while(!bDone) {
+	if(m_backend->state()!=PABackend_ready) {
+		PAPendingOp connect_op(this, PAOp_connect);
+		connect_op.start=m_connect_start;
+		
 		// We can't do anything until PA is ready, so just iterate the mainloop
-		pa_mainloop_iterate(m_pa_mainloop, 1, NULL);
+		while(m_backend->state()==PABackend_connecting) m_backend->iterate(-1);
 		
-		if (m_pa_ready == 2) { // We couldn't get a connection to the server, so exit out
+		if(m_backend->state()!=PABackend_ready) { // We couldn't get a connection to the server, so exit out
+			finishOperation(connect_op, false);
+			finishOperation(init_op, false);
 			THROW_s(EDEVICE, "Failed to connect to PulseAudio Server");
-		} else if(m_pa_ready!=0) {
-			// At this point, we're connected to the server and ready to make
-			// requests
-			switch (state) {
-			// State 0: we haven't done anything yet
-			case 0:
-				// This sends an operation to the server.  pa_sinklist_info is
-				// our callback function and a pointer to our devicelist will
-				// be passed to the callback The operation ID is stored in the
-				// pa_op variable
-				pa_op = pa_context_get_sink_info_list(m_pa_context,
-						pa_sinklist_cb,
-						&m_sinks
-				);
-				ASSERT_THROW_e(pa_op, EGENERAL, "pa_context_get_sink_info_list failed");
-				
-				// Update state for next iteration through the loop
-				state++;
-				break;
-			case 1:
-				// Now we wait for our operation to complete.  When it's
-				// complete our pa_output_devicelist is filled out, and we move
-				// along to the next state
-				if (pa_operation_get_state(pa_op) == PA_OPERATION_DONE) {
-					pa_operation_unref(pa_op);
-	
-					// Now we perform another operation to get the source
-					// (input device) list just like before.  This time we pass
-					// a pointer to our input structure
-					pa_op = pa_context_get_source_info_list(m_pa_context,
-							pa_sourcelist_cb,
-							&m_sources
-					);
-					ASSERT_THROW_e(pa_op, EGENERAL, "pa_context_get_source_info_list failed");
-					
-					// Update the state so we know what to do next
-					state++;
-				}
-				break;
-			case 2:
-				if (pa_operation_get_state(pa_op) == PA_OPERATION_DONE) {
-					pa_operation_unref(pa_op);
-					
-					//get client info
-		            pa_op=pa_context_get_client_info_list(m_pa_context, pa_client_cb, &m_clients);
-		            ASSERT_THROW_e(pa_op, EGENERAL, "pa_context_get_client_info_list failed");
-		            
-		            ++state;
-				}
-				break;
-			case 3:
-				if (pa_operation_get_state(pa_op) == PA_OPERATION_DONE) {
-					pa_operation_unref(pa_op);
-					
-					//get the applications that use a sink
-		            pa_op = pa_context_get_sink_input_info_list(m_pa_context, pa_sink_input_cb, &m_sink_inputs);
-		            ASSERT_THROW_e(pa_op, EGENERAL, "pa_context_get_sink_input_info_list failed");
-		            
-		            ++state;
-				}
-				break;
-			case 4:
-				if (pa_operation_get_state(pa_op) == PA_OPERATION_DONE) {
-					pa_operation_unref(pa_op);
-					
-					//get the cards
-		            pa_op = pa_context_get_card_info_list(m_pa_context, pa_card_cb, &m_cards);
-		            ASSERT_THROW_e(pa_op, EGENERAL, "pa_context_get_card_info_list failed");
-		            
-		            ++state;
-				}
-				break;
-			case 5:
-				if (pa_operation_get_state(pa_op) == PA_OPERATION_DONE) {
-					// Now we're done, clean up
-					pa_operation_unref(pa_op);
-					bDone=true;
-				}
-				break;
-			default:
-				// We should never see this state
-				THROW_s(EGENERAL, "Unexpected state. This MUST NOT happen!");
-			}
 		}
+		finishOperation(connect_op, true);
+	}
+	
+	clearLists();
+	
+	// All lists are requested at once, so the enumeration needs a single
+	// round trip instead of one per list. The callbacks fill the lists.
+	PAListOp sink_op(this, PAOp_sink_list, &m_sinks);
+	PAListOp source_op(this, PAOp_source_list, &m_sources);
+	PAListOp client_op(this, PAOp_client_list, &m_clients);
+	PAListOp sink_input_op(this, PAOp_sink_input_list, &m_sink_inputs);
+	PAListOp card_op(this, PAOp_card_list, &m_cards);
+	PAListOp* ops[] = { &sink_op, &source_op, &client_op, &sink_input_op, &card_op };
+	
+	if(!m_backend->getSinkInfoList(pa_sinklist_cb, &sink_op)) finishOperation(sink_op, false);
+	if(!m_backend->getSourceInfoList(pa_sourcelist_cb, &source_op)) finishOperation(source_op, false);
+	if(!m_backend->getClientInfoList(pa_client_cb, &client_op)) finishOperation(client_op, false);
+	if(!m_backend->getSinkInputInfoList(pa_sink_input_cb, &sink_input_op)) finishOperation(sink_input_op, false);
+	if(!m_backend->getCardInfoList(pa_card_cb, &card_op)) finishOperation(card_op, false);
+	
+	for(size_t i=0; i<sizeof(ops)/sizeof(ops[0]); ++i) {
+		waitForOperation(*ops[i]);
+		if(ops[i]->ready!=1) LOG(ERROR, "%s failed", paOpName(ops[i]->type));
 	}
 	
 	//fill the objects of sink inputs
+	linkSinkInputs();
+	
+	finishOperation(init_op, true);
+}
+
+void PAManager::linkSinkInputs() {
 	for(pa_sink_input_list::iterator iter=m_sink_inputs.begin(); iter!=m_sink_inputs.end(); ++iter) {
 		iter->second->client_obj=Client(iter->second->client);
 		iter->second->sink_obj=Sink(iter->second->sink);
 	}
 }
 
+void PAManager::waitForOperation(PAPendingOp& op) {
+	while(op.ready==0) {
+		if(m_backend->state()!=PABackend_ready) {
+			THROW_s(EDEVICE, "Lost the connection to the PulseAudio Server");
+		}
+		//wait for the callback
+		m_backend->iterate(-1);
+	}
+}
+
+void PAManager::iterate(int timeout_ms) {
+	ASSERT_THROW(m_backend, ENOT_INITIALIZED);
+	ASSERT_THROW_e(m_backend->state()==PABackend_ready, EDEVICE, "Lost the connection to the PulseAudio Server");
+	m_backend->iterate(timeout_ms);
+}
+
+void PAManager::subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb, void* userdata) {
+	ASSERT_THROW(m_backend, ENOT_INITIALIZED);
+	m_event_cb=cb;
+	m_event_userdata=userdata;
+	m_subscription_mask=mask;
+	m_bSubscribed=true;
+	ASSERT_THROW_e(m_backend->subscribe(mask, eventCb, this), EGENERAL, "subscribe failed");
+}
+
+void PAManager::eventCb(pa_subscription_event_type_t type, uint32_t idx, void* userdata) {
+	((PAManager*)userdata)->handleEvent(type, idx);
+}
+
+void PAManager::handleEvent(pa_subscription_event_type_t type, uint32_t idx) {
+	int facility=type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+	uint64_t now=getTimeUsec();
+	
+	if((type & PA_SUBSCRIPTION_EVENT_TYPE_MASK)==PA_SUBSCRIPTION_EVENT_REMOVE) {
+		switch(facility) {
+		case PA_SUBSCRIPTION_EVENT_SINK: removeObject(m_sinks, idx); break;
+		case PA_SUBSCRIPTION_EVENT_SOURCE: removeObject(m_sources, idx); break;
+		case PA_SUBSCRIPTION_EVENT_CLIENT: removeObject(m_clients, idx); break;
+		case PA_SUBSCRIPTION_EVENT_SINK_INPUT: removeObject(m_sink_inputs, idx); break;
+		case PA_SUBSCRIPTION_EVENT_CARD: removeObject(m_cards, idx); break;
+		default: break;
+		}
+		linkSinkInputs();
+		m_event_time=now;
+		if(m_event_cb) m_event_cb(type, idx, m_event_userdata);
+		return;
+	}
+	
+	/* new or changed: fetch the object, the event is forwarded when it's done */
+	PAListOp* op=NULL;
+	bool bIssued=false;
+	switch(facility) {
+	case PA_SUBSCRIPTION_EVENT_SINK:
+		op=new PAListOp(this, PAOp_sink_info, &m_sinks, idx);
+		op->done=eventFetchDone;
+		bIssued=m_backend->getSinkInfo(idx, pa_sinklist_cb, op);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SOURCE:
+		op=new PAListOp(this, PAOp_source_info, &m_sources, idx);
+		op->done=eventFetchDone;
+		bIssued=m_backend->getSourceInfo(idx, pa_sourcelist_cb, op);
+		break;
+	case PA_SUBSCRIPTION_EVENT_CLIENT:
+		op=new PAListOp(this, PAOp_client_info, &m_clients, idx);
+		op->done=eventFetchDone;
+		bIssued=m_backend->getClientInfo(idx, pa_client_cb, op);
+		break;
+	case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+		op=new PAListOp(this, PAOp_sink_input_info, &m_sink_inputs, idx);
+		op->done=eventFetchDone;
+		bIssued=m_backend->getSinkInputInfo(idx, pa_sink_input_cb, op);
+		break;
+	case PA_SUBSCRIPTION_EVENT_CARD:
+		op=new PAListOp(this, PAOp_card_info, &m_cards, idx);
+		op->done=eventFetchDone;
+		bIssued=m_backend->getCardInfo(idx, pa_card_cb, op);
+		break;
+	default: //not cached
+		m_event_time=now;
+		if(m_event_cb) m_event_cb(type, idx, m_event_userdata);
+		return;
+	}
+	op->event=type;
+	if(!bIssued) {
+		LOG(ERROR, "failed to get %s for index %i", paOpName(op->type), idx);
+		delete(op);
+		return;
+	}
+	m_event_ops.insert(op);
+}
+
+void PAManager::eventFetchDone(PAPendingOp* op) {
+	PAListOp* list_op=static_cast<PAListOp*>(op);
+	PAManager* manager=op->manager;
+	manager->m_event_ops.erase(list_op);
+	
+	if(op->ready==1) {
+		manager->linkSinkInputs();
+		/* the fetch was issued when the event arrived */
+		manager->m_event_time=op->start;
+		if(manager->m_event_cb) manager->m_event_cb(list_op->event, op->index, manager->m_event_userdata);
+	}
+	delete(list_op);
+}
+
 
 PADeviceInfo* PAManager::Sink(uint32_t idx) {
 	pa_dev_list::iterator iter = m_sinks.find(idx);
@@ -531,18 +645,16 @@ string PAManager::cardProfileName(PACardInfo* card, const string& profile) {
 
 void PAManager::setCardProfile(PACardInfo* card, const string& profile_name) {
 	ASSERT_THROW(card, EINVALID_PARAMETER);
-	m_pa_ready=0;
-	pa_operation* op = pa_context_set_card_profile_by_index(m_pa_context
-			, card->index, profile_name.c_str(), pa_context_success_cb, &m_pa_ready);
-	
-	ASSERT_THROW_e(op, EGENERAL, "pa_context_set_card_profile_by_index failed");
+	PAPendingOp& op=newOperation(PAOp_set_card_profile, card->index);
+	bool bIssued = m_backend->setCardProfile(card->index, profile_name.c_str(), pa_success_cb, &op);
 	
-    pa_operation_unref(op);
-    
-	while(m_pa_ready==0) {
-		//wait for the callback
-		pa_mainloop_iterate(m_pa_mainloop, 1, NULL);
+	if(!bIssued) {
+		finishOperation(op, false);
+		m_operations.pop_back();
+		THROW_s(EGENERAL, "setCardProfile failed");
 	}
+	
+	completeOperation(op);
 }
 
 
@@ -638,38 +750,27 @@ void PAManager::setSinkVolume(uint32_t idx, const string& volume, const vector<i
 
 void PAManager::setSinkVolume(uint32_t idx, const pa_cvolume& volume) {
 	
-	pa_operation* o;
-	m_pa_ready=0;
+	PAPendingOp& op=newOperation(PAOp_set_sink_volume, idx);
 	
-	if(!(o = pa_context_set_sink_volume_by_index(m_pa_context, idx, &volume
-			, pa_context_success_cb, &m_pa_ready))) {
-		LOG(ERROR, "pa_context_set_sink_volume_by_index() for index %i failed", idx);
-	} else {
-		pa_operation_unref(o);
+	if(!m_backend->setSinkVolume(idx, volume, pa_success_cb, &op)) {
+		LOG(ERROR, "setSinkVolume() for index %i failed", idx);
+		finishOperation(op, false);
 	}
 	
-	while(m_pa_ready==0) {
-		//wait for the callback
-		pa_mainloop_iterate(m_pa_mainloop, 1, NULL);
-	}
+	completeOperation(op);
 	
 }
 
 void PAManager::setSinkMute(uint32_t idx, int mute) {
 	
-	pa_operation* o;
-	m_pa_ready=0;
+	PAPendingOp& op=newOperation(PAOp_set_sink_mute, idx);
 	
-	if(!(o = pa_context_set_sink_mute_by_index(m_pa_context, idx, mute, pa_context_success_cb, &m_pa_ready))) {
-		LOG(ERROR, "pa_context_set_sink_mute_by_index() for index %i failed", idx);
-	} else {
-		pa_operation_unref(o);
+	if(!m_backend->setSinkMute(idx, mute, pa_success_cb, &op)) {
+		LOG(ERROR, "setSinkMute() for index %i failed", idx);
+		finishOperation(op, false);
 	}
 	
-	while(m_pa_ready==0) {
-		//wait for the callback
-		pa_mainloop_iterate(m_pa_mainloop, 1, NULL);
-	}
+	completeOperation(op);
 }
 
 
@@ -691,36 +792,26 @@ void PAManager::setSourceVolume(uint32_t idx, const string& volume, const vector
 
 void PAManager::setSourceVolume(uint32_t idx, const pa_cvolume& volume) {
 	
-	pa_operation* o;
-	m_pa_ready=0;
+	PAPendingOp& op=newOperation(PAOp_set_source_volume, idx);
 	
-	if(!(o = pa_context_set_source_volume_by_index(m_pa_context, idx, &volume, pa_context_success_cb, &m_pa_ready))) {
-		LOG(ERROR, "pa_context_set_source_volume_by_index() for index %i failed", idx);
-	} else {
-		pa_operation_unref(o);
+	if(!m_backend->setSourceVolume(idx, volume, pa_success_cb, &op)) {
+		LOG(ERROR, "setSourceVolume() for index %i failed", idx);
+		finishOperation(op, false);
 	}
 	
-	while(m_pa_ready==0) {
-		//wait for the callback
-		pa_mainloop_iterate(m_pa_mainloop, 1, NULL);
-	}
+	completeOperation(op);
 }
 
 void PAManager::setSourceMute(uint32_t idx, int mute) {
 	
-	pa_operation* o;
-	m_pa_ready=0;
+	PAPendingOp& op=newOperation(PAOp_set_source_mute, idx);
 	
-	if(!(o = pa_context_set_source_mute_by_index(m_pa_context, idx, mute, pa_context_success_cb, &m_pa_ready))) {
-		LOG(ERROR, "pa_context_set_source_mute_by_index() for index %i failed", idx);
-	} else {
-		pa_operation_unref(o);
+	if(!m_backend->setSourceMute(idx, mute, pa_success_cb, &op)) {
+		LOG(ERROR, "setSourceMute() for index %i failed", idx);
+		finishOperation(op, false);
 	}
 	
-	while(m_pa_ready==0) {
-		//wait for the callback
-		pa_mainloop_iterate(m_pa_mainloop, 1, NULL);
-	}
+	completeOperation(op);
 }
 
 
@@ -741,36 +832,95 @@ void PAManager::setSinkInputVolume(uint32_t idx, const string& volume, const vec
 }
 
 void PAManager::setSinkInputVolume(uint32_t idx, const pa_cvolume& volume) {
-	pa_operation* o;
-	m_pa_ready=0;
+	PAPendingOp& op=newOperation(PAOp_set_sink_input_volume, idx);
 	
-	if(!(o = pa_context_set_sink_input_volume(m_pa_context, idx, &volume, pa_context_success_cb, &m_pa_ready))) {
-		LOG(ERROR, "pa_context_set_sink_input_volume() for index %i failed", idx);
-	} else {
-		pa_operation_unref(o);
+	if(!m_backend->setSinkInputVolume(idx, volume, pa_success_cb, &op)) {
+		LOG(ERROR, "setSinkInputVolume() for index %i failed", idx);
+		finishOperation(op, false);
 	}
 	
-	while(m_pa_ready==0) {
-		//wait for the callback
-		pa_mainloop_iterate(m_pa_mainloop, 1, NULL);
-	}
+	completeOperation(op);
 }
 
 void PAManager::setSinkInputMute(uint32_t idx, int mute) {
 	
-	pa_operation* o;
-	m_pa_ready=0;
+	PAPendingOp& op=newOperation(PAOp_set_sink_input_mute, idx);
 	
-	if(!(o = pa_context_set_sink_input_mute(m_pa_context, idx, mute, pa_context_success_cb, &m_pa_ready))) {
-		LOG(ERROR, "pa_context_set_sink_input_mute() for index %i failed", idx);
-	} else {
-		pa_operation_unref(o);
+	if(!m_backend->setSinkInputMute(idx, mute, pa_success_cb, &op)) {
+		LOG(ERROR, "setSinkInputMute() for index %i failed", idx);
+		finishOperation(op, false);
 	}
 	
-	while(m_pa_ready==0) {
-		//wait for the callback
-		pa_mainloop_iterate(m_pa_mainloop, 1, NULL);
+	completeOperation(op);
+}
+
+void PAManager::moveSinkInput(uint32_t idx, uint32_t sink_idx) {
+	
+	PAPendingOp& op=newOperation(PAOp_move_sink_input, idx);
+	
+	if(!m_backend->moveSinkInput(idx, sink_idx, pa_success_cb, &op)) {
+		LOG(ERROR, "moveSinkInput() for index %i failed", idx);
+		finishOperation(op, false);
+	}
+	
+	completeOperation(op);
+}
+
+void PAManager::suspendSink(uint32_t idx, int suspend) {
+	
+	PAPendingOp& op=newOperation(PAOp_suspend_sink, idx);
+	
+	if(!m_backend->suspendSink(idx, suspend, pa_success_cb, &op)) {
+		LOG(ERROR, "suspendSink() for index %i failed", idx);
+		finishOperation(op, false);
 	}
+	
+	completeOperation(op);
+}
+
+void PAManager::suspendSource(uint32_t idx, int suspend) {
+	
+	PAPendingOp& op=newOperation(PAOp_suspend_source, idx);
+	
+	if(!m_backend->suspendSource(idx, suspend, pa_success_cb, &op)) {
+		LOG(ERROR, "suspendSource() for index %i failed", idx);
+		finishOperation(op, false);
+	}
+	
+	completeOperation(op);
+}
+
+PAPendingOp& PAManager::newOperation(EPAOpType type, uint32_t idx) {
+	ASSERT_THROW(m_backend, ENOT_INITIALIZED);
+	m_operations.push_back(PAPendingOp(this, type, idx));
+	return(m_operations.back());
+}
+
+void PAManager::completeOperation(PAPendingOp& op) {
+	if(m_bBatch) return;
+	
+	waitForOperation(op);
+	m_operations.pop_back();
+}
+
+void PAManager::beginBatch() {
+	m_bBatch=true;
+}
+
+bool PAManager::flush() {
+	m_bBatch=false;
+	
+	bool bSuccess=true;
+	while(!m_operations.empty()) {
+		PAPendingOp& op=m_operations.front();
+		waitForOperation(op);
+		if(op.ready!=1) {
+			LOG(ERROR, "%s for index %i failed", paOpName(op.type), op.index);
+			bSuccess=false;
+		}
+		m_operations.pop_front();
+	}
+	return(bSuccess);
 }
 
 void PAManager::applyVolume(const string& volume, pa_volume_t& value) {
@@ -840,9 +990,32 @@ void PAManager::applyVolumeChannel(const string& volume, pa_cvolume& vol, const
 	}
 }
 
+bool PAManager::volumeClose(const pa_cvolume& a, const pa_cvolume& b, pa_volume_t tolerance) {
+	if(a.channels!=b.channels) return(false);
+	for(uint8_t i=0; i<a.channels; ++i) {
+		pa_volume_t diff=a.values[i]>b.values[i] ? a.values[i]-b.values[i] : b.values[i]-a.values[i];
+		if(diff>tolerance) return(false);
+	}
+	return(true);
+}
 
+void PAManager::resetLatencyStats() {
+	for(int i=0; i<PAOp_count; ++i) m_latency[i].reset();
+}
 
-
-
-
-
+string PAManager::LatencyStatsInfo() const {
+	char line[128];
+	ostringstream ret;
+	sprintf(line, "%-22s %8s %9s %9s %9s %9s", "operation (usec)", "count", "p50", "p90", "p99", "max");
+	ret << line;
+	for(int i=0; i<PAOp_count; ++i) {
+		const CLatencyHistogram& h=m_latency[i];
+		if(h.count()==0) continue;
+		sprintf(line, "\n%-22s %8llu %9llu %9llu %9llu %9llu", paOpName((EPAOpType)i)
+				, (unsigned long long)h.count(), (unsigned long long)h.percentile(50)
+				, (unsigned long long)h.percentile(90), (unsigned long long)h.percentile(99)
+				, (unsigned long long)h.max());
+		ret << line;
+	}
+	return(ret.str());
+}
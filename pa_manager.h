@@ -16,8 +16,11 @@
 #define PA_MANAGER_H_
 
 #include "global.h"
+#include "latency_histogram.h"
+#include "pa_backend.h"
 #include <map>
-#include <pulse/pulseaudio.h>
+#include <deque>
+#include <set>
 
 
 #define MAX_VOLUME PA_VOLUME_NORM //which is 0dB
@@ -85,6 +88,8 @@ struct PASinkInputInfo {
 	pa_usec_t sink_usec;
 	const string driver;
 	int mute;
+	int corked;
+	const string media_role; //media.role property, eg. music, phone or event ("" if not set)
 	
 	PADeviceInfo* sink_obj;
 	PAClientInfo* client_obj;
@@ -103,6 +108,7 @@ struct PACardProfileInfo {
 
 struct PACardInfo {
 	PACardInfo(const pa_card_info& card);
+	PACardInfo(const PACardInfo& card); //copies the profiles
 	~PACardInfo();
 	
 	string Info(bool with_profiles=true) const;
@@ -113,6 +119,76 @@ struct PACardInfo {
     string driver;                       /**< Driver name */
     vector<PACardProfileInfo*> profiles;         
     int active_profile;                  /**< Pointer to active profile in the array, or -1 */
+	
+private:
+	PACardInfo& operator=(const PACardInfo&);
+};
+
+/* types of pulseaudio operations issued by PAManager (used for tracing & statistics) */
+enum EPAOpType {
+	PAOp_connect=0,
+	PAOp_init,
+	PAOp_sink_list,
+	PAOp_source_list,
+	PAOp_client_list,
+	PAOp_sink_input_list,
+	PAOp_card_list,
+	PAOp_sink_info,
+	PAOp_source_info,
+	PAOp_client_info,
+	PAOp_sink_input_info,
+	PAOp_card_info,
+	PAOp_set_sink_volume,
+	PAOp_set_sink_mute,
+	PAOp_set_source_volume,
+	PAOp_set_source_mute,
+	PAOp_set_sink_input_volume,
+	PAOp_set_sink_input_mute,
+	PAOp_set_card_profile,
+	PAOp_move_sink_input,
+	PAOp_suspend_sink,
+	PAOp_suspend_source,
+	
+	PAOp_count
+};
+
+const char* paOpName(EPAOpType type);
+
+class PAManager;
+struct PAPendingOp;
+
+typedef void (*pa_op_done_cb_t)(PAPendingOp* op);
+
+/* state of an issued operation, passed as userdata to the completion callback */
+struct PAPendingOp {
+	PAPendingOp(PAManager* op_manager, EPAOpType op_type, uint32_t op_index=PA_INVALID_INDEX);
+	
+	PAManager* manager;
+	EPAOpType type;
+	uint32_t index;
+	uint64_t start; //getTimeUsec() when issued
+	int ready; //0: pending, 1: success, -1: failed
+	
+	pa_op_done_cb_t done; //called after completion if set. it may delete the op
+};
+
+/* mark an operation as completed: records the latency & trace, then calls done */
+void finishOperation(PAPendingOp& op, bool success);
+/* backend completion callback of mutations, userdata is the PAPendingOp */
+void pa_success_cb(int success, void *userdata);
+/* backend callbacks of list & by-index fetches, userdata is the PAListOp */
+void pa_sinklist_cb(const pa_sink_info *l, int eol, void *userdata);
+void pa_sourcelist_cb(const pa_source_info *l, int eol, void *userdata);
+void pa_client_cb(const pa_client_info *i, int eol, void *userdata);
+void pa_sink_input_cb(const pa_sink_input_info *i, int eol, void *userdata);
+void pa_card_cb(const pa_card_info *i, int eol, void *userdata);
+
+/* list or by-index fetch: the callback inserts the objects into list */
+struct PAListOp : public PAPendingOp {
+	PAListOp(PAManager* op_manager, EPAOpType op_type, void* op_list, uint32_t op_index=PA_INVALID_INDEX);
+	
+	void* list; //one of pa_dev_list, pa_client_list, ...
+	pa_subscription_event_type_t event; //the event which triggered the fetch
 };
 
 /*////////////////////////////////////////////////////////////////////////////////////////////////
@@ -126,12 +202,33 @@ typedef map<uint32_t, PAClientInfo*> pa_client_list;
 typedef map<uint32_t, PASinkInputInfo*> pa_sink_input_list;
 
 class PAManager {
+	friend class PACoro;
+	friend class PAOpAwaiter;
 public:
 	PAManager();
 	~PAManager();
 	
-	void Init();
+	/* connect & get all objects. PAManager takes ownership of backend,
+	 * if it's NULL libpulse is used. server NULL means default server */
+	void Init(PABackend* backend=NULL, const char* server=NULL);
 	void DeInit();
+	/* after the connection was lost (eg. the server restarted): connect
+	 * again to the same server with the same backend, get all objects and
+	 * subscribe again. operations issued before are failed. throws like
+	 * Init() if the server is not reachable, then it can be called again */
+	void reconnect();
+	
+	PABackend* Backend() { return(m_backend); }
+	
+	/* keep the object lists up to date with server events. cb (can be NULL)
+	 * is called after the lists are updated. objects returned before can
+	 * be deleted by an update. */
+	void subscribe(pa_subscription_mask_t mask, pa_backend_event_cb_t cb=NULL, void* userdata=NULL);
+	/* getTimeUsec() when the event arrived whose callback is running. the
+	 * callback of a new or changed object comes after its fetch */
+	uint64_t eventTime() const { return(m_event_time); }
+	/* run the event loop once, wait at most timeout_ms (-1: block) */
+	void iterate(int timeout_ms);
 	
 	const pa_dev_list& Sinks() const { return(m_sinks); }
 	PADeviceInfo* Sink(uint32_t idx); /* returns NULL if not found */
@@ -185,14 +282,54 @@ public:
 	void setSinkInputVolume(uint32_t idx, const string& volume, const vector<int>* channel_list=NULL);
 	void setSinkInputVolume(uint32_t idx, const pa_cvolume& volume);
 	void setSinkInputMute(uint32_t idx, int mute);
+	/* move a playback stream to another sink */
+	void moveSinkInput(uint32_t idx, uint32_t sink_idx);
+	/* suspend (suspend!=0) or resume a sink or source */
+	void suspendSink(uint32_t idx, int suspend);
+	void suspendSource(uint32_t idx, int suspend);
+	
+	/* batching: after beginBatch() the set* functions issue the operation
+	 * and return without waiting for the server. flush() waits for all of
+	 * them, so a batch costs a single round trip.
+	 * returns false if an operation failed */
+	void beginBatch();
+	bool flush();
+	
+	/* apply a volume string (format see above) to value */
+	static void applyVolume(const string& volume, pa_volume_t& value);
+	// this will call applyVolume for all chosen channels:
+	static void applyVolumeChannel(const string& volume, pa_cvolume& vol, const vector<int>* channel_list);
+	/* true if the volumes differ by at most tolerance per channel (the
+	 * server may round a written volume) */
+	static bool volumeClose(const pa_cvolume& a, const pa_cvolume& b, pa_volume_t tolerance=16);
+	
+	/* round-trip latency statistics, per operation type */
+	CLatencyHistogram& latencyStats(EPAOpType type) { return(m_latency[type]); }
+	const CLatencyHistogram& latencyStats(EPAOpType type) const { return(m_latency[type]); }
+	void resetLatencyStats();
+	/* table with count, p50/p90/p99/max of all used operation types */
+	string LatencyStatsInfo() const;
 	
 private:
 	
 	void InitPAInfo();
+	void clearLists();
+	/* set sink_obj & client_obj of the sink inputs */
+	void linkSinkInputs();
 	
-	void applyVolume(const string& volume, pa_volume_t& value);
-	// this will call applyVolume for all chosen channels:
-	void applyVolumeChannel(const string& volume, pa_cvolume& vol, const vector<int>* channel_list);
+	/* wait until the operation completed */
+	void waitForOperation(PAPendingOp& op);
+	
+	static void eventCb(pa_subscription_event_type_t type, uint32_t idx, void* userdata);
+	static void eventFetchDone(PAPendingOp* op);
+	void handleEvent(pa_subscription_event_type_t type, uint32_t idx);
+	
+	/* set* operations: newOperation() creates the op, completeOperation()
+	 * waits for it unless a batch is active */
+	PAPendingOp& newOperation(EPAOpType type, uint32_t idx);
+	void completeOperation(PAPendingOp& op);
+	/* the connection is gone, no callback will come for the issued operations */
+	void dropOperations();
 	
 	pa_dev_list m_sinks;
 	pa_dev_list m_sources;
@@ -202,10 +339,21 @@ private:
 	pa_client_list m_clients;
 	pa_sink_input_list m_sink_inputs; /* these are the connected playback streams */
 	
-	/* pulseaudio stuff */
-	pa_context* m_pa_context;
-	pa_mainloop* m_pa_mainloop;
-	int m_pa_ready; //used for callback
+	PABackend* m_backend;
+	uint64_t m_connect_start;
+	string m_server; //"" is the default server
+	
+	deque<PAPendingOp> m_operations; //issued set* operations (a deque does not move its elements)
+	bool m_bBatch;
+	
+	bool m_bSubscribed;
+	pa_subscription_mask_t m_subscription_mask;
+	pa_backend_event_cb_t m_event_cb;
+	void* m_event_userdata;
+	uint64_t m_event_time;
+	set<PAListOp*> m_event_ops; //object fetches of events
+	
+	CLatencyHistogram m_latency[PAOp_count];
 };
 
 
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_meter.h"
+
+#include <cstdio>
+#include <cmath>
+
+
+string loudnessJson(const SLoudness& loudness) {
+	const char* names[]={ "momentary", "short_term", "integrated", "lra" };
+	double values[]={ loudness.momentary, loudness.short_term, loudness.integrated, loudness.range };
+	string ret;
+	char buffer[32];
+	for(int i=0; i<4; ++i) {
+		if(std::isinf(values[i])) snprintf(buffer, sizeof(buffer), "null");
+		else snprintf(buffer, sizeof(buffer), "%.1f", values[i]);
+		ret+=string(",\"")+names[i]+"\":"+buffer;
+	}
+	return(ret);
+}
+
+static string loudnessValue(double value, const char* unit) {
+	if(std::isinf(value)) return("-");
+	return(roundStr((float)value, 1)+" "+unit);
+}
+
+string loudnessStr(const SLoudness& loudness) {
+	return("loudness: momentary "+loudnessValue(loudness.momentary, "LUFS")
+		+", short-term "+loudnessValue(loudness.short_term, "LUFS")
+		+", integrated "+loudnessValue(loudness.integrated, "LUFS")
+		+", range "+loudnessValue(loudness.range, "LU"));
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAMeter
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAMeter::PAMeter(PAManager& manager) : m_manager(manager), m_bPeak_detect(false), m_bLoudness(false)
+	, m_fragment_usec(10000) {
+}
+
+PAMeter::~PAMeter() {
+	close();
+}
+
+void PAMeter::setMode(bool bPeak_detect, uint32_t fragment_usec) {
+	m_bPeak_detect=bPeak_detect;
+	m_fragment_usec=fragment_usec>0 ? fragment_usec : 10000;
+}
+
+bool PAMeter::addSink(uint32_t idx) {
+	PADeviceInfo* sink=m_manager.Sink(idx);
+	if(!sink) return(false);
+	return(open(PADev_sink, *sink, sink->monitor_name));
+}
+
+bool PAMeter::addSource(uint32_t idx) {
+	PADeviceInfo* source=m_manager.Source(idx);
+	if(!source) return(false);
+	return(open(PADev_source, *source, source->name));
+}
+
+bool PAMeter::open(EPADeviceType type, const PADeviceInfo& device, const string& source) {
+	PABackend* backend=m_manager.Backend();
+	if(!backend) return(false);
+	
+	PARecordSpec spec;
+	spec.source=source;
+	spec.channels=device.sample_spec.channels;
+	spec.channel_map=device.channel_map;
+	spec.fragment_usec=m_fragment_usec;
+	spec.bPeak_detect=m_bPeak_detect;
+	/* one peak per fragment */
+	if(m_bPeak_detect) spec.rate=1000000/m_fragment_usec>0 ? 1000000/m_fragment_usec : 1;
+	else spec.rate=device.sample_spec.rate;
+	
+	SMeterStream* stream=new SMeterStream();
+	stream->meter=this;
+	stream->type=type;
+	stream->index=device.index;
+	stream->name=device.name;
+	stream->levels.reset(spec.channels);
+	stream->bPeak_detect=m_bPeak_detect;
+	stream->loudness=NULL;
+	if(m_bLoudness && !m_bPeak_detect) {
+		stream->loudness=new CLoudness();
+		stream->loudness->init(spec.rate, spec.channels);
+	}
+	stream->bEnded=false;
+	stream->bReported_end=false;
+	stream->id=backend->openRecordStream(spec, recordCb, stream);
+	if(stream->id==0) {
+		LOG(WARN, "failed to open a record stream on %s", source.c_str());
+		delete(stream->loudness);
+		delete(stream);
+		return(false);
+	}
+	m_streams.push_back(stream);
+	return(true);
+}
+
+void PAMeter::close() {
+	PABackend* backend=m_manager.Backend();
+	for(size_t i=0; i<m_streams.size(); ++i) {
+		if(backend && !m_streams[i]->bEnded) backend->closeStream(m_streams[i]->id);
+		delete(m_streams[i]->loudness);
+		delete(m_streams[i]);
+	}
+	m_streams.clear();
+}
+
+bool PAMeter::active() const {
+	for(size_t i=0; i<m_streams.size(); ++i) {
+		if(!m_streams[i]->bEnded) return(true);
+	}
+	return(false);
+}
+
+void PAMeter::recordCb(const float* samples, size_t frames, void* userdata) {
+	SMeterStream* stream=(SMeterStream*)userdata;
+	if(!samples) {
+		stream->bEnded=true;
+		return;
+	}
+	stream->levels.add(samples, frames);
+	if(stream->loudness) stream->loudness->process(samples, frames);
+}
+
+static void writeDbList(ostream& out, const char* key, const double* values, uint8_t channels) {
+	char buffer[32];
+	out << ",\"" << key << "\":[";
+	for(uint8_t k=0; k<channels; ++k) {
+		snprintf(buffer, sizeof(buffer), "%s%.1f", k>0 ? "," : "", levelToDb(values[k]));
+		out << buffer;
+	}
+	out << "]";
+}
+
+void PAMeter::report(ostream& out, double time) {
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.3f", time);
+	
+	double values[PA_CHANNELS_MAX];
+	for(size_t i=0; i<m_streams.size(); ++i) {
+		SMeterStream& stream=*m_streams[i];
+		if(stream.bReported_end) continue;
+		
+		out << "{\"time\":" << buffer << ",\"type\":\"" << (stream.type==PADev_sink ? "sink" : "source")
+			<< "\",\"index\":" << stream.index << ",\"name\":" << jsonStr(stream.name);
+		if(stream.bEnded) {
+			out << ",\"ended\":true}" << endl;
+			stream.bReported_end=true;
+			continue;
+		}
+		
+		SLevels& levels=stream.levels;
+		for(uint8_t k=0; k<levels.channels; ++k) values[k]=levels.peak[k];
+		writeDbList(out, "peak", values, levels.channels);
+		if(!stream.bPeak_detect) {
+			for(uint8_t k=0; k<levels.channels; ++k) values[k]=levels.rms(k);
+			writeDbList(out, "rms", values, levels.channels);
+		}
+		if(stream.loudness) {
+			SLoudness loudness;
+			stream.loudness->values(loudness);
+			out << loudnessJson(loudness);
+		}
+		out << "}" << endl;
+		levels.reset(levels.channels);
+	}
+}
+
+bool PAMeter::loudness(EPADeviceType type, uint32_t index, SLoudness& loudness) const {
+	for(size_t i=0; i<m_streams.size(); ++i) {
+		const SMeterStream& stream=*m_streams[i];
+		if(stream.type!=type || stream.index!=index || !stream.loudness) continue;
+		stream.loudness->values(loudness);
+		return(true);
+	}
+	return(false);
+}
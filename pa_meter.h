@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_METER_H_
+#define PA_METER_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include "levels.h"
+#include "loudness.h"
+
+
+/* json members with the loudness (starting with ','), null if not measured */
+string loudnessJson(const SLoudness& loudness);
+/* for the listing */
+string loudnessStr(const SLoudness& loudness);
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAMeter
+ * peak & RMS level meters of sinks and sources. every device gets a record
+ * stream: a sink is recorded on its monitor source. the levels are
+ * accumulated until the next report().
+ *
+ * with peak detection the server reduces the signal to one peak per
+ * fragment, which costs almost nothing but gives no RMS. otherwise the
+ * stream has the rate of the device and the levels are computed here.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAMeter {
+public:
+	PAMeter(PAManager& manager);
+	~PAMeter();
+	
+	/* for the streams added afterwards */
+	void setMode(bool bPeak_detect, uint32_t fragment_usec=10000);
+	/* measure the loudness as well (not with peak detection) */
+	void setLoudness(bool bLoudness) { m_bLoudness=bLoudness; }
+	
+	/* returns false if the device does not exist or the stream could not
+	 * be opened */
+	bool addSink(uint32_t idx);
+	bool addSource(uint32_t idx);
+	void close();
+	
+	size_t count() const { return(m_streams.size()); }
+	/* a stream did not end yet */
+	bool active() const;
+	
+	/* write one json line per device with the levels since the last report
+	 * in dBFS and reset them. time is in seconds. an ended stream is
+	 * reported once with "ended":true */
+	void report(ostream& out, double time);
+	
+	/* false if the device is not metered with loudness */
+	bool loudness(EPADeviceType type, uint32_t index, SLoudness& loudness) const;
+	
+private:
+	struct SMeterStream {
+		PAMeter* meter;
+		uint32_t id;
+		EPADeviceType type;
+		uint32_t index;
+		string name;
+		SLevels levels;
+		CLoudness* loudness; //NULL if not measured
+		bool bPeak_detect;
+		bool bEnded;
+		bool bReported_end;
+	};
+	
+	bool open(EPADeviceType type, const PADeviceInfo& device, const string& source);
+	static void recordCb(const float* samples, size_t frames, void* userdata);
+	
+	PAManager& m_manager;
+	vector<SMeterStream*> m_streams;
+	bool m_bPeak_detect;
+	bool m_bLoudness;
+	uint32_t m_fragment_usec;
+};
+
+
+#endif /* PA_METER_H_ */
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_normalizer.h"
+#include <cmath>
+
+
+PANormalizeConfig::PANormalizeConfig() : target_lufs(-23.0), attack_ms(1000.0), release_ms(8000.0)
+	, hysteresis_lu(2.0), min_step_db(0.5), max_boost_db(6.0), max_cut_db(30.0), gate_lufs(-50.0)
+	, override_hold_ms(30000) {
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PANormalizer
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PANormalizer::PANormalizer(PAManager& manager, size_t capacity) : m_manager(manager), m_meter(manager, capacity)
+	, m_filter(NULL), m_filter_userdata(NULL), m_interval_ms(0), m_history_length(1) {
+	
+	setInterval(100);
+}
+
+void PANormalizer::setFilter(pa_sink_input_filter_t filter, void* userdata) {
+	m_filter=filter;
+	m_filter_userdata=userdata;
+	m_meter.setFilter(filter, userdata);
+}
+
+void PANormalizer::setInterval(uint32_t interval_ms) {
+	ASSERT_THROW(interval_ms>0, EINVALID_PARAMETER);
+	m_interval_ms=interval_ms;
+	m_history_length=(int)((3000+interval_ms-1)/interval_ms);
+	if(m_history_length>NORMALIZE_HISTORY) m_history_length=NORMALIZE_HISTORY;
+	m_meter.setMode(interval_ms*1000, 48000);
+	m_meter.setLoudness(true);
+}
+
+void PANormalizer::initStream(SNormStream& stream, const pa_cvolume& volume) {
+	stream.user=volume;
+	stream.written=volume;
+	stream.previous=volume;
+	stream.gain_db=0.0;
+	stream.smooth_db=0.0;
+	stream.bCorrecting=false;
+	stream.hold_until=0;
+	for(int i=0; i<NORMALIZE_HISTORY; ++i) stream.history[i]=1.0f;
+	stream.history_pos=0;
+}
+
+void PANormalizer::sync() {
+	m_meter.sync();
+	
+	const pa_sink_input_list& sink_inputs=m_manager.SinkInputs();
+	for(map<uint32_t, SNormStream>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ) {
+		if(sink_inputs.find(iter->first)==sink_inputs.end()) m_streams.erase(iter++);
+		else ++iter;
+	}
+	for(pa_sink_input_list::const_iterator iter=sink_inputs.begin(); iter!=sink_inputs.end(); ++iter) {
+		if(m_streams.find(iter->first)!=m_streams.end()) continue;
+		if(!m_filter || m_filter(*iter->second, m_filter_userdata)) initStream(m_streams[iter->first], iter->second->volume);
+	}
+}
+
+bool PANormalizer::isOverride(SNormStream& stream, const pa_cvolume& volume) {
+	if(PAManager::volumeClose(volume, stream.written)) {
+		stream.previous=stream.written; //the write arrived
+		return(false);
+	}
+	return(!PAManager::volumeClose(volume, stream.previous));
+}
+
+bool PANormalizer::control(SNormStream& stream, double loudness, PANormalizeChange& change) {
+	if(loudness==-HUGE_VAL) return(false); //less than 3s measured
+	
+	/* remove the average gain of the measured 3s */
+	double power=0.0;
+	for(int i=0; i<m_history_length; ++i) power+=stream.history[i];
+	loudness-=10.0*log10(power/m_history_length);
+	if(loudness<m_config.gate_lufs) return(false);
+	
+	/* hysteresis: the stream is only corrected once it left the band and
+	 * until the correction is done */
+	if(!stream.bCorrecting) {
+		if(fabs(m_config.target_lufs-(loudness+stream.gain_db))<=m_config.hysteresis_lu) return(false);
+		stream.bCorrecting=true;
+		stream.smooth_db=stream.gain_db;
+	}
+	double desired=m_config.target_lufs-loudness;
+	if(desired>m_config.max_boost_db) desired=m_config.max_boost_db;
+	if(desired<-m_config.max_cut_db) desired=-m_config.max_cut_db;
+	
+	double time_constant=desired<stream.smooth_db ? m_config.attack_ms : m_config.release_ms;
+	stream.smooth_db+=(desired-stream.smooth_db)*(1.0-exp(-(double)m_interval_ms/time_constant));
+	if(fabs(desired-stream.smooth_db)<m_config.min_step_db) {
+		stream.smooth_db=desired;
+		stream.bCorrecting=false;
+	}
+	if(fabs(stream.smooth_db-stream.gain_db)<m_config.min_step_db) return(false);
+	
+	stream.gain_db=stream.smooth_db;
+	change.loudness=loudness;
+	change.gain_db=stream.gain_db;
+	return(true);
+}
+
+size_t PANormalizer::tick(vector<PANormalizeChange>* changes) {
+	uint64_t now=getTimeUsec();
+	size_t writes=0;
+	SLevelEntry entry;
+	
+	for(map<uint32_t, SNormStream>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ++iter) {
+		PASinkInputInfo* sink_input=m_manager.SinkInput(iter->first);
+		if(!sink_input) continue;
+		SNormStream& stream=iter->second;
+		
+		if(isOverride(stream, sink_input->volume)) {
+			LOG(DEBUG, "volume of sink input %u changed by the user, pausing the normalization", iter->first);
+			initStream(stream, sink_input->volume);
+			stream.hold_until=now+m_config.override_hold_ms*1000ULL;
+		}
+		
+		/* the gain in effect during the last interval */
+		stream.history[stream.history_pos]=(float)pow(10.0, stream.gain_db/10.0);
+		stream.history_pos=(stream.history_pos+1)%m_history_length;
+		
+		if(now<stream.hold_until || sink_input->mute) continue;
+		if(!m_meter.table().find(iter->first, entry) || entry.updates==0) continue;
+		
+		PANormalizeChange change;
+		change.sink_input=iter->first;
+		if(!control(stream, entry.loudness.short_term, change)) continue;
+		
+		pa_cvolume volume=stream.user;
+		pa_volume_t gain=pa_sw_volume_from_dB(stream.gain_db);
+		for(uint8_t i=0; i<volume.channels; ++i) volume.values[i]=pa_sw_volume_multiply(stream.user.values[i], gain);
+		stream.previous=stream.written;
+		stream.written=volume;
+		
+		/* the writes of a tick cost a single round trip */
+		if(writes==0) m_manager.beginBatch();
+		m_manager.setSinkInputVolume(iter->first, volume);
+		++writes;
+		if(changes) changes->push_back(change);
+	}
+	
+	if(writes>0 && !m_manager.flush()) LOG(WARN, "not all volume changes of the normalization were applied");
+	return(writes);
+}
+
+void PANormalizer::close() {
+	m_meter.close();
+	
+	size_t writes=0;
+	for(map<uint32_t, SNormStream>::iterator iter=m_streams.begin(); iter!=m_streams.end(); ++iter) {
+		SNormStream& stream=iter->second;
+		PASinkInputInfo* sink_input=m_manager.SinkInput(iter->first);
+		if(!sink_input || stream.gain_db==0.0 || isOverride(stream, sink_input->volume)) continue;
+		if(writes==0) m_manager.beginBatch();
+		m_manager.setSinkInputVolume(iter->first, stream.user);
+		++writes;
+	}
+	m_streams.clear();
+	
+	if(writes>0 && !m_manager.flush()) LOG(WARN, "not all volumes were restored");
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_NORMALIZER_H_
+#define PA_NORMALIZER_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include "pa_stream_meter.h"
+#include <map>
+
+
+#define NORMALIZE_HISTORY 64 //ticks of applied gain, covers the 3s of the short-term loudness
+
+/* control loop of the normalization */
+struct PANormalizeConfig {
+	PANormalizeConfig();
+	
+	double target_lufs;
+	double attack_ms; //time constant to lower the volume
+	double release_ms; //time constant to raise the volume
+	double hysteresis_lu; //start correcting when the loudness is off by more than this
+	double min_step_db; //smaller volume changes are not written
+	double max_boost_db; //limits of the gain, relative to the volume of the user
+	double max_cut_db;
+	double gate_lufs; //quieter streams keep their volume (pauses, silence)
+	uint32_t override_hold_ms; //a stream is left alone for this long after the user changed its volume
+};
+
+/* a volume change of a tick */
+struct PANormalizeChange {
+	uint32_t sink_input;
+	double loudness; //short-term loudness of the stream without the gain (LUFS)
+	double gain_db; //relative to the volume of the user
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PANormalizer
+ * closed-loop loudness normalization of the playback streams: the
+ * short-term loudness of every sink input is measured on its monitor
+ * (PAStreamMeter) and its volume is moved toward the target.
+ *
+ * the measurement contains the gain of the last 3s, so it is divided by
+ * the average of the applied gain over that time. the gain is smoothed
+ * with an attack & release time constant and only corrected when the
+ * loudness leaves the hysteresis band. all volume writes of a tick are
+ * pipelined & flushed together, changes below min_step_db are not written.
+ * a volume change by someone else is taken as the new volume of the user.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PANormalizer {
+public:
+	PANormalizer(PAManager& manager, size_t capacity=256);
+	
+	void setConfig(const PANormalizeConfig& config) { m_config = config; }
+	const PANormalizeConfig& config() const { return(m_config); }
+	/* normalize only the sink inputs for which filter returns true */
+	void setFilter(pa_sink_input_filter_t filter, void* userdata);
+	/* interval of tick(), the loudness is published at this interval */
+	void setInterval(uint32_t interval_ms);
+	
+	/* follow new & removed sink inputs. call it after the sink inputs
+	 * changed, eg. from the subscription callback */
+	void sync();
+	/* one step of the control loop, call it every interval. returns the
+	 * number of volume writes, the changes are appended to changes */
+	size_t tick(vector<PANormalizeChange>* changes=NULL);
+	/* restore the volumes of the users & stop */
+	void close();
+	
+	size_t count() const { return(m_streams.size()); }
+	const PAStreamMeter& meter() const { return(m_meter); }
+	
+private:
+	struct SNormStream {
+		pa_cvolume user; //the volume set by the user, the gain is relative to it
+		pa_cvolume written; //last volume written by us
+		pa_cvolume previous; //the volume before, as long as the event of the write is pending
+		double gain_db; //applied gain
+		double smooth_db; //output of the attack/release filter
+		bool bCorrecting; //outside of the hysteresis band
+		uint64_t hold_until; //user override
+		float history[NORMALIZE_HISTORY]; //applied gain (power) of the last ticks
+		int history_pos;
+	};
+	
+	void initStream(SNormStream& stream, const pa_cvolume& volume);
+	/* the volume was changed by someone else */
+	static bool isOverride(SNormStream& stream, const pa_cvolume& volume);
+	/* returns true if the volume needs to be written */
+	bool control(SNormStream& stream, double loudness, PANormalizeChange& change);
+	
+	PAManager& m_manager;
+	PAStreamMeter m_meter;
+	PANormalizeConfig m_config;
+	map<uint32_t, SNormStream> m_streams; //key is the sink input index
+	
+	pa_sink_input_filter_t m_filter;
+	void* m_filter_userdata;
+	
+	uint32_t m_interval_ms;
+	int m_history_length;
+};
+
+
+#endif /* PA_NORMALIZER_H_ */
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_selector.h"
+
+
+template<class Object>
+static void allIndexes(const map<uint32_t, Object*>& objects, vector<uint32_t>& indexes) {
+	indexes.clear();
+	for(typename map<uint32_t, Object*>::const_iterator iter=objects.begin(); iter!=objects.end(); ++iter) {
+		indexes.push_back(iter->first);
+	}
+}
+
+template<class Object>
+static bool selectIndex(const map<uint32_t, Object*>& objects, uint32_t idx, vector<uint32_t>& indexes) {
+	indexes.clear();
+	if(objects.find(idx)==objects.end()) return(false);
+	indexes.push_back(idx);
+	return(true);
+}
+
+
+bool selectSinks(PAManager& manager, const PACmdSelector& selector, vector<uint32_t>& indexes) {
+	switch(selector.type) {
+	case PACmdSelect_index: return(selectIndex(manager.Sinks(), selector.index, indexes));
+	case PACmdSelect_name: return(manager.getSinks(selector.name, indexes));
+	default: break;
+	}
+	allIndexes(manager.Sinks(), indexes);
+	return(true);
+}
+
+bool selectSources(PAManager& manager, const PACmdSelector& selector, vector<uint32_t>& indexes) {
+	switch(selector.type) {
+	case PACmdSelect_index: return(selectIndex(manager.Sources(), selector.index, indexes));
+	case PACmdSelect_name: return(manager.getSources(selector.name, indexes));
+	default: break;
+	}
+	allIndexes(manager.Sources(), indexes);
+	return(true);
+}
+
+bool selectSinkInputs(PAManager& manager, const PACmdSelector& selector, vector<uint32_t>& indexes) {
+	switch(selector.type) {
+	case PACmdSelect_index: return(selectIndex(manager.SinkInputs(), selector.index, indexes));
+	case PACmdSelect_name: return(manager.getSinkInputsFromClient(selector.name, indexes));
+	default: break;
+	}
+	allIndexes(manager.SinkInputs(), indexes);
+	return(true);
+}
+
+bool selectCards(PAManager& manager, const PACmdSelector& selector, vector<uint32_t>& indexes) {
+	switch(selector.type) {
+	case PACmdSelect_index: return(selectIndex(manager.Cards(), selector.index, indexes));
+	case PACmdSelect_name: return(manager.getCard(selector.name, indexes));
+	default: break;
+	}
+	allIndexes(manager.Cards(), indexes);
+	return(true);
+}
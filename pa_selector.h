@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_SELECTOR_H_
+#define PA_SELECTOR_H_
+
+#include "global.h"
+#include "pacmdvolume.h"
+#include "pa_manager.h"
+
+
+/* resolve a selector to the indexes of the matching objects (in index
+ * order). a selector for all objects always succeeds, the others return
+ * false if nothing matched. sink inputs are matched by the client name */
+bool selectSinks(PAManager& manager, const PACmdSelector& selector, vector<uint32_t>& indexes);
+bool selectSources(PAManager& manager, const PACmdSelector& selector, vector<uint32_t>& indexes);
+bool selectSinkInputs(PAManager& manager, const PACmdSelector& selector, vector<uint32_t>& indexes);
+bool selectCards(PAManager& manager, const PACmdSelector& selector, vector<uint32_t>& indexes);
+
+
+#endif /* PA_SELECTOR_H_ */
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_spectrum.h"
+
+#include <cstdio>
+#include <chrono>
+
+
+PASpectrumConfig::PASpectrumConfig() : rate(48000), size(4096), hop(1024), bands(Spectrum_third_octave)
+	, fragment_usec(10000), buffer_ms(1000) {
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PASpectrum
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PASpectrum::PASpectrum(PAManager& manager) : m_manager(manager), m_type(PADev_sink), m_index(PA_INVALID_INDEX)
+	, m_id(0), m_bEnded(false), m_dropped(0), m_bStop(false) {
+}
+
+PASpectrum::~PASpectrum() {
+	close();
+}
+
+bool PASpectrum::openSink(uint32_t idx) {
+	PADeviceInfo* sink=m_manager.Sink(idx);
+	if(!sink) return(false);
+	return(open(PADev_sink, *sink, sink->monitor_name));
+}
+
+bool PASpectrum::openSource(uint32_t idx) {
+	PADeviceInfo* source=m_manager.Source(idx);
+	if(!source) return(false);
+	return(open(PADev_source, *source, source->name));
+}
+
+bool PASpectrum::open(EPADeviceType type, const PADeviceInfo& device, const string& source) {
+	PABackend* backend=m_manager.Backend();
+	if(!backend || m_id!=0) return(false);
+	
+	/* everything is allocated here, not while running */
+	m_spectrum.init(m_config.rate, m_config.size, m_config.hop, m_config.bands);
+	m_db.resize(m_spectrum.bands());
+	m_chunk.resize(m_config.hop);
+	m_ring.init((size_t)m_config.rate*m_config.buffer_ms/1000);
+	m_type=type;
+	m_index=device.index;
+	m_name=device.name;
+	m_bEnded=false;
+	m_dropped=0;
+	
+	PARecordSpec spec;
+	spec.source=source;
+	spec.rate=m_config.rate;
+	spec.channels=1;
+	spec.fragment_usec=m_config.fragment_usec;
+	m_bStop=false;
+	m_worker=thread(&PASpectrum::work, this);
+	m_id=backend->openRecordStream(spec, recordCb, this);
+	if(m_id==0) {
+		LOG(WARN, "failed to open a record stream on %s", source.c_str());
+		close();
+		return(false);
+	}
+	return(true);
+}
+
+void PASpectrum::close() {
+	PABackend* backend=m_manager.Backend();
+	if(m_id!=0 && backend && !m_bEnded) backend->closeStream(m_id);
+	m_id=0;
+	if(m_worker.joinable()) {
+		m_bStop=true;
+		m_wake.notify_one();
+		m_worker.join();
+	}
+}
+
+void PASpectrum::recordCb(const float* samples, size_t frames, void* userdata) {
+	PASpectrum* spectrum=(PASpectrum*)userdata;
+	if(!samples) {
+		spectrum->m_bEnded=true;
+		return;
+	}
+	if(!spectrum->m_ring.push(samples, frames)) {
+		spectrum->m_dropped+=frames;
+		return;
+	}
+	/* the worker only needs to wake up for a transform */
+	if(spectrum->m_ring.available()>=spectrum->m_config.hop) spectrum->m_wake.notify_one();
+}
+
+void PASpectrum::work() {
+	while(!m_bStop) {
+		size_t count=m_ring.pop(&m_chunk[0], m_chunk.size());
+		if(count==0) {
+			/* a notification between the check & the wait is lost, the
+			 * timeout limits the delay */
+			unique_lock<mutex> lock(m_wake_mutex);
+			m_wake.wait_for(lock, chrono::milliseconds(10), [this]() {
+				return(m_bStop || m_ring.available()>=m_config.hop);
+			});
+			continue;
+		}
+		lock_guard<mutex> lock(m_spectrum_mutex);
+		m_spectrum.process(&m_chunk[0], count);
+	}
+}
+
+void PASpectrum::report(ostream& out, double time) {
+	uint32_t transforms;
+	{
+		lock_guard<mutex> lock(m_spectrum_mutex);
+		transforms=m_spectrum.transforms();
+		if(!m_spectrum.take(m_db)) return;
+	}
+	
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.3f", time);
+	out << "{\"time\":" << buffer << ",\"type\":\"spectrum\",\"device\":\"" << (m_type==PADev_sink ? "sink" : "source")
+		<< "\",\"index\":" << m_index << ",\"name\":" << jsonStr(m_name) << ",\"transforms\":" << transforms;
+	if(m_dropped>0) out << ",\"dropped\":" << m_dropped.load();
+	if(m_config.bands==Spectrum_bins) {
+		snprintf(buffer, sizeof(buffer), "%.4f", (double)m_config.rate/m_config.size);
+		out << ",\"bin_hz\":" << buffer;
+	} else {
+		out << ",\"bands\":\"" << (m_config.bands==Spectrum_octave ? "octave" : "third_octave") << "\",\"hz\":[";
+		for(size_t i=0; i<m_db.size(); ++i) {
+			snprintf(buffer, sizeof(buffer), "%s%g", i>0 ? "," : "", m_spectrum.frequency(i));
+			out << buffer;
+		}
+		out << "]";
+	}
+	out << ",\"db\":[";
+	for(size_t i=0; i<m_db.size(); ++i) {
+		snprintf(buffer, sizeof(buffer), "%s%.1f", i>0 ? "," : "", m_db[i]);
+		out << buffer;
+	}
+	out << "]}" << endl;
+}
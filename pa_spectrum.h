@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_SPECTRUM_H_
+#define PA_SPECTRUM_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include "sample_ring.h"
+#include "spectrum.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+struct PASpectrumConfig {
+	PASpectrumConfig();
+	
+	uint32_t rate; //the server resamples to it
+	uint32_t size; //of the transforms, a power of 2
+	uint32_t hop; //samples between transforms (size/4: 75% overlap)
+	ESpectrumBands bands;
+	uint32_t fragment_usec;
+	uint32_t buffer_ms; //of the ring between the stream & the worker
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PASpectrum
+ * spectrum analyzer of one device: a sink is recorded on its monitor
+ * source, mono at the configured rate. the record callback only copies
+ * the fragments into a lock-free ring (CSampleRing), the transforms run
+ * in a worker thread, so they overlap with the capture and don't delay
+ * the event loop. if the worker falls behind, the fragments which don't
+ * fit into the ring are dropped and counted.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PASpectrum {
+public:
+	PASpectrum(PAManager& manager);
+	~PASpectrum();
+	
+	/* before open */
+	void setConfig(const PASpectrumConfig& config) { m_config=config; }
+	
+	/* returns false if the device does not exist or the stream could not
+	 * be opened */
+	bool openSink(uint32_t idx);
+	bool openSource(uint32_t idx);
+	void close();
+	
+	/* the stream did not end yet */
+	bool active() const { return(m_id!=0 && !m_bEnded.load()); }
+	uint64_t dropped() const { return(m_dropped.load()); }
+	
+	/* write a json line with the mean spectrum since the last report in
+	 * dBFS, nothing if no transform completed meanwhile. time is in
+	 * seconds */
+	void report(ostream& out, double time);
+	
+private:
+	bool open(EPADeviceType type, const PADeviceInfo& device, const string& source);
+	static void recordCb(const float* samples, size_t frames, void* userdata);
+	void work();
+	
+	PAManager& m_manager;
+	PASpectrumConfig m_config;
+	EPADeviceType m_type;
+	uint32_t m_index;
+	string m_name;
+	uint32_t m_id; //of the stream, 0 if not open
+	std::atomic<bool> m_bEnded;
+	std::atomic<uint64_t> m_dropped; //samples
+	
+	CSampleRing m_ring;
+	std::thread m_worker;
+	std::atomic<bool> m_bStop;
+	std::mutex m_wake_mutex;
+	std::condition_variable m_wake;
+	vector<float> m_chunk; //worker only
+	
+	std::mutex m_spectrum_mutex; //between the worker & report()
+	CSpectrum m_spectrum;
+	vector<float> m_db;
+};
+
+
+#endif /* PA_SPECTRUM_H_ */
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_stream_meter.h"
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAStreamMeter
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAStreamMeter::PAStreamMeter(PAManager& manager, size_t capacity) : m_manager(manager), m_table(capacity)
+	, m_slots(capacity), m_window_usec(100000), m_rate(8000), m_fragment_usec(20000)
+	, m_filter(NULL), m_filter_userdata(NULL) {
+	
+	for(size_t i=0; i<m_slots.size(); ++i) {
+		m_slots[i].meter=this;
+		m_slots[i].id=0;
+		m_slots[i].bEnded=false;
+		m_slots[i].slot=(int)i;
+	}
+}
+
+PAStreamMeter::~PAStreamMeter() {
+	close();
+}
+
+void PAStreamMeter::setMode(uint32_t window_usec, uint32_t rate, uint32_t fragment_usec) {
+	if(window_usec>0) m_window_usec=window_usec;
+	if(rate>0) m_rate=rate;
+	if(fragment_usec>0) m_fragment_usec=fragment_usec;
+}
+
+void PAStreamMeter::setLoudness(bool bLoudness) {
+	if(!bLoudness) {
+		m_loudness.clear();
+		return;
+	}
+	m_loudness.resize(m_slots.size());
+	m_rate=48000;
+}
+
+void PAStreamMeter::setFilter(pa_sink_input_filter_t filter, void* userdata) {
+	m_filter=filter;
+	m_filter_userdata=userdata;
+}
+
+void PAStreamMeter::sync() {
+	const pa_sink_input_list& sink_inputs=m_manager.SinkInputs();
+	
+	/* removed, moved or ended */
+	for(map<uint32_t, int>::iterator iter=m_sink_inputs.begin(); iter!=m_sink_inputs.end(); ) {
+		SStreamSlot& stream=m_slots[iter->second];
+		pa_sink_input_list::const_iterator sink_input=sink_inputs.find(iter->first);
+		if(sink_input==sink_inputs.end() || sink_input->second->sink!=stream.sink || stream.bEnded) {
+			closeSlot(stream);
+			m_sink_inputs.erase(iter++);
+		} else {
+			++iter;
+		}
+	}
+	
+	for(pa_sink_input_list::const_iterator iter=sink_inputs.begin(); iter!=sink_inputs.end(); ++iter) {
+		if(m_sink_inputs.find(iter->first)!=m_sink_inputs.end()) continue;
+		if(!m_filter || m_filter(*iter->second, m_filter_userdata)) open(*iter->second);
+	}
+}
+
+bool PAStreamMeter::open(const PASinkInputInfo& sink_input) {
+	PABackend* backend=m_manager.Backend();
+	PADeviceInfo* sink=m_manager.Sink(sink_input.sink);
+	if(!backend || !sink) return(false);
+	
+	int slot=m_table.acquire(sink_input.index);
+	if(slot<0) {
+		LOG(WARN, "level table full, sink input %u is not metered", sink_input.index);
+		return(false);
+	}
+	
+	PARecordSpec spec;
+	spec.source=sink->monitor_name;
+	spec.sink_input=sink_input.index;
+	spec.rate=m_rate;
+	spec.channels=sink_input.sample_spec.channels<LEVEL_TABLE_CHANNELS ? sink_input.sample_spec.channels : LEVEL_TABLE_CHANNELS;
+	spec.channel_map=sink_input.channel_map; //not used if the channels are limited
+	spec.fragment_usec=m_fragment_usec;
+	
+	SStreamSlot& stream=m_slots[slot];
+	stream.sink_input=sink_input.index;
+	stream.sink=sink_input.sink;
+	stream.levels.reset(spec.channels);
+	if(!m_loudness.empty()) m_loudness[slot].init(m_rate, spec.channels);
+	stream.bEnded=false;
+	stream.window_frames=(uint64_t)m_rate*m_window_usec/1000000;
+	if(stream.window_frames==0) stream.window_frames=1;
+	stream.id=backend->openRecordStream(spec, recordCb, &stream);
+	if(stream.id==0) {
+		LOG(WARN, "failed to open a record stream on sink input %u", sink_input.index);
+		m_table.release(slot);
+		return(false);
+	}
+	m_sink_inputs[sink_input.index]=slot;
+	return(true);
+}
+
+void PAStreamMeter::closeSlot(SStreamSlot& stream) {
+	PABackend* backend=m_manager.Backend();
+	if(backend && stream.id!=0) backend->closeStream(stream.id);
+	stream.id=0;
+	m_table.release(stream.slot);
+}
+
+void PAStreamMeter::close() {
+	for(map<uint32_t, int>::iterator iter=m_sink_inputs.begin(); iter!=m_sink_inputs.end(); ++iter) {
+		closeSlot(m_slots[iter->second]);
+	}
+	m_sink_inputs.clear();
+}
+
+void PAStreamMeter::recordCb(const float* samples, size_t frames, void* userdata) {
+	SStreamSlot* stream=(SStreamSlot*)userdata;
+	/* the stream ended (eg. the sink input was removed), sync() cleans up */
+	if(!samples) {
+		stream->bEnded=true;
+		return;
+	}
+	
+	PAStreamMeter* meter=stream->meter;
+	stream->levels.add(samples, frames);
+	if(!meter->m_loudness.empty()) meter->m_loudness[stream->slot].process(samples, frames);
+	if(stream->levels.frames>=stream->window_frames) {
+		SLoudness loudness;
+		if(!meter->m_loudness.empty()) meter->m_loudness[stream->slot].values(loudness);
+		meter->m_table.update(stream->slot, stream->levels, getTimeUsec(), meter->m_loudness.empty() ? NULL : &loudness);
+		stream->levels.reset(stream->levels.channels);
+	}
+}
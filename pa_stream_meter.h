@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_STREAM_METER_H_
+#define PA_STREAM_METER_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include "level_table.h"
+#include "loudness.h"
+#include <map>
+
+
+/* selects the sink inputs to meter */
+typedef bool (*pa_sink_input_filter_t)(const PASinkInputInfo& sink_input, void* userdata);
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAStreamMeter
+ * level meters of every playback stream: each sink input gets a record
+ * stream on the monitor of its sink, limited to that input
+ * (pa_stream_set_monitor_stream). all streams run on the event loop of the
+ * manager. the levels of every window are published to a CLevelTable,
+ * which other threads can read without locking.
+ *
+ * the streams are recorded with at most 2 channels at a low rate, so a
+ * host with 100 streams stays cheap. the stream slots are allocated once.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAStreamMeter {
+public:
+	PAStreamMeter(PAManager& manager, size_t capacity=256);
+	~PAStreamMeter();
+	
+	/* for the streams opened afterwards */
+	void setMode(uint32_t window_usec, uint32_t rate=8000, uint32_t fragment_usec=20000);
+	/* measure the loudness as well (with a rate of 48kHz, K-weighting needs
+	 * the full band) */
+	void setLoudness(bool bLoudness);
+	/* meter only the sink inputs for which filter returns true (NULL: all).
+	 * applies to the streams opened afterwards */
+	void setFilter(pa_sink_input_filter_t filter, void* userdata);
+	
+	/* open the streams of new sink inputs, close the ones of removed
+	 * inputs and reopen the moved ones. call it after the sink inputs
+	 * changed, eg. from the subscription callback */
+	void sync();
+	void close();
+	
+	size_t count() const { return(m_sink_inputs.size()); }
+	/* the keys are the sink input indexes */
+	const CLevelTable& table() const { return(m_table); }
+	
+private:
+	struct SStreamSlot {
+		PAStreamMeter* meter;
+		uint32_t id;
+		bool bEnded;
+		uint32_t sink_input;
+		uint32_t sink;
+		int slot;
+		SLevels levels;
+		uint64_t window_frames;
+	};
+	
+	bool open(const PASinkInputInfo& sink_input);
+	void closeSlot(SStreamSlot& stream);
+	static void recordCb(const float* samples, size_t frames, void* userdata);
+	
+	PAManager& m_manager;
+	CLevelTable m_table;
+	vector<SStreamSlot> m_slots; //index is the table slot
+	vector<CLoudness> m_loudness; //empty or one per slot
+	map<uint32_t, int> m_sink_inputs; //sink input to slot
+	
+	uint32_t m_window_usec;
+	uint32_t m_rate;
+	uint32_t m_fragment_usec;
+	
+	pa_sink_input_filter_t m_filter;
+	void* m_filter_userdata;
+};
+
+
+#endif /* PA_STREAM_METER_H_ */
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_suspender.h"
+#include "levels.h"
+
+
+#define SUSPENDED "suspended"
+
+
+PAIdleConfig::PAIdleConfig() : silence_db(-80.0), silent_ms(10000), fragment_usec(100000) {
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAIdleSuspender
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PAIdleSuspender::PAIdleSuspender(PAManager& manager) : m_manager(manager) {
+}
+
+PAIdleSuspender::~PAIdleSuspender() {
+	close();
+}
+
+bool PAIdleSuspender::addSink(uint32_t idx) {
+	PADeviceInfo* sink=m_manager.Sink(idx);
+	if(!sink) return(false);
+	return(open(PADev_sink, *sink, sink->monitor_name));
+}
+
+bool PAIdleSuspender::addSource(uint32_t idx) {
+	PADeviceInfo* source=m_manager.Source(idx);
+	if(!source) return(false);
+	return(open(PADev_source, *source, source->name));
+}
+
+bool PAIdleSuspender::open(EPADeviceType type, const PADeviceInfo& info, const string& source) {
+	PABackend* backend=m_manager.Backend();
+	if(!backend) return(false);
+	
+	/* one peak per fragment */
+	PARecordSpec spec;
+	spec.source=source;
+	spec.channels=1;
+	spec.fragment_usec=m_config.fragment_usec;
+	spec.rate=1000000/m_config.fragment_usec>0 ? 1000000/m_config.fragment_usec : 1;
+	spec.bPeak_detect=true;
+	
+	uint64_t now=getTimeUsec();
+	SIdleDevice* device=new SIdleDevice();
+	device->suspender=this;
+	device->bEnded=false;
+	device->last_sound=now;
+	device->state=info.State();
+	device->since=now;
+	device->bOurs=false;
+	device->bSaving=false;
+	device->bResume=false;
+	device->resume_input=PA_INVALID_INDEX;
+	device->resume_event=0;
+	device->stats.dev_type=type;
+	device->stats.index=info.index;
+	device->stats.saved_usec=0;
+	device->stats.suspends=0;
+	device->id=backend->openRecordStream(spec, recordCb, device);
+	if(device->id==0) {
+		LOG(WARN, "failed to open a record stream on %s", source.c_str());
+		delete(device);
+		return(false);
+	}
+	m_devices.push_back(device);
+	return(true);
+}
+
+void PAIdleSuspender::close() {
+	if(m_devices.empty()) return;
+	PABackend* backend=m_manager.Backend();
+	
+	bool bBatch=false;
+	for(size_t i=0; i<m_devices.size(); ++i) {
+		if(!m_devices[i]->bOurs || !device(*m_devices[i])) continue;
+		if(!bBatch) m_manager.beginBatch();
+		bBatch=true;
+		suspend(*m_devices[i], 0);
+	}
+	if(bBatch && !m_manager.flush()) LOG(WARN, "not all devices suspended by us could be resumed");
+	
+	for(size_t i=0; i<m_devices.size(); ++i) {
+		if(backend && !m_devices[i]->bEnded) backend->closeStream(m_devices[i]->id);
+		delete(m_devices[i]);
+	}
+	m_devices.clear();
+}
+
+bool PAIdleSuspender::active() const {
+	for(size_t i=0; i<m_devices.size(); ++i) {
+		if(!m_devices[i]->bEnded) return(true);
+	}
+	return(false);
+}
+
+PADeviceInfo* PAIdleSuspender::device(const SIdleDevice& device) {
+	if(device.stats.dev_type==PADev_sink) return(m_manager.Sink(device.stats.index));
+	return(m_manager.Source(device.stats.index));
+}
+
+void PAIdleSuspender::suspend(const SIdleDevice& device, int suspend) {
+	if(device.stats.dev_type==PADev_sink) m_manager.suspendSink(device.stats.index, suspend);
+	else m_manager.suspendSource(device.stats.index, suspend);
+}
+
+bool PAIdleSuspender::playing(const SIdleDevice& device) {
+	if(device.stats.dev_type!=PADev_sink) return(false);
+	const pa_sink_input_list& sink_inputs=m_manager.SinkInputs();
+	for(pa_sink_input_list::const_iterator it=sink_inputs.begin(); it!=sink_inputs.end(); ++it) {
+		if(it->second->sink==device.stats.index && !it->second->corked) return(true);
+	}
+	return(false);
+}
+
+void PAIdleSuspender::recordCb(const float* samples, size_t frames, void* userdata) {
+	SIdleDevice* device=(SIdleDevice*)userdata;
+	if(!samples) {
+		device->bEnded=true;
+		return;
+	}
+	float peak=0.0f;
+	for(size_t i=0; i<frames; ++i) {
+		if(fabsf(samples[i])>peak) peak=fabsf(samples[i]);
+	}
+	if(levelToDb(peak)>=device->suspender->m_config.silence_db) device->last_sound=getTimeUsec();
+}
+
+void PAIdleSuspender::event(pa_subscription_event_type_t type, uint32_t idx) {
+	int facility=type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+	int kind=type & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+	if(kind==PA_SUBSCRIPTION_EVENT_REMOVE) return;
+	
+	if(facility==PA_SUBSCRIPTION_EVENT_SINK_INPUT) {
+		PASinkInputInfo* sink_input=m_manager.SinkInput(idx);
+		if(!sink_input) return;
+		for(size_t i=0; i<m_devices.size(); ++i) {
+			SIdleDevice& device=*m_devices[i];
+			if(device.stats.dev_type!=PADev_sink || device.stats.index!=sink_input->sink || !device.bOurs
+					|| device.bResume) continue;
+			device.bResume=true;
+			device.resume_input=idx;
+			device.resume_event=getTimeUsec();
+		}
+	} else if(facility==PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT && kind==PA_SUBSCRIPTION_EVENT_NEW) {
+		for(size_t i=0; i<m_devices.size(); ++i) {
+			SIdleDevice& device=*m_devices[i];
+			if(device.stats.dev_type!=PADev_source || !device.bOurs || device.bResume) continue;
+			device.bResume=true;
+			device.resume_input=PA_INVALID_INDEX;
+			device.resume_event=getTimeUsec();
+		}
+	}
+}
+
+void PAIdleSuspender::changeState(SIdleDevice& device, const string& state, uint64_t now) {
+	device.stats.state_usec[device.state]+=now-device.since;
+	if(device.state==SUSPENDED) {
+		if(device.bSaving) device.stats.saved_usec+=now-device.since;
+		device.bSaving=false;
+		/* resumed by somebody else */
+		if(device.bOurs) {
+			device.bOurs=false;
+			device.last_sound=now;
+		}
+	}
+	if(state==SUSPENDED) device.bSaving=device.bOurs;
+	device.state=state;
+	device.since=now;
+}
+
+size_t PAIdleSuspender::tick(vector<PAIdleEvent>* events) {
+	uint64_t now=getTimeUsec();
+	size_t writes=0;
+	
+	for(size_t i=0; i<m_devices.size(); ++i) {
+		SIdleDevice& device=*m_devices[i];
+		PADeviceInfo* info=this->device(device);
+		if(device.bEnded || !info) continue;
+		
+		PAIdleEvent event;
+		event.dev_type=device.stats.dev_type;
+		event.index=device.stats.index;
+		event.previous_usec=0;
+		event.silent_usec=0;
+		event.sink_input=PA_INVALID_INDEX;
+		event.latency_usec=0;
+		
+		string state=info->State();
+		if(state!=device.state) {
+			event.type=Idle_state;
+			event.state=state;
+			event.previous=device.state;
+			event.previous_usec=now-device.since;
+			if(events) events->push_back(event);
+			changeState(device, state, now);
+		}
+		
+		if(device.bResume) {
+			device.bResume=false;
+			if(!device.bOurs) continue;
+			if(writes++==0) m_manager.beginBatch();
+			suspend(device, 0);
+			device.bOurs=false;
+			device.last_sound=now;
+			event.type=Idle_resume;
+			event.sink_input=device.resume_input;
+			event.latency_usec=now-device.resume_event;
+			if(events) events->push_back(event);
+		} else if(!device.bOurs && playing(device)) {
+			/* the silence counts from the end of the stream */
+			device.last_sound=now;
+		} else if(!device.bOurs && state!=SUSPENDED && now-device.last_sound>=m_config.silent_ms*1000ULL) {
+			if(writes++==0) m_manager.beginBatch();
+			suspend(device, 1);
+			device.bOurs=true;
+			++device.stats.suspends;
+			event.type=Idle_suspend;
+			event.silent_usec=now-device.last_sound;
+			if(events) events->push_back(event);
+		}
+	}
+	
+	if(writes>0 && !m_manager.flush()) LOG(WARN, "not all suspends & resumes were applied");
+	return(writes);
+}
+
+void PAIdleSuspender::stats(vector<PAIdleStats>& stats) {
+	uint64_t now=getTimeUsec();
+	for(size_t i=0; i<m_devices.size(); ++i) {
+		const SIdleDevice& device=*m_devices[i];
+		/* with the current state until now */
+		stats.push_back(device.stats);
+		stats.back().state_usec[device.state]+=now-device.since;
+		if(device.bSaving) stats.back().saved_usec+=now-device.since;
+	}
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_SUSPENDER_H_
+#define PA_SUSPENDER_H_
+
+#include "global.h"
+#include "pa_manager.h"
+#include <map>
+
+
+struct PAIdleConfig {
+	PAIdleConfig();
+	
+	double silence_db; //a fragment with a lower peak (dBFS) is silent
+	uint32_t silent_ms; //a device silent for this long is suspended
+	uint32_t fragment_usec;
+};
+
+enum EIdleEvent {
+	Idle_state, //the state (PADeviceInfo::State()) changed
+	Idle_suspend, //suspended by us
+	Idle_resume //resumed by us
+};
+
+struct PAIdleEvent {
+	EIdleEvent type;
+	EPADeviceType dev_type;
+	uint32_t index;
+	string state; //Idle_state: the new & the previous state and the time in it
+	string previous;
+	uint64_t previous_usec;
+	uint64_t silent_usec; //Idle_suspend
+	uint32_t sink_input; //Idle_resume of a sink: the stream which resumed it
+	uint64_t latency_usec; //Idle_resume: from the event of the stream to the resume
+};
+
+/* time per state of a device */
+struct PAIdleStats {
+	EPADeviceType dev_type;
+	uint32_t index;
+	map<string, uint64_t> state_usec;
+	uint64_t saved_usec; //suspended by us
+	uint32_t suspends;
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PAIdleSuspender
+ * suspends sinks & sources which are silent for silent_ms and resumes
+ * them when a new stream appears. every device is recorded with peak
+ * detection (a sink on its monitor), so the server only delivers a few
+ * peaks per second.
+ *
+ * a stream which starts to play after a pause sends no event, so a sink
+ * with an uncorked sink input is never suspended, even if it's silent. the
+ * silence counts from the moment its last stream was corked or removed.
+ * the record streams are not listed here, so a source is suspended when
+ * silent even if a record stream is connected to it.
+ *
+ * a suspended device delivers nothing, so a new stream cannot be measured
+ * before the resume: a sink is resumed when one of its sink inputs is
+ * created or changes (eg. uncorked), a source when a record stream is
+ * created (the source of a source output is not known here, so all the
+ * sources suspended by us are resumed). devices suspended by somebody else
+ * are left alone.
+ *
+ * the events of the subscription have to be passed to event(), tick()
+ * issues the suspends & resumes and should be called after every
+ * iterate().
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PAIdleSuspender {
+public:
+	PAIdleSuspender(PAManager& manager);
+	~PAIdleSuspender();
+	
+	void setConfig(const PAIdleConfig& config) { m_config=config; }
+	
+	/* returns false if the device does not exist or could not be recorded */
+	bool addSink(uint32_t idx);
+	bool addSource(uint32_t idx);
+	/* resumes the devices suspended by us */
+	void close();
+	
+	size_t count() const { return(m_devices.size()); }
+	/* a device was not removed yet */
+	bool active() const;
+	
+	void event(pa_subscription_event_type_t type, uint32_t idx);
+	/* returns the number of suspends & resumes, the events are appended to
+	 * events */
+	size_t tick(vector<PAIdleEvent>* events=NULL);
+	
+	/* the time per state until now */
+	void stats(vector<PAIdleStats>& stats);
+	
+private:
+	struct SIdleDevice {
+		PAIdleSuspender* suspender;
+		uint32_t id;
+		bool bEnded;
+		uint64_t last_sound; //last fragment above the silence, or the resume
+		
+		string state;
+		uint64_t since; //of the state
+		bool bOurs; //our suspend is in effect
+		bool bSaving; //in the state suspended because of us
+		bool bResume; //a stream wants the device
+		uint32_t resume_input;
+		uint64_t resume_event;
+		
+		PAIdleStats stats;
+	};
+	
+	bool open(EPADeviceType type, const PADeviceInfo& device, const string& source);
+	static void recordCb(const float* samples, size_t frames, void* userdata);
+	PADeviceInfo* device(const SIdleDevice& device);
+	/* a sink with an uncorked sink input */
+	bool playing(const SIdleDevice& device);
+	void suspend(const SIdleDevice& device, int suspend);
+	/* account the time in the current state */
+	void changeState(SIdleDevice& device, const string& state, uint64_t now);
+	
+	PAManager& m_manager;
+	PAIdleConfig m_config;
+	vector<SIdleDevice*> m_devices;
+};
+
+
+#endif /* PA_SUSPENDER_H_ */
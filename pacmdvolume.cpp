@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pacmdvolume.h"
+#include "global.h"
+#include "pa_manager.h"
+#include "pa_selector.h"
+#include "backoff.h"
+#include <deque>
+#include <unistd.h>
+
+
+PACmdSelector PACmdSelector::Index(uint32_t idx) {
+	PACmdSelector selector;
+	selector.type=PACmdSelect_index;
+	selector.index=idx;
+	return(selector);
+}
+
+PACmdSelector PACmdSelector::Name(const string& name) {
+	PACmdSelector selector;
+	selector.type=PACmdSelect_name;
+	selector.name=name;
+	return(selector);
+}
+
+
+static void copyVolume(const pa_cvolume& volume, vector<uint32_t>& values) {
+	values.assign(volume.values, volume.values+volume.channels);
+}
+
+static void copyDevice(const PADeviceInfo& info, PACmdDevice& device) {
+	device.index=info.index;
+	device.name=info.name;
+	device.description=info.description;
+	device.card=info.card;
+	copyVolume(info.volume, device.volume);
+	device.bMute=info.mute!=0;
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACmdVolumeImpl
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum EChangeType {
+	Change_sink_volume,
+	Change_source_volume,
+	Change_playback_volume,
+	Change_card_profile
+};
+
+/* a set* call of the application, kept to be queued during a reconnect */
+struct SChange {
+	SChange(EChangeType change_type, const PACmdSelector& change_selector, const string& change_value
+			, const vector<int>* change_channels);
+	
+	EChangeType type;
+	PACmdSelector selector;
+	string value; //volume or profile
+	bool bChannels;
+	vector<int> channels;
+	uint64_t time; //getTimeUsec() of the call
+};
+
+SChange::SChange(EChangeType change_type, const PACmdSelector& change_selector, const string& change_value
+		, const vector<int>* change_channels) : type(change_type), selector(change_selector)
+	, value(change_value), bChannels(change_channels!=NULL), time(getTimeUsec()) {
+	if(change_channels) channels=*change_channels;
+}
+
+class PACmdVolumeImpl {
+public:
+	PACmdVolumeImpl();
+	
+	/* apply pending events. if the connection is lost, try to restore it
+	 * (waiting for it if bWait). sets the error on failure */
+	bool ready(bool bWait);
+	bool failed(Exception& e);
+	
+	/* reconnect if the backoff delay passed. with bWait, retry until the
+	 * deadline. the queued changes are applied after a reconnect */
+	bool restore(bool bWait);
+	void replay();
+	void queueChange(const SChange& change);
+	
+	/* apply the change, after restoring a lost connection */
+	bool change(const SChange& change);
+	/* select the objects and set them. it's sent as a batch (if the
+	 * application has none open), so that failures are reported */
+	bool apply(const SChange& change);
+	bool finishChange();
+	/* a set* threw: wait for what was issued before unless a batch is open */
+	bool abortChange(Exception& e);
+	
+	PAManager manager;
+	bool bConnected;
+	bool bBatch; //opened by the application
+	vector<uint32_t> indexes;
+	string error;
+	
+	PACmdReconnect config;
+	CBackoff backoff;
+	bool bLost; //connection lost, reconnecting
+	uint64_t lost_time;
+	uint64_t next_attempt;
+	deque<SChange> queued;
+};
+
+PACmdVolumeImpl::PACmdVolumeImpl() : bConnected(false), bBatch(false)
+	, backoff(config.backoff_min_ms*1000ULL, config.backoff_max_ms*1000ULL)
+	, bLost(false), lost_time(0), next_attempt(0) {
+}
+
+bool PACmdVolumeImpl::ready(bool bWait) {
+	if(!bConnected) {
+		error="not connected";
+		return(false);
+	}
+	if(bLost && !restore(bWait)) return(false);
+	try {
+		manager.iterate(0);
+	} catch(Exception& e) {
+		failed(e);
+		if(!bLost || !bWait) return(false);
+		return(restore(true));
+	}
+	return(true);
+}
+
+bool PACmdVolumeImpl::failed(Exception& e) {
+	error=e.getErrorStr();
+	if(e.getError()!=EDEVICE) return(false);
+	
+	bBatch=false;
+	if(!config.bEnabled) {
+		manager.DeInit();
+		bConnected=false;
+		return(false);
+	}
+	if(!bLost) {
+		LOG(WARN, "connection lost (%s), reconnecting", error.c_str());
+		bLost=true;
+		lost_time=getTimeUsec();
+		next_attempt=lost_time;
+		backoff.reset();
+	}
+	return(false);
+}
+
+bool PACmdVolumeImpl::restore(bool bWait) {
+	uint64_t deadline=lost_time+config.deadline_ms*1000ULL;
+	
+	while(true) {
+		uint64_t now=getTimeUsec();
+		if(now>=next_attempt) {
+			try {
+				manager.reconnect();
+				LOG(DEBUG, "reconnected after %i ms", (int)((getTimeUsec()-lost_time)/1000));
+				bLost=false;
+				replay();
+				if(!bLost) return(true);
+			} catch(Exception& e) {
+				LOG(DEBUG, "reconnect failed: %s", e.getErrorStr().c_str());
+			}
+			now=getTimeUsec();
+			next_attempt=now+backoff.next();
+			if(now<deadline && next_attempt>deadline) next_attempt=deadline;
+		}
+		if(!bWait || now>=deadline) {
+			error="connection lost";
+			return(false);
+		}
+		usleep((useconds_t)(next_attempt-now));
+	}
+	return(false);
+}
+
+void PACmdVolumeImpl::replay() {
+	if(queued.empty()) return;
+	
+	uint64_t now=getTimeUsec();
+	deque<SChange> changes;
+	changes.swap(queued);
+	bool bApplication_batch=bBatch;
+	bBatch=true;
+	for(deque<SChange>::iterator iter=changes.begin(); iter!=changes.end(); ++iter) {
+		if(now-iter->time > config.queue_timeout_ms*1000ULL) {
+			LOG(WARN, "dropping queued change to '%s': too old", iter->value.c_str());
+			continue;
+		}
+		if(bLost) {
+			queued.push_back(*iter);
+		} else if(!apply(*iter)) {
+			LOG(WARN, "queued change to '%s' failed: %s", iter->value.c_str(), error.c_str());
+		}
+	}
+	if(bLost) return;
+	bBatch=bApplication_batch;
+	if(!finishChange()) LOG(WARN, "queued changes failed: %s", error.c_str());
+}
+
+void PACmdVolumeImpl::queueChange(const SChange& change) {
+	/* the indexes of a restarted server are not the same */
+	if(change.selector.type==PACmdSelect_index) {
+		error="connection lost, change by index dropped";
+		return;
+	}
+	if(config.max_queued==0) return;
+	if(queued.size()>=config.max_queued) {
+		LOG(WARN, "reconnect queue full, dropping change to '%s'", queued.front().value.c_str());
+		queued.pop_front();
+	}
+	queued.push_back(change);
+	error="connection lost, change queued";
+}
+
+bool PACmdVolumeImpl::change(const SChange& change) {
+	if(!ready(true)) {
+		if(bLost) queueChange(change);
+		return(false);
+	}
+	if(apply(change)) return(true);
+	if(!bLost) return(false);
+	
+	/* lost while applying: apply again on the restored connection */
+	if(change.selector.type!=PACmdSelect_index && restore(true)) return(apply(change));
+	queueChange(change);
+	return(false);
+}
+
+bool PACmdVolumeImpl::apply(const SChange& change) {
+	bool bSelected=false;
+	switch(change.type) {
+	case Change_sink_volume: bSelected=selectSinks(manager, change.selector, indexes); break;
+	case Change_source_volume: bSelected=selectSources(manager, change.selector, indexes); break;
+	case Change_playback_volume: bSelected=selectSinkInputs(manager, change.selector, indexes); break;
+	case Change_card_profile: bSelected=selectCards(manager, change.selector, indexes); break;
+	}
+	if(!bSelected) {
+		error=change.type==Change_card_profile ? "no card matches the selector" : "no object matches the selector";
+		return(false);
+	}
+	
+	const vector<int>* channels=change.bChannels ? &change.channels : NULL;
+	try {
+		manager.beginBatch();
+		for(size_t i=0; i<indexes.size(); ++i) {
+			switch(change.type) {
+			case Change_sink_volume: manager.setSinkVolume(indexes[i], change.value, channels); break;
+			case Change_source_volume: manager.setSourceVolume(indexes[i], change.value, channels); break;
+			case Change_playback_volume: manager.setSinkInputVolume(indexes[i], change.value, channels); break;
+			case Change_card_profile: {
+				PACardInfo* card=manager.Card(indexes[i]);
+				manager.setCardProfile(card, manager.cardProfileName(card, change.value));
+				break;
+			}
+			}
+		}
+	} catch(Exception& e) {
+		return(abortChange(e));
+	}
+	return(finishChange());
+}
+
+bool PACmdVolumeImpl::finishChange() {
+	if(bBatch) return(true);
+	try {
+		if(!manager.flush()) {
+			error="not all changes were applied";
+			return(false);
+		}
+	} catch(Exception& e) {
+		return(failed(e));
+	}
+	return(true);
+}
+
+bool PACmdVolumeImpl::abortChange(Exception& e) {
+	failed(e);
+	if(bConnected && !bLost && !bBatch) {
+		try {
+			manager.flush();
+		} catch(Exception& flush_error) {
+			failed(flush_error);
+		}
+	}
+	error=e.getErrorStr();
+	return(false);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACmdVolume
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+PACmdVolume::PACmdVolume() : m_impl(new PACmdVolumeImpl()) {
+}
+
+PACmdVolume::~PACmdVolume() {
+	delete(m_impl);
+}
+
+bool PACmdVolume::connect(const string& server) {
+	disconnect();
+	try {
+		m_impl->manager.Init(NULL, server.empty() ? NULL : server.c_str());
+		m_impl->manager.subscribe((pa_subscription_mask_t)(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE
+				| PA_SUBSCRIPTION_MASK_SINK_INPUT | PA_SUBSCRIPTION_MASK_CLIENT | PA_SUBSCRIPTION_MASK_CARD));
+	} catch(Exception& e) {
+		m_impl->error=e.getErrorStr();
+		m_impl->manager.DeInit();
+		return(false);
+	}
+	m_impl->bConnected=true;
+	return(true);
+}
+
+void PACmdVolume::disconnect() {
+	m_impl->manager.DeInit();
+	m_impl->bConnected=false;
+	m_impl->bBatch=false;
+	m_impl->bLost=false;
+	m_impl->queued.clear();
+}
+
+bool PACmdVolume::connected() const {
+	return(m_impl->bConnected);
+}
+
+void PACmdVolume::setReconnect(const PACmdReconnect& config) {
+	m_impl->config=config;
+	m_impl->backoff.setLimits(config.backoff_min_ms*1000ULL, config.backoff_max_ms*1000ULL);
+}
+
+bool PACmdVolume::reconnecting() const {
+	return(m_impl->bLost);
+}
+
+bool PACmdVolume::update() {
+	return(m_impl->ready(false));
+}
+
+bool PACmdVolume::listSinks(vector<PACmdDevice>& sinks, const PACmdSelector& selector) {
+	sinks.clear();
+	if(!m_impl->ready(true)) return(false);
+	if(!selectSinks(m_impl->manager, selector, m_impl->indexes)) return(true);
+	
+	sinks.resize(m_impl->indexes.size());
+	for(size_t i=0; i<m_impl->indexes.size(); ++i) copyDevice(*m_impl->manager.Sink(m_impl->indexes[i]), sinks[i]);
+	return(true);
+}
+
+bool PACmdVolume::listSources(vector<PACmdDevice>& sources, const PACmdSelector& selector) {
+	sources.clear();
+	if(!m_impl->ready(true)) return(false);
+	if(!selectSources(m_impl->manager, selector, m_impl->indexes)) return(true);
+	
+	sources.resize(m_impl->indexes.size());
+	for(size_t i=0; i<m_impl->indexes.size(); ++i) copyDevice(*m_impl->manager.Source(m_impl->indexes[i]), sources[i]);
+	return(true);
+}
+
+bool PACmdVolume::listPlayback(vector<PACmdPlayback>& playback, const PACmdSelector& selector) {
+	playback.clear();
+	if(!m_impl->ready(true)) return(false);
+	if(!selectSinkInputs(m_impl->manager, selector, m_impl->indexes)) return(true);
+	
+	playback.resize(m_impl->indexes.size());
+	for(size_t i=0; i<m_impl->indexes.size(); ++i) {
+		const PASinkInputInfo* info=m_impl->manager.SinkInput(m_impl->indexes[i]);
+		PACmdPlayback& stream=playback[i];
+		stream.index=info->index;
+		stream.name=info->name;
+		stream.client_name=info->client_obj ? info->client_obj->name : string();
+		stream.sink=info->sink;
+		copyVolume(info->volume, stream.volume);
+		stream.bMute=info->mute!=0;
+	}
+	return(true);
+}
+
+bool PACmdVolume::listCards(vector<PACmdCard>& cards, const PACmdSelector& selector) {
+	cards.clear();
+	if(!m_impl->ready(true)) return(false);
+	if(!selectCards(m_impl->manager, selector, m_impl->indexes)) return(true);
+	
+	cards.resize(m_impl->indexes.size());
+	for(size_t i=0; i<m_impl->indexes.size(); ++i) {
+		const PACardInfo* info=m_impl->manager.Card(m_impl->indexes[i]);
+		PACmdCard& card=cards[i];
+		card.index=info->index;
+		card.name=info->name;
+		for(size_t k=0; k<info->profiles.size(); ++k) card.profiles.push_back(info->profiles[k]->name);
+		card.active_profile=info->active_profile;
+	}
+	return(true);
+}
+
+bool PACmdVolume::setSinkVolume(const PACmdSelector& selector, const string& volume, const vector<int>* channels) {
+	return(m_impl->change(SChange(Change_sink_volume, selector, volume, channels)));
+}
+
+bool PACmdVolume::setSourceVolume(const PACmdSelector& selector, const string& volume, const vector<int>* channels) {
+	return(m_impl->change(SChange(Change_source_volume, selector, volume, channels)));
+}
+
+bool PACmdVolume::setPlaybackVolume(const PACmdSelector& selector, const string& volume, const vector<int>* channels) {
+	return(m_impl->change(SChange(Change_playback_volume, selector, volume, channels)));
+}
+
+bool PACmdVolume::setCardProfile(const PACmdSelector& selector, const string& profile) {
+	return(m_impl->change(SChange(Change_card_profile, selector, profile, NULL)));
+}
+
+void PACmdVolume::beginBatch() {
+	m_impl->bBatch=true;
+}
+
+bool PACmdVolume::flush() {
+	m_impl->bBatch=false;
+	if(!m_impl->ready(true)) return(false);
+	return(m_impl->finishChange());
+}
+
+const string& PACmdVolume::lastError() const {
+	return(m_impl->error);
+}
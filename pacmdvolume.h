@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PACMDVOLUME_H_
+#define PACMDVOLUME_H_
+
+/* public interface of libpacmdvolume. it depends neither on libpulse nor on
+ * the other headers of the project and the implementation is behind a
+ * pointer, so applications built against it keep working when the library
+ * is updated. */
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+#define PACMDVOLUME_API_VERSION 1
+
+#define PACMD_VOLUME_NORM 0x10000U //100% (0dB), same as PA_VOLUME_NORM
+#define PACMD_INVALID_INDEX ((uint32_t)-1)
+
+
+enum EPACmdSelect {
+	PACmdSelect_all,
+	PACmdSelect_index,
+	PACmdSelect_name
+};
+
+/* selects objects like the -c/-C and -i/-I options of the command line:
+ * all of them, by index or by (case insensitive substring of) the name.
+ * playback streams are selected by the name of their client. */
+struct PACmdSelector {
+	PACmdSelector() : type(PACmdSelect_all), index(PACMD_INVALID_INDEX) {}
+	
+	static PACmdSelector Index(uint32_t idx);
+	static PACmdSelector Name(const std::string& name);
+	
+	bool all() const { return(type==PACmdSelect_all); }
+	
+	EPACmdSelect type;
+	uint32_t index;
+	std::string name;
+};
+
+struct PACmdDevice {
+	uint32_t index;
+	std::string name;
+	std::string description;
+	uint32_t card; //PACMD_INVALID_INDEX if none
+	std::vector<uint32_t> volume; //per channel, PACMD_VOLUME_NORM is 100%
+	bool bMute;
+};
+
+struct PACmdPlayback {
+	uint32_t index;
+	std::string name;
+	std::string client_name;
+	uint32_t sink;
+	std::vector<uint32_t> volume;
+	bool bMute;
+};
+
+struct PACmdCard {
+	uint32_t index;
+	std::string name;
+	std::vector<std::string> profiles;
+	int active_profile; //index into profiles or -1
+};
+
+/* automatic reconnect when the connection is lost, eg. because the server
+ * restarted. a call that finds the connection lost retries with a jittered
+ * exponential backoff, but waits at most deadline_ms from the loss. later
+ * changes are queued and applied after the reconnect: the selectors are
+ * resolved again on the new objects, changes selected by index are dropped
+ * (the indexes of a restarted server differ). */
+struct PACmdReconnect {
+	PACmdReconnect() : bEnabled(true), deadline_ms(3000), backoff_min_ms(20), backoff_max_ms(1000)
+		, max_queued(32), queue_timeout_ms(30000) {}
+	
+	bool bEnabled;
+	uint32_t deadline_ms;
+	uint32_t backoff_min_ms; //first retry delay, doubles with every retry
+	uint32_t backoff_max_ms;
+	uint32_t max_queued; //the oldest change is dropped if the queue is full
+	uint32_t queue_timeout_ms; //older queued changes are dropped
+};
+
+class PACmdVolumeImpl;
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class PACmdVolume
+ * the functionality of the command line tool for applications: one
+ * connection is kept open and the objects are kept up to date with server
+ * events, so a change costs a round trip instead of a process start and a
+ * full enumeration.
+ * the functions return false on failure, lastError() has the reason. an
+ * object must be used by one thread at a time.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PACmdVolume {
+public:
+	PACmdVolume();
+	~PACmdVolume();
+	
+	/* connect and get all objects. server "" is the default server */
+	bool connect(const std::string& server=std::string());
+	void disconnect();
+	bool connected() const;
+	
+	void setReconnect(const PACmdReconnect& config);
+	/* the connection was lost and is not restored yet */
+	bool reconnecting() const;
+	
+	/* apply the pending server events without waiting. the other functions
+	 * do this themselves. while reconnecting, it tries to reconnect if the
+	 * backoff delay has passed */
+	bool update();
+	
+	bool listSinks(std::vector<PACmdDevice>& sinks, const PACmdSelector& selector=PACmdSelector());
+	bool listSources(std::vector<PACmdDevice>& sources, const PACmdSelector& selector=PACmdSelector());
+	bool listPlayback(std::vector<PACmdPlayback>& playback, const PACmdSelector& selector=PACmdSelector());
+	bool listCards(std::vector<PACmdCard>& cards, const PACmdSelector& selector=PACmdSelector());
+	
+	/* volume has the format of the --set-volume option: absolute or with %,
+	 * + or - to in/decrease, * or / to in/decrease logarithmically, mute or
+	 * unmute. channels are the channel indexes to change (NULL: all).
+	 * return false if the selector matches nothing or a change failed. a
+	 * change that is queued for a reconnect returns false as well */
+	bool setSinkVolume(const PACmdSelector& selector, const std::string& volume, const std::vector<int>* channels=NULL);
+	bool setSourceVolume(const PACmdSelector& selector, const std::string& volume, const std::vector<int>* channels=NULL);
+	bool setPlaybackVolume(const PACmdSelector& selector, const std::string& volume, const std::vector<int>* channels=NULL);
+	/* profile is the profile index or (substring of) the name */
+	bool setCardProfile(const PACmdSelector& selector, const std::string& profile);
+	
+	/* after beginBatch() the changes are sent without waiting, flush()
+	 * waits for all of them (one round trip in total) */
+	void beginBatch();
+	bool flush();
+	
+	const std::string& lastError() const;
+	
+private:
+	PACmdVolume(const PACmdVolume&);
+	PACmdVolume& operator=(const PACmdVolume&);
+	
+	PACmdVolumeImpl* m_impl;
+};
+
+
+#endif /* PACMDVOLUME_H_ */
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "sample_ring.h"
+
+#include <cstring>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CSampleRing
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CSampleRing::init(size_t capacity) {
+	size_t size=1;
+	while(size<capacity) size*=2;
+	m_buffer.assign(capacity>0 ? size : 0, 0.0f);
+	m_mask=size-1;
+	m_head.store(0, std::memory_order_relaxed);
+	m_tail.store(0, std::memory_order_relaxed);
+}
+
+bool CSampleRing::push(const float* samples, size_t count) {
+	size_t head=m_head.load(std::memory_order_relaxed);
+	size_t tail=m_tail.load(std::memory_order_acquire);
+	if(m_buffer.size()-(head-tail)<count) return(false);
+	
+	size_t offset=head&m_mask;
+	size_t first=m_buffer.size()-offset;
+	if(first>count) first=count;
+	memcpy(&m_buffer[offset], samples, first*sizeof(float));
+	if(count>first) memcpy(&m_buffer[0], samples+first, (count-first)*sizeof(float));
+	m_head.store(head+count, std::memory_order_release);
+	return(true);
+}
+
+size_t CSampleRing::pop(float* samples, size_t count) {
+	size_t tail=m_tail.load(std::memory_order_relaxed);
+	size_t head=m_head.load(std::memory_order_acquire);
+	if(count>head-tail) count=head-tail;
+	if(count==0) return(0);
+	
+	size_t offset=tail&m_mask;
+	size_t first=m_buffer.size()-offset;
+	if(first>count) first=count;
+	memcpy(samples, &m_buffer[offset], first*sizeof(float));
+	if(count>first) memcpy(samples+first, &m_buffer[0], (count-first)*sizeof(float));
+	m_tail.store(tail+count, std::memory_order_release);
+	return(count);
+}
+
+size_t CSampleRing::available() const {
+	return(m_head.load(std::memory_order_acquire)-m_tail.load(std::memory_order_acquire));
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef SAMPLE_RING_H_
+#define SAMPLE_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CSampleRing
+ * single producer, single consumer ring of float samples without locks:
+ * the producer only writes the head, the consumer only the tail. the
+ * capacity is rounded up to a power of 2 and allocated once.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CSampleRing {
+public:
+	CSampleRing(size_t capacity=0) { init(capacity); }
+	
+	/* not thread-safe, before the producer & consumer start */
+	void init(size_t capacity);
+	size_t capacity() const { return(m_buffer.size()); }
+	
+	/* producer: writes all or nothing, false if there is not enough space */
+	bool push(const float* samples, size_t count);
+	/* consumer: reads at most count samples, returns the number read */
+	size_t pop(float* samples, size_t count);
+	
+	/* samples in the ring (a lower bound for the consumer) */
+	size_t available() const;
+	
+private:
+	std::vector<float> m_buffer;
+	size_t m_mask;
+	/* positions increase forever, they are masked for the access. on
+	 * separate cache lines, so the threads don't share them */
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+};
+
+
+#endif /* SAMPLE_RING_H_ */
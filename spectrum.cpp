@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "spectrum.h"
+#include "levels.h"
+
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CRealFFT
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CRealFFT::init(uint32_t size) {
+	m_size=size;
+	uint32_t half=size/2;
+	
+	uint32_t bits=0;
+	while((1U<<bits)<half) ++bits;
+	m_reverse.resize(half);
+	for(uint32_t i=0; i<half; ++i) {
+		uint32_t reverse=0;
+		for(uint32_t b=0; b<bits; ++b) reverse|=((i>>b)&1)<<(bits-1-b);
+		m_reverse[i]=reverse;
+	}
+	
+	m_twiddle_re.resize(half);
+	m_twiddle_im.resize(half);
+	for(uint32_t h=1; h<half; h*=2) {
+		for(uint32_t j=0; j<h; ++j) {
+			m_twiddle_re[h-1+j]=(float)cos(-M_PI*j/h);
+			m_twiddle_im[h-1+j]=(float)sin(-M_PI*j/h);
+		}
+	}
+	m_split_re.resize(half);
+	m_split_im.resize(half);
+	for(uint32_t k=0; k<half; ++k) {
+		m_split_re[k]=(float)cos(-2.0*M_PI*k/size);
+		m_split_im[k]=(float)sin(-2.0*M_PI*k/size);
+	}
+	m_re.resize(half);
+	m_im.resize(half);
+}
+
+void CRealFFT::butterflies() {
+	uint32_t half=m_size/2;
+	float* re=&m_re[0];
+	float* im=&m_im[0];
+	
+	for(uint32_t i=0; i<half; i+=2) {
+		float re_b=re[i+1], im_b=im[i+1];
+		re[i+1]=re[i]-re_b;
+		im[i+1]=im[i]-im_b;
+		re[i]+=re_b;
+		im[i]+=im_b;
+	}
+	/* twiddles 1 and -i */
+	for(uint32_t i=0; i<half; i+=4) {
+		float re_b=re[i+2], im_b=im[i+2];
+		re[i+2]=re[i]-re_b;
+		im[i+2]=im[i]-im_b;
+		re[i]+=re_b;
+		im[i]+=im_b;
+		re_b=im[i+3];
+		im_b=-re[i+3];
+		re[i+3]=re[i+1]-re_b;
+		im[i+3]=im[i+1]-im_b;
+		re[i+1]+=re_b;
+		im[i+1]+=im_b;
+	}
+	
+	for(uint32_t h=4; h<half; h*=2) {
+		const float* twiddle_re=&m_twiddle_re[h-1];
+		const float* twiddle_im=&m_twiddle_im[h-1];
+		for(uint32_t group=0; group<half; group+=2*h) {
+			float* re_a=re+group;
+			float* im_a=im+group;
+			float* re_b=re_a+h;
+			float* im_b=im_a+h;
+#ifdef __SSE2__
+			for(uint32_t j=0; j<h; j+=4) {
+				__m128 w_re=_mm_loadu_ps(twiddle_re+j);
+				__m128 w_im=_mm_loadu_ps(twiddle_im+j);
+				__m128 b_re=_mm_loadu_ps(re_b+j);
+				__m128 b_im=_mm_loadu_ps(im_b+j);
+				__m128 t_re=_mm_sub_ps(_mm_mul_ps(b_re, w_re), _mm_mul_ps(b_im, w_im));
+				__m128 t_im=_mm_add_ps(_mm_mul_ps(b_re, w_im), _mm_mul_ps(b_im, w_re));
+				__m128 a_re=_mm_loadu_ps(re_a+j);
+				__m128 a_im=_mm_loadu_ps(im_a+j);
+				_mm_storeu_ps(re_b+j, _mm_sub_ps(a_re, t_re));
+				_mm_storeu_ps(im_b+j, _mm_sub_ps(a_im, t_im));
+				_mm_storeu_ps(re_a+j, _mm_add_ps(a_re, t_re));
+				_mm_storeu_ps(im_a+j, _mm_add_ps(a_im, t_im));
+			}
+#else
+			for(uint32_t j=0; j<h; ++j) {
+				float t_re=re_b[j]*twiddle_re[j]-im_b[j]*twiddle_im[j];
+				float t_im=re_b[j]*twiddle_im[j]+im_b[j]*twiddle_re[j];
+				re_b[j]=re_a[j]-t_re;
+				im_b[j]=im_a[j]-t_im;
+				re_a[j]+=t_re;
+				im_a[j]+=t_im;
+			}
+#endif
+		}
+	}
+}
+
+void CRealFFT::power(const float* samples, float* power) {
+	uint32_t half=m_size/2;
+	for(uint32_t k=0; k<half; ++k) {
+		m_re[m_reverse[k]]=samples[2*k];
+		m_im[m_reverse[k]]=samples[2*k+1];
+	}
+	butterflies();
+	
+	/* X[k] = E[k] + e^(-2*pi*i*k/size) * O[k] with the transforms of the even
+	 * E = (Z[k] + conj(Z[half-k]))/2 and odd samples O = -i*(Z[k] - conj(Z[half-k]))/2 */
+	power[0]=(m_re[0]+m_im[0])*(m_re[0]+m_im[0]);
+	power[half]=(m_re[0]-m_im[0])*(m_re[0]-m_im[0]);
+	for(uint32_t k=1; k<half; ++k) {
+		float even_re=0.5f*(m_re[k]+m_re[half-k]);
+		float even_im=0.5f*(m_im[k]-m_im[half-k]);
+		float odd_re=0.5f*(m_im[k]+m_im[half-k]);
+		float odd_im=-0.5f*(m_re[k]-m_re[half-k]);
+		float re=even_re+m_split_re[k]*odd_re-m_split_im[k]*odd_im;
+		float im=even_im+m_split_re[k]*odd_im+m_split_im[k]*odd_re;
+		power[k]=re*re+im*im;
+	}
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CSpectrum
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+/* nominal center frequencies, the exact ones are 1000*2^(n/3) */
+static const double g_third_octaves[] = { 25, 31.5, 40, 50, 63, 80, 100, 125, 160, 200, 250, 315, 400, 500
+	, 630, 800, 1000, 1250, 1600, 2000, 2500, 3150, 4000, 5000, 6300, 8000, 10000, 12500, 16000, 20000 };
+#define THIRD_OCTAVE_1K 16 //index of 1000Hz
+
+CSpectrum::CSpectrum() : m_hop(1), m_scale(1.0), m_filled(0), m_transforms(0) {
+}
+
+void CSpectrum::init(uint32_t rate, uint32_t size, uint32_t hop, ESpectrumBands bands) {
+	m_fft.init(size);
+	m_hop=hop>0 && hop<=size ? hop : size;
+	
+	/* periodic hann window */
+	m_window.resize(size);
+	double window_square=0.0;
+	for(uint32_t i=0; i<size; ++i) {
+		m_window[i]=(float)(0.5-0.5*cos(2.0*M_PI*i/size));
+		window_square+=(double)m_window[i]*m_window[i];
+	}
+	/* a sine with amplitude a has the power a^2/4*size*sum(w^2) in the
+	 * positive bins, its mean square is a^2/2 */
+	m_scale=2.0/(size*window_square);
+	
+	m_input.assign(size, 0.0f);
+	m_frame.resize(size);
+	m_power.resize(size/2+1);
+	
+	double bin_hz=(double)rate/size;
+	m_band_first.clear();
+	m_band_last.clear();
+	m_frequency.clear();
+	if(bands==Spectrum_bins) {
+		for(uint32_t k=0; k<=size/2; ++k) {
+			m_band_first.push_back(k);
+			m_band_last.push_back(k+1);
+			m_frequency.push_back(k*bin_hz);
+		}
+	} else {
+		int step=bands==Spectrum_octave ? 3 : 1;
+		for(int i=(THIRD_OCTAVE_1K%step); i<(int)(sizeof(g_third_octaves)/sizeof(g_third_octaves[0])); i+=step) {
+			double center=1000.0*pow(2.0, (i-THIRD_OCTAVE_1K)/3.0);
+			double upper=center*pow(2.0, step/6.0);
+			if(upper>rate/2.0) break;
+			uint32_t first=(uint32_t)ceil(center*pow(2.0, -step/6.0)/bin_hz);
+			uint32_t last=(uint32_t)ceil(upper/bin_hz);
+			if(first<1) first=1;
+			/* narrower than a bin: the nearest one */
+			if(last<=first) {
+				first=(uint32_t)floor(center/bin_hz+0.5);
+				last=first+1;
+			}
+			m_band_first.push_back(first);
+			m_band_last.push_back(last);
+			m_frequency.push_back(g_third_octaves[i]);
+		}
+	}
+	m_sum.resize(m_band_first.size());
+	reset();
+}
+
+void CSpectrum::reset() {
+	m_filled=0;
+	m_transforms=0;
+	for(size_t i=0; i<m_sum.size(); ++i) m_sum[i]=0.0;
+}
+
+void CSpectrum::process(const float* samples, size_t frames) {
+	uint32_t size=m_fft.size();
+	while(frames>0) {
+		size_t count=size-m_filled;
+		if(count>frames) count=frames;
+		memcpy(&m_input[m_filled], samples, count*sizeof(float));
+		m_filled+=(uint32_t)count;
+		samples+=count;
+		frames-=count;
+		if(m_filled==size) {
+			transform();
+			memmove(&m_input[0], &m_input[m_hop], (size-m_hop)*sizeof(float));
+			m_filled=size-m_hop;
+		}
+	}
+}
+
+void CSpectrum::transform() {
+	uint32_t size=m_fft.size();
+	for(uint32_t i=0; i<size; ++i) m_frame[i]=m_input[i]*m_window[i];
+	m_fft.power(&m_frame[0], &m_power[0]);
+	
+	for(size_t band=0; band<m_sum.size(); ++band) {
+		double sum=0.0;
+		for(uint32_t k=m_band_first[band]; k<m_band_last[band]; ++k) sum+=m_power[k];
+		m_sum[band]+=sum;
+	}
+	++m_transforms;
+}
+
+bool CSpectrum::take(std::vector<float>& db) {
+	if(m_transforms==0) return(false);
+	db.resize(m_sum.size());
+	for(size_t band=0; band<m_sum.size(); ++band) {
+		db[band]=(float)levelToDb(sqrt(m_sum[band]*m_scale/m_transforms));
+		m_sum[band]=0.0;
+	}
+	m_transforms=0;
+	return(true);
+}
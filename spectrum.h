@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef SPECTRUM_H_
+#define SPECTRUM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CRealFFT
+ * FFT of real samples with a size of a power of 2: the even & odd samples
+ * are transformed as one complex signal of half the size (iterative
+ * radix-2, split real & imaginary arrays, the butterflies of 4 pairs at
+ * once with SSE2) and separated afterwards. the tables & buffers are
+ * allocated by init().
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CRealFFT {
+public:
+	CRealFFT() : m_size(0) {}
+	
+	/* size must be a power of 2, at least 16 */
+	void init(uint32_t size);
+	uint32_t size() const { return(m_size); }
+	
+	/* squared magnitude of the bins 0 to size/2 of size samples */
+	void power(const float* samples, float* power);
+	
+private:
+	void butterflies();
+	
+	uint32_t m_size;
+	std::vector<uint32_t> m_reverse; //bit reversed index of the complex input
+	/* twiddles of the stages with h butterflies per group start at h-1 */
+	std::vector<float> m_twiddle_re;
+	std::vector<float> m_twiddle_im;
+	/* e^(-2*pi*i*k/size) to separate the real transform */
+	std::vector<float> m_split_re;
+	std::vector<float> m_split_im;
+	std::vector<float> m_re;
+	std::vector<float> m_im;
+};
+
+
+enum ESpectrumBands {
+	Spectrum_bins,
+	Spectrum_octave,
+	Spectrum_third_octave
+};
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CSpectrum
+ * power spectrum of a mono signal: transforms of size samples with a hann
+ * window every hop samples (hop<size overlaps them). the power of the
+ * transforms is accumulated per bin or per octave / third octave band
+ * (IEC 61260 center frequencies) until take().
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CSpectrum {
+public:
+	CSpectrum();
+	
+	void init(uint32_t rate, uint32_t size, uint32_t hop, ESpectrumBands bands);
+	void reset();
+	
+	void process(const float* samples, size_t frames);
+	
+	size_t bands() const { return(m_band_first.size()); }
+	/* center frequency of a band resp. of a bin */
+	double frequency(size_t band) const { return(m_frequency[band]); }
+	uint32_t transforms() const { return(m_transforms); }
+	
+	/* the mean power per band of the transforms since the last take() in
+	 * dBFS (a full scale sine has -3dB like its RMS). false if no transform
+	 * completed */
+	bool take(std::vector<float>& db);
+	
+private:
+	void transform();
+	
+	CRealFFT m_fft;
+	uint32_t m_hop;
+	std::vector<float> m_window;
+	double m_scale; //power of a bin to the mean square
+	
+	std::vector<float> m_input; //the last size samples
+	uint32_t m_filled;
+	std::vector<float> m_frame; //windowed
+	std::vector<float> m_power;
+	
+	std::vector<uint32_t> m_band_first; //bins [first, last) per band
+	std::vector<uint32_t> m_band_last;
+	std::vector<double> m_frequency;
+	std::vector<double> m_sum;
+	uint32_t m_transforms;
+};
+
+
+#endif /* SPECTRUM_H_ */
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * end-to-end latency of a volume change as felt by the user: the time from
+ * starting pacmdvolume -s <volume> until the server broadcasts the sink
+ * change with the new volume. the change is observed on a separate
+ * connection which subscribes to sink events, like a volume indicator in a
+ * status bar.
+ */
+
+#include "pa_server.h"
+#include "../global.h"
+#include "../command_line.h"
+#include "../latency_histogram.h"
+#include "../pa_manager.h"
+#include "../pa_backend_pulse.h"
+
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CE2EHarness
+ * runs the trials: the volume of one sink alternates between two values,
+ * so every trial causes a change event
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CE2EHarness {
+public:
+	CE2EHarness(const string& server, const string& binary, bool bExec, int timeout_ms);
+	
+	/* connect the observer & select the sink */
+	void init();
+	
+	/* run trials, the first warmup trials are not recorded */
+	void run(uint32_t trials, uint32_t warmup);
+	
+	void printResults();
+	
+private:
+	/* by-index fetch after an event, event_time is when the event arrived */
+	struct SFetch {
+		SFetch(CE2EHarness* fetch_harness, uint64_t time) : harness(fetch_harness), event_time(time) {}
+		CE2EHarness* harness;
+		uint64_t event_time;
+	};
+	
+	/* returns false if the trial failed or timed out */
+	bool trial(const string& volume, bool bRecord);
+	/* start the invocation which sets the sink volume */
+	pid_t spawn(const string& volume);
+	void waitForObserver(const bool* done);
+	
+	static void sinkListCb(const pa_sink_info* info, int eol, void* userdata);
+	static void eventCb(pa_subscription_event_type_t type, uint32_t idx, void* userdata);
+	static void sinkInfoCb(const pa_sink_info* info, int eol, void* userdata);
+	
+	string m_server;
+	string m_binary;
+	bool m_bExec;
+	int m_timeout_ms;
+	
+	PAPulseBackend m_observer;
+	uint32_t m_sink;
+	pa_cvolume m_volume; //of m_sink at startup
+	bool m_bList_done;
+	
+	pa_volume_t m_expected; //volume of the current trial
+	uint64_t m_observed; //arrival of the matching event, 0 if not yet
+	
+	CLatencyHistogram m_observed_latency; //usec, start until the change event arrived
+	CLatencyHistogram m_exit_latency; //usec, start until the process exited
+	uint32_t m_failures;
+};
+
+CE2EHarness::CE2EHarness(const string& server, const string& binary, bool bExec, int timeout_ms)
+	: m_server(server), m_binary(binary), m_bExec(bExec), m_timeout_ms(timeout_ms)
+	, m_sink(PA_INVALID_INDEX), m_bList_done(false), m_expected(0), m_observed(0), m_failures(0) {
+	m_volume.channels=0;
+}
+
+void CE2EHarness::waitForObserver(const bool* done) {
+	while(!*done) {
+		ASSERT_THROW_e(m_observer.state()==PABackend_ready, EDEVICE, "Lost the connection to the PulseAudio Server");
+		m_observer.iterate(-1);
+	}
+}
+
+void CE2EHarness::init() {
+	m_observer.connect(m_server.c_str());
+	while(m_observer.state()==PABackend_connecting) m_observer.iterate(-1);
+	ASSERT_THROW_e(m_observer.state()==PABackend_ready, EDEVICE, "Failed to connect to %s", m_server.c_str());
+	
+	ASSERT_THROW_e(m_observer.subscribe(PA_SUBSCRIPTION_MASK_SINK, eventCb, this), EDEVICE, "subscribe failed");
+	/* the list is answered after the subscription is active, so no event is missed */
+	m_bList_done=false;
+	ASSERT_THROW_e(m_observer.getSinkInfoList(sinkListCb, this), EDEVICE, "failed to get the sink list");
+	waitForObserver(&m_bList_done);
+	ASSERT_THROW_e(m_sink!=PA_INVALID_INDEX, ENO_SUCH_DEVICE, "the server has no sink");
+	LOG(DEBUG, "using sink %u", m_sink);
+}
+
+void CE2EHarness::sinkListCb(const pa_sink_info* info, int eol, void* userdata) {
+	CE2EHarness* harness=(CE2EHarness*)userdata;
+	if(eol!=0) {
+		harness->m_bList_done=true;
+		return;
+	}
+	if(harness->m_sink==PA_INVALID_INDEX) {
+		harness->m_sink=info->index;
+		harness->m_volume=info->volume;
+	}
+}
+
+void CE2EHarness::eventCb(pa_subscription_event_type_t type, uint32_t idx, void* userdata) {
+	CE2EHarness* harness=(CE2EHarness*)userdata;
+	if((type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK)!=PA_SUBSCRIPTION_EVENT_SINK
+			|| (type & PA_SUBSCRIPTION_EVENT_TYPE_MASK)!=PA_SUBSCRIPTION_EVENT_CHANGE
+			|| idx!=harness->m_sink) return;
+	
+	/* the event does not contain the volume, so fetch it */
+	SFetch* fetch=new SFetch(harness, getTimeUsec());
+	if(!harness->m_observer.getSinkInfo(idx, sinkInfoCb, fetch)) delete(fetch);
+}
+
+void CE2EHarness::sinkInfoCb(const pa_sink_info* info, int eol, void* userdata) {
+	SFetch* fetch=(SFetch*)userdata;
+	if(eol!=0) {
+		delete(fetch);
+		return;
+	}
+	CE2EHarness* harness=fetch->harness;
+	if(harness->m_observed!=0) return;
+	for(uint8_t i=0; i<info->volume.channels; ++i) {
+		if(info->volume.values[i]!=harness->m_expected) return;
+	}
+	harness->m_observed=fetch->event_time;
+}
+
+pid_t CE2EHarness::spawn(const string& volume) {
+	string sink=toStr(m_sink);
+	pid_t pid=fork();
+	ASSERT_THROW_e(pid>=0, EGENERAL, "fork failed");
+	if(pid!=0) return(pid);
+	
+	int null_fd=open("/dev/null", O_RDWR);
+	if(null_fd>=0) {
+		dup2(null_fd, STDOUT_FILENO);
+		dup2(null_fd, STDERR_FILENO);
+	}
+	if(m_bExec) {
+		execl(m_binary.c_str(), m_binary.c_str(), "--server", m_server.c_str(), "-c", sink.c_str()
+				, "-s", volume.c_str(), (char*)NULL);
+		_exit(127);
+	}
+	
+	/* the same as an invocation, without exec & process startup */
+	int ret=0;
+	try {
+		PAManager manager;
+		manager.Init(NULL, m_server.c_str());
+		manager.setSinkVolume(m_sink, volume);
+	} catch(Exception& e) {
+		ret=1;
+	}
+	_exit(ret);
+}
+
+bool CE2EHarness::trial(const string& volume, bool bRecord) {
+	m_expected=0;
+	PAManager::applyVolume(volume, m_expected);
+	m_observed=0;
+	
+	uint64_t start=getTimeUsec();
+	uint64_t deadline=start+(uint64_t)m_timeout_ms*1000;
+	pid_t pid=spawn(volume);
+	
+	uint64_t exited=0;
+	int status=0;
+	while(m_observed==0 || exited==0) {
+		if(exited==0 && waitpid(pid, &status, WNOHANG)==pid) exited=getTimeUsec();
+		
+		if(getTimeUsec()>deadline || m_observer.state()!=PABackend_ready) {
+			if(exited==0) {
+				kill(pid, SIGKILL);
+				waitpid(pid, NULL, 0);
+			}
+			LOG(WARN, "trial with volume %s timed out", volume.c_str());
+			if(bRecord) ++m_failures;
+			return(false);
+		}
+		/* the event time is taken in the callback, the timeout only limits
+		 * how late the process exit is noticed */
+		m_observer.iterate(exited==0 ? 1 : 10);
+	}
+	
+	if(!WIFEXITED(status) || WEXITSTATUS(status)!=0) {
+		if(bRecord) ++m_failures;
+		return(false);
+	}
+	if(bRecord) {
+		m_observed_latency.record(m_observed-start);
+		m_exit_latency.record(exited-start);
+	}
+	return(true);
+}
+
+void CE2EHarness::run(uint32_t trials, uint32_t warmup) {
+	/* two absolute volumes, starting with the one which differs from the
+	 * current volume */
+	string volumes[2]={ "30%", "60%" };
+	pa_volume_t first=0;
+	PAManager::applyVolume(volumes[0], first);
+	uint32_t next=(m_volume.channels>0 && m_volume.values[0]==first) ? 1 : 0;
+	
+	for(uint32_t i=0; i<warmup+trials; ++i) {
+		trial(volumes[next], i>=warmup);
+		next^=1;
+	}
+}
+
+void CE2EHarness::printResults() {
+	const char* mode=m_bExec ? "exec" : "fork";
+	printf("%-24s %8s %8s %10s %10s %10s %10s %10s\n", "# latency (ms)", "trials", "failed", "mean", "p50", "p90", "p99", "max");
+	
+	const CLatencyHistogram* histograms[]={ &m_observed_latency, &m_exit_latency };
+	const char* names[]={ "observed", "exit" };
+	for(int i=0; i<2; ++i) {
+		const CLatencyHistogram& h=*histograms[i];
+		string name=string(mode)+"/"+names[i];
+		printf("%-24s %8llu %8u %10.2f %10.2f %10.2f %10.2f %10.2f\n", name.c_str()
+				, (unsigned long long)h.count(), m_failures, (double)h.mean()/1000.0
+				, (double)h.percentile(50)/1000.0, (double)h.percentile(90)/1000.0
+				, (double)h.percentile(99)/1000.0, (double)h.max()/1000.0);
+	}
+	fflush(stdout);
+}
+
+
+static void printUsage() {
+	printf("Usage:\n"
+		" " APP_NAME "_e2e [-n <trials>] [--no-exec] [--server <server>]\n"
+		"\n"
+		"  -n, --trials <trials>           number of trials (default 1000)\n"
+		"  -w, --warmup <trials>           trials before the measurement (default 10)\n"
+		"      --no-exec                   run the invocation in a forked child\n"
+		"                                  without exec (the in-process code path)\n"
+		"      --server <server>           use a running server instead of starting a\n"
+		"                                  private one\n"
+		"      --binary <path>             " APP_NAME " binary (default ./" APP_NAME ")\n"
+		"      --timeout <ms>              timeout per trial (default 2000)\n"
+		"  -v, --verbose                   print debug messages\n"
+		"  -h, --help                      print this message\n"
+		"\n"
+		"each trial runs '" APP_NAME " -c <sink> -s <volume>' with alternating volumes\n"
+		"and measures the time from the start until the sink change with the new\n"
+		"volume arrives on a separate, subscribed connection (observed) and until\n"
+		"the process exited (exit).\n"
+		);
+}
+
+int main(int argc, char *argv[]) {
+	try {
+		CLog::getInstance().setConsoleLevel(WARN);
+		CLog::getInstance().setFileLevel(NONE);
+		CLog::getInstance().setLogDateTime(false);
+		CLog::getInstance().setLogSourceFileAll(false);
+		
+		CCommandLineParser parameters(argc, argv);
+		parameters.addSwitch("help", 'h');
+		parameters.addSwitch("verbose", 'v');
+		parameters.addSwitch("no-exec");
+		parameters.addParam("trials", 'n', "1000");
+		parameters.addParam("warmup", 'w', "10");
+		parameters.addParam("server");
+		parameters.addParam("binary", ' ', "./" APP_NAME);
+		parameters.addParam("timeout", ' ', "2000");
+		
+		ECLParsingResult result=parameters.parse();
+		if(result==Parse_unknown_command) {
+			printUsage();
+			printf("\n Unknown command: %s\n", parameters.getUnknownCommand().c_str());
+			return(-1);
+		}
+		if(parameters.getSwitch("help")) {
+			printUsage();
+			return(0);
+		}
+		if(parameters.getSwitch("verbose")) CLog::getInstance().setConsoleLevel(DEBUG);
+		
+		string s;
+		int trials, warmup, timeout;
+		parameters.getParam("trials", s);
+		ASSERT_THROW_e(isInteger(s, &trials) && trials>0, EINVALID_PARAMETER, "invalid number of trials %s", s.c_str());
+		parameters.getParam("warmup", s);
+		ASSERT_THROW_e(isInteger(s, &warmup) && warmup>=0, EINVALID_PARAMETER, "invalid number of warmup trials %s", s.c_str());
+		parameters.getParam("timeout", s);
+		ASSERT_THROW_e(isInteger(s, &timeout) && timeout>0, EINVALID_PARAMETER, "invalid timeout %s", s.c_str());
+		
+		bool bExec=!parameters.getSwitch("no-exec");
+		string binary;
+		parameters.getParam("binary", binary);
+		if(bExec) ASSERT_THROW_e(access(binary.c_str(), X_OK)==0, EINVALID_PARAMETER, "%s is not executable", binary.c_str());
+		
+		CPulseServer private_server;
+		string server;
+		if(!parameters.getParam("server", server)) {
+			ASSERT_THROW_e(private_server.start(1), EDEVICE, "failed to start pulseaudio");
+			server=private_server.server();
+		}
+		
+		CE2EHarness harness(server, binary, bExec, timeout);
+		harness.init();
+		harness.run((uint32_t)trials, (uint32_t)warmup);
+		harness.printResults();
+		
+	} catch(Exception& e) {
+		return(-1);
+	}
+	return(0);
+}
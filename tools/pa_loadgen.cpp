@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * load generator: starts a private pulseaudio server and fills it with null
+ * sinks and silent playback streams, each from its own client. this gives
+ * realistic object counts without sound hardware. the server address is
+ * printed on stdout, pacmdvolume can be pointed to it with --server.
+ */
+
+#include "pa_server.h"
+#include "../global.h"
+#include "../command_line.h"
+
+#include <csignal>
+#include <cstring>
+#include <pulse/pulseaudio.h>
+
+
+static volatile sig_atomic_t stop_requested=0;
+
+static void signalHandler(int) {
+	stop_requested=1;
+}
+
+/* roles assigned round-robin to the streams */
+static const char* stream_roles[]={ "music", "video", "game", "event", "phone", "animation" };
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CLoadGenerator
+ * loads the null sinks over a control connection and connects the streams.
+ * every stream has its own context, so it shows up as a separate client.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CLoadGenerator {
+public:
+	CLoadGenerator(uint32_t sinks, uint32_t streams, bool bCorked);
+	~CLoadGenerator();
+	
+	/* load the sinks & connect the streams, returns when the layout is
+	 * stable. throws on failure or timeout */
+	void setup(const string& server, int timeout_ms);
+	/* keep the streams playing until a signal arrives or duration_s passed
+	 * (0: no limit) */
+	void run(int duration_s);
+	
+private:
+	struct SClient {
+		CLoadGenerator* generator;
+		uint32_t id;
+		pa_context* context;
+		pa_stream* stream;
+	};
+	
+	/* iterate until *counter reaches target, checks for failures */
+	void waitFor(const uint32_t* counter, uint32_t target, uint64_t deadline, const char* what);
+	void iterate(int timeout_ms);
+	
+	void connectStream(SClient& client);
+	
+	static void controlStateCb(pa_context* c, void* userdata);
+	static void moduleLoadedCb(pa_context* c, uint32_t idx, void* userdata);
+	static void clientStateCb(pa_context* c, void* userdata);
+	static void streamStateCb(pa_stream* s, void* userdata);
+	static void streamWriteCb(pa_stream* s, size_t nbytes, void* userdata);
+	static void sinkCountCb(pa_context* c, const pa_sink_info* i, int eol, void* userdata);
+	static void sinkInputCountCb(pa_context* c, const pa_sink_input_info* i, int eol, void* userdata);
+	
+	uint32_t m_sinks;
+	uint32_t m_streams;
+	bool m_bCorked;
+	string m_server;
+	
+	pa_mainloop* m_mainloop;
+	pa_context* m_control;
+	vector<SClient> m_clients;
+	
+	uint32_t m_control_ready;
+	uint32_t m_modules_loaded;
+	uint32_t m_streams_ready;
+	uint32_t m_lists_done;
+	uint32_t m_server_sinks;
+	uint32_t m_server_sink_inputs;
+	string m_error; //set by the callbacks on failure
+};
+
+CLoadGenerator::CLoadGenerator(uint32_t sinks, uint32_t streams, bool bCorked)
+	: m_sinks(sinks), m_streams(streams), m_bCorked(bCorked), m_mainloop(NULL), m_control(NULL)
+	, m_control_ready(0), m_modules_loaded(0), m_streams_ready(0), m_lists_done(0)
+	, m_server_sinks(0), m_server_sink_inputs(0) {
+}
+
+CLoadGenerator::~CLoadGenerator() {
+	for(size_t i=0; i<m_clients.size(); ++i) {
+		if(m_clients[i].stream) {
+			pa_stream_disconnect(m_clients[i].stream);
+			pa_stream_unref(m_clients[i].stream);
+		}
+		pa_context_disconnect(m_clients[i].context);
+		pa_context_unref(m_clients[i].context);
+	}
+	if(m_control) {
+		pa_context_disconnect(m_control);
+		pa_context_unref(m_control);
+	}
+	if(m_mainloop) pa_mainloop_free(m_mainloop);
+}
+
+void CLoadGenerator::iterate(int timeout_ms) {
+	if(pa_mainloop_prepare(m_mainloop, timeout_ms*1000) < 0) return;
+	if(pa_mainloop_poll(m_mainloop) < 0) return;
+	pa_mainloop_dispatch(m_mainloop);
+}
+
+void CLoadGenerator::waitFor(const uint32_t* counter, uint32_t target, uint64_t deadline, const char* what) {
+	while(*counter<target) {
+		ASSERT_THROW_e(m_error.empty(), EDEVICE, "%s", m_error.c_str());
+		ASSERT_THROW_e(!stop_requested, EINTERRUPTED, "interrupted");
+		ASSERT_THROW_e(getTimeUsec()<deadline, ETIMEOUT, "timeout while waiting for %s (%u of %u)"
+				, what, *counter, target);
+		iterate(100);
+	}
+}
+
+void CLoadGenerator::setup(const string& server, int timeout_ms) {
+	ASSERT_THROW(m_mainloop==NULL, EALREADY_INITIALIZED);
+	m_server=server;
+	uint64_t deadline=getTimeUsec()+(uint64_t)timeout_ms*1000;
+	
+	ASSERT_THROW_e(m_mainloop=pa_mainloop_new(), EASSERT, "Failed to create PulseAudio MainLoop");
+	pa_mainloop_api* api=pa_mainloop_get_api(m_mainloop);
+	
+	/* control connection: loads the sinks & checks the layout */
+	ASSERT_THROW_e(m_control=pa_context_new(api, APP_NAME "_loadgen"), EDEVICE, "Failed to get a PulseAudio Context Object");
+	pa_context_set_state_callback(m_control, controlStateCb, this);
+	ASSERT_THROW_e(pa_context_connect(m_control, m_server.c_str(), PA_CONTEXT_NOAUTOSPAWN, NULL)>=0
+			, EDEVICE, "failed to connect to %s", m_server.c_str());
+	waitFor(&m_control_ready, 1, deadline, "the control connection");
+	
+	/* all module loads are issued at once */
+	for(uint32_t i=0; i<m_sinks; ++i) {
+		char args[256];
+		snprintf(args, sizeof(args), "sink_name=loadgen_sink_%u sink_properties=device.description=Loadgen_Sink_%u", i, i);
+		pa_operation* o=pa_context_load_module(m_control, "module-null-sink", args, moduleLoadedCb, this);
+		ASSERT_THROW_e(o, EDEVICE, "failed to load module-null-sink: %s", pa_strerror(pa_context_errno(m_control)));
+		pa_operation_unref(o);
+	}
+	waitFor(&m_modules_loaded, m_sinks, deadline, "the null sinks");
+	LOG(DEBUG, "%u null sinks loaded", m_sinks);
+	
+	/* one client per stream */
+	m_clients.resize(m_streams);
+	for(uint32_t i=0; i<m_streams; ++i) {
+		SClient& client=m_clients[i];
+		client.generator=this;
+		client.id=i;
+		client.stream=NULL;
+		
+		string name="loadgen client "+toStr(i);
+		pa_proplist* props=pa_proplist_new();
+		pa_proplist_sets(props, PA_PROP_APPLICATION_NAME, name.c_str());
+		pa_proplist_sets(props, PA_PROP_APPLICATION_ID, ("org.pacmdvolume.loadgen"+toStr(i)).c_str());
+		pa_proplist_sets(props, PA_PROP_APPLICATION_PROCESS_ID, toStr(100000+i).c_str());
+		pa_proplist_sets(props, PA_PROP_APPLICATION_PROCESS_BINARY, "loadgen");
+		client.context=pa_context_new_with_proplist(api, name.c_str(), props);
+		pa_proplist_free(props);
+		ASSERT_THROW_e(client.context, EDEVICE, "Failed to get a PulseAudio Context Object");
+		
+		pa_context_set_state_callback(client.context, clientStateCb, &client);
+		ASSERT_THROW_e(pa_context_connect(client.context, m_server.c_str(), PA_CONTEXT_NOAUTOSPAWN, NULL)>=0
+				, EDEVICE, "failed to connect client %u", i);
+	}
+	waitFor(&m_streams_ready, m_streams, deadline, "the playback streams");
+	LOG(DEBUG, "%u playback streams ready", m_streams);
+	
+	/* the layout is stable once the server reports all objects */
+	for(;;) {
+		m_lists_done=0;
+		m_server_sinks=m_server_sink_inputs=0;
+		pa_operation* o=pa_context_get_sink_info_list(m_control, sinkCountCb, this);
+		ASSERT_THROW_e(o, EDEVICE, "failed to get the sink list");
+		pa_operation_unref(o);
+		o=pa_context_get_sink_input_info_list(m_control, sinkInputCountCb, this);
+		ASSERT_THROW_e(o, EDEVICE, "failed to get the sink input list");
+		pa_operation_unref(o);
+		waitFor(&m_lists_done, 2, deadline, "the object lists");
+		
+		if(m_server_sinks>=m_sinks && m_server_sink_inputs>=m_streams) break;
+		iterate(10);
+	}
+}
+
+void CLoadGenerator::run(int duration_s) {
+	uint64_t end=getTimeUsec()+(uint64_t)duration_s*1000000;
+	while(!stop_requested && (duration_s<=0 || getTimeUsec()<end)) {
+		ASSERT_THROW_e(m_error.empty(), EDEVICE, "%s", m_error.c_str());
+		iterate(200);
+	}
+}
+
+void CLoadGenerator::connectStream(SClient& client) {
+	pa_sample_spec spec;
+	spec.format=PA_SAMPLE_S16LE;
+	spec.rate=44100;
+	spec.channels=2;
+	
+	string name="loadgen stream "+toStr(client.id);
+	pa_proplist* props=pa_proplist_new();
+	pa_proplist_sets(props, PA_PROP_MEDIA_NAME, name.c_str());
+	pa_proplist_sets(props, PA_PROP_MEDIA_ROLE, stream_roles[client.id%(sizeof(stream_roles)/sizeof(stream_roles[0]))]);
+	client.stream=pa_stream_new_with_proplist(client.context, name.c_str(), &spec, NULL, props);
+	pa_proplist_free(props);
+	if(!client.stream) {
+		m_error="failed to create stream "+toStr(client.id);
+		return;
+	}
+	pa_stream_set_state_callback(client.stream, streamStateCb, &client);
+	pa_stream_set_write_callback(client.stream, streamWriteCb, &client);
+	
+	/* large buffer: few wakeups per stream */
+	pa_buffer_attr attr;
+	attr.maxlength=(uint32_t)-1;
+	attr.tlength=(uint32_t)pa_usec_to_bytes(500*PA_USEC_PER_MSEC, &spec);
+	attr.prebuf=(uint32_t)-1;
+	attr.minreq=(uint32_t)pa_usec_to_bytes(200*PA_USEC_PER_MSEC, &spec);
+	attr.fragsize=(uint32_t)-1;
+	
+	string sink;
+	if(m_sinks>0) sink="loadgen_sink_"+toStr(client.id%m_sinks);
+	pa_stream_flags_t flags=m_bCorked ? PA_STREAM_START_CORKED : PA_STREAM_NOFLAGS;
+	if(pa_stream_connect_playback(client.stream, sink.empty() ? NULL : sink.c_str(), &attr, flags, NULL, NULL)<0) {
+		m_error="failed to connect stream "+toStr(client.id);
+	}
+}
+
+void CLoadGenerator::controlStateCb(pa_context* c, void* userdata) {
+	CLoadGenerator* generator=(CLoadGenerator*)userdata;
+	switch(pa_context_get_state(c)) {
+	case PA_CONTEXT_READY:
+		generator->m_control_ready=1;
+		break;
+	case PA_CONTEXT_FAILED:
+	case PA_CONTEXT_TERMINATED:
+		generator->m_error="control connection failed: "+string(pa_strerror(pa_context_errno(c)));
+		break;
+	default:
+		break;
+	}
+}
+
+void CLoadGenerator::moduleLoadedCb(pa_context* c, uint32_t idx, void* userdata) {
+	CLoadGenerator* generator=(CLoadGenerator*)userdata;
+	if(idx==PA_INVALID_INDEX) {
+		generator->m_error="failed to load module-null-sink: "+string(pa_strerror(pa_context_errno(c)));
+		return;
+	}
+	++generator->m_modules_loaded;
+}
+
+void CLoadGenerator::clientStateCb(pa_context* c, void* userdata) {
+	SClient* client=(SClient*)userdata;
+	switch(pa_context_get_state(c)) {
+	case PA_CONTEXT_READY:
+		client->generator->connectStream(*client);
+		break;
+	case PA_CONTEXT_FAILED:
+	case PA_CONTEXT_TERMINATED:
+		client->generator->m_error="client "+toStr(client->id)+" failed: "+string(pa_strerror(pa_context_errno(c)));
+		break;
+	default:
+		break;
+	}
+}
+
+void CLoadGenerator::streamStateCb(pa_stream* s, void* userdata) {
+	SClient* client=(SClient*)userdata;
+	switch(pa_stream_get_state(s)) {
+	case PA_STREAM_READY:
+		++client->generator->m_streams_ready;
+		break;
+	case PA_STREAM_FAILED:
+	case PA_STREAM_TERMINATED:
+		client->generator->m_error="stream "+toStr(client->id)+" failed";
+		break;
+	default:
+		break;
+	}
+}
+
+void CLoadGenerator::streamWriteCb(pa_stream* s, size_t nbytes, void*) {
+	static const char silence[16384]={ 0 };
+	while(nbytes>0) {
+		size_t n=min(nbytes, sizeof(silence));
+		if(pa_stream_write(s, silence, n, NULL, 0, PA_SEEK_RELATIVE)<0) return;
+		nbytes-=n;
+	}
+}
+
+void CLoadGenerator::sinkCountCb(pa_context*, const pa_sink_info*, int eol, void* userdata) {
+	CLoadGenerator* generator=(CLoadGenerator*)userdata;
+	if(eol) ++generator->m_lists_done;
+	else ++generator->m_server_sinks;
+}
+
+void CLoadGenerator::sinkInputCountCb(pa_context*, const pa_sink_input_info*, int eol, void* userdata) {
+	CLoadGenerator* generator=(CLoadGenerator*)userdata;
+	if(eol) ++generator->m_lists_done;
+	else ++generator->m_server_sink_inputs;
+}
+
+
+static void printUsage() {
+	printf("Usage:\n"
+		" " APP_NAME "_loadgen [-s <sinks>] [-n <streams>] [--corked] [-t <seconds>]\n"
+		"\n"
+		"  -s, --sinks <sinks>             number of null sinks (default 10)\n"
+		"  -n, --streams <streams>         number of playback streams, each from a\n"
+		"                                  separate client (default 20)\n"
+		"      --corked                    create the streams corked (no audio data)\n"
+		"      --server <server>           use a running server instead of starting a\n"
+		"                                  private one\n"
+		"  -t, --time <seconds>            exit after <seconds> (default: run until\n"
+		"                                  SIGINT/SIGTERM)\n"
+		"  -v, --verbose                   print debug messages\n"
+		"  -h, --help                      print this message\n"
+		"\n"
+		"on stdout, 'server <address>' is printed when the server is up and\n"
+		"'stable <sinks> <streams> <msec>' when all objects exist.\n"
+		);
+}
+
+static uint32_t uintParam(CCommandLineParser& parameters, const char* name, uint32_t def) {
+	string s;
+	if(!parameters.getParam(name, s)) return(def);
+	int val;
+	ASSERT_THROW_e(isInteger(s, &val) && val>=0, EINVALID_PARAMETER, "invalid value %s for --%s", s.c_str(), name);
+	return((uint32_t)val);
+}
+
+int main(int argc, char *argv[]) {
+	try {
+		CLog::getInstance().setConsoleLevel(WARN);
+		CLog::getInstance().setFileLevel(NONE);
+		CLog::getInstance().setLogDateTime(false);
+		CLog::getInstance().setLogSourceFileAll(false);
+		
+		CCommandLineParser parameters(argc, argv);
+		parameters.addSwitch("help", 'h');
+		parameters.addSwitch("verbose", 'v');
+		parameters.addSwitch("corked");
+		parameters.addParam("sinks", 's');
+		parameters.addParam("streams", 'n');
+		parameters.addParam("server");
+		parameters.addParam("time", 't');
+		
+		ECLParsingResult result=parameters.parse();
+		if(result==Parse_unknown_command) {
+			printUsage();
+			printf("\n Unknown command: %s\n", parameters.getUnknownCommand().c_str());
+			return(-1);
+		}
+		if(parameters.getSwitch("help")) {
+			printUsage();
+			return(0);
+		}
+		if(parameters.getSwitch("verbose")) CLog::getInstance().setConsoleLevel(DEBUG);
+		
+		uint32_t sinks=uintParam(parameters, "sinks", 10);
+		uint32_t streams=uintParam(parameters, "streams", 20);
+		int duration=(int)uintParam(parameters, "time", 0);
+		
+		signal(SIGINT, signalHandler);
+		signal(SIGTERM, signalHandler);
+		
+		uint64_t start=getTimeUsec();
+		
+		CPulseServer private_server;
+		string server;
+		if(!parameters.getParam("server", server)) {
+			ASSERT_THROW_e(private_server.start(0), EDEVICE, "failed to start pulseaudio");
+			server=private_server.server();
+		}
+		printf("server %s\n", server.c_str());
+		fflush(stdout);
+		
+		CLoadGenerator generator(sinks, streams, parameters.getSwitch("corked"));
+		generator.setup(server, 60000+(int)(sinks+streams)*100);
+		printf("stable %u %u %llu\n", sinks, streams, (unsigned long long)(getTimeUsec()-start)/1000);
+		fflush(stdout);
+		
+		generator.run(duration);
+		
+	} catch(Exception& e) {
+		return(-1);
+	}
+	return(0);
+}
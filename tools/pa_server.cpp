@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "pa_server.h"
+
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CPulseServer
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+CPulseServer::CPulseServer() : m_pid(-1) {
+}
+
+CPulseServer::~CPulseServer() {
+	stop();
+}
+
+bool CPulseServer::start(uint32_t null_sinks, int timeout_ms) {
+	ASSERT_THROW(m_pid<=0, EALREADY_INITIALIZED);
+	
+	char dir[]="/tmp/" APP_NAME "-server-XXXXXX";
+	if(!mkdtemp(dir)) {
+		LOG(ERROR, "failed to create a temporary directory");
+		return(false);
+	}
+	m_dir=dir;
+	string socket=m_dir+"/native";
+	string script=m_dir+"/server.pa";
+	m_server="unix:"+socket;
+	
+	/* the protocol module is loaded last, so all sinks exist when the socket appears */
+	FILE* file=fopen(script.c_str(), "w");
+	if(!file) {
+		LOG(ERROR, "failed to write %s", script.c_str());
+		stop();
+		return(false);
+	}
+	for(uint32_t i=0; i<null_sinks; ++i) {
+		fprintf(file, "load-module module-null-sink sink_name=bench_sink_%u "
+				"sink_properties=device.description=Bench_Sink_%u\n", i, i);
+	}
+	fprintf(file, "load-module module-native-protocol-unix socket=%s auth-anonymous=1\n", socket.c_str());
+	fclose(file);
+	
+	m_pid=fork();
+	if(m_pid<0) {
+		LOG(ERROR, "fork failed");
+		stop();
+		return(false);
+	}
+	if(m_pid==0) {
+		/* keep the server away from the user's runtime & state directories */
+		setenv("PULSE_RUNTIME_PATH", m_dir.c_str(), 1);
+		setenv("PULSE_STATE_PATH", m_dir.c_str(), 1);
+		setenv("XDG_RUNTIME_DIR", m_dir.c_str(), 1);
+		setenv("XDG_CONFIG_HOME", m_dir.c_str(), 1);
+		int null_fd=open("/dev/null", O_RDWR);
+		if(null_fd>=0) {
+			dup2(null_fd, STDIN_FILENO);
+			dup2(null_fd, STDOUT_FILENO);
+			dup2(null_fd, STDERR_FILENO);
+		}
+		execlp("pulseaudio", "pulseaudio", "-n", "-F", script.c_str(), "--daemonize=no"
+				, "--exit-idle-time=-1", "--use-pid-file=no", "--system=no"
+				, "--disallow-exit", (char*)NULL);
+		_exit(127);
+	}
+	
+	uint64_t deadline=getTimeUsec()+(uint64_t)timeout_ms*1000;
+	struct stat st;
+	while(stat(socket.c_str(), &st)!=0) {
+		int status;
+		if(waitpid(m_pid, &status, WNOHANG)==m_pid) {
+			LOG(ERROR, "pulseaudio exited with status %i", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+			m_pid=-1;
+			stop();
+			return(false);
+		}
+		if(getTimeUsec()>deadline) {
+			LOG(ERROR, "timeout while waiting for pulseaudio");
+			stop();
+			return(false);
+		}
+		usleep(10000);
+	}
+	return(true);
+}
+
+void CPulseServer::stop() {
+	if(m_pid>0) {
+		kill(m_pid, SIGTERM);
+		waitpid(m_pid, NULL, 0);
+		m_pid=-1;
+	}
+	if(!m_dir.empty()) {
+		string cmd="rm -rf '"+m_dir+"'";
+		if(system(cmd.c_str())!=0) LOG(WARN, "failed to remove %s", m_dir.c_str());
+		m_dir="";
+	}
+	m_server="";
+}
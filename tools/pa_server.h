@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef PA_SERVER_H_
+#define PA_SERVER_H_
+
+#include "../global.h"
+#include <sys/types.h>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CPulseServer
+ * private pulseaudio instance (pulseaudio -n) in a temporary directory,
+ * loaded with null sinks only. it does not touch the user's server.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CPulseServer {
+public:
+	CPulseServer();
+	~CPulseServer();
+	
+	/* start the server with null_sinks module-null-sink's and wait until it
+	 * accepts connections. returns false if pulseaudio could not be started */
+	bool start(uint32_t null_sinks, int timeout_ms=10000);
+	void stop();
+	
+	bool running() const { return(m_pid>0); }
+	pid_t pid() const { return(m_pid); }
+	/* server string for pa_context_connect() */
+	const string& server() const { return(m_server); }
+	
+private:
+	pid_t m_pid;
+	string m_dir;
+	string m_server;
+};
+
+
+#endif /* PA_SERVER_H_ */
@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * concurrency stress harness: runs bursts of K parallel pacmdvolume
+ * processes against one server, like several hotkey daemons, status bars
+ * and cron jobs firing at the same moment. it measures the latency of the
+ * invocations and the cpu time & context switches of the server during the
+ * bursts.
+ */
+
+#include "pa_server.h"
+#include "../global.h"
+#include "../command_line.h"
+#include "../latency_histogram.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+
+/* cpu & scheduling counters of a process */
+struct SProcStat {
+	SProcStat() : cpu_ticks(0), voluntary_ctxt_switches(0), nonvoluntary_ctxt_switches(0) {}
+	
+	uint64_t cpu_ticks; //utime + stime
+	uint64_t voluntary_ctxt_switches;
+	uint64_t nonvoluntary_ctxt_switches;
+};
+
+/* read /proc/<pid>/stat & /proc/<pid>/status, returns false on failure */
+static bool readProcStat(pid_t pid, SProcStat& stat) {
+	string path="/proc/"+toStr(pid);
+	
+	ifstream stat_file((path+"/stat").c_str());
+	string line;
+	if(!getline(stat_file, line)) return(false);
+	/* the command name can contain spaces, so start after its closing ')' */
+	size_t pos=line.rfind(')');
+	if(pos==string::npos) return(false);
+	istringstream fields(line.substr(pos+1));
+	string field;
+	uint64_t utime=0, stime=0;
+	for(int i=3; i<=15 && (fields >> field); ++i) { //field numbers as in proc(5)
+		if(i==14) utime=strtoull(field.c_str(), NULL, 10);
+		if(i==15) stime=strtoull(field.c_str(), NULL, 10);
+	}
+	stat.cpu_ticks=utime+stime;
+	
+	ifstream status_file((path+"/status").c_str());
+	while(getline(status_file, line)) {
+		unsigned long long val;
+		if(sscanf(line.c_str(), "voluntary_ctxt_switches: %llu", &val)==1) stat.voluntary_ctxt_switches=val;
+		else if(sscanf(line.c_str(), "nonvoluntary_ctxt_switches: %llu", &val)==1) stat.nonvoluntary_ctxt_switches=val;
+	}
+	return(true);
+}
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CStressRunner
+ * spawns the bursts and collects the results of one concurrency level
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CStressRunner {
+public:
+	CStressRunner(const vector<string>& command, pid_t server_pid);
+	
+	/* run bursts of parallel invocations & print one result line */
+	void run(uint32_t parallel, uint32_t bursts);
+	
+	static void printHeader();
+	
+private:
+	/* returns the duration of the burst in usec */
+	uint64_t burst(uint32_t parallel);
+	pid_t spawn();
+	
+	vector<string> m_command;
+	pid_t m_server_pid;
+	
+	CLatencyHistogram m_latency; //usec per invocation
+	uint64_t m_failures;
+	uint64_t m_client_cpu_usec;
+};
+
+CStressRunner::CStressRunner(const vector<string>& command, pid_t server_pid)
+	: m_command(command), m_server_pid(server_pid), m_failures(0), m_client_cpu_usec(0) {
+}
+
+void CStressRunner::printHeader() {
+	printf("%-8s %7s %8s %10s %9s %9s %9s %9s %12s %12s %8s\n", "# K", "bursts", "ops", "ops/s"
+			, "p50_ms", "p90_ms", "p99_ms", "max_ms", "srv_cpu_us", "srv_ctxsw", "failed");
+	printf("%-8s %7s %8s %10s %9s %9s %9s %9s %12s %12s %8s\n", "#", "", "", ""
+			, "", "", "", "", "per op", "per op", "");
+	fflush(stdout);
+}
+
+pid_t CStressRunner::spawn() {
+	vector<char*> argv;
+	for(size_t i=0; i<m_command.size(); ++i) argv.push_back(const_cast<char*>(m_command[i].c_str()));
+	argv.push_back(NULL);
+	
+	pid_t pid=fork();
+	ASSERT_THROW_e(pid>=0, EGENERAL, "fork failed");
+	if(pid==0) {
+		int null_fd=open("/dev/null", O_RDWR);
+		if(null_fd>=0) {
+			dup2(null_fd, STDOUT_FILENO);
+			dup2(null_fd, STDERR_FILENO);
+		}
+		execv(argv[0], &argv[0]);
+		_exit(127);
+	}
+	return(pid);
+}
+
+uint64_t CStressRunner::burst(uint32_t parallel) {
+	map<pid_t, uint64_t> running; //pid -> start time
+	uint64_t start=getTimeUsec();
+	for(uint32_t i=0; i<parallel; ++i) {
+		pid_t pid=spawn();
+		running[pid]=getTimeUsec();
+	}
+	
+	while(!running.empty()) {
+		int status;
+		struct rusage usage;
+		pid_t pid=wait4(-1, &status, 0, &usage);
+		if(pid<0) break;
+		uint64_t end=getTimeUsec();
+		map<pid_t, uint64_t>::iterator iter=running.find(pid);
+		if(iter==running.end()) continue;
+		
+		m_latency.record(end-iter->second);
+		m_client_cpu_usec+=(uint64_t)(usage.ru_utime.tv_sec+usage.ru_stime.tv_sec)*1000000
+				+usage.ru_utime.tv_usec+usage.ru_stime.tv_usec;
+		if(!WIFEXITED(status) || WEXITSTATUS(status)!=0) ++m_failures;
+		running.erase(iter);
+	}
+	return(getTimeUsec()-start);
+}
+
+void CStressRunner::run(uint32_t parallel, uint32_t bursts) {
+	m_latency.reset();
+	m_failures=0;
+	m_client_cpu_usec=0;
+	
+	SProcStat before, after;
+	bool bServer_stats=m_server_pid>0 && readProcStat(m_server_pid, before);
+	
+	uint64_t busy_usec=0;
+	for(uint32_t i=0; i<bursts; ++i) busy_usec+=burst(parallel);
+	
+	bServer_stats=bServer_stats && readProcStat(m_server_pid, after);
+	
+	uint64_t ops=m_latency.count();
+	double ops_per_sec=busy_usec>0 ? (double)ops*1000000.0/(double)busy_usec : 0.0;
+	
+	char server_cpu[32]="-", server_ctxsw[32]="-";
+	if(bServer_stats && ops>0) {
+		double tick_usec=1000000.0/(double)sysconf(_SC_CLK_TCK);
+		snprintf(server_cpu, sizeof(server_cpu), "%.1f", (double)(after.cpu_ticks-before.cpu_ticks)*tick_usec/(double)ops);
+		uint64_t switches=(after.voluntary_ctxt_switches-before.voluntary_ctxt_switches)
+				+(after.nonvoluntary_ctxt_switches-before.nonvoluntary_ctxt_switches);
+		snprintf(server_ctxsw, sizeof(server_ctxsw), "%.1f", (double)switches/(double)ops);
+	}
+	
+	printf("%-8u %7u %8llu %10.1f %9.2f %9.2f %9.2f %9.2f %12s %12s %8llu\n", parallel, bursts
+			, (unsigned long long)ops, ops_per_sec
+			, (double)m_latency.percentile(50)/1000.0, (double)m_latency.percentile(90)/1000.0
+			, (double)m_latency.percentile(99)/1000.0, (double)m_latency.max()/1000.0
+			, server_cpu, server_ctxsw, (unsigned long long)m_failures);
+	LOG(DEBUG, "K=%u: client cpu %.1f us per op", parallel, ops>0 ? (double)m_client_cpu_usec/(double)ops : 0.0);
+	fflush(stdout);
+}
+
+
+static void printUsage() {
+	printf("Usage:\n"
+		" " APP_NAME "_stress [-k <list>] [-b <bursts>] [-s <sinks>] [-c <args>]\n"
+		"\n"
+		"  -k, --parallel <list>           comma-separated concurrency levels\n"
+		"                                  (default 1,2,4,8,16,32)\n"
+		"  -b, --bursts <bursts>           bursts per concurrency level (default 20)\n"
+		"  -s, --sinks <sinks>             null sinks of the private server (default 10)\n"
+		"      --server <server>           use a running server instead of starting a\n"
+		"                                  private one\n"
+		"      --server-pid <pid>          pid of that server for the cpu accounting\n"
+		"      --binary <path>             " APP_NAME " binary (default ./" APP_NAME ")\n"
+		"  -c, --command <args>            arguments of each invocation, separated by\n"
+		"                                  spaces (default '--list-sink')\n"
+		"  -v, --verbose                   print debug messages\n"
+		"  -h, --help                      print this message\n"
+		"\n"
+		"one line per concurrency level K is printed: throughput, latency\n"
+		"percentiles of the invocations and the server cpu time & context switches\n"
+		"per invocation (read from /proc/<pid>/stat and /proc/<pid>/status).\n"
+		);
+}
+
+static void parseUIntList(const string& str, vector<uint32_t>& v) {
+	string s=str+",";
+	int val;
+	while(s.length()>0) {
+		if(sscanf(s.c_str(), "%i", &val)==1 && val>0) v.push_back((uint32_t)val);
+		s=s.substr(s.find(',')+1);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	try {
+		CLog::getInstance().setConsoleLevel(WARN);
+		CLog::getInstance().setFileLevel(NONE);
+		CLog::getInstance().setLogDateTime(false);
+		CLog::getInstance().setLogSourceFileAll(false);
+		
+		CCommandLineParser parameters(argc, argv);
+		parameters.addSwitch("help", 'h');
+		parameters.addSwitch("verbose", 'v');
+		parameters.addParam("parallel", 'k', "1,2,4,8,16,32");
+		parameters.addParam("bursts", 'b', "20");
+		parameters.addParam("sinks", 's', "10");
+		parameters.addParam("server");
+		parameters.addParam("server-pid");
+		parameters.addParam("binary", ' ', "./" APP_NAME);
+		parameters.addParam("command", 'c', "--list-sink");
+		
+		ECLParsingResult result=parameters.parse();
+		if(result==Parse_unknown_command) {
+			printUsage();
+			printf("\n Unknown command: %s\n", parameters.getUnknownCommand().c_str());
+			return(-1);
+		}
+		if(parameters.getSwitch("help")) {
+			printUsage();
+			return(0);
+		}
+		if(parameters.getSwitch("verbose")) CLog::getInstance().setConsoleLevel(DEBUG);
+		
+		string s;
+		vector<uint32_t> levels;
+		parameters.getParam("parallel", s);
+		parseUIntList(s, levels);
+		ASSERT_THROW_e(!levels.empty(), EINVALID_PARAMETER, "invalid concurrency levels %s", s.c_str());
+		int bursts, sinks;
+		parameters.getParam("bursts", s);
+		ASSERT_THROW_e(isInteger(s, &bursts) && bursts>0, EINVALID_PARAMETER, "invalid number of bursts %s", s.c_str());
+		parameters.getParam("sinks", s);
+		ASSERT_THROW_e(isInteger(s, &sinks) && sinks>=0, EINVALID_PARAMETER, "invalid number of sinks %s", s.c_str());
+		
+		string binary;
+		parameters.getParam("binary", binary);
+		ASSERT_THROW_e(access(binary.c_str(), X_OK)==0, EINVALID_PARAMETER, "%s is not executable", binary.c_str());
+		
+		CPulseServer private_server;
+		string server;
+		pid_t server_pid=-1;
+		if(parameters.getParam("server", server)) {
+			int pid;
+			if(parameters.getParam("server-pid", s) && isInteger(s, &pid)) server_pid=pid;
+		} else {
+			ASSERT_THROW_e(private_server.start(sinks), EDEVICE, "failed to start pulseaudio");
+			server=private_server.server();
+			server_pid=private_server.pid();
+		}
+		
+		vector<string> command;
+		command.push_back(binary);
+		command.push_back("--server");
+		command.push_back(server);
+		parameters.getParam("command", s);
+		istringstream args(s);
+		string arg;
+		while(args >> arg) command.push_back(arg);
+		
+		CStressRunner runner(command, server_pid);
+		CStressRunner::printHeader();
+		for(size_t i=0; i<levels.size(); ++i) runner.run(levels[i], (uint32_t)bursts);
+		
+	} catch(Exception& e) {
+		return(-1);
+	}
+	return(0);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include "trace.h"
+#include "global.h"
+
+#include <cstdio>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CTrace
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool CTrace::m_bEnabled = false;
+CTrace::Instance CTrace::m_instance;
+
+
+CTrace::CTrace() : m_start_time(0) {
+}
+
+CTrace::~CTrace() {
+	close();
+}
+
+void CTrace::open(const string& file) {
+	close();
+	lock_guard<mutex> lock(m_mutex);
+	m_file = file;
+	m_spans.clear();
+	m_spans.reserve(1024);
+	m_start_time = getTimeUsec();
+	m_bEnabled = true;
+}
+
+void CTrace::span(const char* name, uint64_t start, uint64_t end, uint32_t index, bool success) {
+	if(!m_bEnabled) return;
+
+	static thread_local int thread = (int)syscall(SYS_gettid);
+	SSpan s;
+	s.name = name;
+	s.start = start;
+	s.end = end;
+	s.index = index;
+	s.success = success;
+	s.thread = thread;
+	lock_guard<mutex> lock(m_mutex);
+	m_spans.push_back(s);
+}
+
+void CTrace::close() {
+	if(!m_bEnabled) return;
+	m_bEnabled = false;
+	lock_guard<mutex> lock(m_mutex);
+
+	FILE* file = fopen(m_file.c_str(), "w");
+	if(!file) {
+		LOG(ERROR, "failed to open trace file %s", m_file.c_str());
+		return;
+	}
+
+	int pid = (int)getpid();
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for(size_t i=0; i<m_spans.size(); ++i) {
+		const SSpan& s = m_spans[i];
+		uint64_t start = s.start > m_start_time ? s.start - m_start_time : 0;
+		uint64_t end = s.end > m_start_time ? s.end - m_start_time : 0;
+
+		fprintf(file, "{\"name\":\"%s\",\"cat\":\"pa\",\"ph\":\"b\",\"id\":%u,"
+				"\"pid\":%i,\"tid\":%i,\"ts\":%llu},\n"
+				, s.name, (unsigned)i, pid, s.thread, (unsigned long long)start);
+		fprintf(file, "{\"name\":\"%s\",\"cat\":\"pa\",\"ph\":\"e\",\"id\":%u,"
+				"\"pid\":%i,\"tid\":%i,\"ts\":%llu,\"args\":{"
+				, s.name, (unsigned)i, pid, s.thread, (unsigned long long)end);
+		if(s.index != (uint32_t)-1) fprintf(file, "\"index\":%u,", s.index);
+		fprintf(file, "\"success\":%s}}%s\n", s.success ? "true" : "false"
+				, i+1 < m_spans.size() ? "," : "");
+	}
+	fprintf(file, "]}\n");
+	fclose(file);
+
+	m_spans.clear();
+}
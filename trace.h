@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2010-2011 Beat Küng <beat-kueng@gmx.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+using namespace std;
+
+
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+ ** class CTrace
+ * records timing spans (eg. of pulseaudio operations) and writes them as
+ * chrome trace json, which can be loaded in chrome://tracing or perfetto.
+ *
+ * spans are written as async events, so overlapping operations show up in
+ * separate rows. span() can be called from several threads, every thread
+ * gets its own track. when tracing is off, the only cost is a check of a
+ * static bool.
+/*////////////////////////////////////////////////////////////////////////////////////////////////
+
+class CTrace {
+public:
+	static CTrace& getInstance() {
+		return(m_instance.trace ? *m_instance.trace : *(m_instance.trace=new CTrace()));
+	}
+
+	static bool enabled() { return(m_bEnabled); }
+
+	/* start recording. the file is written on close() or at program exit */
+	void open(const string& file);
+	void close();
+
+	/* name must be a static string. start & end from getTimeUsec().
+	 * index can be PA_INVALID_INDEX if the span has no object */
+	void span(const char* name, uint64_t start, uint64_t end, uint32_t index, bool success);
+
+private:
+	CTrace();
+	~CTrace();
+
+	struct SSpan {
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+		uint32_t index;
+		bool success;
+		int thread; //kernel thread id
+	};
+
+	mutex m_mutex; //protects m_spans
+	vector<SSpan> m_spans;
+	string m_file;
+	uint64_t m_start_time;
+
+	static bool m_bEnabled;
+
+	struct Instance {
+		Instance() : trace(NULL) {}
+		~Instance() { if(trace) delete(trace); }
+		CTrace* trace;
+	};
+	static Instance m_instance;
+};
+
+
+#endif /* TRACE_H_ */